@@ -0,0 +1,339 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: aimPreview.cpp
+//
+// Desc: Predicted path of the cue ball while the player aims.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "aimPreview.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+namespace
+{
+	// ballUpdate moves TIME_SCALE * v * dt per tick and decays v by
+	// (1 - DECREASE_RATE) * 400 * v * dt, so the speed drops by
+	// 1 / PREVIEW_TRAVEL per unit of distance
+	const float PREVIEW_TRAVEL = TIME_SCALE / (float)((1 - DECREASE_RATE) * 400);
+	const float PREVIEW_MIN_SPEED = 0.01f;
+	const float CONTACT = 2 * (float)M_RADIUS;
+
+	long long aimKey(float x, float z)
+	{
+		long long qx = (long long)floor(x / PREVIEW_AIM_STEP + 0.5f);
+		long long qz = (long long)floor(z / PREVIEW_AIM_STEP + 0.5f);
+		return (qx << 32) ^ (qz & 0xffffffff);
+	}
+}
+
+CAimPreview::CAimPreview(void)
+{
+	m_hasBalls = false;
+	m_cue = 0;
+	m_limitX = m_limitZ = 0;
+	m_cellSize = 2 * CONTACT;
+	m_gridW = m_gridH = 0;
+	m_key = 0;
+	m_tracing = false;
+	m_px = m_pz = m_dx = m_dz = m_speed = 0;
+	m_contacts = 0;
+	m_ignore = -1;
+	m_segEnd = 0;
+	m_segWall = -1;
+	m_cx = m_cz = m_stepX = m_stepZ = 0;
+	m_tMaxX = m_tMaxZ = m_tDeltaX = m_tDeltaZ = 0;
+	m_bestT = 0;
+	m_bestBall = -1;
+	m_work = 0;
+	m_historyNext = 0;
+	m_traces = m_cancelled = m_reused = 0;
+}
+
+int CAimPreview::cellX(float x) const
+{
+	int c = (int)floor((x + m_limitX + (float)M_RADIUS) / m_cellSize);
+	return std::min(std::max(c, 0), m_gridW - 1);
+}
+
+int CAimPreview::cellZ(float z) const
+{
+	int c = (int)floor((z + m_limitZ + (float)M_RADIUS) / m_cellSize);
+	return std::min(std::max(c, 0), m_gridH - 1);
+}
+
+void CAimPreview::setBalls(const float* x, const float* z, const int* type, const unsigned char* active,
+	unsigned int count, unsigned int cue, float halfX, float halfZ)
+{
+	m_x.assign(x, x + count);
+	m_z.assign(z, z + count);
+	m_static.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		m_static[i] = type[i] == ENTITY_OBSTACLE ? 1 : 0;
+	m_cue = cue;
+	m_limitX = halfX - (float)M_RADIUS;
+	m_limitZ = halfZ - (float)M_RADIUS;
+
+	// a ball goes into every cell its contact disc touches, at most four
+	m_gridW = std::max(1, (int)ceil(2 * halfX / m_cellSize));
+	m_gridH = std::max(1, (int)ceil(2 * halfZ / m_cellSize));
+	m_cellStart.assign((size_t)m_gridW * m_gridH + 1, 0);
+	for (int pass = 0; pass < 2; pass++) {
+		for (unsigned int i = 0; i < count; i++) {
+			if (i == cue || !active[i])
+				continue;
+			int x0 = cellX(x[i] - CONTACT), x1 = cellX(x[i] + CONTACT);
+			int z0 = cellZ(z[i] - CONTACT), z1 = cellZ(z[i] + CONTACT);
+			for (int cz = z0; cz <= z1; cz++) {
+				for (int cx = x0; cx <= x1; cx++) {
+					size_t cell = (size_t)cz * m_gridW + cx;
+					if (pass == 0)
+						m_cellStart[cell + 1]++;
+					else
+						m_cellBalls[m_cellStart[cell]++] = i;
+				}
+			}
+		}
+		if (pass == 0) {
+			for (size_t c = 1; c < m_cellStart.size(); c++)
+				m_cellStart[c] += m_cellStart[c - 1];
+			m_cellBalls.resize(m_cellStart.back());
+		}
+		else {
+			// the fill advanced every start to the next cell's
+			for (size_t c = m_cellStart.size() - 1; c > 0; c--)
+				m_cellStart[c] = m_cellStart[c - 1];
+			m_cellStart[0] = 0;
+		}
+	}
+
+	m_hasBalls = true;
+	m_tracing = false;
+	m_segments.clear();
+	m_key = 0;
+	for (unsigned int h = 0; h < PREVIEW_HISTORY; h++)
+		m_history[h].segments.clear();
+}
+
+void CAimPreview::clear(void)
+{
+	if (m_tracing)
+		m_cancelled++;
+	m_hasBalls = false;
+	m_tracing = false;
+	m_segments.clear();
+}
+
+void CAimPreview::aim(float targetX, float targetZ)
+{
+	if (!m_hasBalls)
+		return;
+
+	long long key = aimKey(targetX, targetZ);
+	if (key == m_key && (m_tracing || !m_segments.empty()))
+		return;
+	if (m_tracing)
+		m_cancelled++;
+	m_key = key;
+	m_tracing = false;
+	m_segments.clear();
+
+	for (unsigned int h = 0; h < PREVIEW_HISTORY; h++) {
+		if (m_history[h].key == key && !m_history[h].segments.empty()) {
+			m_segments = m_history[h].segments;
+			m_reused++;
+			return;
+		}
+	}
+
+	// VK_SPACE: power is the distance to the target
+	m_px = m_x[m_cue];
+	m_pz = m_z[m_cue];
+	float dx = targetX - m_px, dz = targetZ - m_pz;
+	m_speed = sqrtf(dx * dx + dz * dz);
+	if (m_speed <= PREVIEW_MIN_SPEED)
+		return;
+	m_dx = dx / m_speed;
+	m_dz = dz / m_speed;
+	m_contacts = 0;
+	m_ignore = -1;
+	m_tracing = true;
+	m_traces++;
+	startSegment();
+}
+
+// distance along (dx, dz) to the cushion limit, and which axis it is on
+float CAimPreview::exitDistance(float px, float pz, float dx, float dz, int* axis) const
+{
+	float tx = dx > 0 ? (m_limitX - px) / dx : dx < 0 ? (-m_limitX - px) / dx : FLT_MAX;
+	float tz = dz > 0 ? (m_limitZ - pz) / dz : dz < 0 ? (-m_limitZ - pz) / dz : FLT_MAX;
+	if (axis != NULL)
+		*axis = tx <= tz ? 0 : 1;
+	return std::max(0.0f, std::min(tx, tz));
+}
+
+void CAimPreview::startSegment(void)
+{
+	int axis;
+	float wall = exitDistance(m_px, m_pz, m_dx, m_dz, &axis);
+	float stop = m_speed * PREVIEW_TRAVEL;
+	m_segEnd = std::min(wall, stop);
+	m_segWall = wall <= stop ? axis : -1;
+	m_bestT = m_segEnd;
+	m_bestBall = -1;
+
+	// grid walk in the usual DDA form: distance to the next cell edge on
+	// each axis, and the distance between edges
+	m_cx = cellX(m_px);
+	m_cz = cellZ(m_pz);
+	float gx = m_px + m_limitX + (float)M_RADIUS;
+	float gz = m_pz + m_limitZ + (float)M_RADIUS;
+	m_stepX = m_dx > 0 ? 1 : -1;
+	m_stepZ = m_dz > 0 ? 1 : -1;
+	if (m_dx != 0) {
+		float edge = (m_cx + (m_dx > 0 ? 1 : 0)) * m_cellSize;
+		m_tMaxX = (edge - gx) / m_dx;
+		m_tDeltaX = m_cellSize / fabsf(m_dx);
+	}
+	else
+		m_tMaxX = m_tDeltaX = FLT_MAX;
+	if (m_dz != 0) {
+		float edge = (m_cz + (m_dz > 0 ? 1 : 0)) * m_cellSize;
+		m_tMaxZ = (edge - gz) / m_dz;
+		m_tDeltaZ = m_cellSize / fabsf(m_dz);
+	}
+	else
+		m_tMaxZ = m_tDeltaZ = FLT_MAX;
+}
+
+// first contact along the ray with the balls listed in one cell
+void CAimPreview::visitCell(int cell)
+{
+	for (unsigned int k = m_cellStart[cell]; k < m_cellStart[cell + 1]; k++) {
+		unsigned int i = m_cellBalls[k];
+		if ((int)i == m_ignore)
+			continue;
+		float ox = m_px - m_x[i], oz = m_pz - m_z[i];
+		float b = ox * m_dx + oz * m_dz;
+		if (b >= 0)
+			continue;		// not moving towards it
+		float c = ox * ox + oz * oz - CONTACT * CONTACT;
+		float t;
+		if (c <= 0)
+			t = 0;			// already touching
+		else {
+			float disc = b * b - c;
+			if (disc < 0)
+				continue;
+			t = -b - sqrtf(disc);
+		}
+		if (t < m_bestT) {
+			m_bestT = t;
+			m_bestBall = (int)i;
+		}
+	}
+	m_work += 1 + m_cellStart[cell + 1] - m_cellStart[cell];
+}
+
+// the contact that ends the segment, then the next segment or the end
+void CAimPreview::finishSegment(void)
+{
+	PreviewSegment s;
+	s.x0 = m_px;
+	s.z0 = m_pz;
+	s.x1 = m_px + m_bestT * m_dx;
+	s.z1 = m_pz + m_bestT * m_dz;
+	s.ball = (int)m_cue;
+	m_segments.push_back(s);
+
+	m_px = s.x1;
+	m_pz = s.z1;
+	m_speed -= m_bestT / PREVIEW_TRAVEL;
+	float vx = m_speed * m_dx, vz = m_speed * m_dz;
+
+	if (m_bestBall >= 0) {
+		// CSphere::hitBy: normal parts swap, or reflect off an obstacle
+		unsigned int j = (unsigned int)m_bestBall;
+		float nx = m_px - m_x[j], nz = m_pz - m_z[j];
+		float len = sqrtf(nx * nx + nz * nz);
+		nx /= len;
+		nz /= len;
+		float vn = vx * nx + vz * nz;
+		if (m_static[j]) {
+			vx -= 2 * vn * nx;
+			vz -= 2 * vn * nz;
+		}
+		else {
+			vx -= vn * nx;
+			vz -= vn * nz;
+
+			PreviewSegment o;
+			o.x0 = m_x[j];
+			o.z0 = m_z[j];
+			float odx = -nx, odz = -nz;
+			float reach = std::min(-vn * PREVIEW_TRAVEL, exitDistance(o.x0, o.z0, odx, odz, NULL));
+			o.x1 = o.x0 + reach * odx;
+			o.z1 = o.z0 + reach * odz;
+			o.ball = (int)j;
+			m_segments.push_back(o);
+		}
+		m_ignore = (int)j;
+	}
+	else if (m_segWall == 0) {
+		vx = -vx;
+		m_ignore = -1;
+	}
+	else if (m_segWall == 1) {
+		vz = -vz;
+		m_ignore = -1;
+	}
+	else {
+		m_tracing = false;		// stopped on the cloth
+		return;
+	}
+
+	m_contacts++;
+	m_speed = sqrtf(vx * vx + vz * vz);
+	if (m_contacts >= PREVIEW_MAX_CONTACTS || m_speed <= PREVIEW_MIN_SPEED) {
+		m_tracing = false;
+		return;
+	}
+	m_dx = vx / m_speed;
+	m_dz = vz / m_speed;
+	startSegment();
+}
+
+bool CAimPreview::advance(unsigned int budget)
+{
+	bool wasTracing = m_tracing;
+	m_work = 0;
+	while (m_tracing && m_work < budget) {
+		visitCell(m_cz * m_gridW + m_cx);
+
+		// a hit before this cell's exit cannot be beaten by a later cell
+		float exitT = std::min(m_tMaxX, m_tMaxZ);
+		if (m_bestT <= exitT || exitT >= m_segEnd) {
+			finishSegment();
+			continue;
+		}
+		if (m_tMaxX < m_tMaxZ) {
+			m_cx += m_stepX;
+			m_tMaxX += m_tDeltaX;
+		}
+		else {
+			m_cz += m_stepZ;
+			m_tMaxZ += m_tDeltaZ;
+		}
+		if (m_cx < 0 || m_cx >= m_gridW || m_cz < 0 || m_cz >= m_gridH)
+			finishSegment();
+	}
+
+	if (wasTracing && !m_tracing) {
+		Finished& f = m_history[m_historyNext];
+		f.key = m_key;
+		f.segments = m_segments;
+		m_historyNext = (m_historyNext + 1) % PREVIEW_HISTORY;
+	}
+	return !m_tracing;
+}
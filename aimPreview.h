@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: aimPreview.h
+//
+// Desc: Predicted path of the cue ball while the player aims.
+//
+//       The path is traced analytically over the resting table: the cue
+//       ball runs straight until it touches a ball or a cushion, the
+//       contact is resolved like CSphere::hitBy and CWall::hitBy, and the
+//       trace goes on from there for the first PREVIEW_MAX_CONTACTS
+//       contacts. Each object ball that is hit gets a segment for the way
+//       it leaves. Speed falls linearly with distance, which is what the
+//       per-tick decay of ballUpdate amounts to, so the path ends where the
+//       ball would stop.
+//
+//       The resting balls go into a uniform grid once per rest, not once
+//       per aim, and the trace walks only the cells along the path. The
+//       walk is resumable: advance() does a bounded amount of work and
+//       returns, and the next call carries on. A new aim drops a trace that
+//       is still running. Finished paths are kept for the last few aims, so
+//       moving back over the same spot costs nothing, and an aim that does
+//       not change the quantized target keeps the current path.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __aimPreviewH__
+#define __aimPreviewH__
+
+#include "tableTypes.h"
+#include <vector>
+
+const unsigned int PREVIEW_MAX_CONTACTS = 4;
+const unsigned int PREVIEW_WORK_BUDGET = 2048;	// cells plus ball tests per advance()
+const unsigned int PREVIEW_HISTORY = 16;		// finished paths kept
+const float PREVIEW_AIM_STEP = 0.007f;			// WM_MOUSEMOVE target step
+
+struct PreviewSegment
+{
+	float	x0, z0, x1, z1;
+	int		ball;		// the cue ball, or the object ball sent off by a contact
+};
+
+class CAimPreview {
+public:
+	CAimPreview(void);
+
+	// the resting table. builds the grid; positions are not read again
+	void setBalls(const float* x, const float* z, const int* type, const unsigned char* active,
+		unsigned int count, unsigned int cue, float halfX, float halfZ);
+	// the balls are moving: no preview until the next setBalls
+	void clear(void);
+	bool hasBalls(void) const { return m_hasBalls; }
+
+	// a new target for the shot. does no tracing itself
+	void aim(float targetX, float targetZ);
+	// carries the current trace on by at most budget units of work.
+	// returns true when the path is complete
+	bool advance(unsigned int budget);
+
+	bool isComplete(void) const { return !m_tracing; }
+	const std::vector<PreviewSegment>& getSegments(void) const { return m_segments; }
+
+	unsigned int getTraces(void) const { return m_traces; }			// traces started
+	unsigned int getCancelled(void) const { return m_cancelled; }	// dropped unfinished by a new aim
+	unsigned int getReused(void) const { return m_reused; }			// aims served from the history
+
+private:
+	struct Finished {
+		long long					key;
+		std::vector<PreviewSegment>	segments;
+	};
+
+	void startSegment(void);
+	void finishSegment(void);
+	void visitCell(int cell);
+	float exitDistance(float px, float pz, float dx, float dz, int* axis) const;
+	int cellX(float x) const;
+	int cellZ(float z) const;
+
+	// table, fixed between setBalls calls
+	bool						m_hasBalls;
+	std::vector<float>			m_x, m_z;
+	std::vector<unsigned char>	m_static;
+	unsigned int				m_cue;
+	float						m_limitX, m_limitZ;	// cue centre range
+
+	float						m_cellSize;
+	int							m_gridW, m_gridH;
+	std::vector<unsigned int>	m_cellStart;		// gridW * gridH + 1
+	std::vector<unsigned int>	m_cellBalls;
+
+	// current trace
+	long long					m_key;
+	bool						m_tracing;
+	std::vector<PreviewSegment>	m_segments;
+	float						m_px, m_pz;
+	float						m_dx, m_dz;
+	float						m_speed;
+	unsigned int				m_contacts;
+	int							m_ignore;			// ball just left, not hit again at t = 0
+
+	// current segment: a walk over the grid cells along the ray
+	float						m_segEnd;
+	int							m_segWall;			// 0 x, 1 z, -1 the ball stops first
+	int							m_cx, m_cz, m_stepX, m_stepZ;
+	float						m_tMaxX, m_tMaxZ, m_tDeltaX, m_tDeltaZ;
+	float						m_bestT;
+	int							m_bestBall;
+	unsigned int				m_work;
+
+	Finished					m_history[PREVIEW_HISTORY];
+	unsigned int				m_historyNext;
+
+	unsigned int				m_traces;
+	unsigned int				m_cancelled;
+	unsigned int				m_reused;
+};
+
+#endif // __aimPreviewH__
@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: aimPreviewBench.cpp
+//
+// Desc: Latency of CAimPreview under a simulated right-drag.
+//
+//       aimPreviewBench <rack|random> <rows or ball count> [mouse events]
+//
+//       Mouse events move the target by whole 0.007 steps, four events per
+//       frame, and each one does what WM_MOUSEMOVE does: aim() and one
+//       advance() with the work budget. Each frame does one more advance(),
+//       like Display. Prints the input-to-preview time of the events, how
+//       often the path was complete when a frame drew it, and the cost of
+//       the same traces without a budget.
+//
+//       On tables of up to ACCURACY_MAX_BALLS it then checks the first
+//       object ball of the predicted path against the fixed-point table for
+//       random shots.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "aimPreview.h"
+#include "tableServer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+static const unsigned int EVENTS_PER_FRAME = 4;
+static const unsigned int ACCURACY_SHOTS = 200;
+static const unsigned int ACCURACY_MAX_BALLS = 5000;	// the reference run steps every ball
+
+static void loadPreview(CAimPreview& preview, const CTableInstance& table, const scene::SceneHeader& h)
+{
+	const TBallSet<FixedPolicy>& b = table.getBalls();
+	std::vector<float> x(b.size()), z(b.size());
+	for (size_t i = 0; i < b.size(); i++) {
+		x[i] = FixedPolicy::toFloat(b.x[i]);
+		z[i] = FixedPolicy::toFloat(b.z[i]);
+	}
+	preview.setBalls(&x[0], &z[0], &b.type[0], &b.active[0], (unsigned int)b.size(), table.getCue(),
+		h.tableHalfX, h.tableHalfZ);
+}
+
+static double percentile(std::vector<double>& v, double p)
+{
+	std::sort(v.begin(), v.end());
+	return v.empty() ? 0 : v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+// the first ball the cue ball touches on the fixed-point table, or -1
+static int firstContact(const CTableInstance& start, const scene::SceneHeader& h, float tx, float tz)
+{
+	TBallSet<FixedPolicy> b = start.getBalls();
+	TTablePhysics<FixedPolicy> table;
+	table.setTable(h.tableHalfX, h.tableHalfZ);
+	CCollisionEventBuffer events;
+	const int cue = (int)start.getCue();
+	TTablePhysics<FixedPolicy>::shot(b, cue, FixedPolicy::fromFloat(tx), FixedPolicy::fromFloat(tz));
+	const int dt = FixedPolicy::fromFloat(0.005f);
+	for (unsigned int t = 0; t < 20000 && !b.atRest(); t++) {
+		events.clear();
+		table.step(b, dt, events);
+		for (size_t k = 0; k < events.size(); k++) {
+			if ((int)events[k].a == cue) return (int)events[k].b;
+			if ((int)events[k].b == cue) return (int)events[k].a;
+		}
+	}
+	return -1;
+}
+
+int main(int argc, char* argv[])
+{
+	typedef std::chrono::steady_clock Clock;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <rack|random> <rows or ball count> [mouse events]\n", argv[0]);
+		return 1;
+	}
+	unsigned int count = (unsigned int)atoi(argv[2]);
+	unsigned int events = argc > 3 ? (unsigned int)atoi(argv[3]) : 20000;
+
+	scene::CSceneBuilder builder;
+	if (strcmp(argv[1], "rack") == 0)
+		scene::generateRack(builder, count, 1);
+	else
+		scene::generateRandomPacking(builder, count, 1);
+	std::vector<unsigned char> image;
+	builder.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size())) {
+		fprintf(stderr, "bad scene image\n");
+		return 1;
+	}
+	const scene::SceneHeader& h = sc.header();
+
+	CTableInstance table;
+	table.load(sc);
+	const TBallSet<FixedPolicy>& balls = table.getBalls();
+
+	CAimPreview preview;
+	Clock::time_point t0 = Clock::now();
+	loadPreview(preview, table, h);
+	double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+	// the drag: the target wanders around in mouse-sized steps
+	std::vector<float> aimX(events), aimZ(events);
+	scene::CRandom rng(5);
+	float tx = 0, tz = 0;		// where g_target_blueball starts
+	for (unsigned int e = 0; e < events; e++) {
+		tx += ((int)(rng.next() % 13) - 6) * PREVIEW_AIM_STEP;
+		tz += ((int)(rng.next() % 13) - 6) * PREVIEW_AIM_STEP;
+		tx = std::max(-h.tableHalfX, std::min(h.tableHalfX, tx));
+		tz = std::max(-h.tableHalfZ, std::min(h.tableHalfZ, tz));
+		aimX[e] = tx;
+		aimZ[e] = tz;
+	}
+
+	std::vector<double> latency;
+	latency.reserve(events);
+	unsigned int frames = 0, complete = 0;
+	for (unsigned int e = 0; e < events; e++) {
+		Clock::time_point s = Clock::now();
+		preview.aim(aimX[e], aimZ[e]);
+		preview.advance(PREVIEW_WORK_BUDGET);
+		latency.push_back(std::chrono::duration<double, std::micro>(Clock::now() - s).count());
+
+		if ((e + 1) % EVENTS_PER_FRAME == 0) {
+			preview.advance(PREVIEW_WORK_BUDGET);
+			frames++;
+			if (preview.isComplete())
+				complete++;
+		}
+	}
+	unsigned int traces = preview.getTraces(), cancelled = preview.getCancelled(), reused = preview.getReused();
+
+	// the same aims, every trace run to the end at once
+	std::vector<double> full;
+	full.reserve(events);
+	loadPreview(preview, table, h);
+	for (unsigned int e = 0; e < events; e++) {
+		Clock::time_point s = Clock::now();
+		preview.aim(aimX[e], aimZ[e]);
+		preview.advance(~0u);
+		full.push_back(std::chrono::duration<double, std::micro>(Clock::now() - s).count());
+	}
+
+	printf("%u balls, table %.1f x %.1f, grid built in %.2f ms\n",
+		(unsigned int)balls.size(), 2 * h.tableHalfX, 2 * h.tableHalfZ, buildMs);
+	double p50 = percentile(latency, 0.5), p99 = percentile(latency, 0.99);
+	printf("%u events: input to preview p50 %.1f us, p99 %.1f us, max %.1f us\n",
+		events, p50, p99, latency.back());
+	printf("traces %u, cancelled %u, reused %u; path complete in %u of %u frames\n",
+		traces, cancelled, reused, complete, frames);
+	p50 = percentile(full, 0.5);
+	p99 = percentile(full, 0.99);
+	printf("unbounded trace p50 %.1f us, p99 %.1f us, max %.1f us\n", p50, p99, full.back());
+	if (balls.size() > ACCURACY_MAX_BALLS)
+		return 0;
+
+	// first object ball, predicted against simulated
+	unsigned int compared = 0, agreed = 0;
+	for (unsigned int s = 0; s < ACCURACY_SHOTS; s++) {
+		// somewhere around a random object ball
+		unsigned int target = rng.next() % (unsigned int)balls.size();
+		float ax = FixedPolicy::toFloat(balls.x[target]) + ((rng.next() % 2001) / 1000.0f - 1.0f) * 0.5f;
+		float az = FixedPolicy::toFloat(balls.z[target]) + ((rng.next() % 2001) / 1000.0f - 1.0f) * 0.5f;
+		loadPreview(preview, table, h);
+		preview.aim(ax, az);
+		preview.advance(~0u);
+
+		int predicted = -1;
+		const std::vector<PreviewSegment>& seg = preview.getSegments();
+		for (size_t k = 0; k < seg.size() && predicted < 0; k++) {
+			if (seg[k].ball != (int)table.getCue())
+				predicted = seg[k].ball;
+		}
+		if (predicted < 0)
+			continue;
+		compared++;
+		if (firstContact(table, h, ax, az) == predicted)
+			agreed++;
+	}
+	printf("first object ball agrees with the fixed-point table in %u of %u shots\n", agreed, compared);
+	return 0;
+}
@@ -0,0 +1,236 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: ballBvh.cpp
+//
+// Desc: Bounding sphere hierarchy over the balls, for ray picking.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ballBvh.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+namespace
+{
+	const int BVH_STACK_SIZE = 64;		// depth of a median split tree over 2^32 balls is 32
+
+	// node spheres are grown by this much so that rounding in the merge
+	// never leaves a grazing ray inside a ball but outside its node
+	const float BVH_SLACK = 1e-3f;
+}
+
+CBallBvh::CBallBvh(void)
+{
+	m_count = 0;
+	m_centerY = 0;
+	m_radius = 0;
+	m_builtArea = 0;
+	m_area = 0;
+}
+
+unsigned int CBallBvh::buildNode(const float* x, const float* z, unsigned int first, unsigned int count)
+{
+	unsigned int index = (unsigned int)m_nodes.size();
+	m_nodes.push_back(Node());
+	m_nodes[index].r = -1;
+
+	if (count <= BALL_BVH_LEAF_SIZE) {
+		m_nodes[index].right = 0;
+		m_nodes[index].first = first;
+		m_nodes[index].count = count;
+		return index;
+	}
+
+	float minX = FLT_MAX, maxX = -FLT_MAX, minZ = FLT_MAX, maxZ = -FLT_MAX;
+	for (unsigned int k = first; k < first + count; k++) {
+		unsigned int i = m_items[k];
+		minX = std::min(minX, x[i]);	maxX = std::max(maxX, x[i]);
+		minZ = std::min(minZ, z[i]);	maxZ = std::max(maxZ, z[i]);
+	}
+	const float* key = (maxX - minX >= maxZ - minZ) ? x : z;
+	unsigned int half = count / 2;
+	std::nth_element(m_items.begin() + first, m_items.begin() + first + half, m_items.begin() + first + count,
+		[key](unsigned int a, unsigned int b) { return key[a] < key[b]; });
+
+	buildNode(x, z, first, half);
+	unsigned int right = buildNode(x, z, first + half, count - half);
+	m_nodes[index].right = right;
+	m_nodes[index].first = 0;
+	m_nodes[index].count = 0;
+	return index;
+}
+
+void CBallBvh::build(const float* x, const float* z, const unsigned char* active, unsigned int count,
+	float centerY, float radius)
+{
+	m_count = count;
+	m_centerY = centerY;
+	m_radius = radius;
+	m_items.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		m_items[i] = i;
+	m_itemX.resize(count);
+	m_itemZ.resize(count);
+	m_itemLive.resize(count);
+
+	m_nodes.clear();
+	m_nodes.reserve(2 * (count / BALL_BVH_LEAF_SIZE + 1));
+	if (count > 0)
+		buildNode(x, z, 0, count);
+
+	refit(x, z, active);
+	m_builtArea = m_area;
+}
+
+void CBallBvh::refit(const float* x, const float* z, const unsigned char* active)
+{
+	m_area = 0;
+	for (size_t k = m_nodes.size(); k-- > 0; ) {
+		Node& n = m_nodes[k];
+
+		if (n.count > 0) {
+			// centroid of the live balls, radius to the farthest of them
+			float sx = 0, sz = 0;
+			unsigned int live = 0;
+			for (unsigned int j = n.first; j < n.first + n.count; j++) {
+				unsigned int i = m_items[j];
+				m_itemX[j] = x[i];
+				m_itemZ[j] = z[i];
+				m_itemLive[j] = active[i];
+				if (active[i]) {
+					sx += x[i];
+					sz += z[i];
+					live++;
+				}
+			}
+			if (live == 0) {
+				n.r = -1;
+				continue;
+			}
+			n.cx = sx / live;
+			n.cz = sz / live;
+			float far2 = 0;
+			for (unsigned int j = n.first; j < n.first + n.count; j++) {
+				if (!m_itemLive[j])
+					continue;
+				float dx = m_itemX[j] - n.cx, dz = m_itemZ[j] - n.cz;
+				far2 = std::max(far2, dx * dx + dz * dz);
+			}
+			n.r = sqrtf(far2) + m_radius + BVH_SLACK;
+			continue;
+		}
+
+		// smallest sphere around both children
+		const Node& a = m_nodes[k + 1];
+		const Node& b = m_nodes[n.right];
+		if (b.r < 0 || a.r < 0) {
+			const Node& s = b.r < 0 ? a : b;
+			n.cx = s.cx;
+			n.cz = s.cz;
+			n.r = s.r;
+		}
+		else {
+			float dx = b.cx - a.cx, dz = b.cz - a.cz;
+			float d = sqrtf(dx * dx + dz * dz);
+			if (d + b.r <= a.r) {
+				n.cx = a.cx;	n.cz = a.cz;	n.r = a.r;
+			}
+			else if (d + a.r <= b.r) {
+				n.cx = b.cx;	n.cz = b.cz;	n.r = b.r;
+			}
+			else {
+				float r = (d + a.r + b.r) / 2;
+				float s = (r - a.r) / d;
+				n.cx = a.cx + s * dx;
+				n.cz = a.cz + s * dz;
+				n.r = r + BVH_SLACK;
+			}
+		}
+		if (n.r > 0)
+			m_area += n.r * n.r;
+	}
+}
+
+bool CBallBvh::hitSphere(float cx, float cz, float r, const float o[3], const float d[3], float* t) const
+{
+	if (r < 0)
+		return false;
+	float ox = o[0] - cx, oy = o[1] - m_centerY, oz = o[2] - cz;
+	float b = ox * d[0] + oy * d[1] + oz * d[2];
+	if (ox * ox + oy * oy + oz * oz <= r * r) {
+		*t = 0;			// the ray starts inside
+		return true;
+	}
+	if (b > 0)
+		return false;
+
+	// r^2 minus the squared distance of the centre from the ray. b^2 - c
+	// would be the same in exact arithmetic, but seen from the camera both
+	// terms are far larger than a ball and the difference is lost
+	float px = ox - b * d[0], py = oy - b * d[1], pz = oz - b * d[2];
+	float disc = r * r - (px * px + py * py + pz * pz);
+	if (disc < 0)
+		return false;
+	*t = -b - sqrtf(disc);
+	return true;
+}
+
+int CBallBvh::intersect(const float origin[3], const float dir[3], float* t) const
+{
+	float best = FLT_MAX;
+	int hit = -1;
+	float entry;
+	if (m_nodes.empty() || !hitSphere(m_nodes[0].cx, m_nodes[0].cz, m_nodes[0].r, origin, dir, &entry))
+		return -1;
+
+	// nearer child on top, so the first leaves reached usually hold the hit
+	unsigned int stack[BVH_STACK_SIZE];
+	float stackT[BVH_STACK_SIZE];
+	int top = 0;
+	stack[top] = 0;
+	stackT[top++] = entry;
+	while (top > 0) {
+		top--;
+		if (stackT[top] >= best)
+			continue;
+		unsigned int index = stack[top];
+		const Node& n = m_nodes[index];
+
+		if (n.count > 0) {
+			for (unsigned int j = n.first; j < n.first + n.count; j++) {
+				float tb;
+				if (m_itemLive[j] && hitSphere(m_itemX[j], m_itemZ[j], m_radius, origin, dir, &tb) && tb < best) {
+					best = tb;
+					hit = (int)m_items[j];
+				}
+			}
+			continue;
+		}
+
+		unsigned int child[2] = { index + 1, n.right };
+		float tc[2];
+		bool in[2];
+		for (int c = 0; c < 2; c++) {
+			const Node& cn = m_nodes[child[c]];
+			in[c] = hitSphere(cn.cx, cn.cz, cn.r, origin, dir, &tc[c]) && tc[c] < best;
+		}
+		int nearer = (in[0] && in[1] && tc[1] < tc[0]) ? 1 : 0;
+		for (int k = 1; k >= 0; k--) {
+			int c = k == 0 ? nearer : 1 - nearer;
+			if (in[c]) {
+				stack[top] = child[c];
+				stackT[top++] = tc[c];
+			}
+		}
+	}
+
+	if (hit >= 0 && t != NULL)
+		*t = best;
+	return hit;
+}
+
+float CBallBvh::getDegradation(void) const
+{
+	return m_builtArea > 0 ? m_area / m_builtArea : 1.0f;
+}
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: ballBvh.h
+//
+// Desc: Bounding sphere hierarchy over the balls, for ray picking.
+//
+//       build() splits the balls top-down at the median of the longest
+//       axis, down to leaves of BALL_BVH_LEAF_SIZE balls. The nodes are
+//       stored depth first, so a node's left child is the next node and
+//       every child comes after its parent.
+//
+//       refit() keeps the tree and only recomputes the spheres from the
+//       current positions, walking the nodes backwards so children are
+//       done before their parents. That is one linear pass per tick, with
+//       no allocation. As the balls scatter the tree gets looser, which
+//       slows queries down but never makes them wrong; getDegradation()
+//       says how far it has gone, and the caller rebuilds when it suits,
+//       for instance once the table is at rest.
+//
+//       A removed ball stays in its leaf and is skipped. A node whose balls
+//       are all gone has a negative radius and no ray hits it.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ballBvhH__
+#define __ballBvhH__
+
+#include <cstddef>
+#include <vector>
+
+const unsigned int BALL_BVH_LEAF_SIZE = 4;
+
+class CBallBvh {
+public:
+	CBallBvh(void);
+
+	// balls lie on the plane y = centerY with the given radius
+	void build(const float* x, const float* z, const unsigned char* active, unsigned int count,
+		float centerY, float radius);
+	void refit(const float* x, const float* z, const unsigned char* active);
+
+	// first ball along the ray, -1 if none. dir must be unit length.
+	// *t gets the distance to the hit
+	int intersect(const float origin[3], const float dir[3], float* t) const;
+
+	// summed node surface now against right after build; 1 when fresh
+	float getDegradation(void) const;
+	unsigned int getBallCount(void) const { return m_count; }
+	size_t getNodeCount(void) const { return m_nodes.size(); }
+
+private:
+	struct Node {
+		float			cx, cz, r;		// sphere, centre at y = m_centerY
+		unsigned int	right;			// right child; the left one is this + 1
+		unsigned int	first, count;	// leaves: range of m_items; count 0 for inner nodes
+	};
+
+	unsigned int buildNode(const float* x, const float* z, unsigned int first, unsigned int count);
+	bool hitSphere(float cx, float cz, float r, const float o[3], const float d[3], float* t) const;
+
+	std::vector<Node>			m_nodes;
+	std::vector<unsigned int>	m_items;		// ball indices, leaf by leaf
+	std::vector<float>			m_itemX, m_itemZ;	// copied in refit, in m_items order
+	std::vector<unsigned char>	m_itemLive;
+	unsigned int				m_count;
+	float						m_centerY;
+	float						m_radius;
+	float						m_builtArea;
+	float						m_area;
+};
+
+#endif // __ballBvhH__
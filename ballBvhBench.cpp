@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: ballBvhBench.cpp
+//
+// Desc: Ray picking through CBallBvh on a large table in motion.
+//
+//       ballBvhBench [balls] [ticks] [rays]
+//
+//       Every ball gets a random push, the float table runs, and the tree
+//       is refit after every tick. Every few ticks a batch of rays from the
+//       game's camera position to random points on the cloth is picked
+//       through the tree and against every ball, and the two must agree.
+//       The last report is repeated after a rebuild, to show what the looser
+//       refit tree costs.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ballBvh.h"
+#include "tablePhysics.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+
+static const unsigned int REPORT_EVERY = 20;		// ticks
+static const unsigned int BRUTE_RAYS = 200;
+
+typedef std::chrono::steady_clock Clock;
+
+static double usSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+}
+
+// every ball, for reference
+static int bruteForce(const TBallSet<FloatPolicy>& b, const float o[3], const float d[3], float r)
+{
+	float best = FLT_MAX;
+	int hit = -1;
+	for (size_t i = 0; i < b.size(); i++) {
+		if (!b.active[i])
+			continue;
+		float ox = o[0] - b.x[i], oy = o[1] - r, oz = o[2] - b.z[i];
+		float bb = ox * d[0] + oy * d[1] + oz * d[2];
+		float px = ox - bb * d[0], py = oy - bb * d[1], pz = oz - bb * d[2];
+		float disc = r * r - (px * px + py * py + pz * pz);
+		if (bb > 0 || disc < 0)
+			continue;
+		float t = -bb - sqrtf(disc);
+		if (t < best) {
+			best = t;
+			hit = (int)i;
+		}
+	}
+	return hit;
+}
+
+static void report(const CBallBvh& bvh, const TBallSet<FloatPolicy>& b, float half, unsigned int rays,
+	unsigned int tick, double refitUs, const char* label)
+{
+	const float r = (float)M_RADIUS;
+	const float eye[3] = { 0.0f, 5.0f * half / 3.0f, -8.0f * half / 3.0f };
+	scene::CRandom rng(99);
+	unsigned int hits = 0, mismatches = 0;
+	double pickUs = 0, bruteUs = 0;
+
+	for (unsigned int k = 0; k < rays; k++) {
+		float px = (rng.unit() * 2 - 1) * half, pz = (rng.unit() * 2 - 1) * half;
+		float d[3] = { px - eye[0], -eye[1], pz - eye[2] };
+		float len = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		d[0] /= len;	d[1] /= len;	d[2] /= len;
+
+		Clock::time_point t0 = Clock::now();
+		float t;
+		int hit = bvh.intersect(eye, d, &t);
+		pickUs += usSince(t0);
+		if (hit >= 0)
+			hits++;
+
+		if (k < BRUTE_RAYS) {
+			t0 = Clock::now();
+			int ref = bruteForce(b, eye, d, r);
+			bruteUs += usSince(t0);
+			if (ref != hit)
+				mismatches++;
+		}
+	}
+	printf("%-8s tick %4u  refit %7.1f us  degradation %.2f  pick %.2f us  brute %.0f us  hits %u/%u  mismatches %u\n",
+		label, tick, refitUs, bvh.getDegradation(), pickUs / rays,
+		bruteUs / (rays < BRUTE_RAYS ? rays : BRUTE_RAYS), hits, rays, mismatches);
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+	unsigned int ticks = argc > 2 ? (unsigned int)atoi(argv[2]) : 100;
+	unsigned int rays = argc > 3 ? (unsigned int)atoi(argv[3]) : 10000;
+
+	scene::CSceneBuilder builder;
+	scene::generateRandomPacking(builder, count, 1);
+	std::vector<unsigned char> image;
+	builder.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size())) {
+		fprintf(stderr, "bad scene image\n");
+		return 1;
+	}
+	const scene::SceneHeader& h = sc.header();
+
+	TBallSet<FloatPolicy> b;
+	b.resize(h.ballCount);
+	scene::CRandom rng(3);
+	for (unsigned int i = 0; i < h.ballCount; i++) {
+		b.x[i] = sc.balls()[i].x;
+		b.z[i] = sc.balls()[i].z;
+		b.vx[i] = (rng.unit() * 2 - 1) * 2;
+		b.vz[i] = (rng.unit() * 2 - 1) * 2;
+		b.type[i] = sc.balls()[i].type;
+		b.active[i] = 1;
+	}
+	TTablePhysics<FloatPolicy> table;
+	table.setTable(h.tableHalfX, h.tableHalfZ);
+	CCollisionEventBuffer events;
+
+	CBallBvh bvh;
+	Clock::time_point t0 = Clock::now();
+	bvh.build(&b.x[0], &b.z[0], &b.active[0], h.ballCount, (float)M_RADIUS, (float)M_RADIUS);
+	printf("%u balls, %u nodes, build %.2f ms\n", h.ballCount, (unsigned int)bvh.getNodeCount(), usSince(t0) / 1000);
+	report(bvh, b, h.tableHalfX, rays, 0, 0, "built");
+
+	double refitUs = 0;
+	for (unsigned int tick = 1; tick <= ticks; tick++) {
+		events.clear();
+		table.step(b, 0.005f, events);
+
+		t0 = Clock::now();
+		bvh.refit(&b.x[0], &b.z[0], &b.active[0]);
+		refitUs += usSince(t0);
+		if (tick % REPORT_EVERY == 0) {
+			report(bvh, b, h.tableHalfX, rays, tick, refitUs / REPORT_EVERY, "refit");
+			refitUs = 0;
+		}
+	}
+
+	t0 = Clock::now();
+	bvh.build(&b.x[0], &b.z[0], &b.active[0], h.ballCount, (float)M_RADIUS, (float)M_RADIUS);
+	double buildUs = usSince(t0);
+	report(bvh, b, h.tableHalfX, rays, ticks, buildUs, "rebuilt");
+	return 0;
+}
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: batchEnv.cpp
+//
+// Desc: Vectorized reset/step interface over many tables.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "batchEnv.h"
+#include <cmath>
+
+namespace
+{
+	const float ENV_TICK = 0.005f;				// same tick as the game's fixed mode
+	const unsigned int ENV_MAX_TICKS = 20000;	// per shot; 100 s of table time
+}
+
+CBatchEnv::CBatchEnv(CWorkerPool& pool, const scene::CSceneFile& sc, unsigned int envCount, unsigned int maxShots)
+	: m_pool(pool)
+{
+	m_start.load(sc);
+	m_envs.assign(envCount, m_start);
+	m_shots.assign(envCount, 0);
+	m_ticks.assign(envCount, 0);
+	m_ballCount = (unsigned int)m_start.getBalls().size();
+	m_maxShots = maxShots;
+	m_dt = FixedPolicy::fromFloat(ENV_TICK);
+}
+
+void CBatchEnv::reset(float* observations)
+{
+	const unsigned int obsSize = getObservationSize();
+	m_pool.parallelFor((int)m_envs.size(), [&](int i) {
+		m_envs[i] = m_start;
+		m_shots[i] = 0;
+		writeObservation(i, observations + (size_t)i * obsSize);
+	});
+}
+
+void CBatchEnv::step(const float* actions, float* observations, float* rewards, unsigned char* dones)
+{
+	const unsigned int obsSize = getObservationSize();
+
+	m_pool.parallelFor((int)m_envs.size(), [&](int i) {
+		CTableInstance& env = m_envs[i];
+		const float* a = actions + (size_t)i * BATCH_ENV_ACTION_SIZE;
+
+		// VK_SPACE: power along the normalized aim
+		float len = sqrtf(a[0] * a[0] + a[1] * a[1]);
+		float power = a[2] > 0 ? a[2] : 0.0f;
+		float vx = len > 0 ? power * a[0] / len : 0.0f;
+		float vz = len > 0 ? power * a[1] / len : 0.0f;
+
+		unsigned int before = countTargets(i);
+		env.queuePower(FixedPolicy::fromFloat(vx), FixedPolicy::fromFloat(vz));
+		m_ticks[i] += env.runToRest(m_dt, ENV_MAX_TICKS);
+		unsigned int after = countTargets(i);
+		m_shots[i]++;
+
+		rewards[i] = (float)(before - after);
+		bool done = after == 0 || m_shots[i] >= m_maxShots;
+		dones[i] = done ? 1 : 0;
+		if (done) {
+			env = m_start;
+			m_shots[i] = 0;
+		}
+		writeObservation(i, observations + (size_t)i * obsSize);
+	});
+}
+
+unsigned long long CBatchEnv::getTicks(void) const
+{
+	unsigned long long total = 0;
+	for (size_t i = 0; i < m_ticks.size(); i++)
+		total += m_ticks[i];
+	return total;
+}
+
+void CBatchEnv::writeObservation(unsigned int env, float* out) const
+{
+	const TBallSet<FixedPolicy>& b = m_envs[env].getBalls();
+	for (unsigned int k = 0; k < m_ballCount; k++) {
+		out[0] = FixedPolicy::toFloat(b.x[k]);
+		out[1] = FixedPolicy::toFloat(b.z[k]);
+		out[2] = b.active[k] ? 1.0f : 0.0f;
+		out += BATCH_ENV_BALL_FIELDS;
+	}
+}
+
+unsigned int CBatchEnv::countTargets(unsigned int env) const
+{
+	const TBallSet<FixedPolicy>& b = m_envs[env].getBalls();
+	unsigned int n = 0;
+	for (unsigned int k = 0; k < m_ballCount; k++) {
+		if (b.active[k] && b.type[k] == ENTITY_YELLOW)
+			n++;
+	}
+	return n;
+}
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: batchEnv.h
+//
+// Desc: Vectorized reset/step interface over many tables, for agent
+//       training.
+//
+//       One step is one shot on every table. The action for a table is the
+//       aim vector and power that VK_SPACE turns into setPower on the cue
+//       ball: [aimX, aimZ, power]. The table then runs to rest.
+//
+//       Observation per table: [x, z, active] for every ball, as floats.
+//       Reward: yellow balls cleared by the shot.
+//       Done: no yellow ball left, or the shot limit reached. A finished
+//       table is reset at once and its observation is the new start state,
+//       so the caller never has to reset tables one by one.
+//
+//       All results are written straight into the caller's contiguous
+//       arrays, table by table, from the worker threads. Nothing is
+//       allocated and nothing is copied through an intermediate buffer.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __batchEnvH__
+#define __batchEnvH__
+
+#include "tableServer.h"
+
+const unsigned int BATCH_ENV_ACTION_SIZE = 3;			// aimX, aimZ, power
+const unsigned int BATCH_ENV_BALL_FIELDS = 3;			// x, z, active
+
+class CBatchEnv {
+public:
+	CBatchEnv(CWorkerPool& pool, const scene::CSceneFile& sc, unsigned int envCount, unsigned int maxShots = 32);
+
+	unsigned int getEnvCount(void) const { return (unsigned int)m_envs.size(); }
+	unsigned int getObservationSize(void) const { return m_ballCount * BATCH_ENV_BALL_FIELDS; }
+
+	// observations: getEnvCount() * getObservationSize() floats
+	void reset(float* observations);
+
+	// actions: getEnvCount() * BATCH_ENV_ACTION_SIZE floats.
+	// rewards and dones: getEnvCount() entries each.
+	void step(const float* actions, float* observations, float* rewards, unsigned char* dones);
+
+	// ticks simulated since construction, over all tables
+	unsigned long long getTicks(void) const;
+
+private:
+	void writeObservation(unsigned int env, float* out) const;
+	unsigned int countTargets(unsigned int env) const;
+
+	CWorkerPool&					m_pool;
+	CTableInstance					m_start;	// copied over a table on reset
+	std::vector<CTableInstance>		m_envs;
+	std::vector<unsigned int>		m_shots;
+	std::vector<unsigned long long>	m_ticks;	// per table, summed on demand
+	unsigned int					m_ballCount;
+	unsigned int					m_maxShots;
+	int								m_dt;
+};
+
+#endif // __batchEnvH__
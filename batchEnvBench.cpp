@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: batchEnvBench.cpp
+//
+// Desc: Throughput of CBatchEnv with random actions.
+//
+//       batchEnvBench <tables> <steps> [threads] [rack rows]
+//
+//       Prints steps per second and simulated ticks per second, then the
+//       same step loop with zero-power shots. Those run a single tick per
+//       table, so their cost is almost all interface overhead: action
+//       decoding, the parallel dispatch and the observation writes.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "batchEnv.h"
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <tables> <steps> [threads] [rack rows]\n", argv[0]);
+		return 1;
+	}
+	unsigned int tables = (unsigned int)atoi(argv[1]);
+	unsigned int steps = (unsigned int)atoi(argv[2]);
+	int threads = argc > 3 ? atoi(argv[3]) : -1;
+	unsigned int rows = argc > 4 ? (unsigned int)atoi(argv[4]) : 5;
+
+	scene::CSceneBuilder b;
+	scene::generateRack(b, rows, 1);
+	std::vector<unsigned char> image;
+	b.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size())) {
+		fprintf(stderr, "bad scene image\n");
+		return 1;
+	}
+
+	CWorkerPool pool(threads);
+	CBatchEnv env(pool, sc, tables);
+
+	// the caller owns every buffer
+	std::vector<float> obs((size_t)tables * env.getObservationSize());
+	std::vector<float> actions((size_t)tables * BATCH_ENV_ACTION_SIZE);
+	std::vector<float> rewards(tables);
+	std::vector<unsigned char> dones(tables);
+	env.reset(&obs[0]);
+
+	typedef std::chrono::steady_clock Clock;
+	scene::CRandom rng(1);
+	double totalReward = 0;
+	unsigned int episodes = 0;
+
+	Clock::time_point start = Clock::now();
+	for (unsigned int s = 0; s < steps; s++) {
+		for (size_t i = 0; i < actions.size(); i += BATCH_ENV_ACTION_SIZE) {
+			actions[i + 0] = rng.unit() * 2 - 1;
+			actions[i + 1] = rng.unit() * 2 - 1;
+			actions[i + 2] = rng.unit() * 6;
+		}
+		env.step(&actions[0], &obs[0], &rewards[0], &dones[0]);
+		for (unsigned int i = 0; i < tables; i++) {
+			totalReward += rewards[i];
+			episodes += dones[i];
+		}
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	unsigned long long ticks = env.getTicks();
+
+	printf("%u tables x %u steps on %d threads: %.3f s\n", tables, steps, pool.getThreadCount() + 1, seconds);
+	printf("  %.0f table-steps/s, %.2f M ticks/s, %.1f ticks per shot\n",
+		tables * steps / seconds, ticks / seconds / 1e6, (double)ticks / ((double)tables * steps));
+	printf("  reward %.0f over %u finished episodes\n", totalReward, episodes);
+
+	// zero power: one tick per table, the rest is the interface
+	for (size_t i = 0; i < actions.size(); i++)
+		actions[i] = 0;
+	env.reset(&obs[0]);
+	start = Clock::now();
+	for (unsigned int s = 0; s < steps; s++)
+		env.step(&actions[0], &obs[0], &rewards[0], &dones[0]);
+	double idleSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+	printf("  zero-power steps: %.3f us per table-step (%.1f%% of a real step)\n",
+		idleSeconds * 1e6 / ((double)tables * steps), 100.0 * idleSeconds / seconds);
+	return 0;
+}
@@ -0,0 +1,505 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: billiard.h
+//
+// Desc: Table objects shared by the game and the physics steppers:
+//       balls (CSphere) and cushions (CWall).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __billiardH__
+#define __billiardH__
+
+#include "d3dUtility.h"
+#include "sceneFile.h"
+#include "tableTypes.h"
+#include "cushionField.h"
+#include <vector>
+
+// playing area is [-g_tableHalfX, g_tableHalfX] x [-g_tableHalfZ, g_tableHalfZ], set by the scene
+extern float g_tableHalfX;
+extern float g_tableHalfZ;
+
+// table outline from the scene, NULL when the cushions are the four walls
+extern const CCushionField* g_cushions;
+
+// -----------------------------------------------------------------------------
+// CSphere class definition
+// -----------------------------------------------------------------------------
+
+// a ball stops when neither velocity component is above this
+const float BALL_MIN_SPEED = 0.01f;
+// velocity lost per unit of tick time, rate = 1 - BALL_DECAY * dt, as
+// TTablePhysics has it
+const float BALL_DECAY = (float)((1 - DECREASE_RATE) * 400);
+
+// the physics state of a ball and nothing else, so that stepping walks a
+// dense array. how it is drawn is in CSphereLook. the state is float
+// (Scalar) and so is every operation of the step: no double temporaries,
+// and values from elsewhere are converted once, on the way in
+class CSphere {
+public:
+	typedef float Scalar;
+
+private:
+	Scalar					center_x, center_y, center_z;
+	Scalar                  m_radius;
+	Scalar					m_mass;
+	Scalar					m_velocity_x;
+	Scalar					m_velocity_z;
+
+	int						m_type;
+	bool active=true;
+
+public:
+	CSphere(void)
+	{
+		center_x = center_y = center_z = 0;
+		m_radius = (float)M_RADIUS;
+		m_mass = 1;
+		m_type = ENTITY_WHITE;
+		m_velocity_x = 0;
+		m_velocity_z = 0;
+	}
+	~CSphere(void) {}
+
+public:
+	// size and weight. a ball is M_RADIUS and mass 1 unless the scene says
+	// otherwise
+	void setShape(Scalar radius, Scalar mass)
+	{
+		m_radius = radius;
+		m_mass = mass;
+	}
+	void setType(int type) { m_type = type; }
+
+	// on the table plane: balls of different sizes have their centres at
+	// different heights. squared distances, no square root
+	bool hasIntersected(CSphere& ball)
+	{
+		Scalar dx = center_x - ball.center_x;
+		Scalar dz = center_z - ball.center_z;
+		Scalar reach = m_radius + ball.m_radius;
+		return dx * dx + dz * dz <= reach * reach;
+	}
+
+	//추가
+	bool isActive() const { return active; }
+	int getType(void) const { return m_type; }
+	bool isStatic(void) const { return m_type == ENTITY_OBSTACLE; }
+
+	// Elastic response only. Game rules are applied afterwards from the
+	// collision events, so this returns whether a contact was resolved.
+	// the same test as narrowPhase(), one pair at a time
+	bool hitBy(CSphere& ball)
+	{
+		if (!this->active || !ball.active) return false; // Skip if either ball is inactive
+
+		float dx = center_x - ball.center_x;
+		float dz = center_z - ball.center_z;
+		float d2 = dx * dx + dz * dz;
+		float reach = m_radius + ball.m_radius;
+		if (d2 > reach * reach || d2 <= 0) return false;  // No collision, or no normal
+
+		float d = sqrtf(d2);
+		resolveHit(ball, dx / d, dz / d);
+		return true;
+	}
+
+	// the response half of hitBy, for a contact found by narrowPhase().
+	// (nx, nz) is unit length and points from ball to this
+	void resolveHit(CSphere& ball, float nx, float nz)
+	{
+		float tx = -nz, tz = nx;
+
+		float thisNormalVel = nx * m_velocity_x + nz * m_velocity_z;
+		float ballNormalVel = nx * ball.m_velocity_x + nz * ball.m_velocity_z;
+
+		float thisTangentVel = tx * m_velocity_x + tz * m_velocity_z;
+		float ballTangentVel = tx * ball.m_velocity_x + tz * ball.m_velocity_z;
+
+		// an obstacle does not move, the other ball is reflected off it
+		if (this->isStatic())
+			ballNormalVel = -ballNormalVel;
+		else if (ball.isStatic())
+			thisNormalVel = -thisNormalVel;
+		else if (m_mass == ball.m_mass)
+			std::swap(thisNormalVel, ballNormalVel);
+		else {
+			// elastic along the normal: the lighter ball takes more of the change
+			float total = m_mass + ball.m_mass;
+			float thisNew = ((m_mass - ball.m_mass) * thisNormalVel + 2 * ball.m_mass * ballNormalVel) / total;
+			float ballNew = ((ball.m_mass - m_mass) * ballNormalVel + 2 * m_mass * thisNormalVel) / total;
+			thisNormalVel = thisNew;
+			ballNormalVel = ballNew;
+		}
+
+		this->setPower(thisNormalVel * nx + thisTangentVel * tx, thisNormalVel * nz + thisTangentVel * tz);
+		ball.setPower(ballNormalVel * nx + ballTangentVel * tx, ballNormalVel * nz + ballTangentVel * tz);
+	}
+
+	// Take the ball off the table (used by collision rules). it is no
+	// longer drawn; its CSphereLook keeps the mesh until it is destroyed
+	void remove(void)
+	{
+		active = false;
+	}
+
+	//void hitBy(CSphere& ball)
+	//{
+	//	// Insert your code here.
+	//	if (!this->active || !ball.active) return; // Skip if either ball is inactive
+	//	if (!this->hasIntersected(ball)) return; // No collision, return early
+
+	//	// Get centers of spheres
+	//	D3DXVECTOR3 thisCenter = this->getCenter();
+	//	D3DXVECTOR3 ballCenter = ball.getCenter();
+
+	//	// Calculate normal and tangent directions
+	//	D3DXVECTOR3 normal = thisCenter - ballCenter;
+	//	D3DXVec3Normalize(&normal, &normal); // Normalize to unit vector
+
+	//	D3DXVECTOR3 tangent(-normal.z, 0, normal.x); // Tangent is perpendicular to normal
+
+	//	// Calculate velocities along the normal and tangent directions
+	//	float thisNormalVel = D3DXVec3Dot(&normal, &D3DXVECTOR3(this->getVelocity_X(), 0, this->getVelocity_Z()));
+	//	float ballNormalVel = D3DXVec3Dot(&normal, &D3DXVECTOR3(ball.getVelocity_X(), 0, ball.getVelocity_Z()));
+
+	//	float thisTangentVel = D3DXVec3Dot(&tangent, &D3DXVECTOR3(this->getVelocity_X(), 0, this->getVelocity_Z()));
+	//	float ballTangentVel = D3DXVec3Dot(&tangent, &D3DXVECTOR3(ball.getVelocity_X(), 0, ball.getVelocity_Z()));
+
+	//	// Swap normal velocities (elastic collision)
+	//	std::swap(thisNormalVel, ballNormalVel);
+
+	//	// Compute the new velocities for both spheres
+	//	D3DXVECTOR3 thisNewVel = thisNormalVel * normal + thisTangentVel * tangent;
+	//	D3DXVECTOR3 ballNewVel = ballNormalVel * normal + ballTangentVel * tangent;
+
+	//	// Set the new velocities
+	//	this->setPower(thisNewVel.x, thisNewVel.z);
+	//	ball.setPower(ballNewVel.x, ballNewVel.z);
+	//}
+
+
+	// one substep; CSlabStepper cuts a tick with fast balls into several.
+	// the same arithmetic as TTablePhysics<FloatPolicy>
+	void ballUpdate(Scalar timeDiff)
+	{
+		if (fabsf(m_velocity_x) > BALL_MIN_SPEED || fabsf(m_velocity_z) > BALL_MIN_SPEED)
+		{
+			const Scalar step = TIME_SCALE * timeDiff;
+			Scalar tX = center_x + step * m_velocity_x;
+			Scalar tZ = center_z + step * m_velocity_z;
+
+			//correction of position of ball
+			// Please uncomment this part because this correction of ball position is necessary when a ball collides with a wall
+			// both axes, so that a ball into a corner stays on the table
+			if (tX >= (g_tableHalfX - m_radius))
+				tX = g_tableHalfX - m_radius;
+			else if (tX <= (-g_tableHalfX + m_radius))
+				tX = -g_tableHalfX + m_radius;
+			if (tZ <= (-g_tableHalfZ + m_radius))
+				tZ = -g_tableHalfZ + m_radius;
+			else if (tZ >= (g_tableHalfZ - m_radius))
+				tZ = g_tableHalfZ - m_radius;
+
+			center_x = tX;
+			center_z = tZ;
+		}
+		else { this->setPower(0, 0); }
+		//this->setPower(this->getVelocity_X() * DECREASE_RATE, this->getVelocity_Z() * DECREASE_RATE);
+		Scalar rate = 1 - BALL_DECAY * timeDiff;
+		if (rate < 0)
+			rate = 0;
+		m_velocity_x *= rate;
+		m_velocity_z *= rate;
+	}
+
+	// cushion contact against the table outline, in place of CWall::hitBy.
+	// false if the ball has dropped into a pocket
+	bool hitCushions(const CCushionField& cushions)
+	{
+		float d, nx, nz;
+		int pocket;
+		cushions.sample(center_x, center_z, d, nx, nz, pocket);
+		if (pocket >= 0)
+			return false;
+		const float r = getRadius();
+		if (d >= r + CUSHION_CONTACT_SLOP)
+			return true;
+		float len = sqrtf(nx * nx + nz * nz);
+		if (len < 0.5f)
+			return true;		// a ridge between two cushions
+		nx /= len;
+		nz /= len;
+
+		// back out to one radius from the cushion, and reflect if moving in
+		if (d < r)
+			this->setCenter(center_x + (r - d) * nx, center_y, center_z + (r - d) * nz);
+		float vn = m_velocity_x * nx + m_velocity_z * nz;
+		if (vn < 0)
+			this->setPower(m_velocity_x - 2 * vn * nx, m_velocity_z - 2 * vn * nz);
+		return true;
+	}
+
+	Scalar getVelocity_X() const { return this->m_velocity_x; }
+	Scalar getVelocity_Z() const { return this->m_velocity_z; }
+
+	void setPower(Scalar vx, Scalar vz)
+	{
+		this->m_velocity_x = vx;
+		this->m_velocity_z = vz;
+	}
+
+	void setCenter(Scalar x, Scalar y, Scalar z)
+	{
+		center_x = x;	center_y = y;	center_z = z;
+	}
+
+	Scalar getRadius(void)  const { return m_radius; }
+	Scalar getMass(void)  const { return m_mass; }
+	D3DXVECTOR3 getCenter(void) const
+	{
+		D3DXVECTOR3 org(center_x, center_y, center_z);
+		return org;
+	}
+};
+
+static_assert(sizeof(CSphere) <= 64, "the physics state of a ball is one cache line at most");
+
+// -----------------------------------------------------------------------------
+// CSphereLook class definition
+// -----------------------------------------------------------------------------
+
+// how a ball is drawn: material and mesh, which stepping never reads. kept
+// next to the CSphere array, one per ball (g_sphereLook), and the
+// transform is made from the ball's centre when it is drawn rather than on
+// every move
+class CSphereLook {
+public:
+	CSphereLook(void)
+	{
+		ZeroMemory(&m_mtrl, sizeof(m_mtrl));
+		m_pSphereMesh = NULL;
+		m_meshScale = 1;
+	}
+	~CSphereLook(void) {}
+
+	// pSharedMesh lets large scenes use one sphere mesh for every ball. it
+	// must have radius M_RADIUS; other sizes are drawn scaled
+	bool create(IDirect3DDevice9* pDevice, float radius, D3DXCOLOR color = d3d::WHITE, ID3DXMesh* pSharedMesh = NULL)
+	{
+		if (NULL == pDevice)
+			return false;
+
+		m_mtrl.Ambient = color;
+		m_mtrl.Diffuse = color;
+		m_mtrl.Specular = color;
+		m_mtrl.Emissive = d3d::BLACK;
+		m_mtrl.Power = 5.0f;
+
+		if (pSharedMesh != NULL) {
+			pSharedMesh->AddRef();
+			m_pSphereMesh = pSharedMesh;
+			m_meshScale = radius / (float)M_RADIUS;
+			return true;
+		}
+		m_meshScale = 1;
+		if (FAILED(D3DXCreateSphere(pDevice, radius, 50, 50, &m_pSphereMesh, NULL)))
+			return false;
+		return true;
+	}
+
+	void destroy(void)
+	{
+		if (m_pSphereMesh != NULL) {
+			m_pSphereMesh->Release();
+			m_pSphereMesh = NULL;
+		}
+	}
+
+	void draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& mWorld, const CSphere& ball) const
+	{
+		if (!ball.isActive() || NULL == pDevice || m_pSphereMesh == NULL) return; // Skip inactive or invalid balls
+		D3DXMATRIX mLocal;
+		getLocalTransform(ball, mLocal);
+		pDevice->SetTransform(D3DTS_WORLD, &mWorld);
+		pDevice->MultiplyTransform(D3DTS_WORLD, &mLocal);
+		pDevice->SetMaterial(&m_mtrl);
+		m_pSphereMesh->DrawSubset(0);
+	}
+
+	// the mesh scaled to the ball and moved to its centre
+	void getLocalTransform(const CSphere& ball, D3DXMATRIX& m) const
+	{
+		D3DXVECTOR3 c = ball.getCenter();
+		D3DXMatrixTranslation(&m, c.x, c.y, c.z);
+		if (m_meshScale != 1) {
+			D3DXMATRIX s;
+			D3DXMatrixScaling(&s, m_meshScale, m_meshScale, m_meshScale);
+			m = s * m;
+		}
+	}
+
+	// what draw() hands the device, for drawing from a list made elsewhere
+	ID3DXMesh* getMesh(void) const { return m_pSphereMesh; }
+	const D3DMATERIAL9& getMaterial(void) const { return m_mtrl; }
+
+private:
+	D3DMATERIAL9            m_mtrl;
+	ID3DXMesh*				m_pSphereMesh;
+	float					m_meshScale;	// the ball's radius over the radius of the mesh drawn
+};
+
+
+
+// removal hook for the collision rules (tableTypes.h)
+inline void removeBall(CSphere* balls, unsigned int i) { balls[i].remove(); }
+
+// -----------------------------------------------------------------------------
+// CWall class definition
+// -----------------------------------------------------------------------------
+
+class CWall {
+
+private:
+
+	float					m_x;
+	float					m_z;
+	float                   m_width;
+	float                   m_depth;
+	float					m_height;
+
+public:
+	CWall(void)
+	{
+		D3DXMatrixIdentity(&m_mLocal);
+		ZeroMemory(&m_mtrl, sizeof(m_mtrl));
+		m_width = 0;
+		m_depth = 0;
+		m_pBoundMesh = NULL;
+	}
+	~CWall(void) {}
+public:
+	// pMesh is a box of these sides made elsewhere (the mesh cache); without
+	// it the wall makes its own
+	bool create(IDirect3DDevice9* pDevice, float ix, float iz, float iwidth, float iheight, float idepth, D3DXCOLOR color = d3d::WHITE, ID3DXMesh* pMesh = NULL)
+	{
+		if (NULL == pDevice)
+			return false;
+
+		m_mtrl.Ambient = color;
+		m_mtrl.Diffuse = color;
+		m_mtrl.Specular = color;
+		m_mtrl.Emissive = d3d::BLACK;
+		m_mtrl.Power = 5.0f;
+
+		m_width = iwidth;
+		m_depth = idepth;
+
+		if (pMesh != NULL) {
+			pMesh->AddRef();
+			m_pBoundMesh = pMesh;
+			return true;
+		}
+		if (FAILED(D3DXCreateBox(pDevice, iwidth, iheight, idepth, &m_pBoundMesh, NULL)))
+			return false;
+		return true;
+	}
+	void destroy(void)
+	{
+		if (m_pBoundMesh != NULL) {
+			m_pBoundMesh->Release();
+			m_pBoundMesh = NULL;
+		}
+	}
+	void draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& mWorld)
+	{
+		if (NULL == pDevice)
+			return;
+		pDevice->SetTransform(D3DTS_WORLD, &mWorld);
+		pDevice->MultiplyTransform(D3DTS_WORLD, &m_mLocal);
+		pDevice->SetMaterial(&m_mtrl);
+		m_pBoundMesh->DrawSubset(0);
+	}
+
+	// what draw() hands the device, for drawing it lit elsewhere (staticLighting.h)
+	ID3DXMesh* getMesh(void) const { return m_pBoundMesh; }
+	const D3DMATERIAL9& getMaterial(void) const { return m_mtrl; }
+	const D3DXMATRIX& getLocalTransform(void) const { return m_mLocal; }
+
+	bool hasIntersected(CSphere& ball)
+	{
+		// Insert your code here.
+		D3DXVECTOR3 ballCenter = ball.getCenter();
+		float ballRadius = ball.getRadius();
+
+		// Check for collision with this wall (based on its position and size)
+		if (ballCenter.x - ballRadius <= -g_tableHalfX || ballCenter.x + ballRadius >= g_tableHalfX ||
+			ballCenter.z - ballRadius <= -g_tableHalfZ || ballCenter.z + ballRadius >= g_tableHalfZ) {
+			return true; // Collision detected
+		}
+		return false; // No collision
+	}
+
+
+	// whether a velocity component was reflected. every wall bounces the
+	// ball off all four sides of the table, so one call per ball does them
+	// all. a ball resting on a cushion or already moving away from it is
+	// only put back, and does not count
+	bool CWall::hitBy(CSphere& ball)
+	{
+		if (!this->hasIntersected(ball)) return false; // No collision, return early
+
+		D3DXVECTOR3 ballCenter = ball.getCenter();
+		float ballRadius = ball.getRadius();
+		bool reflected = false;
+
+		// Check collisions with walls and adjust velocity and position
+		if (ballCenter.x - ballRadius <= -g_tableHalfX) { // Left wall
+			reflected = reflected || ball.getVelocity_X() < 0;
+			ball.setPower(fabsf(ball.getVelocity_X()), ball.getVelocity_Z()); // Reflect X velocity
+			ball.setCenter(-g_tableHalfX + ballRadius, ballCenter.y, ballCenter.z); // Reposition outside wall
+		}
+		if (ballCenter.x + ballRadius >= g_tableHalfX) { // Right wall
+			reflected = reflected || ball.getVelocity_X() > 0;
+			ball.setPower(-fabsf(ball.getVelocity_X()), ball.getVelocity_Z()); // Reflect X velocity
+			ball.setCenter(g_tableHalfX - ballRadius, ballCenter.y, ballCenter.z); // Reposition outside wall
+		}
+		if (ballCenter.z - ballRadius <= -g_tableHalfZ) { // Bottom wall
+			reflected = reflected || ball.getVelocity_Z() < 0;
+			ball.setPower(ball.getVelocity_X(), fabsf(ball.getVelocity_Z())); // Reflect Z velocity
+			ball.setCenter(ballCenter.x, ballCenter.y, -g_tableHalfZ + ballRadius); // Reposition outside wall
+		}
+		if (ballCenter.z + ballRadius >= g_tableHalfZ) { // Top wall
+			reflected = reflected || ball.getVelocity_Z() > 0;
+			ball.setPower(ball.getVelocity_X(), -fabsf(ball.getVelocity_Z())); // Reflect Z velocity
+			ball.setCenter(ballCenter.x, ballCenter.y, g_tableHalfZ - ballRadius); // Reposition outside wall
+		}
+		return reflected;
+	}
+
+
+	void setPosition(float x, float y, float z)
+	{
+		D3DXMATRIX m;
+		this->m_x = x;
+		this->m_z = z;
+
+		D3DXMatrixTranslation(&m, x, y, z);
+		setLocalTransform(m);
+	}
+
+	float getHeight(void) const { return M_HEIGHT; }
+
+
+
+private:
+	void setLocalTransform(const D3DXMATRIX& mLocal) { m_mLocal = mLocal; }
+
+	D3DXMATRIX              m_mLocal;
+	D3DMATERIAL9            m_mtrl;
+	ID3DXMesh* m_pBoundMesh;
+};
+
+#endif // __billiardH__
@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: cushionBench.cpp
+//
+// Desc: Cushion contacts through CCushionField against the four-sided box.
+//
+//       cushionBench [balls] [ticks]
+//
+//       Every ball of a random packing gets a random push and the fixed-point
+//       table runs three times from the same state: with the built-in box
+//       cushions, with the same rectangle given as an outline, and with six
+//       pockets cut into it. Prints the time per tick, how many balls were
+//       pocketed and the energy left, and how far single-ball shots off the
+//       outline end up from the same shots off the box.
+//
+//       Then the cushion test alone, per ball, over positions spread across
+//       the table: the box compares against the field lookup, with the
+//       rectangle and with a 64-sided outline.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "tablePhysics.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+static const unsigned int SAMPLE_ROUNDS = 20;
+static const unsigned int ROUND_SIDES = 64;
+static const unsigned int SINGLE_SHOTS = 100;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static bool loadScene(scene::CSceneBuilder& builder, std::vector<unsigned char>& image, scene::CSceneFile& sc)
+{
+	builder.build(image);
+	return sc.openMemory(&image[0], image.size());
+}
+
+static void loadBalls(const scene::CSceneFile& sc, TBallSet<FixedPolicy>& b)
+{
+	const scene::SceneHeader& h = sc.header();
+	b.resize(h.ballCount);
+	scene::CRandom rng(3);
+	for (unsigned int i = 0; i < h.ballCount; i++) {
+		b.x[i] = FixedPolicy::fromFloat(sc.balls()[i].x);
+		b.z[i] = FixedPolicy::fromFloat(sc.balls()[i].z);
+		b.vx[i] = FixedPolicy::fromFloat((rng.unit() * 2 - 1) * 4);
+		b.vz[i] = FixedPolicy::fromFloat((rng.unit() * 2 - 1) * 4);
+		b.type[i] = sc.balls()[i].type;
+		b.active[i] = 1;
+	}
+}
+
+static double run(const scene::CSceneFile& sc, const CCushionField* cushions, unsigned int ticks, TBallSet<FixedPolicy>& b)
+{
+	const scene::SceneHeader& h = sc.header();
+	loadBalls(sc, b);
+	TTablePhysics<FixedPolicy> table;
+	table.setTable(h.tableHalfX, h.tableHalfZ);
+	table.setCushions(cushions);
+	CCollisionEventBuffer events;
+	const int dt = FixedPolicy::fromFloat(0.005f);
+
+	Clock::time_point t0 = Clock::now();
+	for (unsigned int t = 0; t < ticks; t++) {
+		events.clear();
+		table.step(b, dt, events);
+	}
+	return msSince(t0) / ticks;
+}
+
+static double energy(const TBallSet<FixedPolicy>& b)
+{
+	double e = 0;
+	for (size_t i = 0; i < b.size(); i++) {
+		double vx = FixedPolicy::toFloat(b.vx[i]), vz = FixedPolicy::toFloat(b.vz[i]);
+		e += vx * vx + vz * vz;
+	}
+	return e / 2;
+}
+
+// the test bounceWalls makes, without the response
+static unsigned int boxContacts(const std::vector<int>& x, const std::vector<int>& z, int halfX, int halfZ, int r)
+{
+	unsigned int contacts = 0;
+	for (size_t i = 0; i < x.size(); i++) {
+		if (x[i] - r <= -halfX || x[i] + r >= halfX || z[i] - r <= -halfZ || z[i] + r >= halfZ)
+			contacts++;
+	}
+	return contacts;
+}
+
+static unsigned int fieldContacts(const std::vector<int>& x, const std::vector<int>& z, const CCushionField& f, int r)
+{
+	unsigned int contacts = 0;
+	for (size_t i = 0; i < x.size(); i++) {
+		int d, nx, nz, pocket;
+		f.sample(x[i], z[i], d, nx, nz, pocket);
+		if (d < r || pocket >= 0)
+			contacts++;
+	}
+	return contacts;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 10000;
+	unsigned int ticks = argc > 2 ? (unsigned int)atoi(argv[2]) : 400;
+
+	scene::CSceneBuilder boxBuilder;
+	scene::generateRandomPacking(boxBuilder, count, 1);
+	std::vector<unsigned char> boxImage;
+	scene::CSceneFile boxScene;
+	if (!loadScene(boxBuilder, boxImage, boxScene)) {
+		fprintf(stderr, "bad scene image\n");
+		return 1;
+	}
+	const scene::SceneHeader& h = boxScene.header();
+
+	// the same rectangle as an outline
+	scene::CSceneBuilder rectBuilder;
+	scene::generateRandomPacking(rectBuilder, count, 1);
+	rectBuilder.addOutlinePoint(-h.tableHalfX, -h.tableHalfZ);
+	rectBuilder.addOutlinePoint(h.tableHalfX, -h.tableHalfZ);
+	rectBuilder.addOutlinePoint(h.tableHalfX, h.tableHalfZ);
+	rectBuilder.addOutlinePoint(-h.tableHalfX, h.tableHalfZ);
+	std::vector<unsigned char> rectImage;
+	scene::CSceneFile rectScene;
+	loadScene(rectBuilder, rectImage, rectScene);
+
+	scene::CSceneBuilder pocketBuilder;
+	scene::generateRandomPacking(pocketBuilder, count, 1);
+	pocketBuilder.addPockets(2 * scene::SCENE_BALL_RADIUS, scene::SCENE_BALL_RADIUS / 2);
+	std::vector<unsigned char> pocketImage;
+	scene::CSceneFile pocketScene;
+	loadScene(pocketBuilder, pocketImage, pocketScene);
+
+	// a round table inside the rectangle
+	std::vector<scene::SceneOutlinePoint> round(ROUND_SIDES);
+	for (unsigned int k = 0; k < ROUND_SIDES; k++) {
+		float a = 6.2831853f * k / ROUND_SIDES;
+		round[k].x = h.tableHalfX * cosf(a);
+		round[k].z = h.tableHalfZ * sinf(a);
+	}
+
+	CCushionField rectField, pocketField, roundField;
+	Clock::time_point t0 = Clock::now();
+	rectField.build(rectScene);
+	double rectBuildMs = msSince(t0);
+	t0 = Clock::now();
+	pocketField.build(pocketScene);
+	double pocketBuildMs = msSince(t0);
+	t0 = Clock::now();
+	roundField.build(&round[0], ROUND_SIDES, NULL, 0, 0, h.tableHalfX, h.tableHalfZ);
+	double roundBuildMs = msSince(t0);
+	printf("%u balls, table %.1f x %.1f, field %d x %d at %.3f, band tiles %u/%u/%u of %u\n",
+		h.ballCount, 2 * h.tableHalfX, 2 * h.tableHalfZ, rectField.getWidth(), rectField.getHeight(),
+		rectField.getCellSize(), (unsigned int)rectField.getBandTileCount(), (unsigned int)pocketField.getBandTileCount(),
+		(unsigned int)roundField.getBandTileCount(), (unsigned int)rectField.getTileCount());
+	printf("build: rectangle %.2f ms, pockets %.2f ms, %u-gon %.2f ms\n", rectBuildMs, pocketBuildMs, ROUND_SIDES, roundBuildMs);
+
+	TBallSet<FixedPolicy> box, rect, pocket;
+	double boxMs = run(boxScene, NULL, ticks, box);
+	double rectMs = run(rectScene, &rectField, ticks, rect);
+	double pocketMs = run(pocketScene, &pocketField, ticks, pocket);
+
+	unsigned int potted = 0;
+	for (size_t i = 0; i < pocket.size(); i++) {
+		if (!pocket.active[i])
+			potted++;
+	}
+	printf("%u ticks: box %.3f ms/tick, outline %.3f ms/tick, pockets %.3f ms/tick, %u balls pocketed\n",
+		ticks, boxMs, rectMs, pocketMs, potted);
+	printf("kinetic energy left: box %.1f, outline %.1f\n", energy(box), energy(rect));
+
+	// one ball alone, the same shots off the box and off the outline
+	float maxDev = 0;
+	scene::CRandom shotRng(11);
+	for (unsigned int s = 0; s < SINGLE_SHOTS; s++) {
+		TBallSet<FixedPolicy> one[2];
+		float vx = (shotRng.unit() * 2 - 1) * 8, vz = (shotRng.unit() * 2 - 1) * 8;
+		for (int k = 0; k < 2; k++) {
+			TBallSet<FixedPolicy>& b = one[k];
+			b.resize(1);
+			b.x[0] = b.z[0] = 0;
+			b.vx[0] = FixedPolicy::fromFloat(vx);
+			b.vz[0] = FixedPolicy::fromFloat(vz);
+			b.type[0] = ENTITY_WHITE;
+			b.active[0] = 1;
+			TTablePhysics<FixedPolicy> table;
+			table.setTable(h.tableHalfX, h.tableHalfZ);
+			table.setCushions(k == 0 ? NULL : &rectField);
+			CCollisionEventBuffer events;
+			for (unsigned int t = 0; t < ticks && !b.atRest(); t++)
+				table.step(b, FixedPolicy::fromFloat(0.005f), events);
+		}
+		float dx = FixedPolicy::toFloat(one[0].x[0] - one[1].x[0]), dz = FixedPolicy::toFloat(one[0].z[0] - one[1].z[0]);
+		maxDev = std::max(maxDev, sqrtf(dx * dx + dz * dz));
+	}
+	printf("%u single-ball shots, outline against box: at most %.4f apart\n", SINGLE_SHOTS, maxDev);
+
+	// the test alone, at positions all over the table
+	std::vector<int> x(box.size()), z(box.size());
+	scene::CRandom rng(7);
+	for (size_t i = 0; i < x.size(); i++) {
+		x[i] = FixedPolicy::fromFloat((rng.unit() * 2 - 1) * h.tableHalfX);
+		z[i] = FixedPolicy::fromFloat((rng.unit() * 2 - 1) * h.tableHalfZ);
+	}
+	const int r = FixedPolicy::fromFloat(scene::SCENE_BALL_RADIUS);
+	const int halfX = FixedPolicy::fromFloat(h.tableHalfX), halfZ = FixedPolicy::fromFloat(h.tableHalfZ);
+	unsigned int hits[3] = { 0, 0, 0 };
+	double ns[3] = { 0, 0, 0 };
+	for (unsigned int k = 0; k < SAMPLE_ROUNDS; k++) {
+		t0 = Clock::now();
+		hits[0] += boxContacts(x, z, halfX, halfZ, r);
+		ns[0] += msSince(t0);
+		t0 = Clock::now();
+		hits[1] += fieldContacts(x, z, rectField, r);
+		ns[1] += msSince(t0);
+		t0 = Clock::now();
+		hits[2] += fieldContacts(x, z, roundField, r);
+		ns[2] += msSince(t0);
+	}
+	const double perBall = 1e6 / ((double)SAMPLE_ROUNDS * x.size());
+	printf("cushion test per ball: box %.2f ns, rectangle field %.2f ns, %u-gon field %.2f ns\n",
+		ns[0] * perBall, ns[1] * perBall, ROUND_SIDES, ns[2] * perBall);
+	printf("contacts found: box %u, rectangle field %u, %u-gon field %u\n",
+		hits[0] / SAMPLE_ROUNDS, hits[1] / SAMPLE_ROUNDS, ROUND_SIDES, hits[2] / SAMPLE_ROUNDS);
+	return 0;
+}
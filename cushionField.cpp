@@ -0,0 +1,304 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: cushionField.cpp
+//
+// Desc: Table outline as a 2D signed distance field.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "cushionField.h"
+#include "numericPolicy.h"
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	const float Q16 = 65536.0f;
+
+	// what every tile of one build needs to know
+	struct Outline
+	{
+		const scene::SceneOutlinePoint*	points;
+		unsigned int					count;
+		const scene::ScenePocket*		pockets;
+		unsigned int					pocketCount;
+		float							jawRadius;
+		float							band;
+		float							originX, originZ, cell;
+		std::vector<std::vector<float> >	rowCross;	// sorted crossings of point rows -1 .. height
+	};
+
+	// polynomial smooth maximum: max(a, b) where they are more than k
+	// apart, rounded over a width of k where they meet
+	float smoothMax(float a, float b, float k)
+	{
+		if (k <= 0)
+			return std::max(a, b);
+		float h = std::max(k - fabsf(a - b), 0.0f) / k;
+		return std::max(a, b) + h * h * k * 0.25f;
+	}
+
+	float segmentDistance(float px, float pz, const scene::SceneOutlinePoint& a, const scene::SceneOutlinePoint& b)
+	{
+		float ex = b.x - a.x, ez = b.z - a.z;
+		float len2 = ex * ex + ez * ez;
+		float t = len2 > 0 ? ((px - a.x) * ex + (pz - a.z) * ez) / len2 : 0;
+		t = std::min(1.0f, std::max(0.0f, t));
+		float dx = px - a.x - t * ex, dz = pz - a.z - t * ez;
+		return sqrtf(dx * dx + dz * dz);
+	}
+
+	// even-odd rule along the point's row
+	bool insideAt(const Outline& o, int i, int j)
+	{
+		const std::vector<float>& row = o.rowCross[j + 1];
+		float px = o.originX + i * o.cell;
+		return ((std::upper_bound(row.begin(), row.end(), px) - row.begin()) & 1) != 0;
+	}
+
+	// signed distance at grid point (i, j), clamped to the band. edges are
+	// the ones near its tile: any other is further than the band anyway
+	float fieldAt(const Outline& o, const std::vector<unsigned int>& edges, int i, int j, int* pocket)
+	{
+		float px = o.originX + i * o.cell, pz = o.originZ + j * o.cell;
+		float dist = o.band;
+		for (size_t k = 0; k < edges.size(); k++) {
+			unsigned int e = edges[k];
+			dist = std::min(dist, segmentDistance(px, pz, o.points[e], o.points[(e + 1) % o.count]));
+		}
+		float poly = insideAt(o, i, j) ? dist : -dist;
+
+		// pockets join the polygon with the smooth maximum. a point past
+		// the cushion line inside a pocket circle is in that pocket
+		float field = poly;
+		*pocket = -1;
+		for (unsigned int k = 0; k < o.pocketCount; k++) {
+			const scene::ScenePocket& p = o.pockets[k];
+			float dx = px - p.x, dz = pz - p.z;
+			float d = p.radius - sqrtf(dx * dx + dz * dz);
+			if (d > 0 && poly < 0)
+				*pocket = (int)k;
+			field = smoothMax(field, d, o.jawRadius);
+		}
+		return std::min(o.band, std::max(-o.band, field));
+	}
+
+	int lerpQ16(int a, int b, int f) { return a + FixedPolicy::mul(b - a, f); }
+}
+
+CCushionField::CCushionField(void)
+{
+	m_tilesX = m_tilesZ = 0;
+	m_width = m_height = 0;
+	m_far = 0;
+	m_originX = m_originZ = 0;
+	m_cell = m_invCell = 0;
+	m_fxOriginX = m_fxOriginZ = 0;
+	m_fxInvCell = 0;
+}
+
+void CCushionField::clear(void)
+{
+	m_tiles.clear();
+	m_points.clear();
+	m_tilesX = m_tilesZ = 0;
+	m_width = m_height = 0;
+}
+
+bool CCushionField::build(const scene::CSceneFile& sc)
+{
+	const scene::SceneHeader& h = sc.header();
+	if (h.outlineCount < 3) {
+		clear();
+		return false;
+	}
+	return build(sc.outline(), h.outlineCount, sc.pockets(), h.pocketCount, h.jawRadius, h.tableHalfX, h.tableHalfZ);
+}
+
+bool CCushionField::build(const scene::SceneOutlinePoint* outline, unsigned int outlineCount,
+	const scene::ScenePocket* pockets, unsigned int pocketCount, float jawRadius,
+	float halfX, float halfZ)
+{
+	clear();
+	if (outline == NULL || outlineCount < 3)
+		return false;
+	const int T = CUSHION_TILE;
+
+	// one spare cell around the table, and a coarser grid where the usual
+	// one would not fit in CUSHION_MAX_POINTS
+	float cell = CUSHION_CELL_SIZE;
+	cell = std::max(cell, sqrtf(4 * halfX * halfZ / CUSHION_MAX_POINTS));
+	cell = std::max(cell, 2 * std::max(halfX, halfZ) / (CUSHION_MAX_SIDE - T - 3));
+	m_cell = cell;
+	m_invCell = 1 / cell;
+	m_originX = -halfX - cell;
+	m_originZ = -halfZ - cell;
+	m_tilesX = ((int)ceilf(2 * halfX / cell) + 2 + T - 1) / T;
+	m_tilesZ = ((int)ceilf(2 * halfZ / cell) + 2 + T - 1) / T;
+	m_width = m_tilesX * T + 1;
+	m_height = m_tilesZ * T + 1;
+
+	Outline o;
+	o.points = outline;
+	o.count = outlineCount;
+	o.pockets = pockets;
+	o.pocketCount = pockets != NULL ? pocketCount : 0;
+	o.jawRadius = jawRadius;
+	// a ball only asks about distances up to its radius; a bit more keeps
+	// the normals at the edge of the band from reading the cut-off
+	o.band = 2 * scene::SCENE_BALL_RADIUS + jawRadius + 2 * cell;
+	o.originX = m_originX;
+	o.originZ = m_originZ;
+	o.cell = cell;
+	o.rowCross.resize(m_height + 2);
+	for (int j = -1; j <= m_height; j++) {
+		float pz = m_originZ + j * cell;
+		std::vector<float>& row = o.rowCross[j + 1];
+		for (unsigned int k = 0; k < outlineCount; k++) {
+			const scene::SceneOutlinePoint& a = outline[k];
+			const scene::SceneOutlinePoint& b = outline[(k + 1) % outlineCount];
+			if ((a.z <= pz) != (b.z <= pz))
+				row.push_back(a.x + (pz - a.z) * (b.x - a.x) / (b.z - a.z));
+		}
+		std::sort(row.begin(), row.end());
+	}
+
+	// edges and pockets within reach of each tile: the band, plus the way
+	// from the tile's centre to its farthest point, one beyond the tile
+	const size_t tileCount = (size_t)m_tilesX * m_tilesZ;
+	const float tileSize = T * cell;
+	const float reach = o.band + 0.7072f * (T + 2) * cell;
+	std::vector<std::vector<unsigned int> > tileEdges(tileCount);
+	std::vector<unsigned char> nearPocket(tileCount, 0);
+	for (unsigned int k = 0; k < outlineCount; k++) {
+		const scene::SceneOutlinePoint& a = outline[k];
+		const scene::SceneOutlinePoint& b = outline[(k + 1) % outlineCount];
+		int ti0 = std::max(0, (int)floorf((std::min(a.x, b.x) - reach - m_originX) / tileSize));
+		int ti1 = std::min(m_tilesX - 1, (int)floorf((std::max(a.x, b.x) + reach - m_originX) / tileSize));
+		int tj0 = std::max(0, (int)floorf((std::min(a.z, b.z) - reach - m_originZ) / tileSize));
+		int tj1 = std::min(m_tilesZ - 1, (int)floorf((std::max(a.z, b.z) + reach - m_originZ) / tileSize));
+		for (int tj = tj0; tj <= tj1; tj++) {
+			for (int ti = ti0; ti <= ti1; ti++) {
+				float cx = m_originX + (ti + 0.5f) * tileSize, cz = m_originZ + (tj + 0.5f) * tileSize;
+				if (segmentDistance(cx, cz, a, b) < reach)
+					tileEdges[(size_t)tj * m_tilesX + ti].push_back(k);
+			}
+		}
+	}
+	for (unsigned int k = 0; k < o.pocketCount; k++) {
+		const scene::ScenePocket& p = pockets[k];
+		float r = p.radius + reach + jawRadius;
+		int ti0 = std::max(0, (int)floorf((p.x - r - m_originX) / tileSize));
+		int ti1 = std::min(m_tilesX - 1, (int)floorf((p.x + r - m_originX) / tileSize));
+		int tj0 = std::max(0, (int)floorf((p.z - r - m_originZ) / tileSize));
+		int tj1 = std::min(m_tilesZ - 1, (int)floorf((p.z + r - m_originZ) / tileSize));
+		for (int tj = tj0; tj <= tj1; tj++) {
+			for (int ti = ti0; ti <= ti1; ti++)
+				nearPocket[(size_t)tj * m_tilesX + ti] = 1;
+		}
+	}
+
+	// band tiles get their points, with normals by central differences over
+	// a ring of points one beyond the tile; the rest are inside or outside
+	const int S = T + 3;
+	std::vector<float> field(S * S);
+	std::vector<int> pocketOf(S * S);
+	Point tile[TILE_POINTS];
+	m_far = FixedPolicy::fromFloat(o.band);
+	m_tiles.resize(tileCount);
+	for (int tj = 0; tj < m_tilesZ; tj++) {
+		for (int ti = 0; ti < m_tilesX; ti++) {
+			const size_t t = (size_t)tj * m_tilesX + ti;
+			const int i0 = ti * T, j0 = tj * T;
+			m_tiles[t] = insideAt(o, i0 + T / 2, j0 + T / 2) ? TILE_INSIDE : TILE_OUTSIDE;
+			if (tileEdges[t].empty() && !nearPocket[t])
+				continue;
+
+			for (int j = 0; j < S; j++) {
+				for (int i = 0; i < S; i++)
+					field[j * S + i] = fieldAt(o, tileEdges[t], i0 + i - 1, j0 + j - 1, &pocketOf[j * S + i]);
+			}
+			bool uniform = true;
+			for (int j = 0; j <= T; j++) {
+				for (int i = 0; i <= T; i++) {
+					const int c = (j + 1) * S + i + 1;
+					float gx = field[c + 1] - field[c - 1];
+					float gz = field[c + S] - field[c - S];
+					float len = sqrtf(gx * gx + gz * gz);
+					Point& p = tile[j * (T + 1) + i];
+					p.distance = FixedPolicy::fromFloat(field[c]);
+					p.nx = len > 0 ? FixedPolicy::fromFloat(gx / len) : 0;
+					p.nz = len > 0 ? FixedPolicy::fromFloat(gz / len) : 0;
+					p.pocket = pocketOf[c];
+					uniform = uniform && p.pocket < 0 && p.distance == tile[0].distance &&
+						(p.distance == m_far || p.distance == -m_far);
+				}
+			}
+			if (uniform) {
+				m_tiles[t] = tile[0].distance > 0 ? TILE_INSIDE : TILE_OUTSIDE;
+				continue;
+			}
+			m_tiles[t] = (int)(m_points.size() / TILE_POINTS);
+			m_points.insert(m_points.end(), tile, tile + TILE_POINTS);
+		}
+	}
+
+	m_fxOriginX = FixedPolicy::fromFloat(m_originX);
+	m_fxOriginZ = FixedPolicy::fromFloat(m_originZ);
+	m_fxInvCell = FixedPolicy::fromFloat(m_invCell);
+	return true;
+}
+
+void CCushionField::sample(float x, float z, float& distance, float& nx, float& nz, int& pocket) const
+{
+	float u = (x - m_originX) * m_invCell, v = (z - m_originZ) * m_invCell;
+	int i = (int)floorf(u), j = (int)floorf(v);
+	float fu = u - i, fv = v - j;
+	if (i < 0) { i = 0; fu = 0; }
+	else if (i > m_width - 2) { i = m_width - 2; fu = 1; }
+	if (j < 0) { j = 0; fv = 0; }
+	else if (j > m_height - 2) { j = m_height - 2; fv = 1; }
+
+	int tile = m_tiles[(size_t)(j / CUSHION_TILE) * m_tilesX + i / CUSHION_TILE];
+	if (tile < 0) {
+		distance = (tile == TILE_INSIDE ? m_far : -m_far) / Q16;
+		nx = nz = 0;
+		pocket = -1;
+		return;
+	}
+	const Point* p = &m_points[(size_t)tile * TILE_POINTS + (j % CUSHION_TILE) * (CUSHION_TILE + 1) + i % CUSHION_TILE];
+	const Point* q = p + CUSHION_TILE + 1;
+	float w00 = (1 - fu) * (1 - fv) / Q16, w10 = fu * (1 - fv) / Q16;
+	float w01 = (1 - fu) * fv / Q16, w11 = fu * fv / Q16;
+	distance = p[0].distance * w00 + p[1].distance * w10 + q[0].distance * w01 + q[1].distance * w11;
+	nx = p[0].nx * w00 + p[1].nx * w10 + q[0].nx * w01 + q[1].nx * w11;
+	nz = p[0].nz * w00 + p[1].nz * w10 + q[0].nz * w01 + q[1].nz * w11;
+	pocket = (fv < 0.5f ? p : q)[fu < 0.5f ? 0 : 1].pocket;
+}
+
+void CCushionField::sample(int x, int z, int& distance, int& nx, int& nz, int& pocket) const
+{
+	const int one = FixedPolicy::one();
+	int u = FixedPolicy::mul(x - m_fxOriginX, m_fxInvCell);
+	int v = FixedPolicy::mul(z - m_fxOriginZ, m_fxInvCell);
+	int i = u >> FixedPolicy::FRAC_BITS, j = v >> FixedPolicy::FRAC_BITS;
+	int fu = u & (one - 1), fv = v & (one - 1);
+	if (i < 0) { i = 0; fu = 0; }
+	else if (i > m_width - 2) { i = m_width - 2; fu = one; }
+	if (j < 0) { j = 0; fv = 0; }
+	else if (j > m_height - 2) { j = m_height - 2; fv = one; }
+
+	int tile = m_tiles[(size_t)(j / CUSHION_TILE) * m_tilesX + i / CUSHION_TILE];
+	if (tile < 0) {
+		distance = tile == TILE_INSIDE ? m_far : -m_far;
+		nx = nz = 0;
+		pocket = -1;
+		return;
+	}
+	const Point* p = &m_points[(size_t)tile * TILE_POINTS + (j % CUSHION_TILE) * (CUSHION_TILE + 1) + i % CUSHION_TILE];
+	const Point* q = p + CUSHION_TILE + 1;
+	distance = lerpQ16(lerpQ16(p[0].distance, p[1].distance, fu), lerpQ16(q[0].distance, q[1].distance, fu), fv);
+	nx = lerpQ16(lerpQ16(p[0].nx, p[1].nx, fu), lerpQ16(q[0].nx, q[1].nx, fu), fv);
+	nz = lerpQ16(lerpQ16(p[0].nz, p[1].nz, fu), lerpQ16(q[0].nz, q[1].nz, fu), fv);
+	pocket = (fv < one / 2 ? p : q)[fu < one / 2 ? 0 : 1].pocket;
+}
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: cushionField.h
+//
+// Desc: Table outline as a 2D signed distance field, for cushion contacts
+//       against any shape of table.
+//
+//       The outline is a polygon along the cushion line plus pocket circles
+//       cut into it. build() works out, on a regular grid over the table,
+//       the distance to the nearest cushion (positive on the cloth), its
+//       direction and which pocket a point has dropped into. The polygon and
+//       the pockets are joined with a smooth maximum, which is what rounds
+//       the jaws where a pocket cuts the cushion line.
+//
+//       A ball is then tested with one bilinear lookup of four grid points,
+//       whatever the outline looks like: it touches a cushion where the
+//       distance is below its radius, and the normal it bounces off is the
+//       interpolated direction.
+//
+//       Only the band around the outline needs real distances. The grid is
+//       cut into tiles of CUSHION_TILE cells a side; tiles in the band keep
+//       their points, every other tile is one entry saying "far inside" or
+//       "far outside". A ball in the middle of the table costs one read of
+//       the small tile map, a ball near a cushion one more of a tile that
+//       the other balls near that cushion are using too.
+//
+//       The grid is kept in Q16.16 so the fixed-point table reads the same
+//       bits on every host. sample() has a float and a Q16.16 overload, so
+//       code templated on a numeric policy calls it with its own scalars.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __cushionFieldH__
+#define __cushionFieldH__
+
+#include "sceneFile.h"
+#include <vector>
+
+const float CUSHION_CELL_SIZE = 0.02f;				// grid spacing on a normal table
+const unsigned int CUSHION_MAX_POINTS = 4u << 20;	// larger tables get a coarser grid
+const int CUSHION_MAX_SIDE = 8192;					// keeps Q16.16 grid coordinates in an int
+const int CUSHION_TILE = 8;							// cells per tile side
+
+// a ball this close counts as touching, as CWall::hasIntersected counts a
+// ball exactly on the cushion. otherwise a ball the integration clamped onto
+// the cushion could read a hair more than its radius, keep its outward
+// velocity and be clamped there again
+const float CUSHION_CONTACT_SLOP = 0.001f;
+
+class CCushionField {
+public:
+	CCushionField(void);
+
+	// outline and pockets in table coordinates. halfX, halfZ bound everything
+	// a ball can reach, pockets included. false if the outline has fewer
+	// than three points
+	bool build(const scene::SceneOutlinePoint* outline, unsigned int outlineCount,
+		const scene::ScenePocket* pockets, unsigned int pocketCount, float jawRadius,
+		float halfX, float halfZ);
+	bool build(const scene::CSceneFile& sc);		// from the scene, false if it has no outline
+	void clear(void);
+	bool isBuilt(void) const { return !m_tiles.empty(); }
+
+	// distance to the cushion at (x, z), the direction away from it (not
+	// quite unit length between grid points) and the pocket the point is
+	// in, or -1. the int overload takes and returns Q16.16
+	void sample(float x, float z, float& distance, float& nx, float& nz, int& pocket) const;
+	void sample(int x, int z, int& distance, int& nx, int& nz, int& pocket) const;
+
+	float getCellSize(void) const { return m_cell; }
+	int getWidth(void) const { return m_width; }
+	int getHeight(void) const { return m_height; }
+	size_t getTileCount(void) const { return m_tiles.size(); }
+	size_t getBandTileCount(void) const { return m_points.size() / TILE_POINTS; }
+
+private:
+	struct Point {
+		int		distance;		// Q16.16
+		int		nx, nz;			// Q16.16
+		int		pocket;
+	};
+
+	// a tile also holds the first row and column of the next one, so that a
+	// lookup never needs a second tile
+	enum { TILE_POINTS = (CUSHION_TILE + 1) * (CUSHION_TILE + 1) };
+	enum { TILE_INSIDE = -1, TILE_OUTSIDE = -2 };
+
+	std::vector<int>	m_tiles;		// row by row: band tile number, TILE_INSIDE or TILE_OUTSIDE
+	std::vector<Point>	m_points;		// TILE_POINTS per band tile, row by row within the tile
+	int					m_tilesX, m_tilesZ;
+	int					m_width, m_height;	// points
+	int					m_far;			// Q16.16 distance reported away from the band
+	float				m_originX, m_originZ;
+	float				m_cell, m_invCell;
+	int					m_fxOriginX, m_fxOriginZ;	// Q16.16 copies for the int overload
+	int					m_fxInvCell;
+};
+
+#endif // __cushionFieldH__
@@ -153,19 +153,23 @@ int d3d::EnterMsgLoop( bool (*ptr_display)(float timeDelta) )
 
 	while(msg.message != WM_QUIT)
 	{
-		if(::PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
+		// every message that is waiting, then one frame. input is queued by
+		// the window procedure and applied at the start of the frame
+		while(::PeekMessage(&msg, 0, 0, 0, PM_REMOVE))
 		{
+			if(msg.message == WM_QUIT)
+				break;
 			::TranslateMessage(&msg);
 			::DispatchMessage(&msg);
 		}
-		else
-        {	
-			double currTime  = (double)timeGetTime();
-			double timeDelta = (currTime - lastTime)*0.0007;
-			ptr_display((float)timeDelta);
-
-			lastTime = currTime;
-        }
+		if(msg.message == WM_QUIT)
+			break;
+
+		double currTime  = (double)timeGetTime();
+		double timeDelta = (currTime - lastTime)*0.0007;
+		ptr_display((float)timeDelta);
+
+		lastTime = currTime;
     }
     return msg.wParam;
 }
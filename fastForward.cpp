@@ -0,0 +1,344 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: fastForward.cpp
+//
+// Desc: Closed-form motion of the float table between contacts.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "fastForward.h"
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	const int OUTLINE_TRACE_STEPS = 4096;	// samples along one path before giving up
+
+	// first g in [from, to] at which |e + w * g| <= reach, HUGE_VAL if none
+	double firstTouch(double ex, double ez, double wx, double wz, double reach, double from, double to)
+	{
+		double rx = ex + wx * from, rz = ez + wz * from;
+		if (rx * rx + rz * rz <= reach * reach)
+			return from;
+		double a = wx * wx + wz * wz;
+		if (a <= 0)
+			return HUGE_VAL;
+		double b = 2 * (ex * wx + ez * wz);
+		double c = ex * ex + ez * ez - reach * reach;
+		double disc = b * b - 4 * a * c;
+		if (disc < 0)
+			return HUGE_VAL;
+		double g = (-b - sqrt(disc)) / (2 * a);
+		return g >= from && g <= to ? g : HUGE_VAL;
+	}
+}
+
+CFastForward::CFastForward(void)
+{
+	m_timeScale = m_decay = m_minSpeed = 0;
+	m_dt = 0;
+	m_halfX = m_halfZ = m_slop = 0;
+	m_cushions = NULL;
+	m_maxSubsteps = 1;
+	m_restTime = 0;
+	m_contactTime = 0;
+	m_contactA = m_contactB = -1;
+}
+
+// the pieces follow the fastest ball, as substepCount() does tick by tick
+void CFastForward::buildPieces(double speed, double radius)
+{
+	const double limit = SUBSTEP_TRAVEL * radius;
+	double first = 0, time = 0, f = 1, g = 0;
+	m_pieces.clear();
+	for (;;) {
+		int parts = 1;
+		while (parts < m_maxSubsteps && m_timeScale * m_dt * speed > limit * parts)
+			parts++;
+
+		Piece p;
+		p.first = first;
+		p.startTime = time;
+		p.h = m_dt / parts;
+		p.rate = std::max(0.0, 1 - m_decay * p.h);
+		p.startF = f;
+		p.startG = g;
+		if (parts == 1) {
+			p.count = HUGE_VAL;
+			m_pieces.push_back(p);
+			return;
+		}
+
+		// whole ticks until the fastest ball is slow enough for fewer parts
+		const double perTick = pow(p.rate, parts);
+		const double below = limit * (parts - 1) / (m_timeScale * m_dt);
+		double ticks = 1;
+		if (perTick > 0 && perTick < 1)
+			ticks = std::max(1.0, ceil(log(below / speed) / log(perTick) - 1e-9));
+		p.count = ticks * parts;
+		m_pieces.push_back(p);
+
+		const double decay = pow(p.rate, p.count);
+		g += p.rate < 1 ? m_timeScale * p.h * f * (1 - decay) / (1 - p.rate) : m_timeScale * p.h * f * p.count;
+		f *= decay;
+		speed *= decay;
+		first += p.count;
+		time += ticks * m_dt;
+	}
+}
+
+const CFastForward::Piece& CFastForward::pieceAtSubstep(double q) const
+{
+	size_t k = 0;
+	while (k + 1 < m_pieces.size() && m_pieces[k + 1].first <= q)
+		k++;
+	return m_pieces[k];
+}
+
+double CFastForward::F(double q) const
+{
+	const Piece& p = pieceAtSubstep(q);
+	return p.startF * pow(p.rate, q - p.first);
+}
+
+double CFastForward::G(double q) const
+{
+	const Piece& p = pieceAtSubstep(q);
+	const double j = q - p.first;
+	if (p.rate >= 1)
+		return p.startG + m_timeScale * p.h * p.startF * j;
+	return p.startG + m_timeScale * p.h * p.startF * (1 - pow(p.rate, j)) / (1 - p.rate);
+}
+
+double CFastForward::timeAt(double q) const
+{
+	const Piece& p = pieceAtSubstep(q);
+	return p.startTime + (q - p.first) * p.h;
+}
+
+double CFastForward::substepAt(double t) const
+{
+	size_t k = 0;
+	while (k + 1 < m_pieces.size() && m_pieces[k + 1].startTime <= t)
+		k++;
+	const Piece& p = m_pieces[k];
+	return p.first + (t - p.startTime) / p.h;
+}
+
+double CFastForward::substepAtTravel(double g) const
+{
+	for (size_t k = 0; k < m_pieces.size(); k++) {
+		const Piece& p = m_pieces[k];
+		const double scale = m_timeScale * p.h * p.startF;
+		if (scale <= 0)
+			return HUGE_VAL;
+		const bool last = k + 1 == m_pieces.size();
+		if (!last && g > m_pieces[k + 1].startG)
+			continue;
+		if (p.rate <= 0)
+			return p.first + std::min(1.0, (g - p.startG) / scale);
+		if (p.rate >= 1)
+			return p.first + (g - p.startG) / scale;
+		const double x = 1 - (g - p.startG) * (1 - p.rate) / scale;
+		return x > 0 ? p.first + log(x) / log(p.rate) : HUGE_VAL;
+	}
+	return HUGE_VAL;
+}
+
+double CFastForward::stopSubstep(double speed) const
+{
+	if (speed <= m_minSpeed)
+		return 0;
+	for (size_t k = 0; k < m_pieces.size(); k++) {
+		const Piece& p = m_pieces[k];
+		const bool last = k + 1 == m_pieces.size();
+		if (speed * p.startF <= m_minSpeed)
+			return p.first;
+		double j;
+		if (p.rate <= 0)
+			j = 1;
+		else if (p.rate >= 1)
+			j = HUGE_VAL;
+		else
+			j = ceil(log(m_minSpeed / (speed * p.startF)) / log(p.rate) - 1e-9);
+		if (last || j <= p.count)
+			return p.first + j;
+	}
+	return HUGE_VAL;
+}
+
+// how far along its path (in G) ball i first reaches the rectangle's
+// cushions, CWall::hitBy's test
+double CFastForward::cushionTravel(size_t i) const
+{
+	const double x = m_start.x[i], z = m_start.z[i];
+	const double vx = m_start.vx[i], vz = m_start.vz[i];
+	const double limitX = m_halfX - m_start.radius[i], limitZ = m_halfZ - m_start.radius[i];
+	double g = HUGE_VAL;
+	if (vx > 0)
+		g = std::min(g, (limitX - x) / vx);
+	else if (vx < 0)
+		g = std::min(g, (-limitX - x) / vx);
+	if (vz > 0)
+		g = std::min(g, (limitZ - z) / vz);
+	else if (vz < 0)
+		g = std::min(g, (-limitZ - z) / vz);
+	return std::max(g, 0.0);
+}
+
+// the same against an outline, by sphere tracing: the field's distance is
+// how far the ball can go before it could be near a cushion. where
+// bounceCushions() would change the ball, the sample before is returned
+double CFastForward::outlineTravel(size_t i) const
+{
+	const double x = m_start.x[i], z = m_start.z[i];
+	const double vx = m_start.vx[i], vz = m_start.vz[i];
+	const double length = sqrt(vx * vx + vz * vz);
+	const double end = m_stopTravel[i];
+	const double r = m_start.radius[i];
+	const double minStep = 0.5 * m_cushions->getCellSize() / length;
+	double g = 0, before = 0;
+	for (int k = 0; k < OUTLINE_TRACE_STEPS; k++) {
+		float d, nx, nz;
+		int pocket;
+		m_cushions->sample((float)(x + vx * g), (float)(z + vz * g), d, nx, nz, pocket);
+		if (pocket >= 0)
+			return before;
+		double advance;
+		if (d < r + m_slop) {
+			const bool ridge = nx * nx + nz * nz < 0.25f;	// bounceCushions() leaves these alone
+			if (!ridge && (d < r || vx * nx + vz * nz < 0))
+				return before;
+			advance = minStep;
+		}
+		else
+			advance = std::max((d - r - m_slop) / length, minStep);
+		if (g >= end)
+			return HUGE_VAL;
+		before = g;
+		g = std::min(g + advance, end);
+	}
+	return before;
+}
+
+// pairs whose paths, widened by the radii, overlap on both axes, swept
+// along x; then the quadratic for each while both move and while one does
+void CFastForward::findPairContacts(double& travel)
+{
+	const size_t n = m_start.size();
+	std::vector<int> order;
+	std::vector<double> minX(n), maxX(n), minZ(n), maxZ(n);
+	for (size_t i = 0; i < n; i++) {
+		if (!m_start.active[i])
+			continue;
+		const double r = m_start.radius[i], g = m_stopTravel[i];
+		const double x0 = m_start.x[i], x1 = x0 + m_start.vx[i] * g;
+		const double z0 = m_start.z[i], z1 = z0 + m_start.vz[i] * g;
+		minX[i] = std::min(x0, x1) - r;		maxX[i] = std::max(x0, x1) + r;
+		minZ[i] = std::min(z0, z1) - r;		maxZ[i] = std::max(z0, z1) + r;
+		order.push_back((int)i);
+	}
+	std::sort(order.begin(), order.end(),
+		[&](int l, int r) { return minX[l] < minX[r] || (minX[l] == minX[r] && l < r); });
+
+	for (size_t p = 0; p < order.size(); p++) {
+		const int i = order[p];
+		for (size_t q = p + 1; q < order.size() && minX[order[q]] <= maxX[i]; q++) {
+			const int j = order[q];
+			if (m_stopSubstep[i] == 0 && m_stopSubstep[j] == 0)
+				continue;
+			if (minZ[j] > maxZ[i] || minZ[i] > maxZ[j])
+				continue;
+
+			const double reach = (double)m_start.radius[i] + m_start.radius[j];
+			const double dx = (double)m_start.x[i] - m_start.x[j], dz = (double)m_start.z[i] - m_start.z[j];
+			const double vix = m_start.vx[i], viz = m_start.vz[i];
+			const double vjx = m_start.vx[j], vjz = m_start.vz[j];
+			const double gi = m_stopTravel[i], gj = m_stopTravel[j];
+			const double both = std::min(gi, gj);
+
+			double g = firstTouch(dx, dz, vix - vjx, viz - vjz, reach, 0, both);
+			if (g == HUGE_VAL && gi < gj)
+				g = firstTouch(dx + vix * gi, dz + viz * gi, -vjx, -vjz, reach, both, gj);
+			else if (g == HUGE_VAL && gj < gi)
+				g = firstTouch(dx - vjx * gj, dz - vjz * gj, vix, viz, reach, both, gi);
+			if (g < travel) {
+				travel = g;
+				m_contactA = std::min(i, j);
+				m_contactB = std::max(i, j);
+			}
+		}
+	}
+}
+
+void CFastForward::prepare(const TBallSet<FloatPolicy>& b, const TTablePhysics<FloatPolicy>& table, float dt)
+{
+	m_timeScale = table.getTimeScale();
+	m_decay = table.getDecay();
+	m_minSpeed = table.getMinSpeed();
+	m_halfX = table.getHalfX();
+	m_halfZ = table.getHalfZ();
+	m_slop = table.getCushionSlop();
+	m_cushions = table.getCushions();
+	m_maxSubsteps = table.getMaxSubsteps();
+	m_dt = dt;
+	m_start = b;
+
+	const size_t n = b.size();
+	double speed = 0, radius = 0;
+	bool any = false;
+	for (size_t i = 0; i < n; i++) {
+		if (!b.active[i])
+			continue;
+		speed = std::max(speed, (double)fabsf(b.vx[i]) + fabsf(b.vz[i]));
+		if (!any || b.radius[i] < radius)
+			radius = b.radius[i];
+		any = true;
+	}
+	buildPieces(speed, any ? radius : M_RADIUS);
+
+	m_stopSubstep.assign(n, 0);
+	m_stopTravel.assign(n, 0);
+	m_stopTime.assign(n, 0);
+	m_restTime = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (!b.active[i])
+			continue;
+		const double q = stopSubstep(std::max(fabsf(b.vx[i]), fabsf(b.vz[i])));
+		m_stopSubstep[i] = q;
+		m_stopTravel[i] = G(q);
+		m_stopTime[i] = (float)timeAt(q);
+		m_restTime = std::max(m_restTime, m_stopTime[i]);
+	}
+
+	double travel = HUGE_VAL;
+	m_contactA = m_contactB = -1;
+	for (size_t i = 0; i < n; i++) {
+		if (!b.active[i] || m_stopSubstep[i] == 0)
+			continue;
+		double g = m_cushions != NULL ? outlineTravel(i) : cushionTravel(i);
+		if (g <= m_stopTravel[i] && g < travel) {
+			travel = g;
+			m_contactA = (int)i;
+		}
+	}
+	findPairContacts(travel);
+	m_contactTime = travel == HUGE_VAL ? m_restTime : (float)std::min((double)m_restTime, timeAt(substepAtTravel(travel)));
+}
+
+void CFastForward::fastForward(float t, TBallSet<FloatPolicy>& out) const
+{
+	out = m_start;
+	const double q = substepAt(t);
+	const double f = F(q), g = G(q);
+	for (size_t i = 0; i < m_start.size(); i++) {
+		if (!m_start.active[i])
+			continue;
+		const bool moving = q <= m_stopSubstep[i];
+		const double travel = q < m_stopSubstep[i] ? g : m_stopTravel[i];
+		out.x[i] = (float)(m_start.x[i] + m_start.vx[i] * travel);
+		out.z[i] = (float)(m_start.z[i] + m_start.vz[i] * travel);
+		out.vx[i] = moving ? (float)(m_start.vx[i] * f) : 0;
+		out.vz[i] = moving ? (float)(m_start.vz[i] * f) : 0;
+	}
+}
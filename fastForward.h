@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: fastForward.h
+//
+// Desc: Closed form of the float table (TTablePhysics<FloatPolicy>) between
+//       contacts: ball positions at any later time without stepping, when
+//       each ball stops, and when the whole table is still.
+//
+//       Away from contacts a substep of length h moves a ball by
+//       TIME_SCALE * h * v and then scales v by r = 1 - decay * h, until
+//       neither |vx| nor |vz| is above the minimum speed. Every moving ball
+//       is scaled by the same r in the same substep, so after q substeps all
+//       of them have moved by v * G(q) and go at v * F(q), with one F and G
+//       for the whole table:
+//
+//         F(q) = r^q        G(q) = TIME_SCALE * h * (1 - r^q) / (1 - r)
+//
+//       A ball whose larger velocity component is m stops at the first q
+//       with m * F(q) <= minimum speed, one logarithm. Substeps
+//       (substepCount()) cut the ticks while the fastest ball is fast; the
+//       fastest ball stays the fastest, so the cuts follow from its speed
+//       alone and give at most MAX_SUBSTEPS pieces of the form above, each
+//       with its own h and r. Times between substeps are read off the same
+//       curves.
+//
+//       prepare() also works out when the first contact would come: a
+//       cushion (the rectangle exactly, an outline by sphere tracing its
+//       field), a pocket, or two balls touching, which is a quadratic in G
+//       for each pair whose paths come near each other. Until then
+//       fastForward() gives what stepping would, to float rounding; from
+//       there on the table has to be stepped. Balls that touch and both stay
+//       at rest are no contact, as stepping them changes nothing.
+//
+//       Float only: lockstep and replays need the bits of the stepped
+//       fixed-point table, and Q16.16 rounding takes it off the closed form.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __fastForwardH__
+#define __fastForwardH__
+
+#include "tablePhysics.h"
+#include <vector>
+
+class CFastForward {
+public:
+	CFastForward(void);
+
+	// the table as it is now, to be stepped with ticks of length dt. the
+	// constants, cushions and substep limit are those of table
+	void prepare(const TBallSet<FloatPolicy>& b, const TTablePhysics<FloatPolicy>& table, float dt);
+
+	// time of the first contact, or getRestTime() if there is none
+	float getContactFreeTime(void) const { return m_contactTime; }
+	// the balls of that contact: b is -1 for a cushion or pocket, both are
+	// -1 without a contact
+	int getContactA(void) const { return m_contactA; }
+	int getContactB(void) const { return m_contactB; }
+
+	// after this time the ball does not move; 0 for a ball at rest or off
+	// the table. stepping clears its velocity in the substep after
+	float getStopTime(size_t i) const { return m_stopTime[i]; }
+	// the last stop time, when the whole table is still
+	float getRestTime(void) const { return m_restTime; }
+
+	// the balls t after prepare(), into out (resized to match). only what
+	// stepping gives for t up to getContactFreeTime(); later, it is the
+	// table as if nothing were in the way
+	void fastForward(float t, TBallSet<FloatPolicy>& out) const;
+
+private:
+	// substeps of one length, from first to first + count
+	struct Piece {
+		double		first;			// substeps before the piece
+		double		count;			// HUGE_VAL for the last piece
+		double		startTime;
+		double		h;				// substep length
+		double		rate;			// velocity factor per substep
+		double		startF;			// F and G at first
+		double		startG;
+	};
+
+	void buildPieces(double speed, double radius);
+	const Piece& pieceAtSubstep(double q) const;
+	double F(double q) const;
+	double G(double q) const;
+	double timeAt(double q) const;
+	double substepAt(double t) const;
+	double substepAtTravel(double g) const;		// G(q) = g
+	double stopSubstep(double speed) const;		// first whole q with speed * F(q) <= minimum speed
+
+	double cushionTravel(size_t i) const;
+	double outlineTravel(size_t i) const;
+	void findPairContacts(double& travel);
+
+	double							m_timeScale, m_decay, m_minSpeed;
+	double							m_dt;
+	double							m_halfX, m_halfZ, m_slop;
+	const CCushionField*			m_cushions;
+	int								m_maxSubsteps;
+	std::vector<Piece>				m_pieces;
+
+	TBallSet<FloatPolicy>			m_start;		// the table prepare() was given
+	std::vector<double>				m_stopSubstep;
+	std::vector<double>				m_stopTravel;	// G at the stop
+	std::vector<float>				m_stopTime;
+	float							m_restTime;
+	float							m_contactTime;
+	int								m_contactA, m_contactB;
+};
+
+#endif // __fastForwardH__
@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: fastForwardBench.cpp
+//
+// Desc: The closed form of fastForward.h against stepping the float table.
+//
+//       fastForwardBench [balls] [scattered balls]
+//
+//       First the given number of balls in lanes along x on a long table,
+//       each rolling along its lane at its own speed, the fastest fast
+//       enough for substeps, so that nothing touches anything. The table
+//       is stepped until it is still, and at several ticks the stepped
+//       balls are compared with fastForward() at the same time. Prints the
+//       largest difference in position and velocity, the ticks until every
+//       ball stopped from both, and the time of stepping against prepare()
+//       plus one fastForward() to rest.
+//
+//       Then balls scattered over a table and all pushed, once with the
+//       rectangle and once with pockets, so that contacts come soon: the
+//       time of the first contact prepare() finds, and the first tick at
+//       which the stepped table leaves the closed form, which must not come
+//       before it.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "fastForward.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+
+static const float TICK = 0.005f;
+static const unsigned int MAX_TICKS = 200000;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static float largestDifference(const TBallSet<FloatPolicy>& a, const TBallSet<FloatPolicy>& b, bool velocity)
+{
+	float worst = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		const float dx = velocity ? a.vx[i] - b.vx[i] : a.x[i] - b.x[i];
+		const float dz = velocity ? a.vz[i] - b.vz[i] : a.z[i] - b.z[i];
+		worst = std::max(worst, std::max(fabsf(dx), fabsf(dz)));
+	}
+	return worst;
+}
+
+// lanes one ball apart, every ball going +x, speeds 0.5 .. 40
+static void laneTable(unsigned int count, TBallSet<FloatPolicy>& b, TTablePhysics<FloatPolicy>& table)
+{
+	const float lane = 3 * (float)M_RADIUS;
+	table.setTable(250, lane * (count + 1) / 2);
+	b.resize(count);
+	scene::CRandom rng(3);
+	for (unsigned int i = 0; i < count; i++) {
+		b.x[i] = -240;
+		b.z[i] = -lane * (count - 1) / 2 + lane * i;
+		b.vx[i] = i == 0 ? 40 : 0.5f + rng.unit() * 10;
+		b.vz[i] = 0;
+		b.type[i] = ENTITY_RED;
+		b.active[i] = 1;
+	}
+}
+
+static void lanes(unsigned int count)
+{
+	TBallSet<FloatPolicy> b, closed;
+	TTablePhysics<FloatPolicy> table;
+	laneTable(count, b, table);
+
+	Clock::time_point t0 = Clock::now();
+	CFastForward ff;
+	ff.prepare(b, table, TICK);
+	ff.fastForward(ff.getRestTime(), closed);
+	const double closedMs = msSince(t0);
+
+	const unsigned int checks[] = { 1, 10, 100, 1000, 3000 };
+	const size_t checkCount = sizeof(checks) / sizeof(checks[0]);
+	float worstX = 0, worstV = 0;
+	CCollisionEventBuffer events;
+	std::vector<unsigned int> stopTick(count, 0);
+	std::vector<float> lastX(b.x);
+	unsigned int ticks = 0, next = 0;
+	t0 = Clock::now();
+	while (!b.atRest() && ticks < MAX_TICKS) {
+		table.step(b, TICK, events);
+		ticks++;
+		for (unsigned int i = 0; i < count; i++) {
+			if (b.x[i] != lastX[i])
+				stopTick[i] = ticks;
+			lastX[i] = b.x[i];
+		}
+		if (next < checkCount && ticks == checks[next]) {
+			ff.fastForward(ticks * TICK, closed);
+			worstX = std::max(worstX, largestDifference(b, closed, false));
+			worstV = std::max(worstV, largestDifference(b, closed, true));
+			next++;
+		}
+	}
+	const double steppedMs = msSince(t0);
+	ff.fastForward(ff.getRestTime(), closed);
+	worstX = std::max(worstX, largestDifference(b, closed, false));
+
+	int stopDiff = 0;
+	for (unsigned int i = 0; i < count; i++)
+		stopDiff = std::max(stopDiff, abs((int)stopTick[i] - (int)floor(ff.getStopTime(i) / TICK + 0.5f)));
+
+	printf("%u balls in lanes, contact free until %.3f, still at %.3f\n",
+		count, ff.getContactFreeTime(), ff.getRestTime());
+	printf("  stepped: still after %u ticks, %.2f ms; closed form: %.0f ticks, %.3f ms\n",
+		ticks, steppedMs, ff.getRestTime() / TICK + 1, closedMs);
+	printf("  largest difference: position %.5f, velocity %.5f, stop tick %d\n", worstX, worstV, stopDiff);
+}
+
+// a jittered grid, no two balls touching, every ball pushed
+static void scattered(unsigned int count, bool pockets)
+{
+	const unsigned int side = (unsigned int)ceil(sqrt((double)count));
+	const float spacing = 1.0f, half = side * spacing / 2 + 0.5f;
+	scene::CSceneBuilder builder;
+	builder.setTable(half, half);
+	scene::CRandom rng(9);
+	for (unsigned int i = 0; i < count; i++) {
+		float x = -half + 0.5f + spacing * (i % side + 0.5f) + (rng.unit() - 0.5f) * 0.4f;
+		float z = -half + 0.5f + spacing * (i / side + 0.5f) + (rng.unit() - 0.5f) * 0.4f;
+		builder.addBall(x, z, ENTITY_RED, 0, (rng.unit() * 2 - 1) * 3, (rng.unit() * 2 - 1) * 3);
+	}
+	if (pockets)
+		builder.addPockets(2 * scene::SCENE_BALL_RADIUS, scene::SCENE_BALL_RADIUS / 2);
+	std::vector<unsigned char> image;
+	builder.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size()))
+		return;
+	CCushionField field;
+	const bool outline = field.build(sc);
+
+	TBallSet<FloatPolicy> b, closed;
+	TTablePhysics<FloatPolicy> table;
+	table.setTable(sc.header().tableHalfX, sc.header().tableHalfZ);
+	table.setCushions(outline ? &field : NULL);
+	b.resize(sc.header().ballCount);
+	for (size_t i = 0; i < b.size(); i++) {
+		b.x[i] = sc.balls()[i].x;
+		b.z[i] = sc.balls()[i].z;
+		b.vx[i] = sc.balls()[i].vx;
+		b.vz[i] = sc.balls()[i].vz;
+		b.type[i] = sc.balls()[i].type;
+		b.active[i] = 1;
+	}
+
+	Clock::time_point t0 = Clock::now();
+	CFastForward ff;
+	ff.prepare(b, table, TICK);
+	const double prepareMs = msSince(t0);
+
+	CCollisionEventBuffer events;
+	unsigned int ticks = 0;
+	float left = -1;
+	while (ticks < MAX_TICKS && left < 0) {
+		events.clear();
+		table.step(b, TICK, events);
+		ticks++;
+		ff.fastForward(ticks * TICK, closed);
+		if (largestDifference(b, closed, false) > 1e-4f || largestDifference(b, closed, true) > 1e-4f)
+			left = ticks * TICK;
+	}
+	printf("%u balls, %s: first contact %.3f (balls %d, %d) in %.2f ms; stepping leaves the closed form at %.3f: %s\n",
+		(unsigned int)b.size(), outline ? "pockets" : "rectangle", ff.getContactFreeTime(), ff.getContactA(),
+		ff.getContactB(), prepareMs, left, left >= ff.getContactFreeTime() ? "ok" : "TOO EARLY");
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 64;
+	unsigned int packed = argc > 2 ? (unsigned int)atoi(argv[2]) : 2000;
+
+	lanes(count);
+	scattered(packed, false);
+	scattered(packed, true);
+	return 0;
+}
@@ -0,0 +1,244 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: hierGrid.h
+//
+// Desc: Hierarchical grid broadphase for balls of different sizes, templated
+//       on a numeric policy (numericPolicy.h).
+//
+//       A single grid needs cells as wide as the largest ball, and then a
+//       cell full of pellets hands every pellet all the others as
+//       candidates. Here level l has cells 2^l times the smallest ball's
+//       diameter, and each ball goes into the first level whose cells are
+//       at least as wide as it is. Two balls touching are then in
+//       neighbouring cells of the coarser of their two levels, so a ball
+//       looks through the 3x3 cells around it on its own level and on every
+//       occupied level above it. The pair is found once, from the smaller
+//       ball. Levels are few (one per doubling of size) and a scene usually
+//       fills only some of them.
+//
+//       Each level keeps its cells in a table sized to the balls on it, so
+//       memory does not depend on the table size. Cells go into the table
+//       row by row, wrapping around, which keeps the three cells of a row
+//       next to each other. Entries keep their cell, so cells that wrap
+//       onto the same slot are told apart. Balls are visited level by level
+//       in table order, so one query mostly reads what the last one did.
+//
+//       build() runs every tick from the current positions. Pairs come out
+//       in an order that only depends on positions and indices, which keeps
+//       FixedPolicy results bit-identical on every host.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __hierGridH__
+#define __hierGridH__
+
+#include "numericPolicy.h"
+#include <vector>
+
+const int HIER_GRID_MAX_LEVELS = 16;
+const int HIER_GRID_MAX_CELLS = 8192;		// level 0 cells from the origin to the farthest ball
+
+template<class P>
+class THierGrid
+{
+public:
+	typedef typename P::Scalar Scalar;
+
+	THierGrid(void)
+	{
+		m_x = m_z = NULL;
+		m_levelCount = 0;
+	}
+
+	// inactive balls are left out. the position arrays are read again by
+	// forEachPair() and must not move in between
+	void build(const Scalar* x, const Scalar* z, const Scalar* radius, const unsigned char* active, int count)
+	{
+		m_x = x;
+		m_z = z;
+		m_levelCount = 0;
+
+		int live = 0;
+		Scalar minR = 0, maxR = 0, reach = 0;
+		for (int i = 0; i < count; i++) {
+			if (!active[i])
+				continue;
+			if (live == 0 || radius[i] < minR) minR = radius[i];
+			if (live == 0 || radius[i] > maxR) maxR = radius[i];
+			if (P::abs(x[i]) > reach) reach = P::abs(x[i]);
+			if (P::abs(z[i]) > reach) reach = P::abs(z[i]);
+			live++;
+		}
+		m_entries.resize(live);
+		if (live == 0)
+			return;
+
+		// level 0 fits the smallest ball. past HIER_GRID_MAX_LEVELS
+		// doublings, or with cell numbers too large for Q16.16, the smallest
+		// balls get cells coarser than they need, which costs candidates
+		// but misses nothing
+		Scalar base = 2 * minR;
+		Scalar top = 2 * maxR;
+		for (int l = 1; l < HIER_GRID_MAX_LEVELS; l++)
+			top = top - top / 2;			// halves, rounding up
+		if (base < top)
+			base = top;
+		if (base < reach / HIER_GRID_MAX_CELLS)
+			base = reach / HIER_GRID_MAX_CELLS;
+		if (base <= 0)
+			base = P::one();
+
+		// cell widths, up to the level of the largest ball. the lookup
+		// cells are a little wider than the level says, so that rounding in
+		// the cell computation never puts two touching balls two cells apart
+		Scalar cell = base;
+		int levels = 0;
+		for (;;) {
+			Level& v = m_levels[levels];
+			v.cell = cell;
+			v.invCell = P::div(P::one(), cell + cell / 64);
+			v.count = 0;
+			v.stride = 2 * cellOf(reach, levels) + 3;		// one row of cells with room to spare
+			levels++;
+			if (levels == HIER_GRID_MAX_LEVELS || cell >= 2 * maxR)
+				break;
+			cell = cell + cell;
+		}
+
+		m_ballLevel.resize(count);
+		for (int i = 0; i < count; i++) {
+			if (!active[i])
+				continue;
+			int l = 0;
+			while (l + 1 < levels && m_levels[l].cell < 2 * radius[i])
+				l++;
+			m_ballLevel[i] = l;
+			m_levels[l].count++;
+			if (l + 1 > m_levelCount)
+				m_levelCount = l + 1;
+		}
+
+		// one table per level, twice as many slots as balls on it
+		int slots = 0;
+		for (int l = 0; l < m_levelCount; l++) {
+			Level& v = m_levels[l];
+			unsigned int size = 0;
+			if (v.count > 0) {
+				size = 16;
+				while (size < 2u * (unsigned int)v.count)
+					size <<= 1;
+			}
+			v.mask = size - 1;
+			v.first = slots;
+			slots += size;
+		}
+
+		// counting sort into slots, in index order within a slot
+		m_start.assign(slots + 1, 0);
+		m_slot.resize(count);
+		for (int i = 0; i < count; i++) {
+			if (!active[i])
+				continue;
+			const int l = m_ballLevel[i];
+			m_slot[i] = slotOf(l, cellOf(x[i], l), cellOf(z[i], l));
+			m_start[m_slot[i] + 1]++;
+		}
+		for (int k = 0; k < slots; k++)
+			m_start[k + 1] += m_start[k];
+		m_fill.assign(m_start.begin(), m_start.end() - 1);
+		for (int i = 0; i < count; i++) {
+			if (!active[i])
+				continue;
+			const int l = m_ballLevel[i];
+			Entry& e = m_entries[m_fill[m_slot[i]]++];
+			e.cellX = cellOf(x[i], l);
+			e.cellZ = cellOf(z[i], l);
+			e.index = i;
+		}
+	}
+
+	// visit(i, j) for every pair whose cells are neighbours on the coarser
+	// of the two levels, each pair once. the callback does the exact test.
+	// returns the number of pairs visited
+	template<class F>
+	size_t forEachPair(F visit) const
+	{
+		size_t pairs = 0;
+		for (int li = 0; li < m_levelCount; li++) {
+			const Level& own = m_levels[li];
+			const int end = own.count > 0 ? m_start[own.first + own.mask + 1] : 0;
+			const int begin = own.count > 0 ? m_start[own.first] : 0;
+			for (int k = begin; k < end; k++) {
+				const Entry& e = m_entries[k];
+				const int i = e.index;
+				for (int l = li; l < m_levelCount; l++) {
+					if (m_levels[l].count == 0)
+						continue;
+					const int qx = l == li ? e.cellX : cellOf(m_x[i], l);
+					const int qz = l == li ? e.cellZ : cellOf(m_z[i], l);
+					for (int cz = qz - 1; cz <= qz + 1; cz++) {
+						// the three cells of the row, in one run of slots
+						// unless the row wraps around the end of the table
+						const Level& v = m_levels[l];
+						const unsigned int slot = ((unsigned int)(qx - 1) + (unsigned int)cz * (unsigned int)v.stride) & v.mask;
+						const int runs = slot + 2 <= v.mask ? 1 : 3;
+						for (int r = 0; r < runs; r++) {
+							const int s = runs == 1 ? v.first + (int)slot : slotOf(l, qx - 1 + r, cz);
+							const int last = m_start[s + (runs == 1 ? 3 : 1)];
+							for (int n = m_start[s]; n < last; n++) {
+								const Entry& o = m_entries[n];
+								if (o.cellZ != cz || o.cellX < qx - 1 || o.cellX > qx + 1)
+									continue;
+								// same level: from the lower index only
+								if (l == li && o.index <= i)
+									continue;
+								visit(i, o.index);
+								pairs++;
+							}
+						}
+					}
+				}
+			}
+		}
+		return pairs;
+	}
+
+	int getLevelCount(void) const { return m_levelCount; }
+	Scalar getCellSize(int level) const { return m_levels[level].cell; }
+	int getBallCount(int level) const { return m_levels[level].count; }
+
+private:
+	struct Level {
+		Scalar			cell;
+		Scalar			invCell;
+		int				count;			// balls on this level
+		int				stride;			// slots from one row of cells to the next
+		unsigned int	mask;			// table size - 1
+		int				first;			// first slot of the table
+	};
+
+	struct Entry {
+		int				cellX, cellZ;
+		int				index;
+	};
+
+	int cellOf(Scalar v, int level) const { return P::floorToInt(P::mul(v, m_levels[level].invCell)); }
+
+	int slotOf(int level, int cx, int cz) const
+	{
+		const Level& v = m_levels[level];
+		return v.first + (int)(((unsigned int)cx + (unsigned int)cz * (unsigned int)v.stride) & v.mask);
+	}
+
+	const Scalar*		m_x;
+	const Scalar*		m_z;
+	int					m_levelCount;		// highest occupied level + 1
+	Level				m_levels[HIER_GRID_MAX_LEVELS];
+	std::vector<int>	m_ballLevel;
+	std::vector<int>	m_slot;				// per ball, while building
+	std::vector<int>	m_start;			// slot k holds m_entries[m_start[k] .. m_start[k + 1])
+	std::vector<Entry>	m_entries;
+	std::vector<int>	m_fill;
+};
+
+#endif // __hierGridH__
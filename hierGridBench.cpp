@@ -0,0 +1,213 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: hierGridBench.cpp
+//
+// Desc: Pair search over balls of mixed sizes: THierGrid against the
+//       single-size sweep.
+//
+//       hierGridBench [balls] [ticks]
+//
+//       For 1/10/100 percent of the given count, a generateMixedSizes()
+//       scene (pellets, standard and heavy balls, large obstacles) runs a
+//       few ticks so that balls touch, then is searched both ways from the
+//       same positions. The sweep along x has to use the largest contact
+//       distance for every ball, which is what a one-size broadphase comes
+//       down to. Prints the candidate pairs and
+//       time per ball of each, and checks that both find the same contacts.
+//
+//       Then the fixed-point table runs the full count for the given ticks
+//       and prints the time per tick, and a pellet and a heavy ball meet
+//       head on to show momentum is kept across a contact.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "tablePhysics.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+static const int SEARCH_ROUNDS = 5;
+static const unsigned int SETTLE_TICKS = 20;
+
+typedef std::chrono::steady_clock Clock;
+typedef FixedPolicy::Scalar Fx;
+
+static double msSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static bool loadBalls(unsigned int count, scene::CSceneBuilder& builder, std::vector<unsigned char>& image,
+	TBallSet<FixedPolicy>& b, float& halfX, float& halfZ)
+{
+	scene::generateMixedSizes(builder, count, 1);
+	builder.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size()))
+		return false;
+	const scene::SceneHeader& h = sc.header();
+	b.resize(h.ballCount + h.obstacleCount);
+	for (unsigned int i = 0; i < h.ballCount; i++) {
+		b.x[i] = FixedPolicy::fromFloat(sc.balls()[i].x);
+		b.z[i] = FixedPolicy::fromFloat(sc.balls()[i].z);
+		b.vx[i] = FixedPolicy::fromFloat(sc.balls()[i].vx * 4);
+		b.vz[i] = FixedPolicy::fromFloat(sc.balls()[i].vz * 4);
+		b.radius[i] = FixedPolicy::fromFloat(sc.ballRadius(i));
+		b.mass[i] = FixedPolicy::fromFloat(sc.ballMass(i));
+		b.type[i] = sc.balls()[i].type;
+		b.active[i] = 1;
+	}
+	for (unsigned int k = 0; k < h.obstacleCount; k++) {
+		unsigned int i = h.ballCount + k;
+		b.x[i] = FixedPolicy::fromFloat(sc.obstacles()[k].x);
+		b.z[i] = FixedPolicy::fromFloat(sc.obstacles()[k].z);
+		b.vx[i] = b.vz[i] = 0;
+		b.radius[i] = FixedPolicy::fromFloat(sc.obstacles()[k].radius);
+		b.type[i] = ENTITY_OBSTACLE;
+		b.active[i] = 1;
+	}
+	halfX = h.tableHalfX;
+	halfZ = h.tableHalfZ;
+	return true;
+}
+
+static bool touching(const TBallSet<FixedPolicy>& b, int i, int j)
+{
+	long long dx = b.x[i] - b.x[j], dz = b.z[i] - b.z[j];
+	long long c = b.radius[i] + b.radius[j];
+	return dx * dx + dz * dz <= c * c;
+}
+
+// the single-size sweep, with the largest contact distance for everyone
+static size_t sweepPairs(const TBallSet<FixedPolicy>& b, std::vector<int>& order, size_t& contacts)
+{
+	const int n = (int)b.size();
+	Fx contact = 2 * *std::max_element(b.radius.begin(), b.radius.end());
+	order.resize(n);
+	for (int i = 0; i < n; i++)
+		order[i] = i;
+	const std::vector<Fx>& x = b.x;
+	std::sort(order.begin(), order.end(), [&](int l, int r) { return x[l] < x[r] || (x[l] == x[r] && l < r); });
+
+	size_t pairs = 0;
+	contacts = 0;
+	for (int p = 0; p < n; p++) {
+		int i = order[p];
+		for (int q = p + 1; q < n && x[order[q]] - x[i] <= contact; q++) {
+			int j = order[q];
+			if (FixedPolicy::abs(b.z[i] - b.z[j]) > contact)
+				continue;
+			pairs++;
+			if (touching(b, i, j))
+				contacts++;
+		}
+	}
+	return pairs;
+}
+
+static size_t gridPairs(const TBallSet<FixedPolicy>& b, THierGrid<FixedPolicy>& grid, size_t& contacts)
+{
+	grid.build(&b.x[0], &b.z[0], &b.radius[0], &b.active[0], (int)b.size());
+	size_t found = 0;
+	size_t pairs = grid.forEachPair([&](int i, int j) {
+		if (touching(b, i, j))
+			found++;
+	});
+	contacts = found;
+	return pairs;
+}
+
+static double runTicks(TBallSet<FixedPolicy>& b, float halfX, float halfZ, unsigned int ticks, size_t& contacts)
+{
+	TTablePhysics<FixedPolicy> table;
+	table.setTable(halfX, halfZ);
+	CCollisionEventBuffer events;
+	contacts = 0;
+	Clock::time_point t0 = Clock::now();
+	for (unsigned int t = 0; t < ticks; t++) {
+		events.clear();
+		table.step(b, FixedPolicy::fromFloat(0.005f), events);
+		contacts += events.size();
+	}
+	return msSince(t0) / ticks;
+}
+
+static double momentum(const TBallSet<FixedPolicy>& b)
+{
+	double p = 0;
+	for (size_t i = 0; i < b.size(); i++)
+		p += FixedPolicy::toFloat(b.mass[i]) * FixedPolicy::toFloat(b.vx[i]);
+	return p;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+	unsigned int ticks = argc > 2 ? (unsigned int)atoi(argv[2]) : 200;
+
+	for (unsigned int scale = 100; scale >= 1; scale /= 10) {
+		scene::CSceneBuilder builder;
+		std::vector<unsigned char> image;
+		TBallSet<FixedPolicy> b;
+		float halfX, halfZ;
+		if (!loadBalls(count / scale, builder, image, b, halfX, halfZ)) {
+			fprintf(stderr, "bad scene image\n");
+			return 1;
+		}
+		size_t settled;
+		runTicks(b, halfX, halfZ, SETTLE_TICKS, settled);
+
+		std::vector<int> order;
+		THierGrid<FixedPolicy> grid;
+		size_t sweepCandidates = 0, gridCandidates = 0, sweepContacts = 0, gridContacts = 0;
+		double sweepMs = 0, gridMs = 0;
+		for (int k = 0; k < SEARCH_ROUNDS; k++) {
+			Clock::time_point t0 = Clock::now();
+			sweepCandidates = sweepPairs(b, order, sweepContacts);
+			sweepMs += msSince(t0);
+			t0 = Clock::now();
+			gridCandidates = gridPairs(b, grid, gridContacts);
+			gridMs += msSince(t0);
+		}
+		const double perBall = 1e6 / ((double)SEARCH_ROUNDS * b.size());
+		printf("%u balls, table %.1f x %.1f, %d grid levels\n", (unsigned int)b.size(), 2 * halfX, 2 * halfZ, grid.getLevelCount());
+		printf("  sweep: %zu candidates, %.1f ns/ball; grid: %zu candidates, %.1f ns/ball; contacts %zu / %zu%s\n",
+			sweepCandidates, sweepMs * perBall, gridCandidates, gridMs * perBall, sweepContacts, gridContacts,
+			sweepContacts == gridContacts ? "" : "  MISMATCH");
+	}
+
+	scene::CSceneBuilder builder;
+	std::vector<unsigned char> image;
+	TBallSet<FixedPolicy> b;
+	float halfX, halfZ;
+	loadBalls(count, builder, image, b, halfX, halfZ);
+	size_t contacts;
+	double stepMs = runTicks(b, halfX, halfZ, ticks, contacts);
+	printf("%u balls, %u ticks: %.3f ms/tick, %zu contacts\n", (unsigned int)b.size(), ticks, stepMs, contacts);
+
+	// a pellet at speed into a heavy ball at rest
+	TBallSet<FixedPolicy> two;
+	two.resize(2);
+	const float r = scene::SCENE_BALL_RADIUS;
+	two.x[0] = FixedPolicy::fromFloat(-1);
+	two.x[1] = FixedPolicy::fromFloat(r / 4 + 2 * r - 1 - 0.01f);
+	two.z[0] = two.z[1] = 0;
+	two.vx[0] = FixedPolicy::fromFloat(1);
+	two.vx[1] = two.vz[0] = two.vz[1] = 0;
+	two.radius[0] = FixedPolicy::fromFloat(r / 4);
+	two.radius[1] = FixedPolicy::fromFloat(2 * r);
+	two.mass[0] = FixedPolicy::fromFloat(1.0f / 64);
+	two.mass[1] = FixedPolicy::fromFloat(8);
+	two.type[0] = two.type[1] = ENTITY_RED;
+	two.active[0] = two.active[1] = 1;
+	TTablePhysics<FixedPolicy> table;
+	table.setTable(10, 10);
+	CCollisionEventBuffer events;
+	double p0 = momentum(two);
+	table.step(two, 0, events);
+	printf("pellet into heavy ball: %zu contact, velocities %.4f, %.4f, momentum %.5f -> %.5f\n", events.size(),
+		FixedPolicy::toFloat(two.vx[0]), FixedPolicy::toFloat(two.vx[1]), p0, momentum(two));
+	return 0;
+}
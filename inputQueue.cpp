@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: inputQueue.cpp
+//
+// Desc: Timestamped input queue with mouse move coalescing and latency
+//       percentiles.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "inputQueue.h"
+#include <algorithm>
+
+namespace
+{
+	// a message older than this is a stale stamp, not a wait
+	const DWORD MAX_QUEUED_MS = 10000;
+
+	float percentile(const std::vector<float>& sorted, float p)
+	{
+		size_t k = (size_t)(p * (sorted.size() - 1) + 0.5f);
+		return sorted[std::min(k, sorted.size() - 1)];
+	}
+}
+
+CInputQueue::CInputQueue(void)
+{
+	m_nextSample = 0;
+	m_allWorstMs = 0;
+	m_received = 0;
+	m_queued = 0;
+	m_applied = 0;
+	m_moveButtons = ~(WPARAM)0;
+	m_lastStarts = false;
+	m_samples.reserve(LATENCY_SAMPLES);
+}
+
+long long CInputQueue::now(void)
+{
+	static LARGE_INTEGER frequency = { 0 };
+	if (frequency.QuadPart == 0)
+		::QueryPerformanceFrequency(&frequency);
+	LARGE_INTEGER t;
+	::QueryPerformanceCounter(&t);
+	return (long long)((double)t.QuadPart * 1000000.0 / (double)frequency.QuadPart);
+}
+
+long long CInputQueue::messageStamp(void)
+{
+	// both on the tick count, so the wait is good to its resolution
+	DWORD queuedMs = ::GetTickCount() - (DWORD)::GetMessageTime();
+	if (queuedMs > MAX_QUEUED_MS)
+		queuedMs = 0;
+	return now() - (long long)queuedMs * 1000;
+}
+
+void CInputQueue::push(UINT msg, WPARAM wParam, LPARAM lParam, long long stamp)
+{
+	m_received++;
+	if (msg == WM_MOUSEMOVE) {
+		bool starts = wParam != m_moveButtons;
+		m_moveButtons = wParam;
+		if (!starts && !m_lastStarts && !m_pending.empty()) {
+			InputEvent& last = m_pending.back();
+			if (last.msg == WM_MOUSEMOVE && last.wParam == wParam) {
+				last.lParam = lParam;
+				last.moves++;
+				return;
+			}
+		}
+		m_lastStarts = starts;
+	}
+	InputEvent e;
+	e.msg = msg;
+	e.wParam = wParam;
+	e.lParam = lParam;
+	e.stamp = stamp;
+	e.moves = 1;
+	m_pending.push_back(e);
+	m_queued++;
+}
+
+void CInputQueue::take(std::vector<InputEvent>& events)
+{
+	events.clear();
+	events.swap(m_pending);
+	for (size_t i = 0; i < events.size(); i++)
+		m_shown.push_back(events[i].stamp);
+	m_applied += events.size();
+}
+
+void CInputQueue::presented(long long presentTime)
+{
+	for (size_t i = 0; i < m_shown.size(); i++) {
+		float ms = (float)(presentTime - m_shown[i]) / 1000.0f;
+		if (ms < 0)
+			ms = 0;
+		if (m_samples.size() < LATENCY_SAMPLES)
+			m_samples.push_back(ms);
+		else
+			m_samples[m_nextSample] = ms;
+		m_nextSample = (m_nextSample + 1) % LATENCY_SAMPLES;
+		m_allWorstMs = std::max(m_allWorstMs, ms);
+	}
+	m_shown.clear();
+}
+
+bool CInputQueue::summarize(LatencySummary& s) const
+{
+	s.samples = (unsigned int)m_samples.size();
+	s.allWorstMs = m_allWorstMs;
+	if (m_samples.empty()) {
+		s.p50Ms = s.p90Ms = s.p99Ms = s.worstMs = 0;
+		return false;
+	}
+	std::vector<float> sorted(m_samples);
+	std::sort(sorted.begin(), sorted.end());
+	s.p50Ms = percentile(sorted, 0.50f);
+	s.p90Ms = percentile(sorted, 0.90f);
+	s.p99Ms = percentile(sorted, 0.99f);
+	s.worstMs = sorted.back();
+	return true;
+}
@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: inputQueue.h
+//
+// Desc: Timestamped queue of window input, applied once per frame, and the
+//       latency from each input to the Present that first shows it.
+//
+//       The window procedure only push()es: key presses, button presses and
+//       mouse moves, each stamped with when Windows queued the message
+//       (GetMessageTime(), which has tick-count resolution, carried over to
+//       the microsecond clock at the time it is received). Display() take()s
+//       everything that came since the last frame, applies it in order
+//       before the frame is built, and calls presented() after Present.
+//
+//       A mouse move right behind another with the same buttons down
+//       replaces it: only the last position matters, and the merged move
+//       keeps the older stamp, so its latency is that of the first move it
+//       stands for. Anything else in between (a click, a key) keeps the
+//       moves apart, so the order of what is applied does not change.
+//       The first move after the buttons change is never merged into: a
+//       left drag only records where it starts, and a later position in
+//       its place would drop the turn up to that position.
+//
+//       One latency sample per applied event; percentiles are over the last
+//       LATENCY_SAMPLES. Push and take are for one thread, the one with the
+//       window, which is the one that presents.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __inputQueueH__
+#define __inputQueueH__
+
+#include <windows.h>
+#include <vector>
+
+const unsigned int LATENCY_SAMPLES = 4096;
+
+struct InputEvent
+{
+	UINT		msg;
+	WPARAM		wParam;
+	LPARAM		lParam;
+	long long	stamp;		// microseconds, CInputQueue::now()
+	unsigned int	moves;	// mouse moves merged into this one, 1 for one message
+};
+
+struct LatencySummary
+{
+	unsigned int	samples;	// in the percentiles, at most LATENCY_SAMPLES
+	float			p50Ms, p90Ms, p99Ms, worstMs;
+	float			allWorstMs;	// over every sample so far
+};
+
+class CInputQueue {
+public:
+	CInputQueue(void);
+
+	// microseconds on QueryPerformanceCounter
+	static long long now(void);
+	// now(), less the time the message being handled waited in the thread's
+	// queue. only from the window procedure
+	static long long messageStamp(void);
+
+	void push(UINT msg, WPARAM wParam, LPARAM lParam, long long stamp);
+	// everything pushed since the last take, oldest first, into events
+	// (cleared first). the events wait for presented()
+	void take(std::vector<InputEvent>& events);
+	// the events of the last take are on screen as of presentTime
+	void presented(long long presentTime);
+
+	bool summarize(LatencySummary& s) const;
+
+	unsigned long long getReceived(void) const { return m_received; }	// messages pushed
+	unsigned long long getApplied(void) const { return m_applied; }		// events taken
+	unsigned long long getMerged(void) const { return m_received - m_queued; }
+
+private:
+	std::vector<InputEvent>		m_pending;
+	std::vector<long long>		m_shown;		// stamps of the last take
+	std::vector<float>			m_samples;		// ring, ms
+	size_t						m_nextSample;
+	float						m_allWorstMs;
+	unsigned long long			m_received, m_queued, m_applied;
+	WPARAM						m_moveButtons;	// of the last move pushed, ~0 before the first
+	bool						m_lastStarts;	// the last move pushed has other buttons than the one before
+};
+
+#endif // __inputQueueH__
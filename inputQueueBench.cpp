@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: inputQueueBench.cpp
+//
+// Desc: Input to present latency of the old message loop against the
+//       queue of inputQueue.h, on a simulated clock.
+//
+//       inputQueueBench [seconds] [moves per second] [us per applied move]
+//
+//       A drag delivers every mouse move at the given rate (a source that
+//       does not fold moves itself, such as raw input), with a key press
+//       every half second. At each key the drag lets go for one move and
+//       goes on with the other button: right nudges the target, left turns
+//       the table from the second move on. Frames take 8 ms, every 50th one
+//       40 ms. Applying a move costs the given time, which is what the
+//       target nudge plus its aim preview advance() take.
+//
+//       old: one message per loop iteration, applied in the window
+//       procedure, a frame only when no message is waiting. queued: every
+//       waiting message is pushed, then one frame applies what take() gives.
+//       Both stamp with the arrival time and sample at the next Present.
+//       Prints frames, events applied and the latency percentiles of each,
+//       and how far each left the target and the turn from where applying
+//       every move by itself puts them.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "inputQueue.h"
+#include "sceneFile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+static const long long FRAME_US = 8000;
+static const long long SLOW_FRAME_US = 40000;
+static const unsigned int SLOW_EVERY = 50;
+static const long long KEY_EVERY_US = 500000;
+
+struct Arrival {
+	long long	time;
+	UINT		msg;
+	WPARAM		wParam;
+	LPARAM		lParam;
+};
+
+// a wandering cursor: one move with no button, then right and left drags
+// taking turns at each key press, each after one move with no button
+static void makeArrivals(long long endUs, unsigned int rate, std::vector<Arrival>& arrivals)
+{
+	scene::CRandom rng(5);
+	int x = 400, y = 300;
+	const long long moveUs = 1000000 / rate;
+	long long nextKey = KEY_EVERY_US;
+	WPARAM button = MK_RBUTTON;
+	Arrival hover = { 0, WM_MOUSEMOVE, 0, (LPARAM)(y << 16 | x) };
+	arrivals.push_back(hover);
+	for (long long t = moveUs; t < endUs; t += moveUs) {
+		WPARAM buttons = button;
+		if (t >= nextKey) {
+			Arrival k = { nextKey, WM_KEYDOWN, VK_RETURN, 0 };
+			arrivals.push_back(k);
+			nextKey += KEY_EVERY_US;
+			button = button == MK_RBUTTON ? MK_LBUTTON : MK_RBUTTON;
+			buttons = 0;
+		}
+		x = std::max(0, std::min(799, x + (int)(rng.next() % 7) - 3));
+		y = std::max(0, std::min(599, y + (int)(rng.next() % 7) - 3));
+		Arrival a = { t, WM_MOUSEMOVE, buttons, (LPARAM)(y << 16 | x) };
+		arrivals.push_back(a);
+	}
+}
+
+// the right-drag nudge and the left-drag turn of applyInput(). the turn
+// is kept as the sum of its angles
+struct Target {
+	int		oldX, oldY;
+	bool	isReset;
+	float	x, z;
+	float	turnX, turnY;
+
+	Target(void) : oldX(0), oldY(0), isReset(true), x(0), z(0), turnX(0), turnY(0) {}
+	void apply(const InputEvent& e)
+	{
+		if (e.msg != WM_MOUSEMOVE)
+			return;
+		int newX = LOWORD(e.lParam), newY = HIWORD(e.lParam);
+		if (LOWORD(e.wParam) & MK_LBUTTON) {
+			if (isReset)
+				isReset = false;
+			else {
+				turnY += (oldX - newX) * 0.01f;
+				turnX += (oldY - newY) * 0.01f;
+			}
+		}
+		else {
+			isReset = true;
+			if (LOWORD(e.wParam) & MK_RBUTTON) {
+				x += (oldX - newX) * (-0.007f);
+				z += (oldY - newY) * 0.007f;
+			}
+		}
+		oldX = newX;
+		oldY = newY;
+	}
+	float offBy(const Target& t) const
+	{
+		return std::max(std::max(fabsf(x - t.x), fabsf(z - t.z)), std::max(fabsf(turnX - t.turnX), fabsf(turnY - t.turnY)));
+	}
+};
+
+static long long frameUs(unsigned int frame)
+{
+	return frame % SLOW_EVERY == SLOW_EVERY - 1 ? SLOW_FRAME_US : FRAME_US;
+}
+
+static void print(const char* name, unsigned int frames, unsigned long long applied, const CInputQueue& q)
+{
+	LatencySummary l;
+	if (!q.summarize(l)) {
+		printf("%-7s %6u frames, %7llu events applied, none of them presented\n", name, frames, applied);
+		return;
+	}
+	printf("%-7s %6u frames, %7llu events applied: p50 %6.2f ms, p90 %6.2f ms, p99 %6.2f ms, worst %7.2f ms\n",
+		name, frames, applied, l.p50Ms, l.p90Ms, l.p99Ms, l.allWorstMs);
+}
+
+int main(int argc, char* argv[])
+{
+	const double seconds = argc > 1 ? atof(argv[1]) : 20;
+	const unsigned int rate = argc > 2 ? (unsigned int)atoi(argv[2]) : 1000;
+	const long long moveCost = argc > 3 ? atoi(argv[3]) : 300;
+	const long long endUs = (long long)(seconds * 1000000);
+
+	std::vector<Arrival> arrivals;
+	makeArrivals(endUs, rate, arrivals);
+	std::vector<InputEvent> events;
+
+	// old loop: a message if one is waiting, else a frame
+	CInputQueue oldQueue;
+	Target oldTarget;
+	unsigned int oldFrames = 0;
+	size_t next = 0;
+	long long t = 0;
+	while (t < endUs) {
+		if (next < arrivals.size() && arrivals[next].time <= t) {
+			const Arrival& a = arrivals[next++];
+			oldQueue.push(a.msg, a.wParam, a.lParam, a.time);
+			oldQueue.take(events);
+			oldTarget.apply(events[0]);
+			t += a.msg == WM_MOUSEMOVE ? moveCost : 0;
+		}
+		else {
+			t += frameUs(oldFrames++);
+			oldQueue.presented(t);
+		}
+	}
+
+	// queued: everything waiting, then a frame that applies it
+	CInputQueue queue;
+	Target target;
+	unsigned int frames = 0;
+	next = 0;
+	t = 0;
+	while (t < endUs) {
+		while (next < arrivals.size() && arrivals[next].time <= t) {
+			const Arrival& a = arrivals[next++];
+			queue.push(a.msg, a.wParam, a.lParam, a.time);
+		}
+		queue.take(events);
+		for (size_t k = 0; k < events.size(); k++) {
+			target.apply(events[k]);
+			t += events[k].msg == WM_MOUSEMOVE ? moveCost : 0;
+		}
+		t += frameUs(frames++);
+		queue.presented(t);
+	}
+
+	// what came after the last frame of either, without latency
+	for (size_t k = 0; k < arrivals.size(); k++) {
+		InputEvent e = { arrivals[k].msg, arrivals[k].wParam, arrivals[k].lParam, arrivals[k].time, 1 };
+		if (k >= oldQueue.getReceived())
+			oldTarget.apply(e);
+		if (k >= queue.getReceived())
+			target.apply(e);
+	}
+
+	// where every move applied by itself puts the target and the turn
+	Target exact;
+	size_t moves = 0;
+	for (size_t k = 0; k < arrivals.size(); k++) {
+		InputEvent e = { arrivals[k].msg, arrivals[k].wParam, arrivals[k].lParam, arrivals[k].time, 1 };
+		exact.apply(e);
+		if (arrivals[k].msg == WM_MOUSEMOVE)
+			moves++;
+	}
+
+	printf("%.1f s, %u moves/s (%u moves, %u keys), %lld us per applied move\n", seconds, rate,
+		(unsigned int)moves, (unsigned int)(arrivals.size() - moves), moveCost);
+	print("old", oldFrames, oldQueue.getApplied(), oldQueue);
+	print("queued", frames, queue.getApplied(), queue);
+	printf("queued: %llu messages, %llu moves merged\n", queue.getReceived(), queue.getMerged());
+	printf("target and turn after all input, off by: old %.5f, queued %.5f (float sums of the steps)\n",
+		oldTarget.offBy(exact), target.offBy(exact));
+	return 0;
+}
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: jobGraph.cpp
+//
+// Desc: Jobs with dependencies, run on a CWorkerPool.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "jobGraph.h"
+#include <cassert>
+
+CJobGraph::CJobGraph(void)
+{
+	m_waitingSize = 0;
+	m_pending = 0;
+	m_pool = NULL;
+}
+
+CJobGraph::~CJobGraph(void)
+{
+	if (isRunning())
+		wait();
+}
+
+void CJobGraph::clear(void)
+{
+	assert(!isRunning());
+	m_jobs.clear();
+}
+
+int CJobGraph::add(const char* name, const CWorkerPool::Task& fn)
+{
+	assert(!isRunning());
+	Job job;
+	job.fn = fn;
+	job.before = 0;
+	job.timing.name = name;
+	job.timing.worker = -1;
+	job.timing.startMs = job.timing.endMs = 0;
+	m_jobs.push_back(job);
+	return (int)m_jobs.size() - 1;
+}
+
+void CJobGraph::precede(int before, int after)
+{
+	assert(!isRunning());
+	m_jobs[before].next.push_back(after);
+	m_jobs[after].before++;
+}
+
+void CJobGraph::start(CWorkerPool& pool)
+{
+	assert(!isRunning());
+	if (m_waitingSize < m_jobs.size()) {
+		m_waitingSize = m_jobs.size();
+		m_waiting.reset(new std::atomic<int>[m_waitingSize]);
+	}
+	for (size_t i = 0; i < m_jobs.size(); i++)
+		m_waiting[i] = m_jobs[i].before;
+	m_pending = (int)m_jobs.size();
+	m_pool = &pool;
+	m_start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < m_jobs.size(); i++) {
+		if (m_jobs[i].before == 0) {
+			int job = (int)i;
+			pool.submit([this, job] { runJob(job); });
+		}
+	}
+}
+
+void CJobGraph::wait(void)
+{
+	if (!isRunning())
+		return;
+	m_pool->wait(m_pending);
+	m_pool = NULL;
+}
+
+float CJobGraph::getSpanMs(void) const
+{
+	float span = 0;
+	for (size_t i = 0; i < m_jobs.size(); i++) {
+		if (m_jobs[i].timing.endMs > span)
+			span = m_jobs[i].timing.endMs;
+	}
+	return span;
+}
+
+float CJobGraph::msSinceStart(void) const
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+void CJobGraph::runJob(int job)
+{
+	Job& j = m_jobs[job];
+	CWorkerPool& pool = *m_pool;
+	j.timing.worker = pool.getWorkerIndex();
+	j.timing.startMs = msSinceStart();
+	j.fn();
+	j.timing.endMs = msSinceStart();
+
+	for (size_t k = 0; k < j.next.size(); k++) {
+		int next = j.next[k];
+		if (m_waiting[next].fetch_sub(1) == 1)
+			pool.submit([this, next] { runJob(next); });
+	}
+	// the last thing this job touches: wait() may return right after
+	m_pending.fetch_sub(1);
+}
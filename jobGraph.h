@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: jobGraph.h
+//
+// Desc: Jobs with dependencies, run on a CWorkerPool.
+//
+//       add() jobs and precede() them, then start() queues the jobs nothing
+//       comes before. A finished job queues every job that was only waiting
+//       for it, on the deque of the thread that ran it, so a chain of jobs
+//       tends to stay on one thread while other threads steal the rest.
+//       Jobs may use the pool themselves (parallelFor() inside a job).
+//
+//       start() returns at once; the calling thread can do something the
+//       jobs must not touch (the device, say) and wait() after. Every job
+//       records when it ran and on which thread, for the frame timings.
+//
+//       A graph is set up again each time it runs: clear(), add(), start().
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __jobGraphH__
+#define __jobGraphH__
+
+#include "workerPool.h"
+#include <vector>
+#include <chrono>
+
+struct JobTiming
+{
+	const char*		name;
+	int				worker;		// CWorkerPool::getWorkerIndex() of the thread that ran it
+	float			startMs;	// from start()
+	float			endMs;
+};
+
+class CJobGraph {
+public:
+	CJobGraph(void);
+	~CJobGraph(void);
+
+	// only while not running
+	void clear(void);
+	// name must outlive the graph. returns the job's id
+	int add(const char* name, const CWorkerPool::Task& fn);
+	// after does not start before before has finished
+	void precede(int before, int after);
+
+	void start(CWorkerPool& pool);
+	// runs jobs, and anything else queued on the pool, until all are done
+	void wait(void);
+	void run(CWorkerPool& pool) { start(pool); wait(); }
+	bool isRunning(void) const { return m_pool != NULL; }
+
+	// of the last run, after wait()
+	int getJobCount(void) const { return (int)m_jobs.size(); }
+	const JobTiming& getTiming(int job) const { return m_jobs[job].timing; }
+	// start() to the end of the last job
+	float getSpanMs(void) const;
+
+private:
+	CJobGraph(const CJobGraph&);
+	CJobGraph& operator=(const CJobGraph&);
+
+	struct Job {
+		CWorkerPool::Task	fn;
+		std::vector<int>	next;
+		int					before;		// jobs that come first
+		JobTiming			timing;
+	};
+
+	void runJob(int job);
+	float msSinceStart(void) const;
+
+	std::vector<Job>						m_jobs;
+	std::unique_ptr<std::atomic<int>[]>		m_waiting;		// per job, those of before not finished yet
+	size_t									m_waitingSize;
+	std::atomic<int>						m_pending;		// jobs not finished yet
+	CWorkerPool*							m_pool;
+	std::chrono::steady_clock::time_point	m_start;
+};
+
+#endif // __jobGraphH__
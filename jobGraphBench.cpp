@@ -0,0 +1,244 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: jobGraphBench.cpp
+//
+// Desc: The frame as one thread in sequence against the frame as job graphs.
+//
+//       jobGraphBench [balls] [frames] [submit ms] [threads]
+//
+//       A random packing with every ball pushed runs the given number of
+//       frames twice from the same state. A frame is the slab stepper's
+//       step, culling and world matrices for every ball, and a stand-in for
+//       drawing and Present that keeps the calling thread busy for the
+//       given time (the device belongs to that thread alone):
+//
+//         sequential - step, then matrices, then submit, as Display() was
+//         job graph  - matrices in chunks on the pool, then the step as a
+//                      job while the calling thread submits
+//
+//       Prints the time per frame of both, checks that both end with the
+//       same ball positions, and sums up the jobs of the last frame by name
+//       with the threads that ran them.
+//
+//       Then parallelFor() from several threads at once and from inside
+//       jobs, checked against a plain sum.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "slabStepper.h"
+#include "jobGraph.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+
+static const int BALLS_PER_JOB = 2048;
+static const float FRAME_SECONDS = 0.01f;
+
+typedef std::chrono::steady_clock Clock;
+
+float g_tableHalfX = 0, g_tableHalfZ = 0;
+const CCushionField* g_cushions = NULL;
+
+static double msSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static void loadBalls(const scene::CSceneFile& sc, std::vector<CSphere>& balls)
+{
+	scene::CRandom rng(7);
+	balls.assign(sc.header().ballCount, CSphere());
+	for (size_t i = 0; i < balls.size(); i++) {
+		balls[i].setCenter(sc.balls()[i].x, (float)M_RADIUS, sc.balls()[i].z);
+		balls[i].setPower((rng.unit() * 2 - 1) * 4, (rng.unit() * 2 - 1) * 4);
+	}
+}
+
+// what buildBallDraws() does in the game, without the culling planes
+static void buildMatrices(const std::vector<CSphere>& balls, int first, int last, const D3DXMATRIX& world,
+	std::vector<D3DXMATRIX>& out)
+{
+	const CSphereLook look;
+	D3DXMATRIX local;
+	for (int i = first; i < last; i++) {
+		if (balls[i].isActive()) {
+			look.getLocalTransform(balls[i], local);
+			out[i] = local * world;
+		}
+	}
+}
+
+// the device: this thread and nobody else, for as long as drawing takes
+static void submit(double ms, const std::vector<D3DXMATRIX>& matrices)
+{
+	Clock::time_point t0 = Clock::now();
+	volatile float sink = 0;
+	size_t k = 0;
+	while (msSince(t0) < ms)
+		sink = sink + matrices[k++ % matrices.size()]._41;
+}
+
+static double runSequential(CWorkerPool& pool, const scene::CSceneFile& sc, int frames, double submitMs,
+	std::vector<CSphere>& balls)
+{
+	loadBalls(sc, balls);
+	std::vector<CWall> walls;
+	CSlabStepper stepper(pool);
+	CCollisionEventBuffer events;
+	std::vector<D3DXMATRIX> matrices(balls.size());
+	D3DXMATRIX world;
+	D3DXMatrixIdentity(&world);
+
+	Clock::time_point t0 = Clock::now();
+	for (int f = 0; f < frames; f++) {
+		events.clear();
+		stepper.step(balls, walls, FRAME_SECONDS, events);
+		buildMatrices(balls, 0, (int)balls.size(), world, matrices);
+		submit(submitMs, matrices);
+	}
+	return msSince(t0) / frames;
+}
+
+static double runGraph(CWorkerPool& pool, const scene::CSceneFile& sc, int frames, double submitMs,
+	std::vector<CSphere>& balls, CJobGraph& prepare, CJobGraph& step)
+{
+	loadBalls(sc, balls);
+	std::vector<CWall> walls;
+	CSlabStepper stepper(pool);
+	CCollisionEventBuffer events;
+	std::vector<D3DXMATRIX> matrices(balls.size());
+	D3DXMATRIX world;
+	D3DXMatrixIdentity(&world);
+	const int n = (int)balls.size();
+
+	Clock::time_point t0 = Clock::now();
+	for (int f = 0; f < frames; f++) {
+		prepare.clear();
+		for (int first = 0; first < n; first += BALLS_PER_JOB) {
+			int last = first + BALLS_PER_JOB < n ? first + BALLS_PER_JOB : n;
+			prepare.add("draws", [&, first, last] { buildMatrices(balls, first, last, world, matrices); });
+		}
+		prepare.run(pool);
+
+		step.clear();
+		step.add("physics", [&] {
+			events.clear();
+			stepper.step(balls, walls, FRAME_SECONDS, events);
+		});
+		step.start(pool);
+		submit(submitMs, matrices);
+		step.wait();
+	}
+	return msSince(t0) / frames;
+}
+
+// jobs of the same name together: how many, their busy time, first start
+// to last end, and the threads they ran on
+static void printJobs(const char* graph, const CJobGraph& jobs)
+{
+	std::vector<bool> done(jobs.getJobCount(), false);
+	for (int k = 0; k < jobs.getJobCount(); k++) {
+		if (done[k])
+			continue;
+		const char* name = jobs.getTiming(k).name;
+		int count = 0;
+		float busy = 0, first = 1e30f, last = 0;
+		unsigned int threads = 0;
+		for (int m = k; m < jobs.getJobCount(); m++) {
+			const JobTiming& t = jobs.getTiming(m);
+			if (strcmp(t.name, name) != 0)
+				continue;
+			done[m] = true;
+			count++;
+			busy += t.endMs - t.startMs;
+			first = t.startMs < first ? t.startMs : first;
+			last = t.endMs > last ? t.endMs : last;
+			threads |= 1u << (t.worker & 31);
+		}
+		printf("  %-8s %-8s x%-3d busy %7.3f ms, %7.3f .. %7.3f ms, threads", graph, name, count, busy, first, last);
+		for (int w = 0; w < 32; w++) {
+			if (threads & (1u << w))
+				printf(" %d", w);
+		}
+		printf("\n");
+	}
+}
+
+// every thread sums the same loop, some of them from inside jobs
+static bool checkParallelFor(CWorkerPool& pool)
+{
+	const int count = 100000;
+	long long expected = (long long)count * (count - 1) / 2;
+	const int callers = 4;
+	std::vector<std::atomic<long long> > sums(2 * callers);
+	for (size_t k = 0; k < sums.size(); k++)
+		sums[k] = 0;
+
+	std::vector<std::thread> threads;
+	for (int c = 0; c < callers; c++) {
+		threads.push_back(std::thread([&, c] {
+			pool.parallelFor(count, [&, c](int i) { sums[c] += i; });
+		}));
+	}
+	CJobGraph graph;
+	int last = -1;
+	for (int c = 0; c < callers; c++) {
+		int job = graph.add("nested", [&, c] {
+			pool.parallelFor(count, [&, c](int i) { sums[callers + c] += i; });
+		});
+		if (c % 2 == 1)
+			graph.precede(last, job);
+		last = job;
+	}
+	graph.run(pool);
+	for (size_t k = 0; k < threads.size(); k++)
+		threads[k].join();
+
+	bool ok = true;
+	for (size_t k = 0; k < sums.size(); k++)
+		ok = ok && sums[k] == expected;
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+	int frames = argc > 2 ? atoi(argv[2]) : 100;
+	double submitMs = argc > 3 ? atof(argv[3]) : 4.0;
+	int threads = argc > 4 ? atoi(argv[4]) : -1;
+
+	scene::CSceneBuilder builder;
+	scene::generateRandomPacking(builder, count, 1);
+	std::vector<unsigned char> image;
+	builder.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size())) {
+		fprintf(stderr, "bad scene image\n");
+		return 1;
+	}
+	g_tableHalfX = sc.header().tableHalfX;
+	g_tableHalfZ = sc.header().tableHalfZ;
+
+	CWorkerPool pool(threads);
+	std::vector<CSphere> seqBalls, graphBalls;
+	CJobGraph prepare, step;
+	double seqMs = runSequential(pool, sc, frames, submitMs, seqBalls);
+	double graphMs = runGraph(pool, sc, frames, submitMs, graphBalls, prepare, step);
+
+	bool same = true;
+	for (size_t i = 0; i < seqBalls.size() && same; i++) {
+		D3DXVECTOR3 a = seqBalls[i].getCenter(), b = graphBalls[i].getCenter();
+		same = a.x == b.x && a.z == b.z && seqBalls[i].isActive() == graphBalls[i].isActive();
+	}
+
+	printf("%u balls, %d frames, %.1f ms submit, %d threads + caller\n", count, frames, submitMs, pool.getThreadCount());
+	printf("sequential %.2f ms/frame, job graph %.2f ms/frame; positions %s\n",
+		seqMs, graphMs, same ? "identical" : "DIFFER");
+	printf("last frame:\n");
+	printJobs("prepare", prepare);
+	printJobs("step", step);
+	printf("parallelFor from 4 threads and 4 jobs: %s\n", checkParallelFor(pool) ? "ok" : "WRONG SUM");
+	return 0;
+}
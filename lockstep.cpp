@@ -0,0 +1,326 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: lockstep.cpp
+//
+// Desc: Two-player lockstep over UDP with a minimal reliability layer.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "lockstep.h"
+#include <cstring>
+
+#pragma comment(lib, "ws2_32.lib")
+
+namespace
+{
+	enum { MSG_SHOT = 1, MSG_HASH = 2, MSG_ACK = 3 };
+
+	const unsigned int FINAL_TICK = 0x80000000u;	// set on the hash sent at rest
+	const int HEADER_SIZE = 3;
+
+	void putU16(unsigned char* p, unsigned int v) { p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); }
+	void putU32(unsigned char* p, unsigned int v) { putU16(p, v & 0xffff); putU16(p + 2, v >> 16); }
+	unsigned int getU16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+	unsigned int getU32(const unsigned char* p) { return getU16(p) | (getU16(p + 2) << 16); }
+
+	// seq a is newer than b, with wrap-around
+	bool seqAfter(unsigned short a, unsigned short b) { return (short)(a - b) > 0; }
+}
+
+CLockstepPeer::CLockstepPeer(void)
+{
+	m_socket = (uintptr_t)INVALID_SOCKET;
+	::ZeroMemory(m_remoteAddr, sizeof(m_remoteAddr));
+	m_first = false;
+	m_turn = 0;
+	m_shotInProgress = false;
+	m_tick = 0;
+	m_chain = 0;
+	m_sendSeq = 1;
+	m_recvSeq = 1;
+	m_remoteTurn = 0;
+	m_desynced = false;
+	m_desyncTurn = 0;
+	m_desyncTick = 0;
+	m_bytesSent = 0;
+	m_bytesReceived = 0;
+}
+
+CLockstepPeer::~CLockstepPeer(void)
+{
+	close();
+}
+
+bool CLockstepPeer::open(unsigned short localPort, const char* remoteHost, unsigned short remotePort, bool firstToShoot)
+{
+	close();
+
+	WSADATA wsa;
+	if (::WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+		return false;
+
+	SOCKET s = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s == INVALID_SOCKET) {
+		::WSACleanup();
+		return false;
+	}
+
+	sockaddr_in local;
+	::ZeroMemory(&local, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(localPort);
+
+	sockaddr_in remote;
+	::ZeroMemory(&remote, sizeof(remote));
+	remote.sin_family = AF_INET;
+	remote.sin_port = htons(remotePort);
+
+	u_long nonBlocking = 1;
+	if (::bind(s, (sockaddr*)&local, sizeof(local)) != 0 ||
+		::inet_pton(AF_INET, remoteHost, &remote.sin_addr) != 1 ||
+		::ioctlsocket(s, FIONBIO, &nonBlocking) != 0) {
+		::closesocket(s);
+		::WSACleanup();
+		return false;
+	}
+
+	m_socket = (uintptr_t)s;
+	memcpy(m_remoteAddr, &remote, sizeof(remote));
+	m_first = firstToShoot;
+	return true;
+}
+
+void CLockstepPeer::close(void)
+{
+	if ((SOCKET)m_socket != INVALID_SOCKET) {
+		::closesocket((SOCKET)m_socket);
+		::WSACleanup();
+		m_socket = (uintptr_t)INVALID_SOCKET;
+	}
+}
+
+void CLockstepPeer::sendRaw(const unsigned char* data, int size)
+{
+	int sent = ::sendto((SOCKET)m_socket, (const char*)data, size, 0, (const sockaddr*)m_remoteAddr, sizeof(sockaddr_in));
+	if (sent > 0)
+		m_bytesSent += sent;
+}
+
+void CLockstepPeer::sendAck(void)
+{
+	unsigned char packet[HEADER_SIZE];
+	packet[0] = MSG_ACK;
+	putU16(packet + 1, (unsigned short)(m_recvSeq - 1));
+	sendRaw(packet, sizeof(packet));
+}
+
+void CLockstepPeer::queueReliable(unsigned char type, const unsigned char* payload, int size, unsigned int nowMs)
+{
+	Outgoing o;
+	o.seq = m_sendSeq++;
+	o.data[0] = type;
+	putU16(o.data + 1, o.seq);
+	memcpy(o.data + HEADER_SIZE, payload, size);
+	o.size = HEADER_SIZE + size;
+	o.lastSent = nowMs;
+	m_unacked.push_back(o);
+	sendRaw(o.data, o.size);
+}
+
+void CLockstepPeer::poll(unsigned int nowMs)
+{
+	if ((SOCKET)m_socket == INVALID_SOCKET)
+		return;
+
+	unsigned char packet[64];
+	for (;;) {
+		sockaddr_in from;
+		int fromLen = sizeof(from);
+		int n = ::recvfrom((SOCKET)m_socket, (char*)packet, sizeof(packet), 0, (sockaddr*)&from, &fromLen);
+		if (n <= 0)
+			break;		// WSAEWOULDBLOCK: nothing more this frame
+		m_bytesReceived += n;
+		handlePacket(packet, n);
+	}
+
+	for (size_t i = 0; i < m_unacked.size(); i++) {
+		Outgoing& o = m_unacked[i];
+		if (nowMs - o.lastSent >= LOCKSTEP_RESEND_MS) {
+			sendRaw(o.data, o.size);
+			o.lastSent = nowMs;
+		}
+	}
+}
+
+void CLockstepPeer::handlePacket(const unsigned char* data, int size)
+{
+	if (size < HEADER_SIZE)
+		return;
+
+	unsigned char type = data[0];
+	unsigned short seq = (unsigned short)getU16(data + 1);
+
+	if (type == MSG_ACK) {
+		while (!m_unacked.empty() && !seqAfter(m_unacked.front().seq, seq))
+			m_unacked.pop_front();
+		return;
+	}
+
+	// in order only. a duplicate is acked again, a gap waits for the resend
+	if (seq == m_recvSeq) {
+		m_recvSeq++;
+		deliver(type, data + HEADER_SIZE, size - HEADER_SIZE);
+	}
+	if (!seqAfter(seq, m_recvSeq))
+		sendAck();
+}
+
+void CLockstepPeer::deliver(unsigned char type, const unsigned char* payload, int size)
+{
+	if (type == MSG_SHOT && size >= 10) {
+		LockstepShot shot;
+		shot.turn = (unsigned short)getU16(payload);
+		shot.targetX = (int)getU32(payload + 2);
+		shot.targetZ = (int)getU32(payload + 6);
+		m_remoteShots.push_back(shot);
+	}
+	else if (type == MSG_HASH && size >= 10) {
+		HashRecord r;
+		r.turn = (unsigned short)getU16(payload);
+		r.tick = getU32(payload + 2);
+		r.chain = getU32(payload + 6);
+		m_remoteHashes.push_back(r);
+		if (r.tick & FINAL_TICK)
+			m_remoteTurn = r.turn + 1;
+		checkHashes();
+	}
+}
+
+bool CLockstepPeer::sendShot(int targetX, int targetZ, unsigned int nowMs)
+{
+	if (!isMyTurn() || m_shotInProgress)
+		return false;
+
+	unsigned char payload[10];
+	putU16(payload, m_turn);
+	putU32(payload + 2, (unsigned int)targetX);
+	putU32(payload + 6, (unsigned int)targetZ);
+	queueReliable(MSG_SHOT, payload, sizeof(payload), nowMs);
+
+	m_shotInProgress = true;
+	m_tick = 0;
+	m_chain = m_turn;
+	return true;
+}
+
+bool CLockstepPeer::takeRemoteShot(LockstepShot& shot)
+{
+	if (isMyTurn() || m_shotInProgress || m_remoteShots.empty())
+		return false;
+	if (m_remoteShots.front().turn != m_turn)
+		return false;
+
+	shot = m_remoteShots.front();
+	m_remoteShots.pop_front();
+
+	m_shotInProgress = true;
+	m_tick = 0;
+	m_chain = m_turn;
+	return true;
+}
+
+void CLockstepPeer::recordTick(unsigned int stateHash, unsigned int nowMs)
+{
+	if (!m_shotInProgress)
+		return;
+
+	m_chain = ((m_chain << 5) | (m_chain >> 27)) ^ stateHash;
+	m_chain *= 16777619u;
+	m_tick++;
+	if (m_tick % LOCKSTEP_HASH_INTERVAL == 0)
+		sendHash(nowMs);
+}
+
+void CLockstepPeer::endTurn(unsigned int nowMs)
+{
+	if (!m_shotInProgress)
+		return;
+
+	m_tick |= FINAL_TICK;
+	sendHash(nowMs);
+
+	m_shotInProgress = false;
+	m_turn++;
+	checkHashes();
+}
+
+void CLockstepPeer::sendHash(unsigned int nowMs)
+{
+	HashRecord r;
+	r.turn = m_turn;
+	r.tick = m_tick;
+	r.chain = m_chain;
+	m_localHashes.push_back(r);
+
+	unsigned char payload[10];
+	putU16(payload, r.turn);
+	putU32(payload + 2, r.tick);
+	putU32(payload + 6, r.chain);
+	queueReliable(MSG_HASH, payload, sizeof(payload), nowMs);
+
+	checkHashes();
+}
+
+// pair up records for the same (turn, tick). a record left over from a turn
+// that both sides have finished means the shots ran for different lengths.
+// records arrive in order, so once the peer's final record of a turn is in,
+// none of its others for that turn are still on the way
+void CLockstepPeer::checkHashes(void)
+{
+	for (size_t r = 0; r < m_remoteHashes.size(); ) {
+		const HashRecord& remote = m_remoteHashes[r];
+		bool matched = false;
+
+		for (size_t l = 0; l < m_localHashes.size(); l++) {
+			const HashRecord& local = m_localHashes[l];
+			if (local.turn != remote.turn || local.tick != remote.tick)
+				continue;
+			if (local.chain != remote.chain && !m_desynced) {
+				m_desynced = true;
+				m_desyncTurn = local.turn;
+				m_desyncTick = local.tick & ~FINAL_TICK;
+			}
+			m_localHashes.erase(m_localHashes.begin() + l);
+			matched = true;
+			break;
+		}
+
+		if (!matched && seqAfter(m_turn, remote.turn) && !m_desynced) {
+			m_desynced = true;
+			m_desyncTurn = remote.turn;
+			m_desyncTick = remote.tick & ~FINAL_TICK;
+		}
+
+		if (matched || seqAfter(m_turn, remote.turn))
+			m_remoteHashes.erase(m_remoteHashes.begin() + r);
+		else
+			r++;
+	}
+
+	for (size_t l = 0; l < m_localHashes.size(); ) {
+		const HashRecord& local = m_localHashes[l];
+		if (!seqAfter(m_turn, local.turn) || !seqAfter(m_remoteTurn, local.turn)) {
+			l++;
+			continue;
+		}
+		if (!m_desynced) {
+			m_desynced = true;
+			m_desyncTurn = local.turn;
+			m_desyncTick = local.tick & ~FINAL_TICK;
+		}
+		m_localHashes.erase(m_localHashes.begin() + l);
+	}
+}
@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: lockstep.h
+//
+// Desc: Two-player lockstep over UDP. Both peers run the fixed-point table
+//       (tablePhysics.h), so only the inputs travel: the target position of
+//       each shot. Desyncs are caught by comparing a chained state hash:
+//       every tick of a shot is folded into the chain and the chain value is
+//       exchanged every LOCKSTEP_HASH_INTERVAL ticks and when the table
+//       comes to rest.
+//
+//       Wire format, little endian, one message per datagram:
+//
+//         [u8 type][u16 seq] payload
+//         SHOT   turn u16, targetX i32, targetZ i32           13 bytes
+//         HASH   turn u16, tick u32, chain u32                13 bytes
+//         ACK    (seq is the last in-order seq received)       3 bytes
+//
+//       SHOT and HASH are delivered reliably and in order: they are resent
+//       until acked, and anything past a gap is dropped until the gap is
+//       filled.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __lockstepH__
+#define __lockstepH__
+
+#include <vector>
+#include <deque>
+#include <cstddef>
+#include <cstdint>
+
+const unsigned int LOCKSTEP_HASH_INTERVAL = 32;		// ticks between hash messages
+const unsigned int LOCKSTEP_RESEND_MS = 100;
+
+struct LockstepShot
+{
+	unsigned short	turn;
+	int				targetX;	// FixedPolicy
+	int				targetZ;
+};
+
+class CLockstepPeer {
+public:
+	CLockstepPeer(void);
+	~CLockstepPeer(void);
+
+	// firstToShoot decides who owns turn 0; the two peers must disagree
+	bool open(unsigned short localPort, const char* remoteHost, unsigned short remotePort, bool firstToShoot);
+	void close(void);
+
+	// receive, ack and resend. call once per frame.
+	void poll(unsigned int nowMs);
+
+	unsigned short getTurn(void) const { return m_turn; }
+	bool isMyTurn(void) const { return ((m_turn & 1) == 0) == m_first; }
+	bool isShotInProgress(void) const { return m_shotInProgress; }
+
+	// local shot; only on our turn while the table is at rest
+	bool sendShot(int targetX, int targetZ, unsigned int nowMs);
+	// peer's shot for the current turn, once it has arrived
+	bool takeRemoteShot(LockstepShot& shot);
+
+	// after every tick of a shot, with the table state hash
+	void recordTick(unsigned int stateHash, unsigned int nowMs);
+	// the table came to rest: last hash goes out and the turn passes
+	void endTurn(unsigned int nowMs);
+
+	bool isDesynced(void) const { return m_desynced; }
+	unsigned short getDesyncTurn(void) const { return m_desyncTurn; }
+	unsigned int getDesyncTick(void) const { return m_desyncTick; }
+
+	unsigned long long getBytesSent(void) const { return m_bytesSent; }
+	unsigned long long getBytesReceived(void) const { return m_bytesReceived; }
+
+private:
+	CLockstepPeer(const CLockstepPeer&);
+	CLockstepPeer& operator=(const CLockstepPeer&);
+
+	struct Outgoing {
+		unsigned char	data[16];
+		int				size;
+		unsigned short	seq;
+		unsigned int	lastSent;
+	};
+
+	struct HashRecord {
+		unsigned short	turn;
+		unsigned int	tick;
+		unsigned int	chain;
+	};
+
+	void queueReliable(unsigned char type, const unsigned char* payload, int size, unsigned int nowMs);
+	void sendRaw(const unsigned char* data, int size);
+	void sendAck(void);
+	void handlePacket(const unsigned char* data, int size);
+	void deliver(unsigned char type, const unsigned char* payload, int size);
+	void sendHash(unsigned int nowMs);
+	void checkHashes(void);
+
+	uintptr_t				m_socket;
+	unsigned char			m_remoteAddr[16];	// sockaddr_in
+	bool					m_first;
+
+	unsigned short			m_turn;
+	bool					m_shotInProgress;
+	unsigned int			m_tick;				// ticks of the current shot
+	unsigned int			m_chain;
+
+	unsigned short			m_sendSeq;			// next seq to use
+	unsigned short			m_recvSeq;			// next seq expected
+	std::deque<Outgoing>	m_unacked;
+
+	std::deque<LockstepShot>	m_remoteShots;
+	std::vector<HashRecord>		m_localHashes;
+	std::vector<HashRecord>		m_remoteHashes;
+	unsigned short			m_remoteTurn;		// turn after the last one the peer finished
+
+	bool					m_desynced;
+	unsigned short			m_desyncTurn;
+	unsigned int			m_desyncTick;
+
+	unsigned long long		m_bytesSent;
+	unsigned long long		m_bytesReceived;
+};
+
+#endif // __lockstepH__
@@ -0,0 +1,182 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: lockstepLoopback.cpp
+//
+// Desc: Plays a lockstep match between two peers over 127.0.0.1 in one
+//       process. Each peer owns its own fixed-point table built from the same
+//       rack scene; only the shots and the state hashes cross the sockets.
+//
+//       lockstepLoopback [turns] [-desync]
+//
+//       -desync nudges one ball on the second peer before turn 2, which the
+//       hash exchange must report.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "lockstep.h"
+#include "tablePhysics.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+static const unsigned short PORT_A = 27015;
+static const unsigned short PORT_B = 27016;
+static const float TICK = 0.005f;
+static const unsigned int MAX_TICKS = 200000;	// a shot that never stops is a bug
+
+struct Side
+{
+	CLockstepPeer					peer;
+	TBallSet<FixedPolicy>			balls;
+	TTablePhysics<FixedPolicy>		table;
+	CCollisionEventBuffer			events;
+	unsigned int					cue;
+	unsigned int					ticks;
+};
+
+static unsigned int nowMs(void)
+{
+	using namespace std::chrono;
+	return (unsigned int)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void loadTable(Side& side, const scene::CSceneFile& sc)
+{
+	const scene::SceneHeader& h = sc.header();
+	side.table.setTable(h.tableHalfX, h.tableHalfZ);
+	side.balls.resize(h.ballCount);
+	for (unsigned int i = 0; i < h.ballCount; i++) {
+		const scene::SceneBall& s = sc.balls()[i];
+		side.balls.x[i] = FixedPolicy::fromFloat(s.x);
+		side.balls.z[i] = FixedPolicy::fromFloat(s.z);
+		side.balls.vx[i] = FixedPolicy::fromFloat(s.vx);
+		side.balls.vz[i] = FixedPolicy::fromFloat(s.vz);
+		side.balls.radius[i] = FixedPolicy::fromFloat(sc.ballRadius(i));
+		side.balls.mass[i] = FixedPolicy::fromFloat(sc.ballMass(i));
+		side.balls.type[i] = s.type;
+		side.balls.active[i] = 1;
+	}
+	side.cue = h.cueIndex;
+	side.ticks = 0;
+}
+
+// one tick of a shot in progress, as stepFixedPhysics does it
+static void tick(Side& side)
+{
+	if (!side.peer.isShotInProgress())
+		return;
+
+	side.events.clear();
+	side.table.step(side.balls, FixedPolicy::fromFloat(TICK), side.events);
+	dispatchCollisionEvents(side.events, &side.balls);
+	side.ticks++;
+
+	side.peer.recordTick(side.balls.hash(), nowMs());
+	if (side.balls.atRest() || side.ticks >= MAX_TICKS)
+		side.peer.endTurn(nowMs());
+}
+
+// shooter aims at the next live object ball, so every turn moves something
+static void aim(const Side& side, unsigned int turn, int& tx, int& tz)
+{
+	const size_t n = side.balls.size();
+	for (size_t k = 0; k < n; k++) {
+		size_t i = (turn * 3 + 1 + k) % n;
+		if (i != side.cue && side.balls.active[i]) {
+			tx = side.balls.x[i];
+			tz = side.balls.z[i];
+			return;
+		}
+	}
+	tx = 0;
+	tz = 0;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int turns = 6;
+	bool desync = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-desync") == 0)
+			desync = true;
+		else
+			turns = (unsigned int)strtoul(argv[i], NULL, 10);
+	}
+
+	scene::CSceneBuilder b;
+	scene::generateRack(b, 5, 1);
+	std::vector<unsigned char> image;
+	b.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size())) {
+		fprintf(stderr, "bad scene image\n");
+		return 1;
+	}
+
+	Side a, c;
+	loadTable(a, sc);
+	loadTable(c, sc);
+	if (!a.peer.open(PORT_A, "127.0.0.1", PORT_B, true) ||
+		!c.peer.open(PORT_B, "127.0.0.1", PORT_A, false)) {
+		fprintf(stderr, "cannot open loopback sockets\n");
+		return 1;
+	}
+
+	unsigned long long lastBytes = 0;
+	for (unsigned int turn = 0; turn < turns; turn++) {
+		Side& shooter = a.peer.isMyTurn() ? a : c;
+		Side& other = a.peer.isMyTurn() ? c : a;
+
+		if (desync && turn == 2)
+			c.balls.x[c.cue] += 1;		// one Q16.16 unit
+
+		int tx, tz;
+		aim(shooter, turn, tx, tz);
+		if (!shooter.peer.sendShot(tx, tz, nowMs())) {
+			fprintf(stderr, "turn %u: shot refused\n", turn);
+			return 1;
+		}
+		TTablePhysics<FixedPolicy>::shot(shooter.balls, shooter.cue, tx, tz);
+		shooter.ticks = 0;
+		other.ticks = 0;
+
+		// both tables run in the same loop here, but the second one only
+		// starts once the shot has actually arrived over the socket
+		while (a.peer.getTurn() == turn || c.peer.getTurn() == turn) {
+			a.peer.poll(nowMs());
+			c.peer.poll(nowMs());
+
+			LockstepShot shot;
+			if (other.peer.takeRemoteShot(shot))
+				TTablePhysics<FixedPolicy>::shot(other.balls, other.cue, shot.targetX, shot.targetZ);
+
+			tick(a);
+			tick(c);
+		}
+
+		// let the final hashes and their acks land before reporting
+		unsigned int until = nowMs() + 20;
+		while (nowMs() < until) {
+			a.peer.poll(nowMs());
+			c.peer.poll(nowMs());
+		}
+
+		unsigned long long bytes = a.peer.getBytesSent() + c.peer.getBytesSent();
+		printf("turn %u: %s shot, %u ticks, hash %08x / %08x, %llu bytes on the wire\n",
+			turn, &shooter == &a ? "A" : "B", shooter.ticks,
+			a.balls.hash(), c.balls.hash(), bytes - lastBytes);
+		lastBytes = bytes;
+
+		if (a.peer.isDesynced() || c.peer.isDesynced())
+			break;
+	}
+
+	const CLockstepPeer& bad = a.peer.isDesynced() ? a.peer : c.peer;
+	if (bad.isDesynced()) {
+		printf("desync detected at turn %u, tick %u\n", (unsigned int)bad.getDesyncTurn(), bad.getDesyncTick());
+		return desync ? 0 : 1;
+	}
+	printf("in sync after %u turns\n", turns);
+	return desync ? 1 : 0;
+}
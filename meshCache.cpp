@@ -0,0 +1,397 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: meshCache.cpp
+//
+// Desc: Generated sphere and box meshes, kept in a memory-mapped cache file.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "meshCache.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+namespace
+{
+	const double MESH_PI = 3.14159265358979323846;
+
+	geometry::MeshVertex makeVertex(float x, float y, float z, float nx, float ny, float nz)
+	{
+		geometry::MeshVertex v = { x, y, z, nx, ny, nz };
+		return v;
+	}
+
+	// a, b, c in the order that faces the way their normals point, which is
+	// clockwise seen from outside: D3D's front face with the default culling
+	void addTriangle(const std::vector<geometry::MeshVertex>& v, std::vector<unsigned short>& indices,
+		unsigned int a, unsigned int b, unsigned int c)
+	{
+		float e1[3] = { v[b].x - v[a].x, v[b].y - v[a].y, v[b].z - v[a].z };
+		float e2[3] = { v[c].x - v[a].x, v[c].y - v[a].y, v[c].z - v[a].z };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float out = n[0] * (v[a].nx + v[b].nx + v[c].nx) + n[1] * (v[a].ny + v[b].ny + v[c].ny) + n[2] * (v[a].nz + v[b].nz + v[c].nz);
+		indices.push_back((unsigned short)a);
+		indices.push_back((unsigned short)(out >= 0 ? b : c));
+		indices.push_back((unsigned short)(out >= 0 ? c : b));
+	}
+
+	void generateSphere(float radius, unsigned int slices, unsigned int stacks,
+		std::vector<geometry::MeshVertex>& v, std::vector<unsigned short>& indices)
+	{
+		// poles and stacks - 1 rings of slices vertices
+		v.push_back(makeVertex(0, radius, 0, 0, 1, 0));
+		for (unsigned int i = 1; i < stacks; i++) {
+			double phi = MESH_PI * i / stacks;
+			for (unsigned int j = 0; j < slices; j++) {
+				double theta = 2 * MESH_PI * j / slices;
+				float nx = (float)(sin(phi) * cos(theta)), ny = (float)cos(phi), nz = (float)(sin(phi) * sin(theta));
+				v.push_back(makeVertex(radius * nx, radius * ny, radius * nz, nx, ny, nz));
+			}
+		}
+		const unsigned int bottom = (unsigned int)v.size();
+		v.push_back(makeVertex(0, -radius, 0, 0, -1, 0));
+
+		#define RING(i, j) (1 + ((i) - 1) * slices + (j) % slices)
+		for (unsigned int j = 0; j < slices; j++)
+			addTriangle(v, indices, 0, RING(1, j), RING(1, j + 1));
+		for (unsigned int i = 1; i + 1 < stacks; i++) {
+			for (unsigned int j = 0; j < slices; j++) {
+				addTriangle(v, indices, RING(i, j), RING(i, j + 1), RING(i + 1, j + 1));
+				addTriangle(v, indices, RING(i, j), RING(i + 1, j + 1), RING(i + 1, j));
+			}
+		}
+		for (unsigned int j = 0; j < slices; j++)
+			addTriangle(v, indices, bottom, RING(stacks - 1, j + 1), RING(stacks - 1, j));
+		#undef RING
+	}
+
+	// four vertices per side, so that every side has its own normal
+	void generateBox(const float size[3], std::vector<geometry::MeshVertex>& v, std::vector<unsigned short>& indices)
+	{
+		const float half[3] = { size[0] / 2, size[1] / 2, size[2] / 2 };
+		for (int axis = 0; axis < 3; axis++) {
+			const int u = (axis + 1) % 3, w = (axis + 2) % 3;
+			for (int sign = -1; sign <= 1; sign += 2) {
+				const unsigned int first = (unsigned int)v.size();
+				const float corners[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+				for (int k = 0; k < 4; k++) {
+					float p[3], n[3] = { 0, 0, 0 };
+					p[axis] = sign * half[axis];
+					p[u] = corners[k][0] * half[u];
+					p[w] = corners[k][1] * half[w];
+					n[axis] = (float)sign;
+					v.push_back(makeVertex(p[0], p[1], p[2], n[0], n[1], n[2]));
+				}
+				addTriangle(v, indices, first, first + 1, first + 2);
+				addTriangle(v, indices, first, first + 2, first + 3);
+			}
+		}
+	}
+
+	size_t alignUp(size_t n) { return (n + 3) & ~(size_t)3; }
+}
+
+geometry::MeshParams geometry::sphereParams(float radius, unsigned int slices, unsigned int stacks)
+{
+	MeshParams p;
+	memset(&p, 0, sizeof(p));
+	p.kind = MESH_SPHERE;
+	p.slices = slices;
+	p.stacks = stacks;
+	p.size[0] = radius;
+	return p;
+}
+
+geometry::MeshParams geometry::boxParams(float width, float height, float depth)
+{
+	MeshParams p;
+	memset(&p, 0, sizeof(p));
+	p.kind = MESH_BOX;
+	p.size[0] = width;
+	p.size[1] = height;
+	p.size[2] = depth;
+	return p;
+}
+
+bool geometry::sameParams(const MeshParams& a, const MeshParams& b)
+{
+	return a.kind == b.kind && a.slices == b.slices && a.stacks == b.stacks &&
+		a.size[0] == b.size[0] && a.size[1] == b.size[1] && a.size[2] == b.size[2];
+}
+
+void geometry::generate(const MeshParams& p, std::vector<MeshVertex>& vertices, std::vector<unsigned short>& indices)
+{
+	vertices.clear();
+	indices.clear();
+	if (p.kind == MESH_SPHERE && p.slices >= 3 && p.stacks >= 2 && 2 + p.slices * (p.stacks - 1) <= 65536)
+		generateSphere(p.size[0], p.slices, p.stacks, vertices, indices);
+	else if (p.kind == MESH_BOX)
+		generateBox(p.size, vertices, indices);
+}
+
+geometry::CMeshCache::CMeshCache(void)
+{
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+	m_data = NULL;
+	m_size = 0;
+	m_generatedCount = 0;
+	m_written = false;
+}
+
+geometry::CMeshCache::~CMeshCache(void)
+{
+	close();
+}
+
+void geometry::CMeshCache::close(void)
+{
+	unmap();
+	m_meshes.clear();
+	m_vertices.clear();
+	m_indices.clear();
+}
+
+bool geometry::CMeshCache::map(const char* path)
+{
+	m_file = ::CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(m_file, &size) || size.QuadPart < (LONGLONG)sizeof(CacheHeader)) {
+		unmap();
+		return false;
+	}
+	m_mapping = ::CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == NULL) {
+		unmap();
+		return false;
+	}
+	m_data = (const unsigned char*)::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == NULL) {
+		unmap();
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+
+	if (!validate()) {
+		unmap();
+		return false;
+	}
+	return true;
+}
+
+void geometry::CMeshCache::unmap(void)
+{
+	if (m_mapping != NULL) {
+		if (m_data != NULL)
+			::UnmapViewOfFile(m_data);
+		::CloseHandle(m_mapping);
+		m_mapping = NULL;
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		::CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+	m_data = NULL;
+	m_size = 0;
+}
+
+// everything in bounds and every index a vertex, so that a damaged file
+// cannot hand the device garbage
+bool geometry::CMeshCache::validate(void) const
+{
+	const CacheHeader* h = (const CacheHeader*)m_data;
+	if (h->magic != CACHE_MAGIC || h->version != CACHE_VERSION)
+		return false;
+	if ((unsigned long long)h->entryCount * sizeof(CacheEntry) > m_size - sizeof(CacheHeader))
+		return false;
+
+	const CacheEntry* e = entries();
+	for (unsigned int k = 0; k < h->entryCount; k++) {
+		const unsigned long long vertexBytes = (unsigned long long)e[k].vertexCount * sizeof(MeshVertex);
+		const unsigned long long indexBytes = (unsigned long long)e[k].indexCount * sizeof(unsigned short);
+		if (e[k].vertexCount == 0 || e[k].vertexCount > 65536 || e[k].indexCount % 3 != 0)
+			return false;
+		if (e[k].vertexOffset % 4 != 0 || e[k].indexOffset % 2 != 0)
+			return false;
+		if (e[k].vertexOffset > m_size || vertexBytes > m_size - e[k].vertexOffset)
+			return false;
+		if (e[k].indexOffset > m_size || indexBytes > m_size - e[k].indexOffset)
+			return false;
+		const unsigned short* indices = (const unsigned short*)(m_data + e[k].indexOffset);
+		for (unsigned int i = 0; i < e[k].indexCount; i++) {
+			if (indices[i] >= e[k].vertexCount)
+				return false;
+		}
+	}
+	return true;
+}
+
+int geometry::CMeshCache::find(const MeshParams& p) const
+{
+	if (m_data == NULL)
+		return -1;
+	const unsigned int count = ((const CacheHeader*)m_data)->entryCount;
+	const CacheEntry* e = entries();
+	for (unsigned int k = 0; k < count; k++) {
+		if (sameParams(e[k].params, p))
+			return (int)k;
+	}
+	return -1;
+}
+
+// the mapped file's meshes, then the fresh ones (m_vertices[i] for i in
+// fresh order), each at a 4-byte boundary
+bool geometry::CMeshCache::write(const std::string& path, const std::vector<MeshParams>& fresh) const
+{
+	struct Source {
+		const void*		vertices;
+		const void*		indices;
+	};
+	std::vector<CacheEntry> table;
+	std::vector<Source> sources;
+
+	const unsigned int old = m_data != NULL ? ((const CacheHeader*)m_data)->entryCount : 0;
+	for (unsigned int k = 0; k < old; k++) {
+		table.push_back(entries()[k]);
+		Source s = { m_data + entries()[k].vertexOffset, m_data + entries()[k].indexOffset };
+		sources.push_back(s);
+	}
+	for (size_t k = 0; k < fresh.size(); k++) {
+		size_t i = 0;
+		while (!sameParams(m_params[i], fresh[k]))
+			i++;
+		CacheEntry e;
+		memset(&e, 0, sizeof(e));
+		e.params = fresh[k];
+		e.vertexCount = (unsigned int)m_vertices[i].size();
+		e.indexCount = (unsigned int)m_indices[i].size();
+		table.push_back(e);
+		Source s = { &m_vertices[i][0], e.indexCount > 0 ? (const void*)&m_indices[i][0] : NULL };
+		sources.push_back(s);
+	}
+
+	size_t offset = sizeof(CacheHeader) + table.size() * sizeof(CacheEntry);
+	for (size_t k = 0; k < table.size(); k++) {
+		table[k].vertexOffset = offset;
+		offset = alignUp(offset + table[k].vertexCount * sizeof(MeshVertex));
+		table[k].indexOffset = offset;
+		offset = alignUp(offset + table[k].indexCount * sizeof(unsigned short));
+	}
+
+	FILE* fp = fopen(path.c_str(), "wb");
+	if (fp == NULL)
+		return false;
+	CacheHeader h;
+	h.magic = CACHE_MAGIC;
+	h.version = CACHE_VERSION;
+	h.entryCount = (unsigned int)table.size();
+	h.reserved = 0;
+	bool ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+	if (ok && !table.empty())
+		ok = fwrite(&table[0], sizeof(CacheEntry), table.size(), fp) == table.size();
+	const unsigned char pad[4] = { 0, 0, 0, 0 };
+	for (size_t k = 0; ok && k < table.size(); k++) {
+		const size_t vertexBytes = table[k].vertexCount * sizeof(MeshVertex);
+		const size_t indexBytes = table[k].indexCount * sizeof(unsigned short);
+		ok = fwrite(sources[k].vertices, 1, vertexBytes, fp) == vertexBytes;
+		if (ok && indexBytes > 0)
+			ok = fwrite(sources[k].indices, 1, indexBytes, fp) == indexBytes;
+		if (ok && alignUp(indexBytes) != indexBytes)
+			ok = fwrite(pad, 1, alignUp(indexBytes) - indexBytes, fp) == alignUp(indexBytes) - indexBytes;
+	}
+	if (fclose(fp) != 0)
+		ok = false;
+	if (!ok)
+		::DeleteFile(path.c_str());
+	return ok;
+}
+
+void geometry::CMeshCache::load(const char* path, const MeshParams* params, size_t count, CWorkerPool* pool)
+{
+	close();
+	m_generatedCount = 0;
+	m_written = false;
+	const bool named = path != NULL && path[0] != '\0';
+	if (named)
+		map(path);
+
+	// one of each mesh the file does not have
+	m_params.assign(params, params + count);
+	m_vertices.assign(count, std::vector<MeshVertex>());
+	m_indices.assign(count, std::vector<unsigned short>());
+	std::vector<int> missing;
+	std::vector<MeshParams> fresh;
+	for (size_t i = 0; i < count; i++) {
+		if (find(params[i]) >= 0)
+			continue;
+		bool seen = false;
+		for (size_t k = 0; k < fresh.size() && !seen; k++)
+			seen = sameParams(fresh[k], params[i]);
+		if (seen)
+			continue;
+		missing.push_back((int)i);
+		fresh.push_back(params[i]);
+	}
+	m_generatedCount = missing.size();
+
+	std::function<void(int)> build = [&](int k) {
+		int i = missing[k];
+		generate(params[i], m_vertices[i], m_indices[i]);
+	};
+	if (pool != NULL)
+		pool->parallelFor((int)missing.size(), build);
+	else {
+		for (int k = 0; k < (int)missing.size(); k++)
+			build(k);
+	}
+	for (size_t k = 0; k < missing.size(); k++) {
+		if (m_vertices[missing[k]].empty()) {
+			fresh.erase(fresh.begin() + k);		// parameters nothing can be made from
+			missing.erase(missing.begin() + k);
+			k--;
+		}
+	}
+
+	// the file again with the new meshes, under its own name only once it
+	// is complete, and then mapped like any other time
+	if (named && !fresh.empty()) {
+		char suffix[32];
+		sprintf(suffix, ".%lu.tmp", (unsigned long)::GetCurrentProcessId());
+		std::string temp = std::string(path) + suffix;
+		if (write(temp, fresh)) {
+			unmap();
+			m_written = ::MoveFileEx(temp.c_str(), path, MOVEFILE_REPLACE_EXISTING) != FALSE;
+			if (!m_written)
+				::DeleteFile(temp.c_str());
+			map(path);
+		}
+	}
+
+	// the mapping where it has the mesh, the generated copy otherwise
+	m_meshes.assign(count, MeshData());
+	for (size_t i = 0; i < count; i++) {
+		MeshData& d = m_meshes[i];
+		memset(&d, 0, sizeof(d));
+		int e = find(params[i]);
+		if (e >= 0) {
+			const CacheEntry& c = entries()[e];
+			d.vertices = (const MeshVertex*)(m_data + c.vertexOffset);
+			d.vertexCount = c.vertexCount;
+			d.indices = (const unsigned short*)(m_data + c.indexOffset);
+			d.indexCount = c.indexCount;
+			continue;
+		}
+		size_t s = 0;
+		while (s < count && (m_vertices[s].empty() || !sameParams(params[s], params[i])))
+			s++;
+		if (s == count)
+			continue;
+		d.vertices = &m_vertices[s][0];
+		d.vertexCount = (unsigned int)m_vertices[s].size();
+		d.indices = &m_indices[s][0];
+		d.indexCount = (unsigned int)m_indices[s].size();
+	}
+}
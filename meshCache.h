@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: meshCache.h
+//
+// Desc: Vertex and index data of the scene's meshes, generated on the CPU
+//       and kept in a memory-mapped cache file from one launch to the next.
+//
+//       A mesh is named by what it is made from (MeshParams): a sphere by
+//       radius, slices and stacks, a box by its three sides. load() maps
+//       the cache file and looks every mesh up there. Whatever the file
+//       does not have is generated on the worker pool, one mesh per task,
+//       and the file is written again with the old meshes and the new ones,
+//       to a temporary name first, so that a half-written file is never
+//       seen by another launch. A file that is missing or does not check
+//       out is the same as an empty one.
+//
+//       The layout is what D3DXCreateSphere and D3DXCreateBox give: position
+//       and normal (D3DFVF_XYZ | D3DFVF_NORMAL), 16-bit indices, a triangle
+//       list with clockwise front faces. Nothing here needs Direct3D; the
+//       device meshes are filled from get() on the device thread.
+//
+//       File:   CacheHeader, CacheEntry[entryCount], then the vertices and
+//               indices of each entry at the offsets it gives
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __meshCacheH__
+#define __meshCacheH__
+
+#include "workerPool.h"
+#include <windows.h>
+#include <vector>
+#include <string>
+
+namespace geometry
+{
+	const unsigned int CACHE_MAGIC   = 0x4853454d;	// "MESH"
+	const unsigned int CACHE_VERSION = 1;
+
+	enum MeshKind { MESH_SPHERE = 1, MESH_BOX = 2 };
+
+	//
+	// On-disk records, little endian
+	//
+
+	// what a mesh is made from, and its key in the cache
+	struct MeshParams
+	{
+		unsigned int	kind;			// MeshKind
+		unsigned int	slices, stacks;	// sphere only, 0 for a box
+		float			size[3];		// sphere: radius, 0, 0. box: width, height, depth
+	};
+
+	struct MeshVertex
+	{
+		float			x, y, z;
+		float			nx, ny, nz;
+	};
+
+	struct CacheHeader
+	{
+		unsigned int	magic;
+		unsigned int	version;
+		unsigned int	entryCount;
+		unsigned int	reserved;
+	};
+
+	struct CacheEntry
+	{
+		MeshParams			params;
+		unsigned int		vertexCount;
+		unsigned int		indexCount;
+		unsigned long long	vertexOffset;	// from the start of the file
+		unsigned long long	indexOffset;
+	};
+
+	MeshParams sphereParams(float radius, unsigned int slices, unsigned int stacks);
+	MeshParams boxParams(float width, float height, float depth);
+	bool sameParams(const MeshParams& a, const MeshParams& b);
+
+	// a sphere has 2 + slices * (stacks - 1) vertices, which has to stay
+	// below 65536 for 16-bit indices
+	void generate(const MeshParams& p, std::vector<MeshVertex>& vertices, std::vector<unsigned short>& indices);
+
+	// one mesh, in the mapped file or in memory
+	struct MeshData
+	{
+		const MeshVertex*		vertices;
+		unsigned int			vertexCount;
+		const unsigned short*	indices;
+		unsigned int			indexCount;
+	};
+
+	class CMeshCache
+	{
+	public:
+		CMeshCache(void);
+		~CMeshCache(void);
+
+		// the meshes of params[0 .. count), from path where it has them and
+		// generated on pool (NULL: this thread) where it does not. never
+		// fails: without a usable file everything is generated
+		void load(const char* path, const MeshParams* params, size_t count, CWorkerPool* pool);
+		// drops the mapping and the generated data. get() is invalid after
+		void close(void);
+
+		const MeshData& get(size_t i) const { return m_meshes[i]; }
+		size_t getCount(void) const { return m_meshes.size(); }
+		// of the last load(): meshes that were not in the file, and whether
+		// the file was written again with them
+		size_t getGeneratedCount(void) const { return m_generatedCount; }
+		bool wasWritten(void) const { return m_written; }
+
+	private:
+		CMeshCache(const CMeshCache&);
+		CMeshCache& operator=(const CMeshCache&);
+
+		bool map(const char* path);
+		void unmap(void);
+		bool validate(void) const;
+		const CacheEntry* entries(void) const { return (const CacheEntry*)(m_data + sizeof(CacheHeader)); }
+		int find(const MeshParams& p) const;
+		bool write(const std::string& path, const std::vector<MeshParams>& fresh) const;
+
+		HANDLE							m_file;
+		HANDLE							m_mapping;
+		const unsigned char*			m_data;
+		size_t							m_size;
+
+		std::vector<MeshParams>			m_params;		// of the last load()
+		std::vector<MeshData>			m_meshes;
+		std::vector<std::vector<MeshVertex> >		m_vertices;		// generated, per mesh
+		std::vector<std::vector<unsigned short> >	m_indices;
+		size_t							m_generatedCount;
+		bool							m_written;
+	};
+}
+
+#endif // __meshCacheH__
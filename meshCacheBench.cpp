@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: meshCacheBench.cpp
+//
+// Desc: Startup geometry (meshCache.h): generated in sequence, generated on
+//       the worker pool, and loaded from the cache file.
+//
+//       meshCacheBench [cache file] [spheres] [threads]
+//
+//       The meshes are those of the default table (plane, four walls, the
+//       ball sphere, the light) and the given number of extra 50x50 spheres
+//       of other radii, standing in for a scene with more to build. The
+//       cache file is deleted first, so the first pool load is cold and
+//       writes it, and the next loads find everything there.
+//
+//       Prints the time of each, checks that the loaded meshes are byte for
+//       byte the generated ones, and that every triangle of every mesh faces
+//       the way its vertex normals point (clockwise from outside).
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "meshCache.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static void tableParams(int spheres, std::vector<geometry::MeshParams>& params)
+{
+	params.push_back(geometry::boxParams(9, 0.03f, 6));
+	params.push_back(geometry::boxParams(9, 0.3f, 0.12f));
+	params.push_back(geometry::boxParams(9, 0.3f, 0.12f));
+	params.push_back(geometry::boxParams(0.12f, 0.3f, 6.24f));
+	params.push_back(geometry::boxParams(0.12f, 0.3f, 6.24f));
+	params.push_back(geometry::sphereParams(0.21f, 50, 50));
+	params.push_back(geometry::sphereParams(0.1f, 10, 10));
+	for (int k = 0; k < spheres; k++)
+		params.push_back(geometry::sphereParams(0.1f + 0.01f * k, 50, 50));
+}
+
+static double generateAll(const std::vector<geometry::MeshParams>& params)
+{
+	std::vector<geometry::MeshVertex> vertices;
+	std::vector<unsigned short> indices;
+	Clock::time_point t0 = Clock::now();
+	for (size_t i = 0; i < params.size(); i++)
+		geometry::generate(params[i], vertices, indices);
+	return msSince(t0);
+}
+
+static double loadAll(geometry::CMeshCache& cache, const char* path, const std::vector<geometry::MeshParams>& params,
+	CWorkerPool* pool)
+{
+	Clock::time_point t0 = Clock::now();
+	cache.load(path, &params[0], params.size(), pool);
+	return msSince(t0);
+}
+
+static bool sameMeshes(const geometry::CMeshCache& a, const geometry::CMeshCache& b)
+{
+	if (a.getCount() != b.getCount())
+		return false;
+	for (size_t i = 0; i < a.getCount(); i++) {
+		const geometry::MeshData& x = a.get(i);
+		const geometry::MeshData& y = b.get(i);
+		if (x.vertexCount != y.vertexCount || x.indexCount != y.indexCount)
+			return false;
+		if (memcmp(x.vertices, y.vertices, x.vertexCount * sizeof(geometry::MeshVertex)) != 0)
+			return false;
+		if (memcmp(x.indices, y.indices, x.indexCount * sizeof(unsigned short)) != 0)
+			return false;
+	}
+	return true;
+}
+
+// triangles whose face normal points against their vertex normals
+static size_t wrongFaces(const geometry::MeshData& d)
+{
+	size_t wrong = 0;
+	for (unsigned int t = 0; t + 2 < d.indexCount; t += 3) {
+		const geometry::MeshVertex& a = d.vertices[d.indices[t]];
+		const geometry::MeshVertex& b = d.vertices[d.indices[t + 1]];
+		const geometry::MeshVertex& c = d.vertices[d.indices[t + 2]];
+		float e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+		float e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		if (n[0] * (a.nx + b.nx + c.nx) + n[1] * (a.ny + b.ny + c.ny) + n[2] * (a.nz + b.nz + c.nz) <= 0)
+			wrong++;
+	}
+	return wrong;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* path = argc > 1 ? argv[1] : "meshCacheBench.cache";
+	int spheres = argc > 2 ? atoi(argv[2]) : 32;
+	int threads = argc > 3 ? atoi(argv[3]) : -1;
+
+	std::vector<geometry::MeshParams> params;
+	tableParams(spheres, params);
+	remove(path);
+
+	CWorkerPool pool(threads);
+	geometry::CMeshCache serial, cold, warm;
+	double generateMs = generateAll(params);
+	double serialMs = loadAll(serial, NULL, params, NULL);
+	double coldMs = loadAll(cold, path, params, &pool);
+	size_t coldGenerated = cold.getGeneratedCount();
+	bool written = cold.wasWritten();
+	double warmMs = loadAll(warm, path, params, &pool);
+
+	size_t vertices = 0, triangles = 0, wrong = 0;
+	for (size_t i = 0; i < warm.getCount(); i++) {
+		vertices += warm.get(i).vertexCount;
+		triangles += warm.get(i).indexCount / 3;
+		wrong += wrongFaces(warm.get(i));
+	}
+
+	printf("%u meshes, %u vertices, %u triangles, %d threads + caller\n",
+		(unsigned int)params.size(), (unsigned int)vertices, (unsigned int)triangles, pool.getThreadCount());
+	printf("generate in sequence      %8.3f ms\n", generateMs);
+	printf("load, no file, no pool    %8.3f ms\n", serialMs);
+	printf("load, cold, on the pool   %8.3f ms (%u generated, file %s)\n",
+		coldMs, (unsigned int)coldGenerated, written ? "written" : "NOT WRITTEN");
+	printf("load, warm                %8.3f ms (%u generated)\n", warmMs, (unsigned int)warm.getGeneratedCount());
+	printf("cached meshes %s the generated ones, %u triangles facing the wrong way\n",
+		sameMeshes(serial, warm) && sameMeshes(serial, cold) ? "match" : "DIFFER FROM", (unsigned int)wrong);
+
+	// a file cut short is not used, and gets written again
+	cold.close();
+	warm.close();
+	FILE* fp = fopen(path, "r+b");
+	if (fp != NULL) {
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		fclose(fp);
+		std::vector<char> head(size / 2);
+		fp = fopen(path, "rb");
+		size_t got = fread(&head[0], 1, head.size(), fp);
+		fclose(fp);
+		fp = fopen(path, "wb");
+		fwrite(&head[0], 1, got, fp);
+		fclose(fp);
+	}
+	geometry::CMeshCache damaged;
+	loadAll(damaged, path, params, &pool);
+	printf("cache file cut in half: %u generated, %s\n", (unsigned int)damaged.getGeneratedCount(),
+		sameMeshes(serial, damaged) ? "meshes match" : "MESHES DIFFER");
+	damaged.close();
+	remove(path);
+	return 0;
+}
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: narrowPhase.cpp
+//
+// Desc: Batched ball-ball contact test, SSE2 or scalar.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "narrowPhase.h"
+#include <cmath>
+
+#if defined(NARROW_PHASE_SSE2)
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// lanes of mask that touch, in lane order
+	void emitLanes(unsigned int mask, const int* pairs, const float* nx, const float* nz,
+		std::vector<NarrowContact>& contacts)
+	{
+		while (mask != 0) {
+			int lane = 0;
+			while (!(mask & (1u << lane)))
+				lane++;
+			mask &= mask - 1;
+			NarrowContact c;
+			c.a = pairs[2 * lane];
+			c.b = pairs[2 * lane + 1];
+			c.nx = nx[lane];
+			c.nz = nz[lane];
+			contacts.push_back(c);
+		}
+	}
+
+#if defined(NARROW_PHASE_SSE2)
+	// four balls, one load each, turned into x, z and radius lanes
+	void gatherFour(const NarrowBall* balls, int i0, int i1, int i2, int i3, __m128& x, __m128& z, __m128& r)
+	{
+		__m128 b0 = _mm_loadu_ps(&balls[i0].x);
+		__m128 b1 = _mm_loadu_ps(&balls[i1].x);
+		__m128 b2 = _mm_loadu_ps(&balls[i2].x);
+		__m128 b3 = _mm_loadu_ps(&balls[i3].x);
+		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+		x = b0;
+		z = b1;
+		r = b2;
+	}
+
+	// four pairs, one lane each. returns the touching lanes as bits
+	unsigned int testFour(const NarrowBall* balls, const int* p, float* nx, float* nz)
+	{
+		__m128 xa, za, ra, xb, zb, rb;
+		gatherFour(balls, p[0], p[2], p[4], p[6], xa, za, ra);
+		gatherFour(balls, p[1], p[3], p[5], p[7], xb, zb, rb);
+
+		__m128 dx = _mm_sub_ps(xa, xb);
+		__m128 dz = _mm_sub_ps(za, zb);
+		__m128 reach = _mm_add_ps(ra, rb);
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz));
+		__m128 hit = _mm_and_ps(_mm_cmple_ps(d2, _mm_mul_ps(reach, reach)), _mm_cmpgt_ps(d2, _mm_setzero_ps()));
+		unsigned int mask = (unsigned int)_mm_movemask_ps(hit);
+		if (mask != 0) {
+			__m128 d = _mm_sqrt_ps(d2);
+			_mm_storeu_ps(nx, _mm_div_ps(dx, d));
+			_mm_storeu_ps(nz, _mm_div_ps(dz, d));
+		}
+		return mask;
+	}
+#endif
+}
+
+size_t narrowPhaseScalar(const NarrowBall* balls, const int* pairs, size_t pairCount,
+	std::vector<NarrowContact>& contacts)
+{
+	size_t found = 0;
+	for (size_t k = 0; k < pairCount; k++) {
+		const NarrowBall& a = balls[pairs[2 * k]];
+		const NarrowBall& b = balls[pairs[2 * k + 1]];
+		float dx = a.x - b.x;
+		float dz = a.z - b.z;
+		float d2 = dx * dx + dz * dz;
+		float reach = a.radius + b.radius;
+		if (d2 > reach * reach || d2 <= 0)
+			continue;
+		float d = sqrtf(d2);
+		NarrowContact c;
+		c.a = pairs[2 * k];
+		c.b = pairs[2 * k + 1];
+		c.nx = dx / d;
+		c.nz = dz / d;
+		contacts.push_back(c);
+		found++;
+	}
+	return found;
+}
+
+size_t narrowPhase(const NarrowBall* balls, const int* pairs, size_t pairCount,
+	std::vector<NarrowContact>& contacts)
+{
+	const size_t before = contacts.size();
+	size_t k = 0;
+
+#if defined(NARROW_PHASE_SSE2)
+	float nx[NARROW_PHASE_BATCH], nz[NARROW_PHASE_BATCH];
+	for (; k + NARROW_PHASE_BATCH <= pairCount; k += NARROW_PHASE_BATCH) {
+		const int* p = pairs + 2 * k;
+		unsigned int mask = testFour(balls, p, nx, nz);
+		mask |= testFour(balls, p + 8, nx + 4, nz + 4) << 4;
+		if (mask != 0)
+			emitLanes(mask, p, nx, nz, contacts);
+	}
+#endif
+
+	narrowPhaseScalar(balls, pairs + 2 * k, pairCount - k, contacts);
+	return contacts.size() - before;
+}
@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: narrowPhaseBench.cpp
+//
+// Desc: Ball-ball contact test per candidate pair: batched narrowPhase()
+//       against one pair at a time.
+//
+//       narrowPhaseBench [balls]
+//
+//       The balls of a random packing are pushed together a little so that
+//       some touch, and the candidate pairs come from the same z sweep the
+//       slab stepper runs. Three ways of testing them are timed:
+//
+//         per pair  - what CSphere::hasIntersected did, on CSphere objects:
+//                     getCenter() copies and
+//                     sqrt(pow(dx, 2) + pow(dy, 2) + pow(dz, 2))
+//         scalar    - narrowPhaseScalar(), squared distances on the plane
+//         batched   - narrowPhase(), eight pairs at a time
+//
+//       Prints the time per pair and checks that all three find the same
+//       contacts and the last two the same normals.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "narrowPhase.h"
+#include "billiard.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+static const int ROUNDS = 20;
+static const float SQUEEZE = 0.97f;		// positions scaled towards the middle
+
+typedef std::chrono::steady_clock Clock;
+
+float g_tableHalfX = 0, g_tableHalfZ = 0;
+const CCushionField* g_cushions = NULL;
+
+static double msSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static size_t perPair(const std::vector<CSphere>& spheres, const std::vector<int>& pairs)
+{
+	size_t found = 0;
+	for (size_t k = 0; k < pairs.size(); k += 2) {
+		const CSphere& a = spheres[pairs[k]];
+		const CSphere& b = spheres[pairs[k + 1]];
+		D3DXVECTOR3 ac = a.getCenter(), bc = b.getCenter();
+		float distance = (float)sqrt(pow(ac.x - bc.x, 2) + pow(ac.y - bc.y, 2) + pow(ac.z - bc.z, 2));
+		if (distance <= a.getRadius() + b.getRadius())
+			found++;
+	}
+	return found;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+
+	scene::CSceneBuilder builder;
+	scene::generateRandomPacking(builder, count, 1);
+	std::vector<unsigned char> image;
+	builder.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size())) {
+		fprintf(stderr, "bad scene image\n");
+		return 1;
+	}
+	const scene::SceneHeader& h = sc.header();
+	const int n = (int)h.ballCount;
+
+	std::vector<float> x(n), z(n);
+	std::vector<NarrowBall> balls(n);
+	std::vector<CSphere> spheres(n);
+	for (int i = 0; i < n; i++) {
+		x[i] = sc.balls()[i].x * SQUEEZE;
+		z[i] = sc.balls()[i].z * SQUEEZE;
+		balls[i].x = x[i];
+		balls[i].z = z[i];
+		balls[i].radius = sc.ballRadius(i);
+		balls[i].reserved = 0;
+		spheres[i].setShape(sc.ballRadius(i), sc.ballMass(i));
+		spheres[i].setCenter(x[i], sc.ballRadius(i), z[i]);
+	}
+
+	// the slab stepper's sweep: slabs along x, z sweep within each
+	const float contact = 2 * scene::SCENE_BALL_RADIUS;
+	const float slabWidth = 2 * contact;
+	std::vector<int> order(n);
+	for (int i = 0; i < n; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		int sa = (int)((x[a] + h.tableHalfX) / slabWidth), sb = (int)((x[b] + h.tableHalfX) / slabWidth);
+		return sa < sb || (sa == sb && (z[a] < z[b] || (z[a] == z[b] && a < b)));
+	});
+	std::vector<int> pairs;
+	for (int p = 0; p < n; p++) {
+		int a = order[p];
+		int slab = (int)((x[a] + h.tableHalfX) / slabWidth);
+		for (int q = p + 1; q < n; q++) {
+			int b = order[q];
+			if ((int)((x[b] + h.tableHalfX) / slabWidth) != slab || z[b] - z[a] > contact)
+				break;
+			pairs.push_back(std::min(a, b));
+			pairs.push_back(std::max(a, b));
+		}
+	}
+	const size_t pairCount = pairs.size() / 2;
+
+	std::vector<NarrowContact> scalarContacts, batchContacts;
+	size_t perPairFound = 0;
+	double ms[3] = { 0, 0, 0 };
+	for (int r = 0; r < ROUNDS; r++) {
+		Clock::time_point t0 = Clock::now();
+		perPairFound = perPair(spheres, pairs);
+		ms[0] += msSince(t0);
+
+		scalarContacts.clear();
+		t0 = Clock::now();
+		narrowPhaseScalar(&balls[0], &pairs[0], pairCount, scalarContacts);
+		ms[1] += msSince(t0);
+
+		batchContacts.clear();
+		t0 = Clock::now();
+		narrowPhase(&balls[0], &pairs[0], pairCount, batchContacts);
+		ms[2] += msSince(t0);
+	}
+
+	bool same = scalarContacts.size() == batchContacts.size();
+	for (size_t k = 0; same && k < scalarContacts.size(); k++) {
+		const NarrowContact& s = scalarContacts[k];
+		const NarrowContact& b = batchContacts[k];
+		same = s.a == b.a && s.b == b.b && s.nx == b.nx && s.nz == b.nz;
+	}
+
+	const double perPairNs = 1e6 / ((double)ROUNDS * pairCount);
+#if defined(NARROW_PHASE_SSE2)
+	const char* path = "SSE2";
+#else
+	const char* path = "scalar";
+#endif
+	printf("%d balls, %zu candidate pairs, batched path %s\n", n, pairCount, path);
+	printf("per pair %.2f ns, scalar %.2f ns, batched %.2f ns per candidate\n",
+		ms[0] * perPairNs, ms[1] * perPairNs, ms[2] * perPairNs);
+	printf("contacts: per pair %zu, scalar %zu, batched %zu; batched normals %s\n",
+		perPairFound, scalarContacts.size(), batchContacts.size(), same ? "identical" : "DIFFER");
+	return 0;
+}
@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: numericPolicy.h
+//
+// Desc: Numeric policies for the templated table physics (tablePhysics.h).
+//       A policy names the scalar type and supplies the operations that are
+//       not plain +, -, < on it: multiply, divide, rounding down, sqrt and
+//       trig.
+//
+//       FloatPolicy  - float, the C runtime math functions
+//       FixedPolicy  - Q16.16 in an int. only integer operations, so results
+//                      are the same on every compiler and CPU
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __numericPolicyH__
+#define __numericPolicyH__
+
+#include <cmath>
+
+struct FloatPolicy
+{
+	typedef float Scalar;
+
+	static Scalar fromFloat(float f) { return f; }
+	static float  toFloat(Scalar a) { return a; }
+	static Scalar one(void) { return 1.0f; }
+
+	static Scalar mul(Scalar a, Scalar b) { return a * b; }
+	static Scalar div(Scalar a, Scalar b) { return a / b; }
+	static Scalar abs(Scalar a) { return a < 0 ? -a : a; }
+	static int    floorToInt(Scalar a) { return (int)::floorf(a); }
+	static Scalar sqrt(Scalar a) { return ::sqrtf(a); }
+	static Scalar atan2(Scalar y, Scalar x) { return ::atan2f(y, x); }
+	static void   sinCos(Scalar angle, Scalar& s, Scalar& c) { s = ::sinf(angle); c = ::cosf(angle); }
+};
+
+struct FixedPolicy
+{
+	typedef int Scalar;
+
+	enum { FRAC_BITS = 16, ONE = 1 << FRAC_BITS };
+
+	static const int FX_PI = 205887;			// pi in Q16.16
+	static const int FX_HALF_PI = 102944;
+
+	// float conversion happens only at the edges (scene load, mouse aim,
+	// drawing). inside the simulation everything stays integer.
+	static Scalar fromFloat(float f) { return (int)floor(f * (float)ONE + 0.5f); }
+	static float  toFloat(Scalar a) { return (float)a / (float)ONE; }
+	static Scalar one(void) { return ONE; }
+
+	static Scalar mul(Scalar a, Scalar b) { return (int)(((long long)a * b) >> FRAC_BITS); }
+	static Scalar div(Scalar a, Scalar b) { return (int)(((long long)a << FRAC_BITS) / b); }
+	static Scalar abs(Scalar a) { return a < 0 ? -a : a; }
+	static int    floorToInt(Scalar a) { return a >> FRAC_BITS; }	// arithmetic shift rounds down
+
+	// bit-by-bit integer square root of a << 16
+	static Scalar sqrt(Scalar a)
+	{
+		if (a <= 0)
+			return 0;
+		unsigned long long n = (unsigned long long)a << FRAC_BITS;
+		unsigned long long root = 0;
+		unsigned long long bit = 1ULL << 62;
+		while (bit > n)
+			bit >>= 2;
+		while (bit != 0) {
+			if (n >= root + bit) {
+				n -= root + bit;
+				root = (root >> 1) + bit;
+			}
+			else
+				root >>= 1;
+			bit >>= 2;
+		}
+		return (int)root;
+	}
+
+	// CORDIC, vectoring mode. result in [-FX_PI, FX_PI]
+	static Scalar atan2(Scalar y, Scalar x)
+	{
+		int offset = 0;
+		if (x < 0) {
+			offset = (y >= 0) ? FX_PI : -FX_PI;
+			x = -x;
+			y = -y;
+		}
+		int z = 0;
+		for (int i = 0; i < CORDIC_STEPS; i++) {
+			int dx = y >> i, dy = x >> i;
+			if (y > 0) { x += dx; y -= dy; z += atanTable(i); }
+			else       { x -= dx; y += dy; z -= atanTable(i); }
+		}
+		return z + offset;
+	}
+
+	// CORDIC, rotation mode
+	static void sinCos(Scalar angle, Scalar& s, Scalar& c)
+	{
+		while (angle > FX_PI)  angle -= 2 * FX_PI;
+		while (angle < -FX_PI) angle += 2 * FX_PI;
+
+		int sign = 1;
+		if (angle > FX_HALF_PI)       { angle -= FX_PI; sign = -1; }
+		else if (angle < -FX_HALF_PI) { angle += FX_PI; sign = -1; }
+
+		int x = CORDIC_GAIN, y = 0, z = angle;
+		for (int i = 0; i < CORDIC_STEPS; i++) {
+			int dx = y >> i, dy = x >> i;
+			if (z >= 0) { x -= dx; y += dy; z -= atanTable(i); }
+			else        { x += dx; y -= dy; z += atanTable(i); }
+		}
+		c = sign * x;
+		s = sign * y;
+	}
+
+private:
+	enum { CORDIC_STEPS = 16, CORDIC_GAIN = 39797 };	// 1 / prod(sqrt(1 + 2^-2i))
+
+	// atan(2^-i) in Q16.16
+	static int atanTable(int i)
+	{
+		static const int table[CORDIC_STEPS] = {
+			51472, 30386, 16055, 8150, 4091, 2047, 1024, 512,
+			256, 128, 64, 32, 16, 8, 4, 2
+		};
+		return table[i];
+	}
+};
+
+#endif // __numericPolicyH__
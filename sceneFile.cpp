@@ -0,0 +1,598 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: sceneFile.cpp
+//
+// Desc: Loading (memory mapped), writing and procedural generation of
+//       binary scene files.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "sceneFile.h"
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const unsigned int COLOR_WHITE   = 0xffffffff;
+	const unsigned int COLOR_RED     = 0xffff0000;
+	const unsigned int COLOR_YELLOW  = 0xffffff00;
+	const unsigned int COLOR_DARKRED = 0xffd70000;
+	const unsigned int COLOR_GRAY    = 0xff808080;
+
+	const float WALL_THICKNESS = 0.12f;
+	const float WALL_HEIGHT    = 0.3f;
+
+	// where the fields each version added start
+	const size_t HEADER_V1_SIZE = offsetof(scene::SceneHeader, outlineCount);
+	const size_t HEADER_V2_SIZE = offsetof(scene::SceneHeader, shapeCount);
+
+	size_t alignUp(size_t n) { return (n + 7) & ~(size_t)7; }
+
+	unsigned int ballColor(unsigned int type)
+	{
+		switch (type) {
+		case ENTITY_RED:    return COLOR_RED;
+		case ENTITY_YELLOW: return COLOR_YELLOW;
+		default:            return COLOR_WHITE;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// CSceneFile
+// -----------------------------------------------------------------------------
+
+scene::CSceneFile::CSceneFile(void)
+{
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+#else
+	m_file = -1;
+	m_mapped = false;
+#endif
+	m_data = NULL;
+	m_size = 0;
+	m_header = NULL;
+}
+
+scene::CSceneFile::~CSceneFile(void)
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool scene::CSceneFile::open(const char* path)
+{
+	close();
+
+	m_file = ::CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(m_file, &size) || size.QuadPart < (LONGLONG)HEADER_V1_SIZE) {
+		close();
+		return false;
+	}
+
+	m_mapping = ::CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == NULL) {
+		close();
+		return false;
+	}
+
+	m_data = (const unsigned char*)::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == NULL) {
+		close();
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+
+	if (!validate()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void scene::CSceneFile::close(void)
+{
+	if (m_mapping != NULL) {
+		if (m_data != NULL)
+			::UnmapViewOfFile(m_data);
+		::CloseHandle(m_mapping);
+		m_mapping = NULL;
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		::CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+	m_data = NULL;
+	m_size = 0;
+	m_header = NULL;
+}
+
+#else
+
+bool scene::CSceneFile::open(const char* path)
+{
+	close();
+
+	m_file = ::open(path, O_RDONLY);
+	if (m_file < 0)
+		return false;
+
+	struct stat st;
+	if (::fstat(m_file, &st) != 0 || st.st_size < (off_t)HEADER_V1_SIZE) {
+		close();
+		return false;
+	}
+
+	void* view = ::mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, m_file, 0);
+	if (view == MAP_FAILED) {
+		close();
+		return false;
+	}
+	m_data = (const unsigned char*)view;
+	m_size = (size_t)st.st_size;
+	m_mapped = true;
+
+	if (!validate()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void scene::CSceneFile::close(void)
+{
+	if (m_mapped) {
+		::munmap((void*)m_data, m_size);
+		m_mapped = false;
+	}
+	if (m_file >= 0) {
+		::close(m_file);
+		m_file = -1;
+	}
+	m_data = NULL;
+	m_size = 0;
+	m_header = NULL;
+}
+
+#endif
+
+bool scene::CSceneFile::openMemory(const void* data, size_t size)
+{
+	close();
+
+	// the header holds 64 bit offsets
+	if (data == NULL || size < HEADER_V1_SIZE || (uintptr_t)data % alignof(SceneHeader) != 0)
+		return false;
+
+	m_data = (const unsigned char*)data;
+	m_size = size;
+
+	if (!validate()) {
+		m_data = NULL;
+		m_size = 0;
+		return false;
+	}
+	return true;
+}
+
+// count records of size bytes at offset lie inside the file, on their
+// alignment. the sum is never formed, so a huge offset cannot wrap
+bool scene::CSceneFile::inFile(unsigned long long offset, unsigned int count, size_t size, size_t align) const
+{
+	if (offset % align != 0 || offset > m_size)
+		return false;
+	return (unsigned long long)count * size <= m_size - offset;
+}
+
+// the bounds and the ball types are checked, the rest of the records is
+// trusted
+bool scene::CSceneFile::validate(void)
+{
+	const SceneHeader* h = (const SceneHeader*)m_data;
+
+	if (h->magic != SCENE_MAGIC || h->version == 0 || h->version > SCENE_VERSION)
+		return false;
+	if (h->version < SCENE_VERSION) {
+		size_t headerSize = h->version == 1 ? HEADER_V1_SIZE : HEADER_V2_SIZE;
+		if (m_size < headerSize)
+			return false;
+		memset(&m_oldHeader, 0, sizeof(m_oldHeader));
+		memcpy(&m_oldHeader, m_data, headerSize);
+		h = &m_oldHeader;
+	}
+	else if (m_size < sizeof(SceneHeader))
+		return false;
+
+	if (!inFile(h->ballOffset, h->ballCount, sizeof(SceneBall), alignof(SceneBall)) ||
+		!inFile(h->wallOffset, h->wallCount, sizeof(SceneWall), alignof(SceneWall)) ||
+		!inFile(h->obstacleOffset, h->obstacleCount, sizeof(SceneObstacle), alignof(SceneObstacle)) ||
+		!inFile(h->outlineOffset, h->outlineCount, sizeof(SceneOutlinePoint), alignof(SceneOutlinePoint)) ||
+		!inFile(h->pocketOffset, h->pocketCount, sizeof(ScenePocket), alignof(ScenePocket)) ||
+		!inFile(h->shapeOffset, h->shapeCount, sizeof(SceneBallShape), alignof(SceneBallShape)))
+		return false;
+	if (h->shapeCount != 0 && h->shapeCount != h->ballCount)
+		return false;
+
+	// the game needs a cue ball, and the rule table is indexed by type
+	if (h->ballCount == 0 || h->cueIndex >= h->ballCount)
+		return false;
+	const SceneBall* b = (const SceneBall*)(m_data + h->ballOffset);
+	for (unsigned int i = 0; i < h->ballCount; i++)
+		if (b[i].type >= ENTITY_TYPE_COUNT)
+			return false;
+
+	m_header = h;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// CSceneBuilder
+// -----------------------------------------------------------------------------
+
+scene::CSceneBuilder::CSceneBuilder(void)
+{
+	m_halfX = 4.5f;
+	m_halfZ = 3.0f;
+	m_jawRadius = 0;
+	m_cueIndex = 0;
+}
+
+void scene::CSceneBuilder::setTable(float halfX, float halfZ)
+{
+	m_halfX = halfX;
+	m_halfZ = halfZ;
+}
+
+void scene::CSceneBuilder::addBall(float x, float z, unsigned int type, unsigned int color, float vx, float vz)
+{
+	SceneBall b;
+	b.x = x;	b.z = z;
+	b.vx = vx;	b.vz = vz;
+	b.type = type;
+	b.color = color;
+	m_balls.push_back(b);
+}
+
+void scene::CSceneBuilder::addWall(float x, float y, float z, float width, float height, float depth, unsigned int color)
+{
+	SceneWall w;
+	w.x = x;	w.y = y;	w.z = z;
+	w.width = width;	w.height = height;	w.depth = depth;
+	w.color = color;
+	w.reserved = 0;
+	m_walls.push_back(w);
+}
+
+void scene::CSceneBuilder::addObstacle(float x, float z, float radius, unsigned int color)
+{
+	SceneObstacle o;
+	o.x = x;	o.z = z;
+	o.radius = radius;
+	o.color = color;
+	m_obstacles.push_back(o);
+}
+
+void scene::CSceneBuilder::addBorderWalls(unsigned int color)
+{
+	const float t = WALL_THICKNESS;
+	addWall(0.0f, 0.12f, m_halfZ + t / 2, 2 * m_halfX, WALL_HEIGHT, t, color);
+	addWall(0.0f, 0.12f, -m_halfZ - t / 2, 2 * m_halfX, WALL_HEIGHT, t, color);
+	addWall(m_halfX + t / 2, 0.12f, 0.0f, t, WALL_HEIGHT, 2 * m_halfZ + 2 * t, color);
+	addWall(-m_halfX - t / 2, 0.12f, 0.0f, t, WALL_HEIGHT, 2 * m_halfZ + 2 * t, color);
+}
+
+void scene::CSceneBuilder::addOutlinePoint(float x, float z)
+{
+	SceneOutlinePoint p;
+	p.x = x;	p.z = z;
+	m_outline.push_back(p);
+}
+
+void scene::CSceneBuilder::addPocket(float x, float z, float radius)
+{
+	ScenePocket p;
+	p.x = x;	p.z = z;
+	p.radius = radius;
+	p.reserved = 0;
+	m_pockets.push_back(p);
+}
+
+void scene::CSceneBuilder::setBallShape(unsigned int index, float radius, float mass)
+{
+	SceneBallShape standard = { SCENE_BALL_RADIUS, 1.0f };
+	if (m_shapes.size() <= index)
+		m_shapes.resize(index + 1, standard);
+	m_shapes[index].radius = radius;
+	m_shapes[index].mass = mass;
+}
+
+void scene::CSceneBuilder::addPockets(float pocketRadius, float jawRadius)
+{
+	const float hx = m_halfX, hz = m_halfZ;
+	m_outline.clear();
+	addOutlinePoint(-hx, -hz);
+	addOutlinePoint(hx, -hz);
+	addOutlinePoint(hx, hz);
+	addOutlinePoint(-hx, hz);
+
+	m_pockets.clear();
+	addPocket(-hx, -hz, pocketRadius);
+	addPocket(0.0f, -hz, pocketRadius);
+	addPocket(hx, -hz, pocketRadius);
+	addPocket(-hx, hz, pocketRadius);
+	addPocket(0.0f, hz, pocketRadius);
+	addPocket(hx, hz, pocketRadius);
+
+	m_jawRadius = jawRadius;
+	m_halfX = hx + pocketRadius;
+	m_halfZ = hz + pocketRadius;
+}
+
+void scene::CSceneBuilder::build(std::vector<unsigned char>& image) const
+{
+	SceneHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = SCENE_MAGIC;
+	h.version = SCENE_VERSION;
+	h.ballCount = (unsigned int)m_balls.size();
+	h.wallCount = (unsigned int)m_walls.size();
+	h.obstacleCount = (unsigned int)m_obstacles.size();
+	h.cueIndex = m_cueIndex;
+	h.tableHalfX = m_halfX;
+	h.tableHalfZ = m_halfZ;
+	h.outlineCount = (unsigned int)m_outline.size();
+	h.pocketCount = (unsigned int)m_pockets.size();
+	h.jawRadius = m_jawRadius;
+
+	// shapes go in for every ball or none
+	std::vector<SceneBallShape> shapes(m_shapes);
+	if (!shapes.empty()) {
+		SceneBallShape standard = { SCENE_BALL_RADIUS, 1.0f };
+		shapes.resize(m_balls.size(), standard);
+	}
+	h.shapeCount = (unsigned int)shapes.size();
+
+	size_t offset = alignUp(sizeof(SceneHeader));
+	h.ballOffset = offset;
+	offset = alignUp(offset + m_balls.size() * sizeof(SceneBall));
+	h.wallOffset = offset;
+	offset = alignUp(offset + m_walls.size() * sizeof(SceneWall));
+	h.obstacleOffset = offset;
+	offset = alignUp(offset + m_obstacles.size() * sizeof(SceneObstacle));
+	h.outlineOffset = offset;
+	offset = alignUp(offset + m_outline.size() * sizeof(SceneOutlinePoint));
+	h.pocketOffset = offset;
+	offset = alignUp(offset + m_pockets.size() * sizeof(ScenePocket));
+	h.shapeOffset = offset;
+	offset = alignUp(offset + shapes.size() * sizeof(SceneBallShape));
+
+	image.assign(offset, 0);
+	memcpy(&image[0], &h, sizeof(h));
+	if (!m_balls.empty())
+		memcpy(&image[(size_t)h.ballOffset], &m_balls[0], m_balls.size() * sizeof(SceneBall));
+	if (!m_walls.empty())
+		memcpy(&image[(size_t)h.wallOffset], &m_walls[0], m_walls.size() * sizeof(SceneWall));
+	if (!m_obstacles.empty())
+		memcpy(&image[(size_t)h.obstacleOffset], &m_obstacles[0], m_obstacles.size() * sizeof(SceneObstacle));
+	if (!m_outline.empty())
+		memcpy(&image[(size_t)h.outlineOffset], &m_outline[0], m_outline.size() * sizeof(SceneOutlinePoint));
+	if (!m_pockets.empty())
+		memcpy(&image[(size_t)h.pocketOffset], &m_pockets[0], m_pockets.size() * sizeof(ScenePocket));
+	if (!shapes.empty())
+		memcpy(&image[(size_t)h.shapeOffset], &shapes[0], shapes.size() * sizeof(SceneBallShape));
+}
+
+bool scene::CSceneBuilder::write(const char* path) const
+{
+	std::vector<unsigned char> image;
+	build(image);
+
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+		return false;
+	size_t written = fwrite(&image[0], 1, image.size(), fp);
+	fclose(fp);
+	return written == image.size();
+}
+
+// -----------------------------------------------------------------------------
+// Generators
+// -----------------------------------------------------------------------------
+
+// square grid with small random velocities so that every ball moves
+void scene::generateGrid(CSceneBuilder& b, unsigned int count, unsigned int seed)
+{
+	CRandom rng(seed);
+	const float spacing = SCENE_BALL_RADIUS * 2.5f;
+	unsigned int side = (unsigned int)ceil(sqrt((double)count));
+	float half = side * spacing / 2 + SCENE_BALL_RADIUS;
+
+	b.setTable(half, half);
+	b.setCue(0);
+	for (unsigned int i = 0; i < count; i++) {
+		float x = -half + SCENE_BALL_RADIUS + spacing / 2 + (i % side) * spacing;
+		float z = -half + SCENE_BALL_RADIUS + spacing / 2 + (i / side) * spacing;
+		unsigned int type = (i == 0) ? ENTITY_WHITE : (rng.next() & 1) ? ENTITY_RED : ENTITY_YELLOW;
+		b.addBall(x, z, type, ballColor(type), rng.range(-1.0f, 1.0f), rng.range(-1.0f, 1.0f));
+	}
+	b.addBorderWalls(COLOR_DARKRED);
+}
+
+// triangular rack of yellow balls with the cue ball behind it
+void scene::generateRack(CSceneBuilder& b, unsigned int rows, unsigned int seed)
+{
+	CRandom rng(seed);
+	const float d = SCENE_BALL_RADIUS * 2.0f * 1.001f;
+	const float rowStep = d * 0.8660254f;		// sqrt(3)/2
+	float halfZ = rows * d / 2 + 4 * SCENE_BALL_RADIUS;
+	float halfX = rows * rowStep + 4.0f;
+	if (halfZ < 3.0f)
+		halfZ = 3.0f;
+
+	b.setTable(halfX, halfZ);
+	b.addBall(-halfX + 1.0f, 0.0f, ENTITY_WHITE, COLOR_WHITE);
+	b.setCue(0);
+	for (unsigned int r = 0; r < rows; r++) {
+		float x = r * rowStep;
+		for (unsigned int k = 0; k <= r; k++) {
+			float z = (k - r / 2.0f) * d;
+			unsigned int type = (rng.next() % 8 == 0) ? ENTITY_RED : ENTITY_YELLOW;
+			b.addBall(x, z, type, ballColor(type));
+		}
+	}
+	b.addBorderWalls(COLOR_DARKRED);
+}
+
+// non-overlapping random placement at roughly 30% area coverage.
+// an occupancy grid with one ball per cell keeps placement linear.
+void scene::generateRandomPacking(CSceneBuilder& b, unsigned int count, unsigned int seed)
+{
+	CRandom rng(seed);
+	const float r = SCENE_BALL_RADIUS;
+	const float cell = 2 * r;
+	float area = count * 3.14159265f * r * r / 0.3f;
+	float half = (float)sqrt(area) / 2 + 2 * r;
+	int cells = (int)(2 * half / cell) + 1;
+
+	std::vector<int> grid((size_t)cells * cells, -1);
+	std::vector<float> pos;
+	pos.reserve((size_t)count * 2);
+
+	// a post in the middle of large tables; nothing is placed on top of it
+	const float postRadius = 4 * r;
+	const bool post = count > 64;
+	if (post)
+		b.addObstacle(0.0f, 0.0f, postRadius, COLOR_GRAY);
+
+	b.setTable(half, half);
+	b.setCue(0);
+	unsigned int placed = 0;
+	for (unsigned int attempt = 0; placed < count && attempt < count * 20u; attempt++) {
+		float x = rng.range(-half + r, half - r);
+		float z = rng.range(-half + r, half - r);
+		int cx = (int)((x + half) / cell);
+		int cz = (int)((z + half) / cell);
+		if (grid[(size_t)cz * cells + cx] >= 0)
+			continue;
+		if (post && x * x + z * z < (postRadius + r) * (postRadius + r))
+			continue;
+
+		bool overlap = false;
+		for (int gz = cz - 1; gz <= cz + 1 && !overlap; gz++) {
+			for (int gx = cx - 1; gx <= cx + 1 && !overlap; gx++) {
+				if (gx < 0 || gz < 0 || gx >= cells || gz >= cells)
+					continue;
+				int other = grid[(size_t)gz * cells + gx];
+				if (other < 0)
+					continue;
+				float dx = pos[other * 2] - x;
+				float dz = pos[other * 2 + 1] - z;
+				overlap = dx * dx + dz * dz < cell * cell;
+			}
+		}
+		if (overlap)
+			continue;
+
+		grid[(size_t)cz * cells + cx] = (int)placed;
+		pos.push_back(x);
+		pos.push_back(z);
+		unsigned int type = (placed == 0) ? ENTITY_WHITE : (rng.next() & 1) ? ENTITY_RED : ENTITY_YELLOW;
+		b.addBall(x, z, type, ballColor(type));
+		placed++;
+	}
+	b.addBorderWalls(COLOR_DARKRED);
+}
+
+// balls of three sizes with weight growing as the cube of the radius:
+// pellets a quarter of a ball across, standard balls and heavy balls twice
+// the size, among obstacles eight times the size. placement checks the
+// obstacles directly and the other balls through a grid of cells as wide
+// as a heavy ball, a list of balls per cell.
+void scene::generateMixedSizes(CSceneBuilder& b, unsigned int count, unsigned int seed)
+{
+	CRandom rng(seed);
+	const float r = SCENE_BALL_RADIUS;
+	const float pellet = r / 4, heavy = 2 * r, post = 8 * r;
+	const float cell = 2 * heavy;
+
+	// about a quarter of the area covered at 60% pellets, 35% standard, 5% heavy
+	float meanArea = 3.14159265f * (0.6f * pellet * pellet + 0.35f * r * r + 0.05f * heavy * heavy);
+	unsigned int posts = count / 4096 + 1;
+	if (posts > 64)
+		posts = 64;
+	float area = count * meanArea / 0.25f + posts * 3.14159265f * post * post;
+	float half = (float)sqrt(area) / 2 + 2 * heavy;
+	int cells = (int)(2 * half / cell) + 1;
+
+	b.setTable(half, half);
+	b.setCue(0);
+
+	std::vector<float> postPos;
+	for (unsigned int k = 0; k < posts; k++) {
+		float x = rng.range(-half + 2 * post, half - 2 * post);
+		float z = rng.range(-half + 2 * post, half - 2 * post);
+		b.addObstacle(x, z, post, COLOR_GRAY);
+		postPos.push_back(x);
+		postPos.push_back(z);
+	}
+
+	std::vector<std::vector<int> > grid((size_t)cells * cells);
+	std::vector<float> pos;			// x, z, radius per placed ball
+	pos.reserve((size_t)count * 3);
+	unsigned int placed = 0;
+	for (unsigned int attempt = 0; placed < count && attempt < count * 20u; attempt++) {
+		unsigned int pick = rng.next() % 100;
+		float radius = placed == 0 || (pick >= 60 && pick < 95) ? r : pick < 60 ? pellet : heavy;
+		float x = rng.range(-half + radius, half - radius);
+		float z = rng.range(-half + radius, half - radius);
+
+		bool overlap = false;
+		for (unsigned int k = 0; k < posts && !overlap; k++) {
+			float dx = postPos[k * 2] - x, dz = postPos[k * 2 + 1] - z;
+			overlap = dx * dx + dz * dz < (post + radius) * (post + radius);
+		}
+		int cx = (int)((x + half) / cell);
+		int cz = (int)((z + half) / cell);
+		for (int gz = cz - 1; gz <= cz + 1 && !overlap; gz++) {
+			for (int gx = cx - 1; gx <= cx + 1 && !overlap; gx++) {
+				if (gx < 0 || gz < 0 || gx >= cells || gz >= cells)
+					continue;
+				const std::vector<int>& list = grid[(size_t)gz * cells + gx];
+				for (size_t k = 0; k < list.size() && !overlap; k++) {
+					const float* o = &pos[(size_t)list[k] * 3];
+					float dx = o[0] - x, dz = o[1] - z;
+					overlap = dx * dx + dz * dz < (o[2] + radius) * (o[2] + radius);
+				}
+			}
+		}
+		if (overlap)
+			continue;
+
+		grid[(size_t)cz * cells + cx].push_back((int)placed);
+		pos.push_back(x);
+		pos.push_back(z);
+		pos.push_back(radius);
+		unsigned int type = (placed == 0) ? ENTITY_WHITE : (rng.next() & 1) ? ENTITY_RED : ENTITY_YELLOW;
+		float scale = radius / r;
+		b.addBall(x, z, type, ballColor(type), rng.range(-1.0f, 1.0f), rng.range(-1.0f, 1.0f));
+		b.setBallShape(placed, radius, scale * scale * scale);
+		placed++;
+	}
+	b.addBorderWalls(COLOR_DARKRED);
+}
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: sceneFile.h
+//
+// Desc: Binary scene format for Virtual Billiard (balls, walls, obstacles,
+//       cushion outline, pockets and ball sizes).
+//       The file is a fixed header followed by arrays of fixed-size records,
+//       so a loaded scene is just a mapped view of the file: nothing is
+//       parsed, the record arrays are used in place. The records are in
+//       sceneTypes.h; the view is MapViewOfFile on Windows, mmap elsewhere.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __sceneFileH__
+#define __sceneFileH__
+
+#include "sceneTypes.h"
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <cstddef>
+#include <vector>
+
+namespace scene
+{
+	//
+	// Read side: a read-only mapped scene
+	//
+
+	class CSceneFile
+	{
+	public:
+		CSceneFile(void);
+		~CSceneFile(void);
+
+		bool open(const char* path);					// map a file
+		bool openMemory(const void* data, size_t size);	// use an image already in memory
+		void close(void);
+
+		const SceneHeader&   header(void)    const { return *m_header; }
+		const SceneBall*     balls(void)     const { return (const SceneBall*)(m_data + m_header->ballOffset); }
+		const SceneWall*     walls(void)     const { return (const SceneWall*)(m_data + m_header->wallOffset); }
+		const SceneObstacle* obstacles(void) const { return (const SceneObstacle*)(m_data + m_header->obstacleOffset); }
+		const SceneOutlinePoint* outline(void) const { return (const SceneOutlinePoint*)(m_data + m_header->outlineOffset); }
+		const ScenePocket*   pockets(void)   const { return (const ScenePocket*)(m_data + m_header->pocketOffset); }
+		const SceneBallShape* shapes(void)   const { return (const SceneBallShape*)(m_data + m_header->shapeOffset); }
+
+		// ball i, standard size when the scene has no shapes
+		float ballRadius(unsigned int i) const { return m_header->shapeCount ? shapes()[i].radius : SCENE_BALL_RADIUS; }
+		float ballMass(unsigned int i) const { return m_header->shapeCount ? shapes()[i].mass : 1.0f; }
+
+	private:
+		bool inFile(unsigned long long offset, unsigned int count, size_t size, size_t align) const;
+		bool validate(void);
+
+#ifdef _WIN32
+		HANDLE               m_file;
+		HANDLE               m_mapping;
+#else
+		int                  m_file;			// descriptor, -1 when closed
+		bool                 m_mapped;			// m_data is an mmap of m_size bytes
+#endif
+		const unsigned char* m_data;
+		size_t               m_size;
+		const SceneHeader*   m_header;
+		SceneHeader          m_oldHeader;		// an older header with the newer fields zeroed
+	};
+
+	//
+	// Write side: collects records and lays them out in the file format
+	//
+
+	class CSceneBuilder
+	{
+	public:
+		CSceneBuilder(void);
+
+		void setTable(float halfX, float halfZ);
+		void setCue(unsigned int index) { m_cueIndex = index; }
+		void addBall(float x, float z, unsigned int type, unsigned int color, float vx = 0, float vz = 0);
+		void addWall(float x, float y, float z, float width, float height, float depth, unsigned int color);
+		void addObstacle(float x, float z, float radius, unsigned int color);
+		void addBorderWalls(unsigned int color);		// four cushions around the table
+		void addOutlinePoint(float x, float z);
+		void addPocket(float x, float z, float radius);
+		void setJawRadius(float radius) { m_jawRadius = radius; }
+		void setBallShape(unsigned int index, float radius, float mass);
+
+		// the table edge becomes the outline, with pockets in the corners
+		// and halfway along the long sides. the table grows by the pocket
+		// radius so that balls can drop in
+		void addPockets(float pocketRadius, float jawRadius);
+
+		size_t ballCount(void) const { return m_balls.size(); }
+
+		void build(std::vector<unsigned char>& image) const;
+		bool write(const char* path) const;
+
+	private:
+		float                      m_halfX, m_halfZ;
+		float                      m_jawRadius;
+		unsigned int               m_cueIndex;
+		std::vector<SceneBall>     m_balls;
+		std::vector<SceneWall>     m_walls;
+		std::vector<SceneObstacle> m_obstacles;
+		std::vector<SceneOutlinePoint> m_outline;
+		std::vector<ScenePocket>   m_pockets;
+		std::vector<SceneBallShape> m_shapes;		// empty until a ball gets a shape
+	};
+
+	// xorshift32. rand() differs between C runtimes, this does not. the
+	// generators below and the headless tools draw from it
+	class CRandom
+	{
+	public:
+		CRandom(unsigned int seed) : m_state(seed ? seed : 0x9e3779b9) {}
+
+		unsigned int next(void)
+		{
+			m_state ^= m_state << 13;
+			m_state ^= m_state >> 17;
+			m_state ^= m_state << 5;
+			return m_state;
+		}
+
+		// uniform in [0, 1) and in [lo, hi)
+		float unit(void) { return (float)(next() >> 8) / 16777216.0f; }
+		float range(float lo, float hi) { return lo + (hi - lo) * (float)(next() >> 8) / 16777216.0f; }
+
+	private:
+		unsigned int m_state;
+	};
+
+	//
+	// Procedural scenes. the same seed always gives the same scene.
+	//
+
+	void generateGrid(CSceneBuilder& b, unsigned int count, unsigned int seed);
+	void generateRack(CSceneBuilder& b, unsigned int rows, unsigned int seed);
+	void generateRandomPacking(CSceneBuilder& b, unsigned int count, unsigned int seed);
+	void generateMixedSizes(CSceneBuilder& b, unsigned int count, unsigned int seed);
+}
+
+#endif // __sceneFileH__
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: sceneGen.cpp
+//
+// Desc: Command line generator for benchmark scenes.
+//
+//       sceneGen grid   <balls> <seed> <out.scene> [pockets]
+//       sceneGen rack   <rows>  <seed> <out.scene> [pockets]
+//       sceneGen random <balls> <seed> <out.scene> [pockets]
+//       sceneGen mixed  <balls> <seed> <out.scene> [pockets]
+//
+//       The same arguments always produce the same file. "mixed" has pellets,
+//       standard and heavy balls and large obstacles. "pockets" cuts six
+//       pockets into the cushions. After writing, the file is mapped again
+//       and the load time is printed.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "sceneFile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+static const float POCKET_RADIUS = 2 * scene::SCENE_BALL_RADIUS;
+static const float JAW_RADIUS = scene::SCENE_BALL_RADIUS / 2;
+
+static double elapsedMs(std::chrono::steady_clock::time_point since)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 5 && !(argc == 6 && strcmp(argv[5], "pockets") == 0)) {
+		fprintf(stderr, "usage: %s <grid|rack|random|mixed> <count> <seed> <out.scene> [pockets]\n", argv[0]);
+		return 1;
+	}
+
+	const char* kind = argv[1];
+	unsigned int count = (unsigned int)strtoul(argv[2], NULL, 10);
+	unsigned int seed = (unsigned int)strtoul(argv[3], NULL, 10);
+	const char* path = argv[4];
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	scene::CSceneBuilder b;
+	if (strcmp(kind, "grid") == 0)
+		scene::generateGrid(b, count, seed);
+	else if (strcmp(kind, "rack") == 0)
+		scene::generateRack(b, count, seed);
+	else if (strcmp(kind, "random") == 0)
+		scene::generateRandomPacking(b, count, seed);
+	else if (strcmp(kind, "mixed") == 0)
+		scene::generateMixedSizes(b, count, seed);
+	else {
+		fprintf(stderr, "unknown scene kind '%s'\n", kind);
+		return 1;
+	}
+	if (argc == 6)
+		b.addPockets(POCKET_RADIUS, JAW_RADIUS);
+	double genMs = elapsedMs(start);
+
+	if (!b.write(path)) {
+		fprintf(stderr, "cannot write '%s'\n", path);
+		return 1;
+	}
+
+	start = std::chrono::steady_clock::now();
+	scene::CSceneFile sc;
+	if (!sc.open(path)) {
+		fprintf(stderr, "cannot map '%s'\n", path);
+		return 1;
+	}
+	double loadMs = elapsedMs(start);
+
+	const scene::SceneHeader& h = sc.header();
+	printf("%s: %u balls, %u walls, %u obstacles, %u pockets, table %.2f x %.2f\n",
+		path, h.ballCount, h.wallCount, h.obstacleCount, h.pocketCount, 2 * h.tableHalfX, 2 * h.tableHalfZ);
+	printf("generate %.2f ms, map %.3f ms\n", genMs, loadMs);
+	return 0;
+}
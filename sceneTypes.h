@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: sceneTypes.h
+//
+// Desc: Entity types and the on-disk records of the binary scene format.
+//       Plain structs only, no platform headers, so the physics and the
+//       headless tools can use them on any host. Mapping a file is in
+//       sceneFile.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __sceneTypesH__
+#define __sceneTypesH__
+
+// entity type ids stored with each ball. game rules are looked up by these,
+// never by material color
+enum EntityType {
+	ENTITY_RED = 0,
+	ENTITY_YELLOW,
+	ENTITY_WHITE,
+	ENTITY_TARGET,
+	ENTITY_OBSTACLE,
+	ENTITY_TYPE_COUNT
+};
+
+namespace scene
+{
+	const unsigned int SCENE_MAGIC   = 0x4e435342;	// "BSCN"
+	const unsigned int SCENE_VERSION = 3;			// 3 added ball sizes, 2 the outline and pockets; older still load
+
+	const float SCENE_BALL_RADIUS = 0.21f;			// same as M_RADIUS
+
+	//
+	// On-disk records. all little endian, 4 byte aligned, no pointers.
+	//
+
+	struct SceneHeader
+	{
+		unsigned int       magic;
+		unsigned int       version;
+		unsigned int       ballCount;
+		unsigned int       wallCount;
+		unsigned int       obstacleCount;
+		unsigned int       cueIndex;			// index of the cue ball in the ball array
+		float              tableHalfX;			// playing area is [-halfX, halfX] x [-halfZ, halfZ]
+		float              tableHalfZ;
+		unsigned long long ballOffset;			// byte offsets from the start of the file
+		unsigned long long wallOffset;
+		unsigned long long obstacleOffset;
+
+		// version 2. a version 1 file reads as if these were all zero
+		unsigned int       outlineCount;		// cushion polygon; 0 keeps the halfX, halfZ rectangle
+		unsigned int       pocketCount;
+		float              jawRadius;			// rounding where a pocket cuts the outline
+		unsigned int       reserved;
+		unsigned long long outlineOffset;
+		unsigned long long pocketOffset;
+
+		// version 3
+		unsigned int       shapeCount;			// 0 (every ball standard) or ballCount
+		unsigned int       reserved2;
+		unsigned long long shapeOffset;
+	};
+
+	struct SceneBall
+	{
+		float        x, z;
+		float        vx, vz;
+		unsigned int type;						// EntityType
+		unsigned int color;						// D3DCOLOR
+	};
+
+	struct SceneWall
+	{
+		float        x, y, z;
+		float        width, height, depth;
+		unsigned int color;
+		unsigned int reserved;
+	};
+
+	struct SceneObstacle
+	{
+		float        x, z;
+		float        radius;
+		unsigned int color;
+	};
+
+	// size and weight of the ball with the same index. a scene without
+	// them has SCENE_BALL_RADIUS and mass 1 everywhere
+	struct SceneBallShape
+	{
+		float        radius;
+		float        mass;
+	};
+
+	// cushion line, one corner of a closed polygon. a ball's centre stays
+	// one radius inside it
+	struct SceneOutlinePoint
+	{
+		float        x, z;
+	};
+
+	// a ball whose centre is inside the circle and past the cushion line
+	// has dropped in
+	struct ScenePocket
+	{
+		float        x, z;
+		float        radius;
+		unsigned int reserved;
+	};
+}
+
+#endif // __sceneTypesH__
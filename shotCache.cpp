@@ -0,0 +1,200 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotCache.cpp
+//
+// Desc: Transposition table for shot outcomes.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "shotCache.h"
+#include <cmath>
+#include <cstring>
+#include <chrono>
+
+namespace
+{
+	const float SHOT_TICK = 0.005f;				// same tick as the game's fixed mode
+	const unsigned int SHOT_MAX_TICKS = 20000;
+
+	inline void mix(unsigned long long& h, unsigned int v)
+	{
+		h = (h ^ v) * 0x100000001b3ULL;		// FNV-1a, one word at a time
+	}
+}
+
+CShotCache::CShotCache(unsigned int ballCount, size_t maxBytes)
+	: m_slots(0), m_hands(0)
+{
+	m_ballCount = ballCount;
+	m_maskWords = (ballCount + 31) / 32;
+	m_payloadInts = 2 * (size_t)ballCount + m_maskWords;
+
+	// largest power of two bucket count that fits
+	size_t bucketBytes = SHOT_CACHE_WAYS * (sizeof(Slot) + m_payloadInts * sizeof(int)) + 1;
+	size_t buckets = 1;
+	while (buckets * 2 * bucketBytes <= maxBytes)
+		buckets *= 2;
+	m_bucketMask = buckets - 1;
+
+	m_slots = std::vector<Slot>(buckets * SHOT_CACHE_WAYS);
+	m_payload.assign(m_slots.size() * m_payloadInts, 0);
+	m_hands = std::vector<std::atomic<unsigned char> >(buckets);
+
+	for (size_t i = 0; i < m_slots.size(); i++) {
+		m_slots[i].version.store(0);
+		m_slots[i].referenced.store(0);
+		m_slots[i].key.store(0);
+		m_slots[i].ticks.store(0);
+		m_slots[i].costUs.store(0);
+	}
+	for (size_t i = 0; i < buckets; i++)
+		m_hands[i].store(0);
+
+	m_lookups = 0;
+	m_hits = 0;
+	m_inserts = 0;
+	m_evictions = 0;
+	m_insertsSkipped = 0;
+	m_savedUs = 0;
+}
+
+unsigned long long CShotCache::makeKey(const TBallSet<FixedPolicy>& b, int targetX, int targetZ)
+{
+	const int half = 1 << (SHOT_CACHE_POS_SHIFT - 1);
+	unsigned long long h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < b.size(); i++) {
+		if (!b.active[i]) {
+			mix(h, 0xffffffffu);
+			continue;
+		}
+		mix(h, (unsigned int)((b.x[i] + half) >> SHOT_CACHE_POS_SHIFT));
+		mix(h, (unsigned int)((b.z[i] + half) >> SHOT_CACHE_POS_SHIFT));
+	}
+	mix(h, (unsigned int)(int)floor(FixedPolicy::toFloat(targetX) / SHOT_CACHE_AIM_STEP + 0.5f));
+	mix(h, (unsigned int)(int)floor(FixedPolicy::toFloat(targetZ) / SHOT_CACHE_AIM_STEP + 0.5f));
+	return h != 0 ? h : 1;		// 0 marks an empty slot
+}
+
+bool CShotCache::lookup(unsigned long long key, ShotOutcome& out)
+{
+	m_lookups.fetch_add(1, std::memory_order_relaxed);
+
+	const size_t first = (size_t)(key & m_bucketMask) * SHOT_CACHE_WAYS;
+	for (unsigned int way = 0; way < SHOT_CACHE_WAYS; way++) {
+		Slot& s = m_slots[first + way];
+
+		unsigned int v1 = s.version.load(std::memory_order_acquire);
+		if ((v1 & 1) != 0 || s.key.load(std::memory_order_relaxed) != key)
+			continue;
+
+		// copy, then check that no writer came through meanwhile
+		const int* p = payload(first + way);
+		out.x.resize(m_ballCount);
+		out.z.resize(m_ballCount);
+		out.cleared.resize(m_maskWords);
+		memcpy(&out.x[0], p, m_ballCount * sizeof(int));
+		memcpy(&out.z[0], p + m_ballCount, m_ballCount * sizeof(int));
+		memcpy(&out.cleared[0], p + 2 * m_ballCount, m_maskWords * sizeof(unsigned int));
+		out.ticks = s.ticks.load(std::memory_order_relaxed);
+		float cost = s.costUs.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (s.version.load(std::memory_order_relaxed) != v1)
+			continue;
+
+		s.referenced.store(1, std::memory_order_relaxed);
+		out.fromCache = true;
+		m_hits.fetch_add(1, std::memory_order_relaxed);
+		m_savedUs.fetch_add((unsigned long long)cost, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+void CShotCache::insert(unsigned long long key, const ShotOutcome& outcome, float costUs)
+{
+	const size_t bucket = (size_t)(key & m_bucketMask);
+	const size_t first = bucket * SHOT_CACHE_WAYS;
+
+	// the same key or a free way first, otherwise the clock hand decides
+	size_t victim = (size_t)-1;
+	for (unsigned int way = 0; way < SHOT_CACHE_WAYS && victim == (size_t)-1; way++) {
+		unsigned long long k = m_slots[first + way].key.load(std::memory_order_relaxed);
+		if (k == key || k == 0)
+			victim = first + way;
+	}
+	for (unsigned int step = 0; step < 2 * SHOT_CACHE_WAYS && victim == (size_t)-1; step++) {
+		unsigned int way = m_hands[bucket].fetch_add(1, std::memory_order_relaxed) % SHOT_CACHE_WAYS;
+		if (m_slots[first + way].referenced.exchange(0, std::memory_order_relaxed) == 0)
+			victim = first + way;
+	}
+	if (victim == (size_t)-1)
+		victim = first + m_hands[bucket].load(std::memory_order_relaxed) % SHOT_CACHE_WAYS;
+
+	Slot& s = m_slots[victim];
+	unsigned int v = s.version.load(std::memory_order_relaxed);
+	if ((v & 1) != 0 || !s.version.compare_exchange_strong(v, v + 1, std::memory_order_acquire)) {
+		m_insertsSkipped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+
+	unsigned long long old = s.key.load(std::memory_order_relaxed);
+	if (old != 0 && old != key)
+		m_evictions.fetch_add(1, std::memory_order_relaxed);
+
+	int* p = payload(victim);
+	memcpy(p, &outcome.x[0], m_ballCount * sizeof(int));
+	memcpy(p + m_ballCount, &outcome.z[0], m_ballCount * sizeof(int));
+	memcpy(p + 2 * m_ballCount, &outcome.cleared[0], m_maskWords * sizeof(unsigned int));
+	s.key.store(key, std::memory_order_relaxed);
+	s.ticks.store(outcome.ticks, std::memory_order_relaxed);
+	s.costUs.store(costUs, std::memory_order_relaxed);
+	s.referenced.store(0, std::memory_order_relaxed);
+
+	s.version.store(v + 2, std::memory_order_release);
+	m_inserts.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CShotCache::getStats(ShotCacheStats& s) const
+{
+	s.lookups = m_lookups.load();
+	s.hits = m_hits.load();
+	s.inserts = m_inserts.load();
+	s.evictions = m_evictions.load();
+	s.insertsSkipped = m_insertsSkipped.load();
+	s.savedMs = m_savedUs.load() / 1000.0;
+}
+
+void evaluateShot(CShotCache* cache, const CTableInstance& start, int targetX, int targetZ,
+	CTableInstance& work, ShotOutcome& out)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	unsigned long long key = 0;
+	if (cache != NULL) {
+		key = CShotCache::makeKey(start.getBalls(), targetX, targetZ);
+		if (cache->lookup(key, out))
+			return;
+	}
+
+	Clock::time_point t0 = Clock::now();
+	work = start;
+	work.queueShot(targetX, targetZ);
+	out.ticks = work.runToRest(FixedPolicy::fromFloat(SHOT_TICK), SHOT_MAX_TICKS);
+
+	const TBallSet<FixedPolicy>& before = start.getBalls();
+	const TBallSet<FixedPolicy>& after = work.getBalls();
+	const size_t n = after.size();
+	out.x.assign(after.x.begin(), after.x.end());
+	out.z.assign(after.z.begin(), after.z.end());
+	out.cleared.assign((n + 31) / 32, 0);
+	for (size_t i = 0; i < n; i++) {
+		if (before.active[i] && !after.active[i])
+			out.cleared[i / 32] |= 1u << (i % 32);
+	}
+	out.fromCache = false;
+
+	if (cache != NULL)
+		cache->insert(key, out, std::chrono::duration<float, std::micro>(Clock::now() - t0).count());
+}
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotCache.h
+//
+// Desc: Transposition table for shot outcomes.
+//
+//       Shot search evaluates the same start state and aim again and again.
+//       CShotCache maps a key made from the quantized table state and the
+//       quantized aim to the outcome of the shot: resting positions, the
+//       balls it cleared and its length in ticks.
+//
+//       Ball positions are quantized to 1/1024 units and the aim to the
+//       0.007 unit step the blue target moves by, so states that differ
+//       below that share an entry. The key is a 64-bit hash. A collision
+//       would return another state's outcome; at 64 bits that is accepted.
+//
+//       The table is a fixed array of 4-way buckets. Each slot is guarded
+//       by a sequence number, odd while a writer is inside. Readers take no
+//       lock: they copy the slot and recheck the number, and a read that
+//       overlapped a write counts as a miss.
+//       A writer claims a slot with one compare-and-swap and gives up if
+//       another writer holds it. Eviction is CLOCK within the bucket: a hit
+//       sets the slot's reference bit, and the hand skips referenced slots
+//       once, clearing the bit as it goes.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __shotCacheH__
+#define __shotCacheH__
+
+#include "tableServer.h"
+#include <atomic>
+#include <vector>
+
+const unsigned int SHOT_CACHE_WAYS = 4;
+const float SHOT_CACHE_AIM_STEP = 0.007f;		// WM_MOUSEMOVE target step
+const int SHOT_CACHE_POS_SHIFT = 6;				// Q16.16 >> 6: 1/1024 units
+
+struct ShotOutcome
+{
+	std::vector<int>			x, z;			// resting positions, FixedPolicy
+	std::vector<unsigned int>	cleared;		// one bit per ball removed by the shot
+	unsigned int				ticks;
+	bool						fromCache;
+};
+
+struct ShotCacheStats
+{
+	unsigned long long	lookups;
+	unsigned long long	hits;
+	unsigned long long	inserts;
+	unsigned long long	evictions;
+	unsigned long long	insertsSkipped;		// slot held by another writer
+	double				savedMs;			// simulation time of the outcomes served from the cache
+};
+
+class CShotCache {
+public:
+	// the cache uses at most about maxBytes
+	CShotCache(unsigned int ballCount, size_t maxBytes);
+
+	static unsigned long long makeKey(const TBallSet<FixedPolicy>& b, int targetX, int targetZ);
+
+	bool lookup(unsigned long long key, ShotOutcome& out);
+	void insert(unsigned long long key, const ShotOutcome& outcome, float costUs);
+
+	void getStats(ShotCacheStats& s) const;
+	size_t getSlotCount(void) const { return m_slots.size(); }
+
+private:
+	CShotCache(const CShotCache&);
+	CShotCache& operator=(const CShotCache&);
+
+	struct Slot {
+		std::atomic<unsigned int>			version;	// odd while being written
+		std::atomic<unsigned char>			referenced;
+		std::atomic<unsigned long long>		key;		// 0: empty
+		std::atomic<unsigned int>			ticks;
+		std::atomic<float>					costUs;
+	};
+
+	int* payload(size_t slot) { return &m_payload[slot * m_payloadInts]; }
+
+	unsigned int						m_ballCount;
+	unsigned int						m_maskWords;
+	size_t								m_payloadInts;	// x, z, cleared mask
+	size_t								m_bucketMask;
+
+	std::vector<Slot>					m_slots;
+	std::vector<int>					m_payload;
+	std::vector<std::atomic<unsigned char> >	m_hands;	// clock hand per bucket
+
+	std::atomic<unsigned long long>		m_lookups;
+	std::atomic<unsigned long long>		m_hits;
+	std::atomic<unsigned long long>		m_inserts;
+	std::atomic<unsigned long long>		m_evictions;
+	std::atomic<unsigned long long>		m_insertsSkipped;
+	std::atomic<unsigned long long>		m_savedUs;
+};
+
+// evaluates one shot from start, through the cache when one is given.
+// work is scratch space the caller keeps, so repeated calls do not allocate.
+void evaluateShot(CShotCache* cache, const CTableInstance& start, int targetX, int targetZ,
+	CTableInstance& work, ShotOutcome& out);
+
+#endif // __shotCacheH__
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: shotCacheBench.cpp
+//
+// Desc: Shot search with and without CShotCache.
+//
+//       shotCacheBench <rounds> [cache KB] [threads] [rack rows]
+//
+//       A planner scores a grid of aims around every object ball, in
+//       parallel, and does it again each round the way an iterative search
+//       revisits its candidates. From the second round on every aim moves
+//       by less than one aim step, so it lands on the entry of the same
+//       candidate. The same rounds run once without the cache and once with
+//       it; a small cache size shows eviction at work.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "shotCache.h"
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+
+static const int GRID = 3;		// aims -GRID..GRID steps around each ball, per axis
+
+struct Candidate
+{
+	int			tx, tz;
+	ShotOutcome	outcome;
+};
+
+// runs every round; returns the wall time
+static double search(CWorkerPool& pool, CShotCache* cache, const CTableInstance& start,
+	std::vector<Candidate>& cand, std::vector<CTableInstance>& work, unsigned int rounds)
+{
+	typedef std::chrono::steady_clock Clock;
+	const int step = FixedPolicy::fromFloat(SHOT_CACHE_AIM_STEP);
+	scene::CRandom rng(11);
+	std::vector<int> jitter(cand.size() * 2);
+
+	Clock::time_point t0 = Clock::now();
+	for (unsigned int r = 0; r < rounds; r++) {
+		for (size_t i = 0; i < jitter.size(); i++)
+			jitter[i] = r == 0 ? 0 : (int)(rng.next() % (unsigned int)(step / 2)) - step / 4;
+
+		pool.parallelFor((int)cand.size(), [&](int i) {
+			Candidate& c = cand[i];
+			evaluateShot(cache, start, c.tx + jitter[2 * i], c.tz + jitter[2 * i + 1], work[i], c.outcome);
+		});
+	}
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <rounds> [cache KB] [threads] [rack rows]\n", argv[0]);
+		return 1;
+	}
+	unsigned int rounds = (unsigned int)atoi(argv[1]);
+	size_t cacheKB = argc > 2 ? (size_t)atoi(argv[2]) : 16384;
+	int threads = argc > 3 ? atoi(argv[3]) : -1;
+	unsigned int rows = argc > 4 ? (unsigned int)atoi(argv[4]) : 5;
+
+	scene::CSceneBuilder b;
+	scene::generateRack(b, rows, 1);
+	std::vector<unsigned char> image;
+	b.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size())) {
+		fprintf(stderr, "bad scene image\n");
+		return 1;
+	}
+
+	CTableInstance start;
+	start.load(sc);
+	const TBallSet<FixedPolicy>& balls = start.getBalls();
+	const int step = FixedPolicy::fromFloat(SHOT_CACHE_AIM_STEP);
+
+	std::vector<Candidate> cand;
+	for (size_t i = 0; i < balls.size(); i++) {
+		if (i == start.getCue() || !balls.active[i])
+			continue;
+		for (int gz = -GRID; gz <= GRID; gz++) {
+			for (int gx = -GRID; gx <= GRID; gx++) {
+				Candidate c;
+				c.tx = balls.x[i] + gx * step;
+				c.tz = balls.z[i] + gz * step;
+				c.outcome.ticks = 0;
+				c.outcome.fromCache = false;
+				cand.push_back(c);
+			}
+		}
+	}
+	std::vector<CTableInstance> work(cand.size(), start);
+
+	CWorkerPool pool(threads);
+	double plainMs = search(pool, NULL, start, cand, work, rounds);
+
+	CShotCache cache((unsigned int)balls.size(), cacheKB * 1024);
+	double cachedMs = search(pool, &cache, start, cand, work, rounds);
+
+	ShotCacheStats s;
+	cache.getStats(s);
+	printf("%u candidates x %u rounds on %d threads, cache %u slots\n",
+		(unsigned int)cand.size(), rounds, pool.getThreadCount() + 1, (unsigned int)cache.getSlotCount());
+	printf("no cache %.1f ms, cache %.1f ms (%.1fx)\n", plainMs, cachedMs, plainMs / cachedMs);
+	printf("lookups %llu, hits %llu (%.1f%%), inserts %llu, evictions %llu, skipped %llu\n",
+		s.lookups, s.hits, s.lookups ? 100.0 * s.hits / s.lookups : 0.0, s.inserts, s.evictions, s.insertsSkipped);
+	printf("simulation saved %.1f ms\n", s.savedMs);
+	return 0;
+}
@@ -0,0 +1,389 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: slabStepper.cpp
+//
+// Desc: Multi-threaded physics step over spatial slabs.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "slabStepper.h"
+#include "tablePhysics.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const int   BALLS_PER_TASK = 4096;				// integration work item
+	const int   MAX_SLABS = 1024;
+	const float CONTACT_DIST = (float)(2 * M_RADIUS);
+	const float MIN_SLAB_WIDTH = 2 * CONTACT_DIST;	// ghost zone must stay inside the next slab
+
+	void fillNarrowBall(NarrowBall& nb, const CSphere& ball)
+	{
+		D3DXVECTOR3 c = ball.getCenter();
+		nb.x = c.x;
+		nb.z = c.z;
+		nb.radius = ball.getRadius();
+		nb.reserved = 0;
+	}
+}
+
+CSlabStepper::CSlabStepper(CWorkerPool& pool)
+	: m_pool(pool)
+{
+	m_halfX = 0;
+	m_slabCount = 0;
+	m_slabWidth = 0;
+	m_maxSubsteps = MAX_SUBSTEPS;
+	m_lastSubsteps = 1;
+	memset(&m_lastStats, 0, sizeof(m_lastStats));
+}
+
+void CSlabStepper::layoutSlabs(void)
+{
+	m_halfX = g_tableHalfX;
+	m_slabCount = (int)(2 * m_halfX / MIN_SLAB_WIDTH);
+	if (m_slabCount < 1)
+		m_slabCount = 1;
+	if (m_slabCount > MAX_SLABS)
+		m_slabCount = MAX_SLABS;
+	m_slabWidth = 2 * m_halfX / m_slabCount;
+
+	m_slabStart.assign(m_slabCount + 1, 0);
+	m_sweep.resize(m_slabCount);
+	m_candidates.resize(m_slabCount);
+	m_contacts.resize(m_slabCount);
+	m_slabEvents.resize(m_slabCount);
+	m_eventStart.resize(m_slabCount);
+}
+
+// balls migrate between slabs here: membership is rebuilt from the new
+// positions every tick. each task counts its balls per slab, and a slab
+// lists the balls of task 0 first, so members come in index order whatever
+// thread ran which task
+void CSlabStepper::binBalls(std::vector<CSphere>& balls)
+{
+	const int n = (int)balls.size();
+	const int slabs = m_slabCount;
+	const int tasks = (n + BALLS_PER_TASK - 1) / BALLS_PER_TASK;
+	m_ballSlab.resize(n);
+	m_ballZ.resize(n);
+	m_narrowBalls.resize(n);
+	m_binFill.resize((size_t)tasks * slabs);
+	m_taskObstacles.resize(tasks);
+
+	m_pool.parallelFor(tasks, [&](int t) {
+		int* count = &m_binFill[(size_t)t * slabs];
+		std::fill(count, count + slabs, 0);
+		std::vector<int>& obstacles = m_taskObstacles[t];
+		obstacles.clear();
+		int end = std::min(n, (t + 1) * BALLS_PER_TASK);
+		for (int i = t * BALLS_PER_TASK; i < end; i++) {
+			if (!balls[i].isActive()) {
+				m_ballSlab[i] = -1;
+				continue;
+			}
+			if (balls[i].isStatic()) {
+				m_ballSlab[i] = -1;
+				fillNarrowBall(m_narrowBalls[i], balls[i]);
+				obstacles.push_back(i);
+				continue;
+			}
+			D3DXVECTOR3 c = balls[i].getCenter();
+			int s = (int)((c.x + m_halfX) / m_slabWidth);
+			s = s < 0 ? 0 : (s >= slabs ? slabs - 1 : s);
+			m_ballSlab[i] = s;
+			m_ballZ[i] = c.z;
+			fillNarrowBall(m_narrowBalls[i], balls[i]);
+			count[s]++;
+		}
+	});
+
+	// slab sizes, where each slab starts, then where each task writes in it
+	m_pool.parallelFor(slabs, [&](int s) {
+		int total = 0;
+		for (int t = 0; t < tasks; t++)
+			total += m_binFill[(size_t)t * slabs + s];
+		m_slabStart[s + 1] = total;
+	});
+	m_slabStart[0] = 0;
+	for (int s = 0; s < slabs; s++)
+		m_slabStart[s + 1] += m_slabStart[s];
+	m_pool.parallelFor(slabs, [&](int s) {
+		int at = m_slabStart[s];
+		for (int t = 0; t < tasks; t++) {
+			int& fill = m_binFill[(size_t)t * slabs + s];
+			int count = fill;
+			fill = at;
+			at += count;
+		}
+	});
+
+	m_obstacles.clear();
+	for (int t = 0; t < tasks; t++)
+		m_obstacles.insert(m_obstacles.end(), m_taskObstacles[t].begin(), m_taskObstacles[t].end());
+
+	m_members.resize(m_slabStart[slabs]);
+	m_pool.parallelFor(tasks, [&](int t) {
+		int* fill = &m_binFill[(size_t)t * slabs];
+		int end = std::min(n, (t + 1) * BALLS_PER_TASK);
+		for (int i = t * BALLS_PER_TASK; i < end; i++) {
+			if (m_ballSlab[i] >= 0)
+				m_members[fill[m_ballSlab[i]]++] = i;
+		}
+	});
+
+	const std::vector<float>& z = m_ballZ;
+	m_pool.parallelFor(slabs, [&](int s) {
+		std::sort(m_members.begin() + m_slabStart[s], m_members.begin() + m_slabStart[s + 1],
+			[&](int a, int b) { return z[a] < z[b] || (z[a] == z[b] && a < b); });
+	});
+}
+
+// sweep along z over the balls of slab s and the ghost zone of slab s + 1.
+// pairs with both balls in the ghost zone belong to slab s + 1.
+void CSlabStepper::collideSlab(int s, std::vector<CSphere>& balls)
+{
+	const std::vector<float>& z = m_ballZ;
+	std::vector<int>& sweep = m_sweep[s];
+	CCollisionEventBuffer& events = m_slabEvents[s];
+	events.clear();
+
+	std::vector<int>::const_iterator own = m_members.begin() + m_slabStart[s];
+	std::vector<int>::const_iterator ownEnd = m_members.begin() + m_slabStart[s + 1];
+	sweep.assign(own, ownEnd);
+
+	if (s + 1 < m_slabCount) {
+		float ghostEdge = -m_halfX + (s + 1) * m_slabWidth + CONTACT_DIST;
+		size_t ownCount = sweep.size();
+		for (int k = m_slabStart[s + 1]; k < m_slabStart[s + 2]; k++) {
+			int i = m_members[k];
+			if (m_narrowBalls[i].x <= ghostEdge)
+				sweep.push_back(i);
+		}
+		std::inplace_merge(sweep.begin(), sweep.begin() + ownCount, sweep.end(),
+			[&](int a, int b) { return z[a] < z[b] || (z[a] == z[b] && a < b); });
+	}
+
+	std::vector<int>& candidates = m_candidates[s];
+	candidates.clear();
+	const int count = (int)sweep.size();
+	for (int p = 0; p < count; p++) {
+		int a = sweep[p];
+		for (int q = p + 1; q < count && z[sweep[q]] - z[a] <= CONTACT_DIST; q++) {
+			int b = sweep[q];
+			if (m_ballSlab[a] != s && m_ballSlab[b] != s)
+				continue;
+			candidates.push_back(std::min(a, b));
+			candidates.push_back(std::max(a, b));
+		}
+	}
+
+	std::vector<NarrowContact>& contacts = m_contacts[s];
+	contacts.clear();
+	if (!candidates.empty())
+		narrowPhase(&m_narrowBalls[0], &candidates[0], candidates.size() / 2, contacts);
+	resolve(contacts, balls, events);
+}
+
+void CSlabStepper::resolve(const std::vector<NarrowContact>& contacts, std::vector<CSphere>& balls, CCollisionEventBuffer& events)
+{
+	for (size_t k = 0; k < contacts.size(); k++) {
+		const NarrowContact& c = contacts[k];
+		balls[c.a].resolveHit(balls[c.b], c.nx, c.nz);
+		events.push(c.a, c.b, balls[c.a].getType(), balls[c.b].getType());
+	}
+}
+
+// an obstacle may be far larger than a ball and never moves, so it is
+// kept out of the slabs and tested against the balls of every slab its
+// reach overlaps. obstacles run one after another on the calling thread:
+// a ball touching two of them must see them in index order. two obstacles
+// are not tested against each other
+void CSlabStepper::collideObstacles(std::vector<CSphere>& balls, CCollisionEventBuffer& events)
+{
+	const std::vector<float>& z = m_ballZ;
+	std::vector<int>& candidates = m_obstaclePairs;
+	candidates.clear();
+	for (size_t k = 0; k < m_obstacles.size(); k++) {
+		int o = m_obstacles[k];
+		const NarrowBall& ob = m_narrowBalls[o];
+		float reach = ob.radius + (float)M_RADIUS;
+		int s0 = (int)((ob.x - reach + m_halfX) / m_slabWidth);
+		int s1 = (int)((ob.x + reach + m_halfX) / m_slabWidth);
+		s0 = s0 < 0 ? 0 : (s0 >= m_slabCount ? m_slabCount - 1 : s0);
+		s1 = s1 < 0 ? 0 : (s1 >= m_slabCount ? m_slabCount - 1 : s1);
+		for (int s = s0; s <= s1; s++) {
+			std::vector<int>::const_iterator it = std::lower_bound(
+				m_members.begin() + m_slabStart[s], m_members.begin() + m_slabStart[s + 1], ob.z - reach,
+				[&](int i, float value) { return z[i] < value; });
+			for (; it != m_members.begin() + m_slabStart[s + 1] && z[*it] <= ob.z + reach; ++it) {
+				candidates.push_back(std::min(o, *it));
+				candidates.push_back(std::max(o, *it));
+			}
+		}
+	}
+
+	m_obstacleContacts.clear();
+	if (!candidates.empty())
+		narrowPhase(&m_narrowBalls[0], &candidates[0], candidates.size() / 2, m_obstacleContacts);
+	resolve(m_obstacleContacts, balls, events);
+	m_lastStats.pairTests += (unsigned int)(candidates.size() / 2);
+	m_lastStats.contacts += (unsigned int)m_obstacleContacts.size();
+}
+
+// the pairs of slabs [0, slabs) into the stats of this step
+void CSlabStepper::countPairs(int slabs)
+{
+	for (int s = 0; s < slabs; s++) {
+		m_lastStats.pairTests += (unsigned int)(m_candidates[s].size() / 2);
+		m_lastStats.contacts += (unsigned int)m_contacts[s].size();
+	}
+}
+
+void CSlabStepper::collideGrid(std::vector<CSphere>& balls, CCollisionEventBuffer& events)
+{
+	const int n = (int)balls.size();
+	m_narrowBalls.resize(n);
+	m_gridX.resize(n);
+	m_gridZ.resize(n);
+	m_gridRadius.resize(n);
+	m_gridActive.resize(n);
+	for (int i = 0; i < n; i++) {
+		fillNarrowBall(m_narrowBalls[i], balls[i]);
+		m_gridX[i] = m_narrowBalls[i].x;
+		m_gridZ[i] = m_narrowBalls[i].z;
+		m_gridRadius[i] = m_narrowBalls[i].radius;
+		m_gridActive[i] = balls[i].isActive() ? 1 : 0;
+	}
+
+	std::vector<int>& candidates = m_candidates[0];
+	candidates.clear();
+	m_grid.build(&m_gridX[0], &m_gridZ[0], &m_gridRadius[0], &m_gridActive[0], n);
+	m_grid.forEachPair([&](int a, int b) {
+		candidates.push_back(std::min(a, b));
+		candidates.push_back(std::max(a, b));
+	});
+
+	std::vector<NarrowContact>& contacts = m_contacts[0];
+	contacts.clear();
+	if (!candidates.empty())
+		narrowPhase(&m_narrowBalls[0], &candidates[0], candidates.size() / 2, contacts);
+	resolve(contacts, balls, events);
+}
+
+void CSlabStepper::step(std::vector<CSphere>& balls, std::vector<CWall>& walls, float timeDelta, CCollisionEventBuffer& events)
+{
+	const int n = (int)balls.size();
+	const int tasks = (n + BALLS_PER_TASK - 1) / BALLS_PER_TASK;
+	m_taskScan.resize(tasks);
+	m_pool.parallelFor(tasks, [&](int t) {
+		TaskScan& scan = m_taskScan[t];
+		scan.speed = 0;
+		scan.radius = 0;
+		scan.active = 0;
+		int end = std::min(n, (t + 1) * BALLS_PER_TASK);
+		for (int i = t * BALLS_PER_TASK; i < end; i++) {
+			if (!balls[i].isActive())
+				continue;
+			float s = fabsf(balls[i].getVelocity_X()) + fabsf(balls[i].getVelocity_Z());
+			if (s > scan.speed) scan.speed = s;
+			if (scan.active == 0 || balls[i].getRadius() < scan.radius) scan.radius = balls[i].getRadius();
+			scan.active++;
+		}
+	});
+
+	float speed = 0, radius = 0;
+	memset(&m_lastStats, 0, sizeof(m_lastStats));
+	for (int t = 0; t < tasks; t++) {
+		const TaskScan& scan = m_taskScan[t];
+		if (scan.active == 0)
+			continue;
+		if (scan.speed > speed) speed = scan.speed;
+		if (m_lastStats.activeBalls == 0 || scan.radius < radius) radius = scan.radius;
+		m_lastStats.activeBalls += scan.active;
+	}
+
+	const int parts = m_lastStats.activeBalls > 0 ? substepCount<FloatPolicy>(TIME_SCALE * timeDelta, speed, radius, m_maxSubsteps) : 1;
+	m_lastSubsteps = parts;
+	for (int k = 0; k < parts; k++)
+		substep(balls, walls, timeDelta / parts, events);
+}
+
+void CSlabStepper::substep(std::vector<CSphere>& balls, std::vector<CWall>& walls, float timeDelta, CCollisionEventBuffer& events)
+{
+	if (m_slabCount == 0 || m_halfX != g_tableHalfX)
+		layoutSlabs();
+
+	// integration and cushions touch one ball at a time. a ball that drops
+	// into a pocket goes at once, and a ball of another size still on the
+	// table sends the contacts to the grid. obstacles do not: they are
+	// tested on their own after the slabs
+	const int n = (int)balls.size();
+	const int numWalls = (int)walls.size();
+	const int tasks = (n + BALLS_PER_TASK - 1) / BALLS_PER_TASK;
+	const CCushionField* cushions = g_cushions;
+	m_taskPass.resize(tasks);
+	m_pool.parallelFor(tasks, [&](int t) {
+		int end = std::min(n, (t + 1) * BALLS_PER_TASK);
+		unsigned int wallHits = 0;
+		bool mixed = false;
+		for (int i = t * BALLS_PER_TASK; i < end; i++) {
+			if (!balls[i].isActive()) continue;
+			balls[i].ballUpdate(timeDelta);
+			if (cushions != NULL) {
+				if (!balls[i].hitCushions(*cushions)) {
+					balls[i].remove();
+					continue;
+				}
+			}
+			else if (numWalls > 0 && walls[0].hitBy(balls[i])) {
+				// any wall covers all four sides; the others would only
+				// see the ball put back already
+				wallHits++;
+			}
+			if (!balls[i].isStatic() && balls[i].getRadius() != (float)M_RADIUS)
+				mixed = true;
+		}
+		m_taskPass[t].wallHits = wallHits;
+		m_taskPass[t].mixed = mixed;
+	});
+	bool mixed = false;
+	for (int t = 0; t < tasks; t++) {
+		m_lastStats.wallHits += m_taskPass[t].wallHits;
+		mixed = mixed || m_taskPass[t].mixed;
+	}
+
+	if (mixed) {
+		collideGrid(balls, events);
+		countPairs(1);
+		return;
+	}
+
+	binBalls(balls);
+
+	// even slabs, then odd slabs
+	for (int phase = 0; phase < 2; phase++) {
+		m_pool.parallelFor((m_slabCount - phase + 1) / 2, [&](int k) {
+			collideSlab(2 * k + phase, balls);
+		});
+	}
+
+	// the events in the same order, even slabs then odd slabs, each slab
+	// copied to its place on the pool
+	size_t at = events.size();
+	for (int phase = 0; phase < 2; phase++) {
+		for (int s = phase; s < m_slabCount; s += 2) {
+			m_eventStart[s] = at;
+			at += m_slabEvents[s].size();
+		}
+	}
+	events.grow(at - events.size());
+	m_pool.parallelFor(m_slabCount, [&](int s) {
+		events.copyInto(m_eventStart[s], m_slabEvents[s]);
+	});
+	countPairs(m_slabCount);
+
+	if (!m_obstacles.empty())
+		collideObstacles(balls, events);
+}
@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: slabStepper.h
+//
+// Desc: Multi-threaded physics step. The table is cut along x into slabs of
+//       fixed width; each slab resolves the contacts of its own balls plus a
+//       ghost zone reaching into the next slab. Slabs are processed even/odd
+//       so that two slabs running at the same time never share a ball.
+//
+//       The slab layout depends only on the table size and the order of work
+//       inside a slab only on ball positions and indices, so the result is
+//       the same for any number of threads.
+//
+//       The sweeps only collect candidate pairs; narrowPhase() tests them in
+//       batches and the contacts are resolved in candidate order.
+//
+//       Slabs are as wide as two standard balls need. When balls of other
+//       sizes are on the table, contacts go through a hierarchical grid
+//       (hierGrid.h) on the calling thread instead. Obstacles are not in
+//       the slabs whatever their size: after the slab passes each one is
+//       tested against the balls of the slabs it reaches into.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __slabStepperH__
+#define __slabStepperH__
+
+#include "billiard.h"
+#include "workerPool.h"
+#include "hierGrid.h"
+#include "narrowPhase.h"
+#include <vector>
+
+// what the last step() did, over all of its substeps
+struct StepStats
+{
+	unsigned int	activeBalls;
+	unsigned int	pairTests;		// candidate pairs given to narrowPhase()
+	unsigned int	contacts;		// of those, the ones that touched
+	unsigned int	wallHits;		// balls CWall::hitBy reflected, at most once per ball and substep
+};
+
+class CSlabStepper {
+public:
+	CSlabStepper(CWorkerPool& pool);
+
+	// one tick: integration and cushions (ballUpdate, CWall::hitBy or
+	// CSphere::hitCushions when the scene has an outline), then ball-ball
+	// contacts. resolved contacts are appended to events. a tick in which a
+	// ball would move more than SUBSTEP_TRAVEL of a radius runs as several
+	// equal substeps (substepCount(), tablePhysics.h)
+	void step(std::vector<CSphere>& balls, std::vector<CWall>& walls, float timeDelta, CCollisionEventBuffer& events);
+
+	int getSlabCount(void) const { return m_slabCount; }
+	// 1 runs every tick whole, as before substeps
+	void setMaxSubsteps(int maxSubsteps) { m_maxSubsteps = maxSubsteps < 1 ? 1 : maxSubsteps; }
+	int getLastSubsteps(void) const { return m_lastSubsteps; }
+	const StepStats& getLastStats(void) const { return m_lastStats; }
+
+private:
+	void substep(std::vector<CSphere>& balls, std::vector<CWall>& walls, float timeDelta, CCollisionEventBuffer& events);
+	void layoutSlabs(void);
+	void binBalls(std::vector<CSphere>& balls);
+	void collideSlab(int s, std::vector<CSphere>& balls);
+	void collideObstacles(std::vector<CSphere>& balls, CCollisionEventBuffer& events);
+	void collideGrid(std::vector<CSphere>& balls, CCollisionEventBuffer& events);
+	void resolve(const std::vector<NarrowContact>& contacts, std::vector<CSphere>& balls, CCollisionEventBuffer& events);
+	void countPairs(int slabs);
+
+	// what one integration task saw, summed on the calling thread
+	struct TaskScan {
+		float			speed;			// largest |vx| + |vz| before the step
+		float			radius;			// smallest radius, when active > 0
+		unsigned int	active;
+	};
+	struct TaskPass {
+		unsigned int	wallHits;
+		bool			mixed;			// a ball, not an obstacle, of another size still on the table
+	};
+
+	CWorkerPool&						m_pool;
+
+	float								m_halfX;		// table size the slabs were laid out for
+	int									m_slabCount;
+	float								m_slabWidth;
+	int									m_maxSubsteps;
+	int									m_lastSubsteps;
+	StepStats							m_lastStats;
+	std::vector<TaskScan>				m_taskScan;		// per integration task this step
+	std::vector<TaskPass>				m_taskPass;		// per integration task this substep
+
+	std::vector<int>					m_ballSlab;		// slab of each ball this tick, -1 if inactive or an obstacle
+	std::vector<float>					m_ballZ;		// z of each ball this tick
+	std::vector<NarrowBall>				m_narrowBalls;	// what narrowPhase() reads of each ball this tick
+	std::vector<int>					m_slabStart;	// slab s owns m_members[m_slabStart[s] .. m_slabStart[s + 1])
+	std::vector<int>					m_members;		// ball indices by slab, each slab sorted by z
+	std::vector<int>					m_binFill;		// per task and slab: its ball count, then where it writes
+	std::vector<std::vector<int> >		m_sweep;		// per slab: own balls merged with the ghost zone
+	std::vector<std::vector<int> >		m_candidates;	// per slab: pairs from the sweep, a and b interleaved
+	std::vector<std::vector<NarrowContact> >	m_contacts;	// per slab: the pairs that touch
+	std::vector<CCollisionEventBuffer>	m_slabEvents;
+	std::vector<size_t>					m_eventStart;	// where each slab's events go in the step's buffer
+	std::vector<std::vector<int> >		m_taskObstacles;	// per binning task: its active obstacles
+	std::vector<int>					m_obstacles;	// all of them, in index order
+	std::vector<int>					m_obstaclePairs;	// obstacle pairs, a and b interleaved
+	std::vector<NarrowContact>			m_obstacleContacts;
+
+	THierGrid<FloatPolicy>				m_grid;			// mixed sizes
+	std::vector<float>					m_gridX, m_gridZ, m_gridRadius;
+	std::vector<unsigned char>			m_gridActive;
+};
+
+#endif // __slabStepperH__
@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: spectatorHost.cpp
+//
+// Desc: Headless table that streams itself to spectators.
+//
+//       spectatorHost [port] [rack rows] [seconds]
+//
+//       Runs a rack scene at SERVER_HZ and publishes every server tick. A
+//       second after the table comes to rest the cue ball is shot at another
+//       ball, so the stream alternates between moving and resting tables. Once a second it prints the
+//       viewer count, the outgoing bandwidth and the server CPU per viewer.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "spectatorServer.h"
+#include "tablePhysics.h"
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+
+static const int SERVER_HZ = 60;
+static const int SUBSTEPS = 3;				// physics ticks per server tick
+
+static double processCpuSeconds(void)
+{
+#ifdef _WIN32
+	FILETIME created, exited, kernel, user;
+	::GetProcessTimes(::GetCurrentProcess(), &created, &exited, &kernel, &user);
+	unsigned long long k = ((unsigned long long)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+	unsigned long long u = ((unsigned long long)user.dwHighDateTime << 32) | user.dwLowDateTime;
+	return (k + u) * 1e-7;
+#else
+	rusage ru;
+	::getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned short port = (unsigned short)(argc > 1 ? atoi(argv[1]) : 27020);
+	unsigned int rows = argc > 2 ? (unsigned int)atoi(argv[2]) : 5;
+	int seconds = argc > 3 ? atoi(argv[3]) : 0;		// 0: run until killed
+
+	scene::CSceneBuilder b;
+	scene::generateRack(b, rows, 1);
+	std::vector<unsigned char> image;
+	b.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size())) {
+		fprintf(stderr, "bad scene image\n");
+		return 1;
+	}
+
+	const scene::SceneHeader& h = sc.header();
+	TBallSet<FloatPolicy> balls;
+	TTablePhysics<FloatPolicy> table;
+	CCollisionEventBuffer events;
+	table.setTable(h.tableHalfX, h.tableHalfZ);
+	balls.resize(h.ballCount);
+	for (unsigned int i = 0; i < h.ballCount; i++) {
+		const scene::SceneBall& s = sc.balls()[i];
+		balls.x[i] = s.x;
+		balls.z[i] = s.z;
+		balls.vx[i] = s.vx;
+		balls.vz[i] = s.vz;
+		balls.radius[i] = sc.ballRadius(i);
+		balls.mass[i] = sc.ballMass(i);
+		balls.type[i] = s.type;
+		balls.active[i] = 1;
+	}
+	const unsigned int cue = h.cueIndex;
+
+	CSpectatorServer server;
+	if (!server.open(port)) {
+		fprintf(stderr, "cannot listen on port %u\n", (unsigned int)port);
+		return 1;
+	}
+	printf("streaming %u balls on port %u at %d Hz\n", h.ballCount, (unsigned int)port, SERVER_HZ);
+
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration period = std::chrono::microseconds(1000000 / SERVER_HZ);
+	Clock::time_point start = Clock::now();
+	Clock::time_point next = start + period;
+	Clock::time_point lastReport = start;
+	double cpuAtReport = processCpuSeconds();
+	unsigned long long bytesAtReport = 0;
+	unsigned int shots = 0;
+	int restTicks = 0;
+
+	for (;;) {
+		// table
+		restTicks = balls.atRest() ? restTicks + 1 : 0;
+		if (restTicks > SERVER_HZ) {
+			unsigned int target = (cue + 1 + shots * 7) % h.ballCount;
+			while (target == cue || !balls.active[target])
+				target = (target + 1) % h.ballCount;
+			TTablePhysics<FloatPolicy>::shot(balls, cue, balls.x[target], balls.z[target]);
+			shots++;
+		}
+		for (int i = 0; i < SUBSTEPS; i++) {
+			events.clear();
+			table.step(balls, 1.0f / (SERVER_HZ * SUBSTEPS), events);
+			dispatchCollisionEvents(events, &balls);
+		}
+
+		server.publish(&balls.x[0], &balls.z[0], &balls.active[0], balls.size());
+
+		// network until the next tick is due
+		for (Clock::time_point now = Clock::now(); now < next; now = Clock::now()) {
+			int waitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+			server.poll(waitMs);
+		}
+		next += period;
+
+		Clock::time_point now = Clock::now();
+		if (now - lastReport >= std::chrono::seconds(1)) {
+			const SpectatorStats& st = server.getStats();
+			double cpu = processCpuSeconds();
+			double interval = std::chrono::duration<double>(now - lastReport).count();
+			double out = (st.bytesSent - bytesAtReport) / interval;
+			double cpuPerViewer = st.viewers > 0 ? (cpu - cpuAtReport) / interval / st.viewers : 0.0;
+			printf("viewers %u  out %.1f KB/s  %.0f B/s per viewer  cpu %.1f us/s per viewer  keyframes %llu  skipped %llu\n",
+				st.viewers, out / 1024.0, st.viewers > 0 ? out / st.viewers : 0.0, cpuPerViewer * 1e6,
+				st.keyframesSent, st.framesSkipped);
+			fflush(stdout);
+
+			cpuAtReport = cpu;
+			bytesAtReport = st.bytesSent;
+			lastReport = now;
+			if (seconds > 0 && now - start >= std::chrono::seconds(seconds))
+				break;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: spectatorLoad.cpp
+//
+// Desc: Load generator for spectatorHost.
+//
+//       spectatorLoad <host> <port> <viewers> <seconds>
+//
+//       Opens the given number of viewer connections, decodes every frame
+//       with CSpectatorView and acks it, like a real viewer would. At the end
+//       it prints the per-viewer bandwidth and frame rate and the number of
+//       frames that failed to decode.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#define poll WSAPoll
+typedef WSAPOLLFD pollfd;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define closesocket ::close
+#endif
+
+#include "spectatorServer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+struct LoadViewer
+{
+	SOCKET						socket;
+	std::vector<unsigned char>	in;
+	CSpectatorView				view;
+	unsigned long long			bytes;
+	unsigned int				frames;
+	unsigned int				badFrames;
+};
+
+static bool setNonBlocking(SOCKET s)
+{
+#ifdef _WIN32
+	u_long nonBlocking = 1;
+	return ::ioctlsocket(s, FIONBIO, &nonBlocking) == 0;
+#else
+	int flags = ::fcntl(s, F_GETFL, 0);
+	return flags >= 0 && ::fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+// decode every whole message in the input buffer and ack it
+static void consume(LoadViewer& v)
+{
+	size_t pos = 0;
+	while (v.in.size() - pos >= 4) {
+		const unsigned char* p = &v.in[pos];
+		size_t size = p[0] | (p[1] << 8) | (p[2] << 16) | ((size_t)p[3] << 24);
+		if (v.in.size() - pos < 4 + size)
+			break;
+
+		if (v.view.apply(p, 4 + size)) {
+			unsigned int frame = v.view.current().frame;
+			unsigned char ack[4] = { (unsigned char)frame, (unsigned char)(frame >> 8),
+				(unsigned char)(frame >> 16), (unsigned char)(frame >> 24) };
+			// an ack lost to a full socket only makes the next delta larger
+			::send(v.socket, (const char*)ack, sizeof(ack), 0);
+			v.frames++;
+		}
+		else
+			v.badFrames++;
+		pos += 4 + size;
+	}
+	v.in.erase(v.in.begin(), v.in.begin() + pos);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 5) {
+		fprintf(stderr, "usage: %s <host> <port> <viewers> <seconds>\n", argv[0]);
+		return 1;
+	}
+
+#ifdef _WIN32
+	WSADATA wsa;
+	::WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+
+	sockaddr_in server;
+	::memset(&server, 0, sizeof(server));
+	server.sin_family = AF_INET;
+	server.sin_port = htons((unsigned short)atoi(argv[2]));
+	if (::inet_pton(AF_INET, argv[1], &server.sin_addr) != 1) {
+		fprintf(stderr, "bad address '%s'\n", argv[1]);
+		return 1;
+	}
+	const int count = atoi(argv[3]);
+	const int seconds = atoi(argv[4]);
+
+	std::vector<LoadViewer> viewers(count);
+	for (int i = 0; i < count; i++) {
+		LoadViewer& v = viewers[i];
+		v.bytes = 0;
+		v.frames = 0;
+		v.badFrames = 0;
+		v.socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (v.socket == INVALID_SOCKET ||
+			::connect(v.socket, (sockaddr*)&server, sizeof(server)) != 0 ||
+			!setNonBlocking(v.socket)) {
+			fprintf(stderr, "viewer %d cannot connect\n", i);
+			return 1;
+		}
+	}
+
+	std::vector<pollfd> fds(count);
+	for (int i = 0; i < count; i++) {
+		fds[i].fd = viewers[i].socket;
+		fds[i].events = POLLIN;
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	Clock::time_point end = start + std::chrono::seconds(seconds);
+	unsigned char buf[65536];
+	int open = count;
+
+	while (open > 0 && Clock::now() < end) {
+		if (::poll(&fds[0], count, 100) <= 0)
+			continue;
+		for (int i = 0; i < count; i++) {
+			if (fds[i].revents == 0)
+				continue;
+			LoadViewer& v = viewers[i];
+			int n = ::recv(v.socket, (char*)buf, sizeof(buf), 0);
+			if (n <= 0) {
+				if (n == 0 || (fds[i].revents & (POLLHUP | POLLERR))) {
+					closesocket(v.socket);
+					fds[i].fd = INVALID_SOCKET;
+					open--;
+				}
+				continue;
+			}
+			v.bytes += n;
+			v.in.insert(v.in.end(), buf, buf + n);
+			consume(v);
+		}
+	}
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+	unsigned long long minBytes = ~0ULL, maxBytes = 0, totalBytes = 0;
+	unsigned long long totalFrames = 0, badFrames = 0;
+	for (int i = 0; i < count; i++) {
+		const LoadViewer& v = viewers[i];
+		minBytes = std::min(minBytes, v.bytes);
+		maxBytes = std::max(maxBytes, v.bytes);
+		totalBytes += v.bytes;
+		totalFrames += v.frames;
+		badFrames += v.badFrames;
+	}
+
+	printf("%d viewers, %.1f s, %d still connected\n", count, elapsed, open);
+	printf("per viewer: %.0f / %.0f / %.0f B/s (min / avg / max), %.1f frames/s\n",
+		minBytes / elapsed, totalBytes / elapsed / count, maxBytes / elapsed, totalFrames / elapsed / count);
+	printf("total: %.1f KB/s, %llu frames, %llu failed to decode\n",
+		totalBytes / elapsed / 1024.0, totalFrames, badFrames);
+	return badFrames == 0 ? 0 : 1;
+}
@@ -0,0 +1,549 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: spectatorServer.cpp
+//
+// Desc: Spectator stream: quantized frames, delta encoding and the
+//       non-blocking TCP fan-out.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#define SEND_FLAGS 0
+#else
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define closesocket ::close
+#define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+#include "spectatorServer.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const unsigned int LISTEN_KEY = 0xffffffffu;
+
+	void putU32(unsigned char* p, unsigned int v)
+	{
+		p[0] = (unsigned char)v;			p[1] = (unsigned char)(v >> 8);
+		p[2] = (unsigned char)(v >> 16);	p[3] = (unsigned char)(v >> 24);
+	}
+	unsigned int getU32(const unsigned char* p)
+	{
+		return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	}
+
+	void putVarint(std::vector<unsigned char>& out, unsigned int v)
+	{
+		while (v >= 0x80) {
+			out.push_back((unsigned char)(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back((unsigned char)v);
+	}
+	bool getVarint(const unsigned char*& p, const unsigned char* end, unsigned int& v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			if (p == end)
+				return false;
+			unsigned char b = *p++;
+			v |= (unsigned int)(b & 0x7f) << shift;
+			if ((b & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	unsigned int zigzag(int v) { return ((unsigned int)v << 1) ^ (unsigned int)(v >> 31); }
+	int unzigzag(unsigned int v) { return (int)(v >> 1) ^ -(int)(v & 1); }
+
+	bool wouldBlock(void)
+	{
+#ifdef _WIN32
+		return ::WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+	}
+
+	bool setNonBlocking(SOCKET s)
+	{
+#ifdef _WIN32
+		u_long nonBlocking = 1;
+		return ::ioctlsocket(s, FIONBIO, &nonBlocking) == 0;
+#else
+		int flags = ::fcntl(s, F_GETFL, 0);
+		return flags >= 0 && ::fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Frames
+// -----------------------------------------------------------------------------
+
+void SpectatorFrame::quantize(unsigned int frameNumber, const float* x, const float* z, const unsigned char* activeFlags, size_t count)
+{
+	frame = frameNumber;
+	qx.resize(count);
+	qz.resize(count);
+	active.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		qx[i] = (int)floor(x[i] * SPECTATOR_POS_SCALE + 0.5f);
+		qz[i] = (int)floor(z[i] * SPECTATOR_POS_SCALE + 0.5f);
+		active[i] = activeFlags[i] ? 1 : 0;
+	}
+}
+
+void encodeSpectatorFrame(const SpectatorFrame& cur, const SpectatorFrame* base, std::vector<unsigned char>& out)
+{
+	const size_t count = cur.qx.size();
+	const size_t baseCount = base != NULL ? base->qx.size() : 0;
+
+	out.resize(4);
+	putVarint(out, cur.frame);
+	putVarint(out, base != NULL ? cur.frame - base->frame : 0);
+	putVarint(out, (unsigned int)count);
+
+	unsigned int prev = (unsigned int)-1;
+	for (size_t i = 0; i < count; i++) {
+		// balls past the end of the base start from an empty slot
+		int bx = 0, bz = 0;
+		unsigned char ba = 0;
+		if (i < baseCount) {
+			bx = base->qx[i];
+			bz = base->qz[i];
+			ba = base->active[i];
+		}
+
+		bool moved = cur.qx[i] != bx || cur.qz[i] != bz;
+		if (!moved && cur.active[i] == ba)
+			continue;
+
+		putVarint(out, (unsigned int)i - prev);
+		out.push_back((unsigned char)(cur.active[i] | (moved ? 2 : 0)));
+		if (moved) {
+			putVarint(out, zigzag(cur.qx[i] - bx));
+			putVarint(out, zigzag(cur.qz[i] - bz));
+		}
+		prev = (unsigned int)i;
+	}
+
+	putU32(&out[0], (unsigned int)out.size() - 4);
+}
+
+// -----------------------------------------------------------------------------
+// CSpectatorView
+// -----------------------------------------------------------------------------
+
+CSpectatorView::CSpectatorView(void)
+{
+	m_latest = 0;
+	m_hasFrame = false;
+	for (unsigned int i = 0; i < SPECTATOR_HISTORY; i++)
+		m_frames[i].frame = SPECTATOR_NO_BASE;
+}
+
+bool CSpectatorView::apply(const unsigned char* msg, size_t size)
+{
+	const unsigned char* p = msg + 4;
+	const unsigned char* end = msg + size;
+	unsigned int frame, baseDistance, count;
+	if (size < 4 || !getVarint(p, end, frame) || !getVarint(p, end, baseDistance) || !getVarint(p, end, count))
+		return false;
+
+	const SpectatorFrame* base = NULL;
+	if (baseDistance != 0) {
+		base = &m_frames[(frame - baseDistance) % SPECTATOR_HISTORY];
+		if (base->frame != frame - baseDistance || baseDistance >= SPECTATOR_HISTORY)
+			return false;
+	}
+
+	SpectatorFrame& dst = m_frames[frame % SPECTATOR_HISTORY];
+	if (base != NULL) {
+		dst.qx = base->qx;
+		dst.qz = base->qz;
+		dst.active = base->active;
+	}
+	else {
+		dst.qx.clear();
+		dst.qz.clear();
+		dst.active.clear();
+	}
+	dst.qx.resize(count, 0);
+	dst.qz.resize(count, 0);
+	dst.active.resize(count, 0);
+	dst.frame = SPECTATOR_NO_BASE;	// not usable as a base until complete
+
+	unsigned int index = (unsigned int)-1;
+	while (p != end) {
+		unsigned int gap, ux, uz;
+		if (!getVarint(p, end, gap) || p == end)
+			return false;
+		index += gap;
+		if (index >= count)
+			return false;
+		unsigned char flags = *p++;
+		dst.active[index] = flags & 1;
+		if (flags & 2) {
+			if (!getVarint(p, end, ux) || !getVarint(p, end, uz))
+				return false;
+			dst.qx[index] += unzigzag(ux);
+			dst.qz[index] += unzigzag(uz);
+		}
+	}
+
+	dst.frame = frame;
+	m_latest = frame;
+	m_hasFrame = true;
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+// CSpectatorServer
+// -----------------------------------------------------------------------------
+
+CSpectatorServer::CSpectatorServer(void)
+{
+	m_listen = (uintptr_t)INVALID_SOCKET;
+	m_poller = -1;
+	m_frame = 0;
+	for (unsigned int i = 0; i < SPECTATOR_HISTORY; i++)
+		m_history[i].frame = SPECTATOR_NO_BASE;
+	for (unsigned int i = 0; i <= SPECTATOR_HISTORY; i++)
+		m_encodedFrame[i] = SPECTATOR_NO_BASE;
+	::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+CSpectatorServer::~CSpectatorServer(void)
+{
+	close();
+}
+
+bool CSpectatorServer::open(unsigned short port)
+{
+	close();
+
+#ifdef _WIN32
+	WSADATA wsa;
+	if (::WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+		return false;
+#endif
+
+	SOCKET s = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET) {
+#ifdef _WIN32
+		::WSACleanup();
+#endif
+		return false;
+	}
+	m_listen = (uintptr_t)s;
+
+	int reuse = 1;
+	::setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	sockaddr_in local;
+	::memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(port);
+
+	if (::bind(s, (sockaddr*)&local, sizeof(local)) != 0 ||
+		::listen(s, SOMAXCONN) != 0 ||
+		!setNonBlocking(s)) {
+		close();
+		return false;
+	}
+
+#ifndef _WIN32
+	m_poller = ::epoll_create1(0);
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.u64 = LISTEN_KEY;
+	if (m_poller < 0 || ::epoll_ctl(m_poller, EPOLL_CTL_ADD, s, &ev) != 0) {
+		close();
+		return false;
+	}
+#endif
+	return true;
+}
+
+void CSpectatorServer::close(void)
+{
+	for (unsigned int i = 0; i < m_viewers.size(); i++) {
+		if ((SOCKET)m_viewers[i].socket != INVALID_SOCKET)
+			dropViewer(i);
+	}
+	m_viewers.clear();
+	m_freeSlots.clear();
+
+#ifndef _WIN32
+	if (m_poller >= 0)
+		::close(m_poller);
+	m_poller = -1;
+#endif
+
+	if ((SOCKET)m_listen != INVALID_SOCKET) {
+		closesocket((SOCKET)m_listen);
+		m_listen = (uintptr_t)INVALID_SOCKET;
+#ifdef _WIN32
+		::WSACleanup();
+#endif
+	}
+}
+
+void CSpectatorServer::publish(const float* x, const float* z, const unsigned char* active, size_t count)
+{
+	SpectatorFrame& cur = m_history[m_frame % SPECTATOR_HISTORY];
+	cur.quantize(m_frame, x, z, active, count);
+
+	for (unsigned int slot = 0; slot < m_viewers.size(); slot++) {
+		Viewer& v = m_viewers[slot];
+		if ((SOCKET)v.socket == INVALID_SOCKET)
+			continue;
+		if (v.isSending()) {
+			m_stats.framesSkipped++;
+			continue;
+		}
+
+		const SpectatorFrame* base = NULL;
+		unsigned int key = SPECTATOR_HISTORY;
+		if (v.acked != SPECTATOR_NO_BASE && m_frame - v.acked < SPECTATOR_HISTORY) {
+			base = &m_history[v.acked % SPECTATOR_HISTORY];
+			key = v.acked % SPECTATOR_HISTORY;
+		}
+
+		if (m_encodedFrame[key] != m_frame) {
+			// a viewer may still be sending the old bytes
+			if (!m_encoded[key] || m_encoded[key].use_count() > 1)
+				m_encoded[key] = std::make_shared<std::vector<unsigned char> >();
+			encodeSpectatorFrame(cur, base, *m_encoded[key]);
+			m_encodedFrame[key] = m_frame;
+		}
+		if (base == NULL)
+			m_stats.keyframesSent++;
+		m_stats.framesSent++;
+
+		v.out = m_encoded[key];
+		v.outSent = 0;
+		if (!flush(slot))
+			dropViewer(slot);
+	}
+
+	m_frame++;
+}
+
+void CSpectatorServer::poll(int timeoutMs)
+{
+	if ((SOCKET)m_listen == INVALID_SOCKET)
+		return;
+
+#ifdef _WIN32
+	std::vector<WSAPOLLFD> fds;
+	std::vector<unsigned long long> keys;
+	fds.reserve(m_viewers.size() + 1);
+	keys.reserve(m_viewers.size() + 1);
+
+	WSAPOLLFD pfd;
+	pfd.fd = (SOCKET)m_listen;
+	pfd.events = POLLRDNORM;
+	pfd.revents = 0;
+	fds.push_back(pfd);
+	keys.push_back(LISTEN_KEY);
+	for (unsigned int slot = 0; slot < m_viewers.size(); slot++) {
+		const Viewer& v = m_viewers[slot];
+		if ((SOCKET)v.socket == INVALID_SOCKET)
+			continue;
+		pfd.fd = (SOCKET)v.socket;
+		pfd.events = POLLRDNORM | (v.wantWrite ? POLLWRNORM : 0);
+		fds.push_back(pfd);
+		keys.push_back(pollerKey(slot));
+	}
+
+	if (::WSAPoll(&fds[0], (ULONG)fds.size(), timeoutMs) <= 0)
+		return;
+
+	for (size_t i = 0; i < fds.size(); i++) {
+		short re = fds[i].revents;
+		if (re == 0)
+			continue;
+		unsigned int key = (unsigned int)keys[i];
+		if (key == LISTEN_KEY) {
+			acceptViewers();
+			continue;
+		}
+		if ((SOCKET)m_viewers[key].socket == INVALID_SOCKET || m_viewers[key].generation != (unsigned int)(keys[i] >> 32))
+			continue;
+		bool ok = true;
+		if (re & (POLLRDNORM | POLLHUP | POLLERR))
+			ok = readAcks(m_viewers[key]);
+		if (ok && (re & POLLWRNORM))
+			ok = flush(key);
+		if (!ok)
+			dropViewer(key);
+	}
+#else
+	const int MAX_EVENTS = 256;
+	epoll_event events[MAX_EVENTS];
+
+	// level triggered: keep draining while the batch comes back full. a
+	// slot dropped and taken again in the same batch has a new generation,
+	// and the old socket's events left in the batch are skipped
+	int n = ::epoll_wait(m_poller, events, MAX_EVENTS, timeoutMs);
+	while (n > 0) {
+		for (int i = 0; i < n; i++) {
+			unsigned int key = (unsigned int)events[i].data.u64;
+			if (key == LISTEN_KEY) {
+				acceptViewers();
+				continue;
+			}
+			if (key >= m_viewers.size() || (SOCKET)m_viewers[key].socket == INVALID_SOCKET ||
+				m_viewers[key].generation != (unsigned int)(events[i].data.u64 >> 32))
+				continue;
+			bool ok = true;
+			if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+				ok = readAcks(m_viewers[key]);
+			if (ok && (events[i].events & EPOLLOUT))
+				ok = flush(key);
+			if (!ok)
+				dropViewer(key);
+		}
+		if (n < MAX_EVENTS)
+			break;
+		n = ::epoll_wait(m_poller, events, MAX_EVENTS, 0);
+	}
+#endif
+}
+
+void CSpectatorServer::acceptViewers(void)
+{
+	for (;;) {
+		SOCKET s = ::accept((SOCKET)m_listen, NULL, NULL);
+		if (s == INVALID_SOCKET)
+			return;
+
+		int noDelay = 1;
+		::setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+		if (!setNonBlocking(s)) {
+			closesocket(s);
+			continue;
+		}
+
+		unsigned int slot;
+		if (!m_freeSlots.empty()) {
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else {
+			slot = (unsigned int)m_viewers.size();
+			m_viewers.push_back(Viewer());
+			m_viewers[slot].generation = 0;
+		}
+
+		Viewer& v = m_viewers[slot];
+		v.socket = (uintptr_t)s;
+		v.acked = SPECTATOR_NO_BASE;
+		v.ackFill = 0;
+		v.out.reset();
+		v.outSent = 0;
+		v.wantWrite = false;
+		m_stats.viewers++;
+
+#ifndef _WIN32
+		epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.u64 = pollerKey(slot);
+		if (::epoll_ctl(m_poller, EPOLL_CTL_ADD, s, &ev) != 0) {
+			dropViewer(slot);
+			continue;
+		}
+#endif
+	}
+}
+
+bool CSpectatorServer::readAcks(Viewer& v)
+{
+	unsigned char buf[256];
+	for (;;) {
+		int n = ::recv((SOCKET)v.socket, (char*)buf, sizeof(buf), 0);
+		if (n == 0)
+			return false;		// viewer left
+		if (n < 0)
+			return wouldBlock();
+
+		for (int i = 0; i < n; i++) {
+			v.ackBuf[v.ackFill++] = buf[i];
+			if (v.ackFill == 4) {
+				unsigned int frame = getU32(v.ackBuf);
+				// only move forward, and never onto a frame not yet sent
+				if ((v.acked == SPECTATOR_NO_BASE || (int)(frame - v.acked) > 0) && (int)(m_frame - frame) > 0)
+					v.acked = frame;
+				v.ackFill = 0;
+			}
+		}
+	}
+}
+
+bool CSpectatorServer::flush(unsigned int slot)
+{
+	Viewer& v = m_viewers[slot];
+	while (v.isSending()) {
+		const std::vector<unsigned char>& out = *v.out;
+		int n = ::send((SOCKET)v.socket, (const char*)&out[v.outSent], (int)(out.size() - v.outSent), SEND_FLAGS);
+		if (n < 0) {
+			if (!wouldBlock())
+				return false;
+			setWantWrite(slot, true);
+			return true;
+		}
+		v.outSent += n;
+		m_stats.bytesSent += n;
+	}
+	v.out.reset();
+	v.outSent = 0;
+	setWantWrite(slot, false);
+	return true;
+}
+
+void CSpectatorServer::setWantWrite(unsigned int slot, bool want)
+{
+	Viewer& v = m_viewers[slot];
+	if (v.wantWrite == want)
+		return;
+	v.wantWrite = want;
+
+#ifndef _WIN32
+	epoll_event ev;
+	ev.events = (uint32_t)(want ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+	ev.data.u64 = pollerKey(slot);
+	::epoll_ctl(m_poller, EPOLL_CTL_MOD, (SOCKET)v.socket, &ev);
+#endif
+}
+
+void CSpectatorServer::dropViewer(unsigned int slot)
+{
+	Viewer& v = m_viewers[slot];
+	if ((SOCKET)v.socket == INVALID_SOCKET)
+		return;
+
+	// closing the socket also takes it out of the epoll set
+	closesocket((SOCKET)v.socket);
+	v.socket = (uintptr_t)INVALID_SOCKET;
+	v.generation++;
+	v.out.reset();
+	v.outSent = 0;
+	m_freeSlots.push_back(slot);
+	m_stats.viewers--;
+}
@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: spectatorServer.h
+//
+// Desc: Streams live table state to spectators over TCP.
+//
+//       Each tick the host publishes the ball centers and active flags. They
+//       are quantized to SPECTATOR_POS_SCALE steps per unit and kept in a
+//       short history. Each viewer gets the current frame encoded as a delta
+//       against the last frame that viewer acked. A ball that has not moved
+//       since then is not written at all, so a resting table costs only the
+//       few bytes of the frame header. A viewer that has acked nothing, or whose ack fell out
+//       of the history, gets a delta against an empty table (a keyframe).
+//
+//       A viewer whose socket is still draining the previous frame skips
+//       ticks instead of queueing them, so slow viewers cost no memory.
+//
+//       Sockets are non-blocking and multiplexed with epoll (WSAPoll on
+//       Windows).
+//
+//       Stream format, little endian. Server to viewer, one message per frame:
+//
+//         [u32 size] [varint frame] [varint frame - base] [varint ball count]
+//         records
+//
+//       frame - base is 0 for a keyframe. For every ball whose
+//       quantized state differs from the base, in index order, there is a
+//       record:
+//
+//         varint  index gap since the previous record (first: index + 1)
+//         u8      bit 0: active, bit 1: position follows
+//         varint  zigzag(qx - base qx), zigzag(qz - base qz)   if bit 1
+//
+//       Viewer to server: [u32 frame] acks, one per frame applied.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __spectatorServerH__
+#define __spectatorServerH__
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+const float SPECTATOR_POS_SCALE = 512.0f;			// quantization steps per unit
+const unsigned int SPECTATOR_HISTORY = 64;			// frames a delta can be based on
+const unsigned int SPECTATOR_NO_BASE = 0xffffffffu;
+
+// -----------------------------------------------------------------------------
+// Quantized table state, one entry per ball
+// -----------------------------------------------------------------------------
+
+struct SpectatorFrame
+{
+	unsigned int				frame;
+	std::vector<int>			qx, qz;
+	std::vector<unsigned char>	active;
+
+	void quantize(unsigned int frameNumber, const float* x, const float* z, const unsigned char* activeFlags, size_t count);
+};
+
+// writes one frame message; base may be NULL for a keyframe
+void encodeSpectatorFrame(const SpectatorFrame& cur, const SpectatorFrame* base, std::vector<unsigned char>& out);
+
+// -----------------------------------------------------------------------------
+// Viewer side: rebuilds frames from the stream
+// -----------------------------------------------------------------------------
+
+class CSpectatorView {
+public:
+	CSpectatorView(void);
+
+	// one whole message as framed by the u32 size. false if it does not
+	// decode or is based on a frame this view no longer has.
+	bool apply(const unsigned char* msg, size_t size);
+
+	const SpectatorFrame& current(void) const { return m_frames[m_latest % SPECTATOR_HISTORY]; }
+	bool hasFrame(void) const { return m_hasFrame; }
+
+private:
+	SpectatorFrame			m_frames[SPECTATOR_HISTORY];
+	unsigned int			m_latest;
+	bool					m_hasFrame;
+};
+
+// -----------------------------------------------------------------------------
+// CSpectatorServer
+// -----------------------------------------------------------------------------
+
+struct SpectatorStats
+{
+	unsigned int		viewers;
+	unsigned long long	bytesSent;
+	unsigned long long	framesSent;
+	unsigned long long	keyframesSent;
+	unsigned long long	framesSkipped;		// viewer still draining the previous one
+};
+
+class CSpectatorServer {
+public:
+	CSpectatorServer(void);
+	~CSpectatorServer(void);
+
+	bool open(unsigned short port);
+	void close(void);
+
+	// sample the table for this tick and send it to every ready viewer
+	void publish(const float* x, const float* z, const unsigned char* active, size_t count);
+
+	// accept viewers, read acks, flush pending output. waits up to timeoutMs.
+	void poll(int timeoutMs);
+
+	const SpectatorStats& getStats(void) const { return m_stats; }
+
+private:
+	CSpectatorServer(const CSpectatorServer&);
+	CSpectatorServer& operator=(const CSpectatorServer&);
+
+	typedef std::shared_ptr<const std::vector<unsigned char> > Encoded;
+
+	struct Viewer {
+		uintptr_t					socket;		// INVALID_SOCKET: free slot
+		unsigned int				generation;	// bumped when the slot is dropped
+		unsigned int				acked;		// SPECTATOR_NO_BASE until the first ack
+		unsigned char				ackBuf[4];
+		unsigned int				ackFill;
+		Encoded						out;		// shared with the viewers on the same base
+		size_t						outSent;
+		bool						wantWrite;
+
+		bool isSending(void) const { return out && outSent < out->size(); }
+	};
+
+	// slot in the low half, its generation in the high half
+	unsigned long long pollerKey(unsigned int slot) const { return ((unsigned long long)m_viewers[slot].generation << 32) | slot; }
+
+	void acceptViewers(void);
+	bool readAcks(Viewer& v);
+	bool flush(unsigned int slot);
+	void setWantWrite(unsigned int slot, bool want);
+	void dropViewer(unsigned int slot);
+
+	uintptr_t				m_listen;
+	int						m_poller;		// epoll fd; unused with WSAPoll
+	std::vector<Viewer>		m_viewers;		// slot index, with its generation, is the poller key
+	std::vector<unsigned int>	m_freeSlots;
+
+	SpectatorFrame			m_history[SPECTATOR_HISTORY];
+	unsigned int			m_frame;		// next frame number
+
+	// viewers acked on the same frame get the same bytes, so each publish
+	// encodes at most once per base and the viewers hold that one buffer.
+	// the last slot is the keyframe.
+	std::shared_ptr<std::vector<unsigned char> >	m_encoded[SPECTATOR_HISTORY + 1];
+	unsigned int			m_encodedFrame[SPECTATOR_HISTORY + 1];
+
+	SpectatorStats			m_stats;
+};
+
+#endif // __spectatorServerH__
@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: sphereLayoutBench.cpp
+//
+// Desc: What one ballUpdate pass costs per ball with the old CSphere and
+//       with CSphere / CSphereLook.
+//
+//       sphereLayoutBench [balls] [ticks]
+//
+//       OldSphere is CSphere as it was: render members (m_mLocal, m_mtrl,
+//       m_pSphereMesh) in the object, velocities out through double getters,
+//       the step in double, and setCenter() making m_mLocal on every move.
+//
+//       For each layout, and for the TBallSet arrays of tablePhysics.h:
+//       the object size, the cache lines a pass over every ball reads or
+//       writes (from the fields the step uses, every ball moving) as bytes
+//       per ball, and the time of ticks passes. Then the new CSphere
+//       against integrateBalls() on a TBallSet<FloatPolicy> from the same
+//       start, which must match bit for bit, and how far the old double
+//       path ends from both.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "billiard.h"
+#include "tablePhysics.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+static const float TICK = 0.005f;
+static const size_t CACHE_LINE = 64;
+
+typedef std::chrono::steady_clock Clock;
+
+float g_tableHalfX = 0, g_tableHalfZ = 0;
+const CCushionField* g_cushions = NULL;
+
+static double msSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+// the members and step of CSphere before the split
+struct OldSphere {
+	float					center_x, center_y, center_z;
+	float					m_radius;
+	float					m_mass;
+	float					m_meshScale;
+	float					m_velocity_x;
+	float					m_velocity_z;
+	bool					active;
+	int						m_type;
+	D3DXMATRIX				m_mLocal;
+	D3DMATERIAL9			m_mtrl;
+	ID3DXMesh*				m_pSphereMesh;
+
+	OldSphere(void)
+	{
+		center_x = center_y = center_z = 0;
+		m_radius = (float)M_RADIUS;
+		m_mass = 1;
+		m_meshScale = 1;
+		m_velocity_x = m_velocity_z = 0;
+		active = true;
+		m_type = ENTITY_RED;
+		D3DXMatrixIdentity(&m_mLocal);
+		ZeroMemory(&m_mtrl, sizeof(m_mtrl));
+		m_pSphereMesh = NULL;
+	}
+
+	double getVelocity_X() { return m_velocity_x; }
+	double getVelocity_Z() { return m_velocity_z; }
+	void setPower(double vx, double vz)
+	{
+		m_velocity_x = vx;
+		m_velocity_z = vz;
+	}
+	D3DXVECTOR3 getCenter(void) const { return D3DXVECTOR3(center_x, center_y, center_z); }
+	void setCenter(float x, float y, float z)
+	{
+		D3DXMATRIX m;
+		center_x = x;	center_y = y;	center_z = z;
+		D3DXMatrixTranslation(&m, x, y, z);
+		if (m_meshScale != 1) {
+			D3DXMATRIX s;
+			D3DXMatrixScaling(&s, m_meshScale, m_meshScale, m_meshScale);
+			m = s * m;
+		}
+		m_mLocal = m;
+	}
+
+	void ballUpdate(float timeDiff)
+	{
+		D3DXVECTOR3 cord = this->getCenter();
+		double vx = fabs(this->getVelocity_X());
+		double vz = fabs(this->getVelocity_Z());
+
+		if (vx > 0.01 || vz > 0.01)
+		{
+			float tX = cord.x + TIME_SCALE * timeDiff * m_velocity_x;
+			float tZ = cord.z + TIME_SCALE * timeDiff * m_velocity_z;
+			if (tX >= (g_tableHalfX - m_radius))
+				tX = g_tableHalfX - m_radius;
+			else if (tX <= (-g_tableHalfX + m_radius))
+				tX = -g_tableHalfX + m_radius;
+			if (tZ <= (-g_tableHalfZ + m_radius))
+				tZ = -g_tableHalfZ + m_radius;
+			else if (tZ >= (g_tableHalfZ - m_radius))
+				tZ = g_tableHalfZ - m_radius;
+			this->setCenter(tX, cord.y, tZ);
+		}
+		else { this->setPower(0, 0); }
+		double rate = 1 - (1 - DECREASE_RATE) * timeDiff * 400;
+		if (rate < 0)
+			rate = 0;
+		this->setPower(getVelocity_X() * rate, getVelocity_Z() * rate);
+	}
+};
+
+struct Range {
+	size_t	offset, size;
+};
+
+// distinct cache lines under the ranges of count objects of the given
+// stride from a line boundary, in bytes per object
+static double bytesPerBall(size_t stride, const std::vector<Range>& ranges, size_t count)
+{
+	std::set<size_t> lines;
+	for (size_t i = 0; i < count; i++) {
+		for (size_t k = 0; k < ranges.size(); k++) {
+			size_t first = i * stride + ranges[k].offset;
+			size_t last = first + ranges[k].size - 1;
+			for (size_t l = first / CACHE_LINE; l <= last / CACHE_LINE; l++)
+				lines.insert(l);
+		}
+	}
+	return (double)(lines.size() * CACHE_LINE) / count;
+}
+
+static void print(const char* name, size_t size, double bytes, double ms, size_t updates)
+{
+	printf("  %-26s %4u bytes, %6.1f bytes touched per ball, %6.2f ns per ball update\n",
+		name, (unsigned int)size, bytes, ms * 1e6 / updates);
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t count = argc > 1 ? (size_t)atoi(argv[1]) : 4096;
+	const unsigned int ticks = argc > 2 ? (unsigned int)atoi(argv[2]) : 400;
+
+	g_tableHalfX = 20;
+	g_tableHalfZ = 10;
+	std::vector<OldSphere> before(count);
+	std::vector<CSphere> after(count);
+	TBallSet<FloatPolicy> soa;
+	soa.resize(count);
+	scene::CRandom rng(11);
+	for (size_t i = 0; i < count; i++) {
+		float x = (rng.unit() * 2 - 1) * 19, z = (rng.unit() * 2 - 1) * 9;
+		float vx = (rng.unit() * 2 - 1) * 6, vz = (rng.unit() * 2 - 1) * 6;
+		before[i].setCenter(x, (float)M_RADIUS, z);
+		before[i].setPower(vx, vz);
+		after[i].setCenter(x, (float)M_RADIUS, z);
+		after[i].setPower(vx, vz);
+		soa.x[i] = x;
+		soa.z[i] = z;
+		soa.vx[i] = vx;
+		soa.vz[i] = vz;
+		soa.radius[i] = (float)M_RADIUS;
+		soa.type[i] = ENTITY_RED;
+		soa.active[i] = 1;
+	}
+
+	// what the step reads or writes. the new CSphere is all physics state,
+	// so the whole object counts
+	std::vector<Range> oldRanges, newRanges, soaRanges;
+	Range r;
+	r.offset = offsetof(OldSphere, center_x); r.size = 3 * sizeof(float); oldRanges.push_back(r);
+	r.offset = offsetof(OldSphere, m_radius); r.size = sizeof(float); oldRanges.push_back(r);
+	r.offset = offsetof(OldSphere, m_meshScale); r.size = 3 * sizeof(float); oldRanges.push_back(r);
+	r.offset = offsetof(OldSphere, m_mLocal); r.size = sizeof(D3DXMATRIX); oldRanges.push_back(r);
+	r.offset = 0; r.size = sizeof(CSphere); newRanges.push_back(r);
+	r.offset = 0; r.size = 5 * sizeof(float); soaRanges.push_back(r);	// x, z, vx, vz, radius: one array each
+
+	Clock::time_point t0 = Clock::now();
+	for (unsigned int t = 0; t < ticks; t++)
+		for (size_t i = 0; i < count; i++)
+			before[i].ballUpdate(TICK);
+	const double beforeMs = msSince(t0);
+
+	t0 = Clock::now();
+	for (unsigned int t = 0; t < ticks; t++)
+		for (size_t i = 0; i < count; i++)
+			after[i].ballUpdate(TICK);
+	const double afterMs = msSince(t0);
+
+	TTablePhysics<FloatPolicy> table;
+	table.setTable(g_tableHalfX, g_tableHalfZ);
+	TIntegrateParams<FloatPolicy> p;
+	p.step = table.getTimeScale() * TICK;
+	p.rate = 1 - table.getDecay() * TICK;
+	if (p.rate < 0)
+		p.rate = 0;
+	p.minSpeed = table.getMinSpeed();
+	p.halfX = g_tableHalfX;
+	p.halfZ = g_tableHalfZ;
+	t0 = Clock::now();
+	for (unsigned int t = 0; t < ticks; t++)
+		integrateBalls<FloatPolicy>(soa, p, 0, count);
+	const double soaMs = msSince(t0);
+
+	size_t differ = 0;
+	float oldOff = 0;
+	for (size_t i = 0; i < count; i++) {
+		D3DXVECTOR3 c = after[i].getCenter();
+		if (c.x != soa.x[i] || c.z != soa.z[i] || after[i].getVelocity_X() != soa.vx[i] ||
+			after[i].getVelocity_Z() != soa.vz[i])
+			differ++;
+		D3DXVECTOR3 o = before[i].getCenter();
+		oldOff = std::max(oldOff, std::max(fabsf(o.x - c.x), fabsf(o.z - c.z)));
+	}
+
+	const size_t updates = (size_t)ticks * count;
+	printf("%u balls, %u ticks\n", (unsigned int)count, ticks);
+	print("old CSphere (double step)", sizeof(OldSphere), bytesPerBall(sizeof(OldSphere), oldRanges, count), beforeMs, updates);
+	print("CSphere (float step)", sizeof(CSphere), bytesPerBall(sizeof(CSphere), newRanges, count), afterMs, updates);
+	print("TBallSet<FloatPolicy>", soaRanges[0].size, bytesPerBall(soaRanges[0].size, soaRanges, count), soaMs, updates);
+	printf("  CSphereLook, drawing only: %u bytes\n", (unsigned int)sizeof(CSphereLook));
+	printf("CSphere against integrateBalls: %u of %u balls differ; old double step ends up to %.7f away\n",
+		(unsigned int)differ, (unsigned int)count, oldOff);
+	return differ == 0 ? 0 : 1;
+}
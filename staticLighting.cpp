@@ -0,0 +1,193 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: staticLighting.cpp
+//
+// Desc: Fixed-function vertex lighting on the CPU, baked into mesh copies.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "staticLighting.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const DWORD BAKED_FVF = D3DFVF_XYZ | D3DFVF_DIFFUSE | D3DFVF_SPECULAR;
+
+	float clamp01(float v)
+	{
+		return v < 0 ? 0 : (v > 1 ? 1 : v);
+	}
+
+	DWORD packColor(float r, float g, float b, float a)
+	{
+		return ((DWORD)(clamp01(a) * 255.0f + 0.5f) << 24) | ((DWORD)(clamp01(r) * 255.0f + 0.5f) << 16) |
+			((DWORD)(clamp01(g) * 255.0f + 0.5f) << 8) | (DWORD)(clamp01(b) * 255.0f + 0.5f);
+	}
+
+	// row vector times the matrix, as D3D transforms
+	void transformPoint(const D3DXMATRIX& m, float x, float y, float z, float out[3])
+	{
+		for (int k = 0; k < 3; k++)
+			out[k] = x * m.m[0][k] + y * m.m[1][k] + z * m.m[2][k] + m.m[3][k];
+	}
+
+	void transformNormal(const D3DXMATRIX& m, float x, float y, float z, float out[3])
+	{
+		for (int k = 0; k < 3; k++)
+			out[k] = x * m.m[0][k] + y * m.m[1][k] + z * m.m[2][k];
+	}
+
+	bool normalize(float v[3])
+	{
+		float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (len <= 0)
+			return false;
+		v[0] /= len;
+		v[1] /= len;
+		v[2] /= len;
+		return true;
+	}
+}
+
+D3DXVECTOR3 lighting::eyeOfView(const D3DXMATRIX& view)
+{
+	// view = [R 0; t 1] with R orthonormal: the eye is -t R^T
+	const float t[3] = { view.m[3][0], view.m[3][1], view.m[3][2] };
+	float eye[3];
+	for (int k = 0; k < 3; k++)
+		eye[k] = -(t[0] * view.m[k][0] + t[1] * view.m[k][1] + t[2] * view.m[k][2]);
+	return D3DXVECTOR3(eye[0], eye[1], eye[2]);
+}
+
+void lighting::lightVertices(const LightSetup& s, const D3DMATERIAL9& mtrl, const D3DXMATRIX& world,
+	const geometry::MeshVertex* vertices, size_t count, DWORD* diffuse, DWORD* specular)
+{
+	const D3DLIGHT9& l = s.light;
+	const bool point = l.Type != D3DLIGHT_DIRECTIONAL;
+	float toLight[3] = { -l.Direction.x, -l.Direction.y, -l.Direction.z };
+	if (!point)
+		normalize(toLight);
+
+	for (size_t i = 0; i < count; i++) {
+		const geometry::MeshVertex& v = vertices[i];
+		float p[3], n[3];
+		transformPoint(world, v.x, v.y, v.z, p);
+		transformNormal(world, v.nx, v.ny, v.nz, n);
+		normalize(n);
+
+		// ambient, diffuse and specular of the light before the material
+		float atten = 1, nl = 0, spec = 0;
+		float ldir[3] = { toLight[0], toLight[1], toLight[2] };
+		if (point) {
+			ldir[0] = l.Position.x - p[0];
+			ldir[1] = l.Position.y - p[1];
+			ldir[2] = l.Position.z - p[2];
+			float d = sqrtf(ldir[0] * ldir[0] + ldir[1] * ldir[1] + ldir[2] * ldir[2]);
+			if (d > l.Range)
+				atten = 0;
+			else {
+				float f = l.Attenuation0 + l.Attenuation1 * d + l.Attenuation2 * d * d;
+				atten = f > 0 ? 1 / f : 1;
+			}
+			normalize(ldir);
+		}
+		if (atten > 0) {
+			nl = n[0] * ldir[0] + n[1] * ldir[1] + n[2] * ldir[2];
+			if (nl > 0) {
+				float h[3] = { s.eye.x - p[0], s.eye.y - p[1], s.eye.z - p[2] };
+				normalize(h);
+				h[0] += ldir[0];
+				h[1] += ldir[1];
+				h[2] += ldir[2];
+				if (normalize(h)) {
+					float nh = n[0] * h[0] + n[1] * h[1] + n[2] * h[2];
+					if (nh > 0)
+						spec = powf(nh, mtrl.Power);
+				}
+			}
+			else
+				nl = 0;
+		}
+
+		const float da = atten * nl, sa = atten * spec;
+		diffuse[i] = packColor(
+			mtrl.Emissive.r + mtrl.Ambient.r * (s.ambient.r + atten * l.Ambient.r) + mtrl.Diffuse.r * l.Diffuse.r * da,
+			mtrl.Emissive.g + mtrl.Ambient.g * (s.ambient.g + atten * l.Ambient.g) + mtrl.Diffuse.g * l.Diffuse.g * da,
+			mtrl.Emissive.b + mtrl.Ambient.b * (s.ambient.b + atten * l.Ambient.b) + mtrl.Diffuse.b * l.Diffuse.b * da,
+			mtrl.Diffuse.a);
+		specular[i] = packColor(mtrl.Specular.r * l.Specular.r * sa, mtrl.Specular.g * l.Specular.g * sa,
+			mtrl.Specular.b * l.Specular.b * sa, 0);
+	}
+}
+
+lighting::CBakedMesh::CBakedMesh(void)
+{
+	m_mesh = NULL;
+	ZeroMemory(&m_mtrl, sizeof(m_mtrl));
+}
+
+lighting::CBakedMesh::~CBakedMesh(void)
+{
+}
+
+bool lighting::CBakedMesh::create(IDirect3DDevice9* pDevice, ID3DXMesh* mesh, const D3DMATERIAL9& mtrl)
+{
+	destroy();
+	if (pDevice == NULL || mesh == NULL || mesh->GetFVF() != (D3DFVF_XYZ | D3DFVF_NORMAL))
+		return false;
+
+	void* source = NULL;
+	if (FAILED(mesh->LockVertexBuffer(D3DLOCK_READONLY, &source)))
+		return false;
+	const geometry::MeshVertex* v = (const geometry::MeshVertex*)source;
+	m_vertices.assign(v, v + mesh->GetNumVertices());
+	mesh->UnlockVertexBuffer();
+
+	if (FAILED(mesh->CloneMeshFVF(D3DXMESH_MANAGED, BAKED_FVF, pDevice, &m_mesh))) {
+		m_mesh = NULL;
+		m_vertices.clear();
+		return false;
+	}
+	m_mtrl = mtrl;
+	m_diffuse.resize(m_vertices.size());
+	m_specular.resize(m_vertices.size());
+	return true;
+}
+
+void lighting::CBakedMesh::destroy(void)
+{
+	if (m_mesh != NULL) {
+		m_mesh->Release();
+		m_mesh = NULL;
+	}
+	m_vertices.clear();
+	m_diffuse.clear();
+	m_specular.clear();
+}
+
+bool lighting::CBakedMesh::bake(const LightSetup& s, const D3DXMATRIX& world)
+{
+	if (m_mesh == NULL)
+		return false;
+	lightVertices(s, m_mtrl, world, &m_vertices[0], m_vertices.size(), &m_diffuse[0], &m_specular[0]);
+
+	void* dest = NULL;
+	if (FAILED(m_mesh->LockVertexBuffer(0, &dest)))
+		return false;
+	BakedVertex* out = (BakedVertex*)dest;
+	for (size_t i = 0; i < m_vertices.size(); i++) {
+		out[i].diffuse = m_diffuse[i];
+		out[i].specular = m_specular[i];
+	}
+	m_mesh->UnlockVertexBuffer();
+	return true;
+}
+
+void lighting::CBakedMesh::draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& world) const
+{
+	if (pDevice == NULL || m_mesh == NULL)
+		return;
+	pDevice->SetTransform(D3DTS_WORLD, &world);
+	m_mesh->DrawSubset(0);
+}
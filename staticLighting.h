@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: staticLighting.h
+//
+// Desc: Lighting of the table and cushions baked into their vertices.
+//
+//       The plane and the walls do not move on the table, and the light
+//       does not move at all, yet with D3DRS_LIGHTING the device lights
+//       every one of their vertices again each frame, on the CPU when the
+//       device does software vertex processing. CBakedMesh keeps a copy of
+//       such a mesh with a diffuse and a specular colour per vertex,
+//       computed by lightVertices() once, and is drawn with lighting off;
+//       only the balls are lit by the device.
+//
+//       lightVertices() is the fixed-function model the device uses, in
+//       world space: one point or directional light with range and
+//       attenuation, the material's emissive, ambient, diffuse and
+//       specular colours, global ambient, a local viewer (the half vector
+//       of the directions to the light and to the eye) and specular only
+//       where the diffuse term is lit. Colours are clamped to [0, 1] as the
+//       device does before it interpolates them.
+//
+//       The light sits in world space while the mouse rotates the table
+//       under it (g_mWorld), so a bake holds for one world matrix: bake()
+//       again when it changes. Replays and headless renders never rotate,
+//       so they bake once.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __staticLightingH__
+#define __staticLightingH__
+
+#include "meshCache.h"
+#include <d3dx9.h>
+#include <vector>
+
+namespace lighting
+{
+	// everything but the material that lights a vertex
+	struct LightSetup
+	{
+		D3DLIGHT9		light;			// point or directional, world space
+		D3DXVECTOR3		eye;			// camera position, world space
+		D3DCOLORVALUE	ambient;		// D3DRS_AMBIENT
+	};
+
+	// the camera position of a view matrix
+	D3DXVECTOR3 eyeOfView(const D3DXMATRIX& view);
+
+	// D3DCOLOR diffuse (alpha from the material) and specular of count
+	// vertices drawn with world, as the device would light them
+	void lightVertices(const LightSetup& s, const D3DMATERIAL9& mtrl, const D3DXMATRIX& world,
+		const geometry::MeshVertex* vertices, size_t count, DWORD* diffuse, DWORD* specular);
+
+	class CBakedMesh {
+	public:
+		CBakedMesh(void);
+		~CBakedMesh(void);
+
+		// a copy of mesh (position and normal) with vertex colours for mtrl
+		bool create(IDirect3DDevice9* pDevice, ID3DXMesh* mesh, const D3DMATERIAL9& mtrl);
+		void destroy(void);
+
+		// the colours for the mesh drawn with world
+		bool bake(const LightSetup& s, const D3DXMATRIX& world);
+		// with D3DRS_LIGHTING off
+		void draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& world) const;
+
+		size_t getVertexCount(void) const { return m_vertices.size(); }
+
+	private:
+		struct BakedVertex {
+			float	x, y, z;
+			DWORD	diffuse;
+			DWORD	specular;
+		};
+
+		ID3DXMesh*							m_mesh;			// D3DFVF_XYZ | D3DFVF_DIFFUSE | D3DFVF_SPECULAR
+		std::vector<geometry::MeshVertex>	m_vertices;		// the source, for baking
+		std::vector<DWORD>					m_diffuse, m_specular;
+		D3DMATERIAL9						m_mtrl;
+	};
+}
+
+#endif // __staticLightingH__
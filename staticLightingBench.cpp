@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: staticLightingBench.cpp
+//
+// Desc: Vertex lighting per frame with the table lit every frame against
+//       the table baked once, on the CPU as software vertex processing
+//       does it.
+//
+//       staticLightingBench [balls] [frames]
+//
+//       The meshes are those of the default scene, from the mesh cache
+//       generator: the table top and four walls as boxes, every ball a
+//       50 x 50 sphere. The light and camera are those of Setup(). live
+//       runs lightVertices() over every vertex each frame; baked over the
+//       balls only, with the plane and walls lit once before the first
+//       frame. Prints the vertices lit per frame and the time per frame of
+//       each, and checks the model: the eye found from the view matrix, and
+//       the colour of the table top right under the light against the
+//       formula worked by hand.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "staticLighting.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const float TABLE_HALF_X = 4.5f, TABLE_HALF_Z = 3.0f;
+
+static double msSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static D3DCOLORVALUE colorValue(float r, float g, float b, float a)
+{
+	D3DCOLORVALUE c = { r, g, b, a };
+	return c;
+}
+
+static D3DMATERIAL9 material(float r, float g, float b)
+{
+	D3DMATERIAL9 m;
+	m.Ambient = m.Diffuse = m.Specular = colorValue(r, g, b, 1);
+	m.Emissive = colorValue(0, 0, 0, 0);
+	m.Power = 5.0f;
+	return m;
+}
+
+static D3DXMATRIX translation(float x, float y, float z)
+{
+	D3DXMATRIX m;
+	D3DXMatrixTranslation(&m, x, y, z);
+	return m;
+}
+
+struct Lit {
+	const geometry::MeshData*	mesh;
+	D3DMATERIAL9				mtrl;
+	D3DXMATRIX					world;
+};
+
+static size_t lightAll(const lighting::LightSetup& s, const std::vector<Lit>& lits, size_t first,
+	std::vector<DWORD>& diffuse, std::vector<DWORD>& specular)
+{
+	size_t count = 0;
+	for (size_t k = first; k < lits.size(); k++) {
+		const geometry::MeshData& d = *lits[k].mesh;
+		if (diffuse.size() < d.vertexCount) {
+			diffuse.resize(d.vertexCount);
+			specular.resize(d.vertexCount);
+		}
+		lighting::lightVertices(s, lits[k].mtrl, lits[k].world, d.vertices, d.vertexCount, &diffuse[0], &specular[0]);
+		count += d.vertexCount;
+	}
+	return count;
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned int balls = argc > 1 ? (unsigned int)atoi(argv[1]) : 16;
+	const unsigned int frames = argc > 2 ? (unsigned int)atoi(argv[2]) : 200;
+
+	std::vector<geometry::MeshParams> params;
+	params.push_back(geometry::boxParams(2 * TABLE_HALF_X, 0.03f, 2 * TABLE_HALF_Z));
+	params.push_back(geometry::boxParams(0.12f, 0.3f, 2 * TABLE_HALF_Z + 0.24f));
+	params.push_back(geometry::boxParams(2 * TABLE_HALF_X + 0.24f, 0.3f, 0.12f));
+	params.push_back(geometry::sphereParams(0.21f, 50, 50));
+	geometry::CMeshCache cache;
+	cache.load("", &params[0], params.size(), NULL);
+
+	// the light and camera of Setup(), nothing rotated
+	lighting::LightSetup s;
+	ZeroMemory(&s.light, sizeof(s.light));
+	s.light.Type = D3DLIGHT_POINT;
+	s.light.Diffuse = colorValue(1, 1, 1, 1);
+	s.light.Specular = colorValue(0.9f, 0.9f, 0.9f, 0.9f);
+	s.light.Ambient = colorValue(0.9f, 0.9f, 0.9f, 0.9f);
+	s.light.Position.x = 0;
+	s.light.Position.y = 3;
+	s.light.Position.z = 0;
+	s.light.Range = 100;
+	s.light.Attenuation1 = 0.9f;
+	s.ambient = colorValue(0, 0, 0, 0);
+	D3DXVECTOR3 eye(0.0f, 5.0f, -8.0f), at(0.0f, 0.0f, 0.0f), up(0.0f, 2.0f, 0.0f);
+	D3DXMATRIX view;
+	D3DXMatrixLookAtLH(&view, &eye, &at, &up);
+	s.eye = lighting::eyeOfView(view);
+
+	// plane and walls first, then the balls
+	std::vector<Lit> lits;
+	Lit plane = { &cache.get(0), material(0, 0.5f, 0), translation(0, -0.0006f, 0) };
+	lits.push_back(plane);
+	const float wx = TABLE_HALF_X + 0.06f, wz = TABLE_HALF_Z + 0.06f;
+	Lit walls[4] = {
+		{ &cache.get(1), material(0.5f, 0.25f, 0), translation(-wx, 0.12f, 0) },
+		{ &cache.get(1), material(0.5f, 0.25f, 0), translation(wx, 0.12f, 0) },
+		{ &cache.get(2), material(0.5f, 0.25f, 0), translation(0, 0.12f, -wz) },
+		{ &cache.get(2), material(0.5f, 0.25f, 0), translation(0, 0.12f, wz) },
+	};
+	lits.insert(lits.end(), walls, walls + 4);
+	const size_t staticCount = lits.size();
+	for (unsigned int i = 0; i < balls; i++) {
+		Lit b = { &cache.get(3), material(1, 0, 0),
+			translation(-3.5f + 7.0f * (i % 8) / 7, 0.21f, -2.0f + 4.0f * (i / 8) / (balls > 8 ? (balls - 1) / 8 : 1)) };
+		lits.push_back(b);
+	}
+
+	std::vector<DWORD> diffuse, specular;
+	size_t liveCount = 0, bakedCount = 0;
+	Clock::time_point t0 = Clock::now();
+	for (unsigned int f = 0; f < frames; f++)
+		liveCount = lightAll(s, lits, 0, diffuse, specular);
+	const double liveMs = msSince(t0) / frames;
+
+	t0 = Clock::now();
+	std::vector<DWORD> bakedDiffuse, bakedSpecular;
+	const size_t staticVertices = lightAll(s, std::vector<Lit>(lits.begin(), lits.begin() + staticCount), 0,
+		bakedDiffuse, bakedSpecular);
+	const double bakeMs = msSince(t0);
+	t0 = Clock::now();
+	for (unsigned int f = 0; f < frames; f++)
+		bakedCount = lightAll(s, lits, staticCount, diffuse, specular);
+	const double bakedMs = msSince(t0) / frames;
+
+	// the top of the table right under the light: n = l = (0, 1, 0) and
+	// the half vector leans towards the eye
+	const geometry::MeshVertex top = { 0, 0.015f, 0, 0, 1, 0 };
+	DWORD d, sp;
+	lighting::lightVertices(s, plane.mtrl, plane.world, &top, 1, &d, &sp);
+	const float dist = 3 - (0.015f - 0.0006f);
+	const float atten = 1 / (0.9f * dist);
+	const float g = 0.5f * 0.9f * atten + 0.5f * atten;
+	float h[3] = { eye.x, eye.y - (0.015f - 0.0006f), eye.z };
+	float len = sqrtf(h[0] * h[0] + h[1] * h[1] + h[2] * h[2]);
+	h[0] /= len; h[1] = h[1] / len + 1; h[2] /= len;
+	len = sqrtf(h[0] * h[0] + h[1] * h[1] + h[2] * h[2]);
+	const float sg = 0.5f * 0.9f * powf(h[1] / len, 5.0f) * atten;
+	const int expectG = (int)(std::min(g, 1.0f) * 255 + 0.5f), expectS = (int)(std::min(sg, 1.0f) * 255 + 0.5f);
+	const bool formulaOk = (int)((d >> 8) & 0xff) == expectG && (d >> 16 & 0xff) == 0 && (int)((sp >> 8) & 0xff) == expectS;
+	const bool eyeOk = fabsf(s.eye.x - eye.x) < 1e-4f && fabsf(s.eye.y - eye.y) < 1e-4f && fabsf(s.eye.z - eye.z) < 1e-4f;
+
+	printf("%u balls, %u static vertices, %u per ball\n", balls, (unsigned int)staticVertices, cache.get(3).vertexCount);
+	printf("  live:  %7u vertices lit per frame, %.3f ms per frame\n", (unsigned int)liveCount, liveMs);
+	printf("  baked: %7u vertices lit per frame, %.3f ms per frame, %.3f ms once for the bake\n",
+		(unsigned int)bakedCount, bakedMs, bakeMs);
+	printf("eye from the view matrix: %s; table under the light: green %d (expected %d), specular %d (expected %d): %s\n",
+		eyeOk ? "ok" : "WRONG", (int)((d >> 8) & 0xff), expectG, (int)((sp >> 8) & 0xff), expectS, formulaOk ? "ok" : "WRONG");
+	return eyeOk && formulaOk ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: substepBench.cpp
+//
+// Desc: Adaptive substeps (substepCount(), tablePhysics.h) against one whole
+//       step per tick.
+//
+//       substepBench [balls] [ticks]
+//
+//       First a cue ball at several speeds into a ball at rest, with the
+//       float table at the tick of a slow frame (50 ms). For each speed,
+//       with and without substeps: whether the cue ball hit the other one
+//       or passed through it, the speed it gave it, and the most parts a
+//       tick was cut into. A tick that moves the cue ball further than a
+//       ball's width jumps through the other ball without touching it.
+//
+//       Then a ball into a corner at an angle, checking that it stays on
+//       the table after every tick.
+//
+//       Then the fixed-point table over a random packing for the given
+//       ticks, once with every ball slow and once with a fast break, with
+//       and without substeps: time per tick and the parts of the last tick.
+//       A slow table is never cut, so the two times should match.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "tablePhysics.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+
+static const float SLOW_FRAME = 0.035f;		// timeDelta of a 50 ms frame
+static const float FIXED_TICK = 0.005f;
+static const int SHOT_TICKS = 200;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+// cue ball from x = -6 at speed into a ball at rest at the origin, until
+// they meet or the cue ball is past
+static void shotAtBall(float speed, int maxSubsteps, bool& hit, float& given, int& parts)
+{
+	typedef FloatPolicy P;
+	TBallSet<P> b;
+	b.resize(2);
+	b.x[0] = -6;	b.z[0] = 0;		b.vx[0] = speed;	b.vz[0] = 0;
+	b.x[1] = 0;		b.z[1] = 0;		b.vx[1] = 0;		b.vz[1] = 0;
+	b.type[0] = ENTITY_WHITE;
+	b.type[1] = ENTITY_RED;
+	b.active[0] = b.active[1] = 1;
+
+	TTablePhysics<P> table;
+	table.setTable(10, 3);
+	table.setMaxSubsteps(maxSubsteps);
+	CCollisionEventBuffer events;
+	hit = false;
+	parts = 1;
+	for (int t = 0; t < SHOT_TICKS && !hit && b.x[0] < b.x[1]; t++) {
+		events.clear();
+		table.step(b, SLOW_FRAME, events);
+		if (table.getLastSubsteps() > parts)
+			parts = table.getLastSubsteps();
+		hit = events.size() > 0;
+	}
+	given = b.vx[1];
+}
+
+// furthest a centre got past the line one radius inside the cushions
+static float intoCorner(void)
+{
+	typedef FloatPolicy P;
+	TBallSet<P> b;
+	b.resize(1);
+	b.x[0] = 3.5f;	b.z[0] = 2.2f;	b.vx[0] = 6;	b.vz[0] = 5;
+	b.type[0] = ENTITY_WHITE;
+	b.active[0] = 1;
+
+	TTablePhysics<P> table;
+	table.setTable(4.5f, 3.0f);
+	CCollisionEventBuffer events;
+	const float limitX = 4.5f - (float)M_RADIUS, limitZ = 3.0f - (float)M_RADIUS;
+	float worst = 0;
+	for (int t = 0; t < SHOT_TICKS; t++) {
+		table.step(b, SLOW_FRAME, events);
+		if (fabsf(b.x[0]) - limitX > worst) worst = fabsf(b.x[0]) - limitX;
+		if (fabsf(b.z[0]) - limitZ > worst) worst = fabsf(b.z[0]) - limitZ;
+	}
+	return worst;
+}
+
+static bool loadPacking(unsigned int count, float speed, TBallSet<FixedPolicy>& b, float& halfX, float& halfZ)
+{
+	scene::CSceneBuilder builder;
+	scene::generateRandomPacking(builder, count, 1);
+	std::vector<unsigned char> image;
+	builder.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size()))
+		return false;
+	const scene::SceneHeader& h = sc.header();
+	scene::CRandom rng(5);
+	b.resize(h.ballCount);
+	for (unsigned int i = 0; i < h.ballCount; i++) {
+		b.x[i] = FixedPolicy::fromFloat(sc.balls()[i].x);
+		b.z[i] = FixedPolicy::fromFloat(sc.balls()[i].z);
+		b.vx[i] = FixedPolicy::fromFloat((rng.unit() * 2 - 1) * speed);
+		b.vz[i] = FixedPolicy::fromFloat((rng.unit() * 2 - 1) * speed);
+		b.type[i] = sc.balls()[i].type;
+		b.active[i] = 1;
+	}
+	halfX = h.tableHalfX;
+	halfZ = h.tableHalfZ;
+	return true;
+}
+
+static double runPacking(unsigned int count, float speed, unsigned int ticks, int maxSubsteps, int& lastParts)
+{
+	TBallSet<FixedPolicy> b;
+	float halfX, halfZ;
+	if (!loadPacking(count, speed, b, halfX, halfZ))
+		return -1;
+	TTablePhysics<FixedPolicy> table;
+	table.setTable(halfX, halfZ);
+	table.setMaxSubsteps(maxSubsteps);
+	CCollisionEventBuffer events;
+	const int dt = FixedPolicy::fromFloat(FIXED_TICK);
+	Clock::time_point t0 = Clock::now();
+	for (unsigned int t = 0; t < ticks; t++) {
+		events.clear();
+		table.step(b, dt, events);
+	}
+	lastParts = table.getLastSubsteps();
+	return msSince(t0) / ticks;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+	unsigned int ticks = argc > 2 ? (unsigned int)atoi(argv[2]) : 50;
+
+	printf("cue ball into a ball at rest, %.0f ms frames\n", SLOW_FRAME / 0.0007f);
+	const float speeds[] = { 2, 5, 10, 20, 40 };
+	for (size_t k = 0; k < sizeof(speeds) / sizeof(speeds[0]); k++) {
+		bool wholeHit, subHit;
+		float wholeGiven, subGiven;
+		int wholeParts, subParts;
+		shotAtBall(speeds[k], 1, wholeHit, wholeGiven, wholeParts);
+		shotAtBall(speeds[k], MAX_SUBSTEPS, subHit, subGiven, subParts);
+		printf("  speed %4.0f: whole ticks %-12s (gave %6.2f), substeps %-12s (gave %6.2f, up to %d parts)\n",
+			speeds[k], wholeHit ? "hit" : "passed", wholeGiven, subHit ? "hit" : "passed", subGiven, subParts);
+	}
+
+	printf("ball into a corner: furthest past the cushion line %.4f\n", intoCorner());
+
+	const float packingSpeeds[] = { 0.5f, 8 };
+	for (size_t k = 0; k < 2; k++) {
+		int wholeParts, subParts;
+		double wholeMs = runPacking(count, packingSpeeds[k], ticks, 1, wholeParts);
+		double subMs = runPacking(count, packingSpeeds[k], ticks, MAX_SUBSTEPS, subParts);
+		if (wholeMs < 0 || subMs < 0) {
+			fprintf(stderr, "bad scene image\n");
+			return 1;
+		}
+		printf("%u balls, speeds up to %.1f: whole ticks %.3f ms/tick, substeps %.3f ms/tick (last tick %d parts)\n",
+			count, packingSpeeds[k], wholeMs, subMs, subParts);
+	}
+	return 0;
+}
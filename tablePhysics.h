@@ -0,0 +1,544 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: tablePhysics.h
+//
+// Desc: Table physics templated on a numeric policy (numericPolicy.h).
+//       It follows CSphere::ballUpdate, CWall::hitBy and CSphere::hitBy,
+//       but works on plain arrays of ball state instead of render objects.
+//       Cushions are the table rectangle, or an outline with pockets when a
+//       CCushionField is set (cushionField.h).
+//
+//       Balls may differ in radius and mass. While every ball has the
+//       standard radius, contacts are found with a sweep along x; otherwise
+//       a hierarchical grid (hierGrid.h) keeps the pair search near linear.
+//
+//       With FixedPolicy every operation is integer arithmetic in a fixed
+//       order, so the same inputs and tick length give bit-identical results
+//       on every host. This is what lockstep play and replay checks run on.
+//       The integration loop has an SSE4.1 path for FixedPolicy that gives
+//       the same bits as the scalar loop.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __tablePhysicsH__
+#define __tablePhysicsH__
+
+#include "numericPolicy.h"
+#include "tableTypes.h"
+#include "cushionField.h"
+#include "hierGrid.h"
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#include <smmintrin.h>
+#define TABLE_PHYSICS_SSE41
+#endif
+
+// -----------------------------------------------------------------------------
+// Ball state, one array per field
+// -----------------------------------------------------------------------------
+
+template<class P>
+struct TBallSet
+{
+	typedef typename P::Scalar Scalar;
+
+	std::vector<Scalar>			x, z;
+	std::vector<Scalar>			vx, vz;
+	std::vector<Scalar>			radius, mass;
+	std::vector<int>			type;
+	std::vector<unsigned char>	active;
+
+	// new balls have the standard radius and unit mass
+	void resize(size_t n)
+	{
+		x.resize(n);	z.resize(n);
+		vx.resize(n);	vz.resize(n);
+		radius.resize(n, P::fromFloat((float)M_RADIUS));
+		mass.resize(n, P::one());
+		type.resize(n);
+		active.resize(n);
+	}
+	size_t size(void) const { return x.size(); }
+
+	// a removed ball is parked with zero velocity, so integration and
+	// cushions leave it alone without checking the flag
+	void remove(size_t i)
+	{
+		active[i] = 0;
+		vx[i] = 0;
+		vz[i] = 0;
+	}
+
+	// FNV-1a over positions and velocities, for desync and replay checks
+	unsigned int hash(void) const
+	{
+		unsigned int h = 2166136261u;
+		for (size_t i = 0; i < x.size(); i++) {
+			const Scalar v[4] = { x[i], z[i], vx[i], vz[i] };
+			const unsigned char* p = (const unsigned char*)v;
+			for (size_t k = 0; k < sizeof(v); k++)
+				h = (h ^ p[k]) * 16777619u;
+		}
+		return h;
+	}
+
+	bool atRest(void) const
+	{
+		for (size_t i = 0; i < x.size(); i++) {
+			if (vx[i] != 0 || vz[i] != 0)
+				return false;
+		}
+		return true;
+	}
+};
+
+// removal hook for the collision rules (tableTypes.h)
+template<class P>
+void removeBall(TBallSet<P>* balls, unsigned int i) { balls->remove(i); }
+
+// -----------------------------------------------------------------------------
+// Integration (CSphere::ballUpdate)
+// -----------------------------------------------------------------------------
+
+template<class P>
+struct TIntegrateParams
+{
+	typename P::Scalar step;		// TIME_SCALE * dt
+	typename P::Scalar rate;		// velocity decay for this tick
+	typename P::Scalar minSpeed;	// below this on both axes the ball stops
+	typename P::Scalar halfX;		// a centre stays one radius inside these
+	typename P::Scalar halfZ;
+};
+
+template<class P>
+void integrateBallsScalar(TBallSet<P>& b, const TIntegrateParams<P>& p, size_t first, size_t last)
+{
+	typedef typename P::Scalar Scalar;
+
+	for (size_t i = first; i < last; i++) {
+		if (P::abs(b.vx[i]) > p.minSpeed || P::abs(b.vz[i]) > p.minSpeed) {
+			Scalar tX = b.x[i] + P::mul(p.step, b.vx[i]);
+			Scalar tZ = b.z[i] + P::mul(p.step, b.vz[i]);
+			Scalar limitX = p.halfX - b.radius[i];
+			Scalar limitZ = p.halfZ - b.radius[i];
+
+			// same correction as ballUpdate, on both axes
+			if (tX >= limitX)
+				tX = limitX;
+			else if (tX <= -limitX)
+				tX = -limitX;
+			if (tZ <= -limitZ)
+				tZ = -limitZ;
+			else if (tZ >= limitZ)
+				tZ = limitZ;
+
+			b.x[i] = tX;
+			b.z[i] = tZ;
+		}
+		else {
+			b.vx[i] = 0;
+			b.vz[i] = 0;
+		}
+		b.vx[i] = P::mul(b.vx[i], p.rate);
+		b.vz[i] = P::mul(b.vz[i], p.rate);
+	}
+}
+
+template<class P>
+void integrateBalls(TBallSet<P>& b, const TIntegrateParams<P>& p, size_t first, size_t last)
+{
+	integrateBallsScalar<P>(b, p, first, last);
+}
+
+#ifdef TABLE_PHYSICS_SSE41
+namespace tablePhysicsDetail
+{
+	// four Q16.16 products with a broadcast factor: (a * s) >> 16 per lane
+	inline __m128i mulQ16(__m128i a, __m128i s)
+	{
+		__m128i even = _mm_srli_epi64(_mm_mul_epi32(a, s), 16);
+		__m128i odd = _mm_slli_epi64(_mm_mul_epi32(_mm_srli_epi64(a, 32), s), 16);
+		return _mm_blend_epi16(even, odd, 0xcc);
+	}
+}
+
+template<>
+inline void integrateBalls<FixedPolicy>(TBallSet<FixedPolicy>& b, const TIntegrateParams<FixedPolicy>& p, size_t first, size_t last)
+{
+	using namespace tablePhysicsDetail;
+
+	const __m128i step = _mm_set1_epi32(p.step);
+	const __m128i rate = _mm_set1_epi32(p.rate);
+	const __m128i minSpeed = _mm_set1_epi32(p.minSpeed);
+	const __m128i halfX = _mm_set1_epi32(p.halfX);
+	const __m128i halfZ = _mm_set1_epi32(p.halfZ);
+
+	size_t i = first;
+	for (; i + 4 <= last; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*)&b.x[i]);
+		__m128i z = _mm_loadu_si128((const __m128i*)&b.z[i]);
+		__m128i vx = _mm_loadu_si128((const __m128i*)&b.vx[i]);
+		__m128i vz = _mm_loadu_si128((const __m128i*)&b.vz[i]);
+		__m128i r = _mm_loadu_si128((const __m128i*)&b.radius[i]);
+		__m128i hiX = _mm_sub_epi32(halfX, r), loX = _mm_sub_epi32(r, halfX);
+		__m128i hiZ = _mm_sub_epi32(halfZ, r), loZ = _mm_sub_epi32(r, halfZ);
+
+		__m128i moving = _mm_or_si128(_mm_cmpgt_epi32(_mm_abs_epi32(vx), minSpeed),
+			_mm_cmpgt_epi32(_mm_abs_epi32(vz), minSpeed));
+
+		__m128i tX = _mm_add_epi32(x, mulQ16(vx, step));
+		__m128i tZ = _mm_add_epi32(z, mulQ16(vz, step));
+
+		// each axis's else-if pair: the bound tested first wins
+		tX = _mm_min_epi32(_mm_max_epi32(tX, loX), hiX);
+		tZ = _mm_max_epi32(_mm_min_epi32(tZ, hiZ), loZ);
+
+		x = _mm_blendv_epi8(x, tX, moving);
+		z = _mm_blendv_epi8(z, tZ, moving);
+		vx = mulQ16(_mm_and_si128(vx, moving), rate);
+		vz = mulQ16(_mm_and_si128(vz, moving), rate);
+
+		_mm_storeu_si128((__m128i*)&b.x[i], x);
+		_mm_storeu_si128((__m128i*)&b.z[i], z);
+		_mm_storeu_si128((__m128i*)&b.vx[i], vx);
+		_mm_storeu_si128((__m128i*)&b.vz[i], vz);
+	}
+
+	// tail, same arithmetic one ball at a time
+	integrateBallsScalar<FixedPolicy>(b, p, i, last);
+}
+#endif // TABLE_PHYSICS_SSE41
+
+// -----------------------------------------------------------------------------
+// Substeps
+// -----------------------------------------------------------------------------
+
+// equal parts to cut a tick into so that the fastest ball moves no more than
+// SUBSTEP_TRAVEL of the smallest radius in each. step is TIME_SCALE * dt,
+// speed |vx| + |vz|, which is never less than the true speed. 1 when nothing
+// is that fast, at most maxParts
+template<class P>
+int substepCount(typename P::Scalar step, typename P::Scalar speed, typename P::Scalar radius, int maxParts)
+{
+	typedef typename P::Scalar Scalar;
+	const Scalar travel = P::mul(step, speed);
+	const Scalar limit = P::mul(P::fromFloat(SUBSTEP_TRAVEL), radius);
+	int parts = 1;
+	while (parts < maxParts && travel > limit * parts)
+		parts++;
+	return parts;
+}
+
+// -----------------------------------------------------------------------------
+// TTablePhysics
+// -----------------------------------------------------------------------------
+
+template<class P>
+class TTablePhysics
+{
+public:
+	typedef typename P::Scalar Scalar;
+
+	TTablePhysics(void)
+	{
+		m_radius = P::fromFloat((float)M_RADIUS);		// balls all this size use the sweep
+		m_minSpeed = P::fromFloat(0.01f);
+		m_timeScale = P::fromFloat(TIME_SCALE);
+		m_maxSubsteps = MAX_SUBSTEPS;
+		m_lastSubsteps = 1;
+		m_lastActive = 0;
+		m_decay = P::fromFloat((float)((1 - DECREASE_RATE) * 400));
+		setTable(4.5f, 3.0f);
+		m_slop = P::fromFloat(CUSHION_CONTACT_SLOP);
+		m_cushions = NULL;
+	}
+
+	void setTable(float halfX, float halfZ)
+	{
+		m_halfX = P::fromFloat(halfX);
+		m_halfZ = P::fromFloat(halfZ);
+	}
+
+	// a table outline instead of the four cushions along halfX, halfZ.
+	// setTable() still bounds the table. NULL goes back to the rectangle
+	void setCushions(const CCushionField* cushions) { m_cushions = cushions; }
+
+	// one tick of length dt. resolved ball-ball contacts go to events.
+	// a tick in which a ball would move more than SUBSTEP_TRAVEL of a radius
+	// runs as several equal substeps, each a whole tick of its own
+	void step(TBallSet<P>& b, Scalar dt, CCollisionEventBuffer& events)
+	{
+		Scalar speed = 0, radius = 0;
+		bool any = false;
+		const size_t n = b.size();
+		m_lastActive = 0;
+		for (size_t i = 0; i < n; i++) {
+			if (!b.active[i])
+				continue;
+			m_lastActive++;
+			Scalar s = P::abs(b.vx[i]) + P::abs(b.vz[i]);
+			if (s > speed) speed = s;
+			if (!any || b.radius[i] < radius) radius = b.radius[i];
+			any = true;
+		}
+
+		const int parts = any ? substepCount<P>(P::mul(m_timeScale, dt), speed, radius, m_maxSubsteps) : 1;
+		m_lastSubsteps = parts;
+		if (parts == 1) {
+			substep(b, dt, events);
+			return;
+		}
+		// the remainder goes to the last part, so the parts add up to dt
+		const Scalar part = dt / parts;
+		for (int k = 0; k < parts; k++)
+			substep(b, k + 1 < parts ? part : dt - part * (parts - 1), events);
+	}
+
+	// what step() works with, for the closed form of fastForward.h
+	Scalar getHalfX(void) const { return m_halfX; }
+	Scalar getHalfZ(void) const { return m_halfZ; }
+	Scalar getMinSpeed(void) const { return m_minSpeed; }
+	Scalar getTimeScale(void) const { return m_timeScale; }
+	Scalar getDecay(void) const { return m_decay; }
+	Scalar getCushionSlop(void) const { return m_slop; }
+	const CCushionField* getCushions(void) const { return m_cushions; }
+	int getMaxSubsteps(void) const { return m_maxSubsteps; }
+
+	// 1 runs every tick whole, as before substeps
+	void setMaxSubsteps(int maxSubsteps) { m_maxSubsteps = maxSubsteps < 1 ? 1 : maxSubsteps; }
+	int getLastSubsteps(void) const { return m_lastSubsteps; }
+	// balls on the table when the last step() began
+	unsigned int getLastActiveCount(void) const { return m_lastActive; }
+
+	// VK_SPACE: shoot the cue ball towards the target with power = distance
+	static void shot(TBallSet<P>& b, int cue, Scalar targetX, Scalar targetZ)
+	{
+		Scalar dx = targetX - b.x[cue];
+		Scalar dz = targetZ - b.z[cue];
+		Scalar distance = P::sqrt(P::mul(dx, dx) + P::mul(dz, dz));
+		Scalar s, c;
+		P::sinCos(P::atan2(dz, dx), s, c);
+		b.vx[cue] = P::mul(distance, c);
+		b.vz[cue] = P::mul(distance, s);
+	}
+
+private:
+	void substep(TBallSet<P>& b, Scalar dt, CCollisionEventBuffer& events)
+	{
+		TIntegrateParams<P> p;
+		p.step = P::mul(m_timeScale, dt);
+		p.rate = P::one() - P::mul(m_decay, dt);
+		if (p.rate < 0)
+			p.rate = 0;
+		p.minSpeed = m_minSpeed;
+		p.halfX = m_halfX;
+		p.halfZ = m_halfZ;
+
+		integrateBalls<P>(b, p, 0, b.size());
+		bounceWalls(b);
+		collidePairs(b, events);
+	}
+
+	// CWall::hitBy
+	void bounceWalls(TBallSet<P>& b)
+	{
+		if (m_cushions != NULL) {
+			bounceCushions(b);
+			return;
+		}
+		const size_t n = b.size();
+		for (size_t i = 0; i < n; i++) {
+			const Scalar r = b.radius[i];
+			if (b.x[i] - r <= -m_halfX) {
+				b.vx[i] = P::abs(b.vx[i]);
+				b.x[i] = -m_halfX + r;
+			}
+			if (b.x[i] + r >= m_halfX) {
+				b.vx[i] = -P::abs(b.vx[i]);
+				b.x[i] = m_halfX - r;
+			}
+			if (b.z[i] - r <= -m_halfZ) {
+				b.vz[i] = P::abs(b.vz[i]);
+				b.z[i] = -m_halfZ + r;
+			}
+			if (b.z[i] + r >= m_halfZ) {
+				b.vz[i] = -P::abs(b.vz[i]);
+				b.z[i] = m_halfZ - r;
+			}
+		}
+	}
+
+	// CSphere::hitCushions: back out along the field normal to one radius
+	// from the cushion and reflect the normal velocity if it points in
+	void bounceCushions(TBallSet<P>& b)
+	{
+		const size_t n = b.size();
+		for (size_t i = 0; i < n; i++) {
+			if (!b.active[i])
+				continue;
+			Scalar d, nx, nz;
+			int pocket;
+			m_cushions->sample(b.x[i], b.z[i], d, nx, nz, pocket);
+			if (pocket >= 0) {
+				b.remove(i);
+				continue;
+			}
+			const Scalar r = b.radius[i];
+			if (d >= r + m_slop)
+				continue;
+			// where the normals around a point disagree (a ridge between two
+			// cushions) their blend is short and says little, and in Q16.16
+			// it would not normalize to unit length
+			Scalar len = P::sqrt(P::mul(nx, nx) + P::mul(nz, nz));
+			if (len < P::one() / 2)
+				continue;
+			nx = P::div(nx, len);
+			nz = P::div(nz, len);
+			if (d < r) {
+				b.x[i] += P::mul(r - d, nx);
+				b.z[i] += P::mul(r - d, nz);
+			}
+			Scalar vn = P::mul(b.vx[i], nx) + P::mul(b.vz[i], nz);
+			if (vn < 0) {
+				b.vx[i] -= 2 * P::mul(vn, nx);
+				b.vz[i] -= 2 * P::mul(vn, nz);
+			}
+		}
+	}
+
+	// sweep along x. ties are broken by index so the pair order, and with
+	// it the result, only depends on the state. obstacles of any size stay
+	// out of the sweep and are tested after it, one at a time in index
+	// order, against the balls within their reach
+	void collidePairs(TBallSet<P>& b, CCollisionEventBuffer& events)
+	{
+		const int n = (int)b.size();
+		bool obstacles = false;
+		for (int i = 0; i < n; i++) {
+			if (!b.active[i])
+				continue;
+			if (b.type[i] == ENTITY_OBSTACLE) {
+				obstacles = true;
+				continue;
+			}
+			if (b.radius[i] != m_radius) {
+				collideGrid(b, events);
+				return;
+			}
+		}
+		const Scalar contact = 2 * m_radius;
+
+		m_order.resize(n);
+		for (int i = 0; i < n; i++)
+			m_order[i] = i;
+		const std::vector<Scalar>& x = b.x;
+		std::sort(m_order.begin(), m_order.end(),
+			[&](int l, int r) { return x[l] < x[r] || (x[l] == x[r] && l < r); });
+
+		for (int p = 0; p < n; p++) {
+			int i = m_order[p];
+			if (!b.active[i] || b.type[i] == ENTITY_OBSTACLE) continue;
+			for (int q = p + 1; q < n && x[m_order[q]] - x[i] <= contact; q++) {
+				int j = m_order[q];
+				if (!b.active[j] || b.type[j] == ENTITY_OBSTACLE) continue;
+				int lo = std::min(i, j), hi = std::max(i, j);
+				if (collide(b, lo, hi))
+					events.push(lo, hi, b.type[lo], b.type[hi]);
+			}
+		}
+
+		if (!obstacles)
+			return;
+		// two obstacles are not tested against each other
+		for (int o = 0; o < n; o++) {
+			if (!b.active[o] || b.type[o] != ENTITY_OBSTACLE) continue;
+			const Scalar reach = b.radius[o] + m_radius;
+			std::vector<int>::const_iterator it = std::lower_bound(m_order.begin(), m_order.end(), x[o] - reach,
+				[&](int l, Scalar value) { return x[l] < value; });
+			for (; it != m_order.end() && x[*it] <= x[o] + reach; ++it) {
+				int j = *it;
+				if (!b.active[j] || b.type[j] == ENTITY_OBSTACLE) continue;
+				int lo = std::min(o, j), hi = std::max(o, j);
+				if (collide(b, lo, hi))
+					events.push(lo, hi, b.type[lo], b.type[hi]);
+			}
+		}
+	}
+
+	// mixed radii. collide() moves no ball, so the grid stays valid
+	// through the pass
+	void collideGrid(TBallSet<P>& b, CCollisionEventBuffer& events)
+	{
+		m_grid.build(&b.x[0], &b.z[0], &b.radius[0], &b.active[0], (int)b.size());
+		m_grid.forEachPair([&](int i, int j) {
+			int lo = std::min(i, j), hi = std::max(i, j);
+			if (collide(b, lo, hi))
+				events.push(lo, hi, b.type[lo], b.type[hi]);
+		});
+	}
+
+	// CSphere::hitBy
+	bool collide(TBallSet<P>& b, int i, int j)
+	{
+		Scalar dx = b.x[i] - b.x[j];
+		Scalar dz = b.z[i] - b.z[j];
+		Scalar contact = b.radius[i] + b.radius[j];
+		if (P::abs(dz) > contact)
+			return false;
+		Scalar dist2 = P::mul(dx, dx) + P::mul(dz, dz);
+		if (dist2 > P::mul(contact, contact))
+			return false;
+		Scalar dist = P::sqrt(dist2);
+		if (dist <= 0)
+			return false;
+
+		Scalar nx = P::div(dx, dist), nz = P::div(dz, dist);
+		Scalar tx = -nz, tz = nx;
+
+		Scalar iNormal = P::mul(nx, b.vx[i]) + P::mul(nz, b.vz[i]);
+		Scalar jNormal = P::mul(nx, b.vx[j]) + P::mul(nz, b.vz[j]);
+		Scalar iTangent = P::mul(tx, b.vx[i]) + P::mul(tz, b.vz[i]);
+		Scalar jTangent = P::mul(tx, b.vx[j]) + P::mul(tz, b.vz[j]);
+
+		bool iStatic = b.type[i] == ENTITY_OBSTACLE, jStatic = b.type[j] == ENTITY_OBSTACLE;
+		if (iStatic)
+			jNormal = -jNormal;
+		else if (jStatic)
+			iNormal = -iNormal;
+		else if (b.mass[i] == b.mass[j])
+			std::swap(iNormal, jNormal);
+		else {
+			// elastic along the normal, with mass fractions so that Q16.16
+			// products stay in range
+			Scalar total = b.mass[i] + b.mass[j];
+			Scalar fi = P::div(b.mass[i], total), fj = P::div(b.mass[j], total);
+			Scalar newI = P::mul(fi - fj, iNormal) + 2 * P::mul(fj, jNormal);
+			Scalar newJ = P::mul(fj - fi, jNormal) + 2 * P::mul(fi, iNormal);
+			iNormal = newI;
+			jNormal = newJ;
+		}
+
+		b.vx[i] = P::mul(iNormal, nx) + P::mul(iTangent, tx);
+		b.vz[i] = P::mul(iNormal, nz) + P::mul(iTangent, tz);
+		b.vx[j] = P::mul(jNormal, nx) + P::mul(jTangent, tx);
+		b.vz[j] = P::mul(jNormal, nz) + P::mul(jTangent, tz);
+		return true;
+	}
+
+	Scalar				m_halfX, m_halfZ;
+	Scalar				m_radius;
+	Scalar				m_minSpeed;
+	Scalar				m_timeScale;
+	Scalar				m_decay;
+	int					m_maxSubsteps;
+	int					m_lastSubsteps;		// parts the last step() was cut into
+	unsigned int		m_lastActive;
+	Scalar				m_slop;
+	const CCushionField*	m_cushions;
+	std::vector<int>	m_order;
+	THierGrid<P>		m_grid;
+};
+
+#endif // __tablePhysicsH__
@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: tableServer.cpp
+//
+// Desc: Headless multi-table server.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "tableServer.h"
+#include <algorithm>
+#include <chrono>
+
+// -----------------------------------------------------------------------------
+// CTableInstance
+// -----------------------------------------------------------------------------
+
+CTableInstance::CTableInstance(void)
+{
+	m_cue = 0;
+	m_atRest = true;
+	m_pending = SHOT_NONE;
+	m_shotX = 0;
+	m_shotZ = 0;
+	m_ticks = 0;
+}
+
+void CTableInstance::load(const scene::CSceneFile& sc)
+{
+	std::shared_ptr<CCushionField> cushions = std::make_shared<CCushionField>();
+	if (cushions->build(sc))
+		load(sc, cushions);
+	else
+		load(sc, NULL);
+}
+
+void CTableInstance::load(const scene::CSceneFile& sc, const std::shared_ptr<const CCushionField>& cushions)
+{
+	const scene::SceneHeader& h = sc.header();
+	m_cushions = cushions;
+	m_table.setTable(h.tableHalfX, h.tableHalfZ);
+	m_table.setCushions(m_cushions.get());
+
+	// balls, then the obstacles as balls that never move
+	m_balls.resize(h.ballCount + h.obstacleCount);
+	for (unsigned int i = 0; i < h.ballCount; i++) {
+		const scene::SceneBall& s = sc.balls()[i];
+		m_balls.x[i] = FixedPolicy::fromFloat(s.x);
+		m_balls.z[i] = FixedPolicy::fromFloat(s.z);
+		m_balls.vx[i] = FixedPolicy::fromFloat(s.vx);
+		m_balls.vz[i] = FixedPolicy::fromFloat(s.vz);
+		m_balls.radius[i] = FixedPolicy::fromFloat(sc.ballRadius(i));
+		m_balls.mass[i] = FixedPolicy::fromFloat(sc.ballMass(i));
+		m_balls.type[i] = s.type;
+		m_balls.active[i] = 1;
+	}
+	for (unsigned int k = 0; k < h.obstacleCount; k++) {
+		const scene::SceneObstacle& o = sc.obstacles()[k];
+		const unsigned int i = h.ballCount + k;
+		m_balls.x[i] = FixedPolicy::fromFloat(o.x);
+		m_balls.z[i] = FixedPolicy::fromFloat(o.z);
+		m_balls.vx[i] = 0;
+		m_balls.vz[i] = 0;
+		m_balls.radius[i] = FixedPolicy::fromFloat(o.radius);
+		m_balls.mass[i] = FixedPolicy::one();
+		m_balls.type[i] = ENTITY_OBSTACLE;
+		m_balls.active[i] = 1;
+	}
+	m_cue = h.cueIndex;
+	m_atRest = m_balls.atRest();
+	m_pending = SHOT_NONE;
+	m_ticks = 0;
+}
+
+void CTableInstance::queueShot(int targetX, int targetZ)
+{
+	m_pending = SHOT_TARGET;
+	m_shotX = targetX;
+	m_shotZ = targetZ;
+}
+
+void CTableInstance::queuePower(int vx, int vz)
+{
+	m_pending = SHOT_POWER;
+	m_shotX = vx;
+	m_shotZ = vz;
+}
+
+void CTableInstance::step(int dt)
+{
+	if (m_pending == SHOT_TARGET)
+		TTablePhysics<FixedPolicy>::shot(m_balls, m_cue, m_shotX, m_shotZ);
+	else if (m_pending == SHOT_POWER) {
+		m_balls.vx[m_cue] = m_shotX;
+		m_balls.vz[m_cue] = m_shotZ;
+	}
+	m_pending = SHOT_NONE;
+
+	m_events.clear();
+	m_table.step(m_balls, dt, m_events);
+	dispatchCollisionEvents(m_events, &m_balls);
+	m_atRest = m_balls.atRest();
+	m_ticks++;
+}
+
+unsigned int CTableInstance::runToRest(int dt, unsigned int maxTicks)
+{
+	unsigned int ticks = 0;
+	while (needsStep() && ticks < maxTicks) {
+		step(dt);
+		ticks++;
+	}
+	return ticks;
+}
+
+// -----------------------------------------------------------------------------
+// CTableServer
+// -----------------------------------------------------------------------------
+
+CTableServer::CTableServer(CWorkerPool& pool, float tickSeconds)
+	: m_pool(pool)
+{
+	m_tickSeconds = tickSeconds;
+	m_dt = FixedPolicy::fromFloat(tickSeconds);
+	m_stepUsSum = 0;
+	m_steps = 0;
+}
+
+CTableServer::~CTableServer(void)
+{
+	for (size_t i = 0; i < m_tables.size(); i++)
+		delete m_tables[i];
+}
+
+// the table size, jaw radius, outline and pockets a cushion field is built
+// from, as bytes
+static void cushionKey(const scene::CSceneFile& sc, std::vector<unsigned char>& key)
+{
+	const scene::SceneHeader& h = sc.header();
+	const float sizes[3] = { h.tableHalfX, h.tableHalfZ, h.jawRadius };
+	const unsigned char* p = (const unsigned char*)sizes;
+	key.assign(p, p + sizeof(sizes));
+	p = (const unsigned char*)sc.outline();
+	key.insert(key.end(), p, p + h.outlineCount * sizeof(scene::SceneOutlinePoint));
+	p = (const unsigned char*)sc.pockets();
+	key.insert(key.end(), p, p + h.pocketCount * sizeof(scene::ScenePocket));
+}
+
+unsigned int CTableServer::addTable(const scene::CSceneFile& sc)
+{
+	CTableInstance* t = new CTableInstance();
+	if (sc.header().outlineCount == 0)
+		t->load(sc, NULL);
+	else {
+		std::vector<unsigned char> key;
+		cushionKey(sc, key);
+		if (m_cushions == NULL || key != m_cushionKey) {
+			t->load(sc);
+			m_cushions = t->getCushions();
+			m_cushionKey.swap(key);
+		}
+		else
+			t->load(sc, m_cushions);
+	}
+	m_tables.push_back(t);
+	return (unsigned int)m_tables.size() - 1;
+}
+
+void CTableServer::tick(void)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	m_active.clear();
+	for (unsigned int i = 0; i < m_tables.size(); i++) {
+		if (m_tables[i]->needsStep())
+			m_active.push_back(i);
+	}
+	m_stepUs.resize(m_active.size());
+
+	// one task per table. each task writes only its own table and timing
+	// slot, so nothing is shared between workers.
+	m_pool.parallelFor((int)m_active.size(), [this](int k) {
+		Clock::time_point t0 = Clock::now();
+		m_tables[m_active[k]]->step(m_dt);
+		m_stepUs[k] = std::chrono::duration<float, std::micro>(Clock::now() - t0).count();
+	});
+
+	for (size_t k = 0; k < m_stepUs.size(); k++)
+		m_stepUsSum += m_stepUs[k];
+	m_steps += m_active.size();
+	m_tickUs.push_back(std::chrono::duration<float, std::micro>(Clock::now() - start).count());
+}
+
+void CTableServer::takeMetrics(TableServerMetrics& m)
+{
+	m.tables = (unsigned int)m_tables.size();
+	m.cores = (unsigned int)m_pool.getThreadCount() + 1;
+	m.ticks = (unsigned int)m_tickUs.size();
+	m.activeMean = m.ticks > 0 ? (double)m_steps / m.ticks : 0.0;
+	m.stepMeanUs = m_steps > 0 ? m_stepUsSum / m_steps : 0.0;
+	m.tablesPerCore = (double)m.tables / m.cores;
+
+	m.tickP50Us = m.tickP95Us = m.tickP99Us = m.tickMaxUs = 0;
+	if (!m_tickUs.empty()) {
+		std::sort(m_tickUs.begin(), m_tickUs.end());
+		size_t n = m_tickUs.size();
+		m.tickP50Us = m_tickUs[n / 2];
+		m.tickP95Us = m_tickUs[std::min(n - 1, n * 95 / 100)];
+		m.tickP99Us = m_tickUs[std::min(n - 1, n * 99 / 100)];
+		m.tickMaxUs = m_tickUs[n - 1];
+	}
+
+	// step cost per hosted table per tick, at the activity seen in this window
+	double costPerTable = (m.tables > 0 && m.ticks > 0) ? m_stepUsSum / ((double)m.tables * m.ticks) : 0.0;
+	m.capacityPerCore = costPerTable > 0 ? m_tickSeconds * 1e6 / costPerTable : 0.0;
+
+	m_tickUs.clear();
+	m_stepUsSum = 0;
+	m_steps = 0;
+}
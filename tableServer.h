@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: tableServer.h
+//
+// Desc: Headless server hosting many independent tables in one process.
+//
+//       A CTableInstance is one complete table: fixed-point ball state,
+//       physics and collision events. It uses no globals, so any number can
+//       live side by side. It loads a scene as the game does: obstacles
+//       after the balls, as static balls, and the cushion outline with its
+//       pockets when the scene has one. The outline's field is read only
+//       and shared by every table built from the same outline.
+//
+//       CTableServer owns the instances and steps them as tasks on a shared
+//       CWorkerPool. A table at rest with no shot pending is not stepped at
+//       all, so idle tables cost nothing per tick.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __tableServerH__
+#define __tableServerH__
+
+#include "tablePhysics.h"
+#include "cushionField.h"
+#include "workerPool.h"
+#include <vector>
+#include <memory>
+
+// -----------------------------------------------------------------------------
+// CTableInstance
+// -----------------------------------------------------------------------------
+
+class CTableInstance {
+public:
+	CTableInstance(void);
+
+	// builds a cushion field when the scene has an outline
+	void load(const scene::CSceneFile& sc);
+	// with the field already built for this scene's outline, or NULL
+	void load(const scene::CSceneFile& sc, const std::shared_ptr<const CCushionField>& cushions);
+
+	// applied at the start of the next tick, FixedPolicy units.
+	// queueShot aims at a target like VK_SPACE; queuePower sets the cue
+	// velocity directly like setPower.
+	void queueShot(int targetX, int targetZ);
+	void queuePower(int vx, int vz);
+
+	bool needsStep(void) const { return m_pending != SHOT_NONE || !m_atRest; }
+	bool isAtRest(void) const { return m_atRest && m_pending == SHOT_NONE; }
+
+	// one server tick of length dt. not thread safe per instance; the
+	// server never runs the same table on two threads.
+	void step(int dt);
+	// steps until the table is at rest; returns the number of ticks
+	unsigned int runToRest(int dt, unsigned int maxTicks);
+
+	const TBallSet<FixedPolicy>& getBalls(void) const { return m_balls; }
+	unsigned int getCue(void) const { return m_cue; }
+	const std::shared_ptr<const CCushionField>& getCushions(void) const { return m_cushions; }
+	unsigned long long getTicks(void) const { return m_ticks; }
+
+private:
+	enum PendingShot { SHOT_NONE, SHOT_TARGET, SHOT_POWER };
+
+	TBallSet<FixedPolicy>			m_balls;
+	TTablePhysics<FixedPolicy>		m_table;
+	std::shared_ptr<const CCushionField>	m_cushions;	// what m_table points at, NULL for the rectangle
+	CCollisionEventBuffer			m_events;
+	unsigned int					m_cue;
+	bool							m_atRest;
+	PendingShot						m_pending;
+	int								m_shotX, m_shotZ;	// target or velocity
+	unsigned long long				m_ticks;
+};
+
+// -----------------------------------------------------------------------------
+// CTableServer
+// -----------------------------------------------------------------------------
+
+struct TableServerMetrics
+{
+	unsigned int		tables;
+	unsigned int		cores;				// pool threads + the calling thread
+	unsigned int		ticks;				// server ticks in the window
+	double				activeMean;			// tables stepped per tick
+	double				tickP50Us;			// whole server tick, percentiles
+	double				tickP95Us;
+	double				tickP99Us;
+	double				tickMaxUs;
+	double				stepMeanUs;			// one table, one tick
+	double				tablesPerCore;		// hosted now
+	double				capacityPerCore;	// at this activity level, if a tick may take the whole period
+};
+
+class CTableServer {
+public:
+	CTableServer(CWorkerPool& pool, float tickSeconds);
+	~CTableServer(void);
+
+	unsigned int addTable(const scene::CSceneFile& sc);
+	CTableInstance& getTable(unsigned int id) { return *m_tables[id]; }
+	unsigned int getTableCount(void) const { return (unsigned int)m_tables.size(); }
+
+	// steps every table that needs it, in parallel
+	void tick(void);
+
+	// metrics since the previous call
+	void takeMetrics(TableServerMetrics& m);
+
+private:
+	CTableServer(const CTableServer&);
+	CTableServer& operator=(const CTableServer&);
+
+	CWorkerPool&					m_pool;
+	float							m_tickSeconds;
+	int								m_dt;
+	std::vector<CTableInstance*>	m_tables;
+
+	// the field of the last outline loaded, and what it was built from
+	std::shared_ptr<const CCushionField>	m_cushions;
+	std::vector<unsigned char>		m_cushionKey;
+
+	std::vector<unsigned int>		m_active;		// tables stepped this tick
+	std::vector<float>				m_stepUs;		// per entry of m_active
+
+	// metrics window
+	std::vector<float>				m_tickUs;
+	double							m_stepUsSum;
+	unsigned long long				m_steps;
+};
+
+#endif // __tableServerH__
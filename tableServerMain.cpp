@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: tableServerMain.cpp
+//
+// Desc: Runs CTableServer with simulated players.
+//
+//       tableServer <tables> <seconds> [threads] [rack rows]
+//
+//       Every table starts from the same rack. A player waits a random
+//       think time (one to six seconds) after the table comes to rest and
+//       then shoots the cue ball at a random live ball. The server ticks at
+//       SERVER_HZ in real time and prints its metrics once a second.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "tableServer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+
+static const int SERVER_HZ = 60;
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <tables> <seconds> [threads] [rack rows]\n", argv[0]);
+		return 1;
+	}
+	unsigned int tableCount = (unsigned int)atoi(argv[1]);
+	int seconds = atoi(argv[2]);
+	int threads = argc > 3 ? atoi(argv[3]) : -1;
+	unsigned int rows = argc > 4 ? (unsigned int)atoi(argv[4]) : 5;
+
+	scene::CSceneBuilder b;
+	scene::generateRack(b, rows, 1);
+	std::vector<unsigned char> image;
+	b.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size())) {
+		fprintf(stderr, "bad scene image\n");
+		return 1;
+	}
+
+	CWorkerPool pool(threads);
+	CTableServer server(pool, 1.0f / SERVER_HZ);
+	for (unsigned int i = 0; i < tableCount; i++)
+		server.addTable(sc);
+
+	// per table: ticks left before the player shoots
+	scene::CRandom rng(12345);
+	std::vector<int> thinkTicks(tableCount);
+	for (unsigned int i = 0; i < tableCount; i++)
+		thinkTicks[i] = SERVER_HZ + (int)(rng.next() % (5 * SERVER_HZ));
+
+	printf("%u tables of %u balls on %d threads at %d Hz\n",
+		tableCount, sc.header().ballCount, pool.getThreadCount() + 1, SERVER_HZ);
+
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration period = std::chrono::microseconds(1000000 / SERVER_HZ);
+	Clock::time_point start = Clock::now();
+	Clock::time_point next = start;
+	Clock::time_point lastReport = start;
+
+	while (Clock::now() - start < std::chrono::seconds(seconds)) {
+		// players
+		for (unsigned int i = 0; i < tableCount; i++) {
+			CTableInstance& t = server.getTable(i);
+			if (!t.isAtRest() || --thinkTicks[i] > 0)
+				continue;
+			const TBallSet<FixedPolicy>& balls = t.getBalls();
+			unsigned int target = rng.next() % (unsigned int)balls.size();
+			while (target == t.getCue() || !balls.active[target])
+				target = (target + 1) % (unsigned int)balls.size();
+			t.queueShot(balls.x[target], balls.z[target]);
+			thinkTicks[i] = SERVER_HZ + (int)(rng.next() % (5 * SERVER_HZ));
+		}
+
+		server.tick();
+
+		next += period;
+		std::this_thread::sleep_until(next);
+
+		Clock::time_point now = Clock::now();
+		if (now - lastReport >= std::chrono::seconds(1)) {
+			TableServerMetrics m;
+			server.takeMetrics(m);
+			printf("tables %u (%.0f/core)  active %.0f  tick p50 %.0f  p95 %.0f  p99 %.0f  max %.0f us  "
+				"step %.1f us  capacity %.0f tables/core\n",
+				m.tables, m.tablesPerCore, m.activeMean, m.tickP50Us, m.tickP95Us, m.tickP99Us, m.tickMaxUs,
+				m.stepMeanUs, m.capacityPerCore);
+			fflush(stdout);
+			lastReport = now;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: tableTypes.h
+//
+// Desc: Table constants and the collision event bus. Nothing in here needs
+//       Direct3D, so headless tools can use it together with tablePhysics.h.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __tableTypesH__
+#define __tableTypesH__
+
+#include "sceneTypes.h"
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+#define M_RADIUS 0.21   // ball radius
+#define PI 3.14159265
+#define M_HEIGHT 0.01
+#define DECREASE_RATE 0.9982
+#define TIME_SCALE 3.3f		// distance per unit of velocity and tick time
+#define SUBSTEP_TRAVEL 0.5f	// most of its radius a ball moves in one substep
+#define MAX_SUBSTEPS 16
+//added preprocessors
+#define BLOCK_WIDTH 0.8f
+#define BLOCK_HEIGHT 0.4f
+#define PADDLE_WIDTH 2.0f
+#define PADDLE_HEIGHT 0.3f
+#define BALL_SPEED 3.0f
+#define PADDLE_SPEED 4.0f
+
+// -----------------------------------------------------------------------------
+// Collision events and rule dispatch
+// -----------------------------------------------------------------------------
+
+// One entry per resolved ball-ball contact. The physics step only appends to
+// the buffer; the rules run afterwards over the whole batch.
+struct CollisionEvent {
+	unsigned int			a, b;			// ball indices
+	unsigned char			typeA, typeB;	// EntityType of a and b
+};
+
+class CCollisionEventBuffer {
+public:
+	void clear(void) { m_events.clear(); }
+	void reserve(size_t n) { m_events.reserve(n); }
+
+	void push(int a, int b, int typeA, int typeB)
+	{
+		CollisionEvent e;
+		e.a = (unsigned int)a;	e.b = (unsigned int)b;
+		e.typeA = (unsigned char)typeA;	e.typeB = (unsigned char)typeB;
+		m_events.push_back(e);
+	}
+
+	void append(const CCollisionEventBuffer& other)
+	{
+		m_events.insert(m_events.end(), other.m_events.begin(), other.m_events.end());
+	}
+
+	// room for n more events, filled by copyInto() from any thread
+	void grow(size_t n) { m_events.resize(m_events.size() + n); }
+	void copyInto(size_t at, const CCollisionEventBuffer& other)
+	{
+		std::copy(other.m_events.begin(), other.m_events.end(), m_events.begin() + at);
+	}
+
+	size_t size(void) const { return m_events.size(); }
+	const CollisionEvent& operator[](size_t i) const { return m_events[i]; }
+
+private:
+	std::vector<CollisionEvent> m_events;
+};
+
+// Balls is a handle to the ball storage (CSphere*, TBallSet<P>*). it needs a
+// removeBall(Balls, index) overload next to its definition.
+template<class Balls>
+struct TCollisionRules {
+	typedef void (*Rule)(Balls balls, unsigned int a, unsigned int b);
+
+	static void none(Balls, unsigned int, unsigned int) {}
+	static void removeFirst(Balls balls, unsigned int a, unsigned int) { removeBall(balls, a); }
+	static void removeSecond(Balls balls, unsigned int, unsigned int b) { removeBall(balls, b); }
+
+	static const Rule table[ENTITY_TYPE_COUNT][ENTITY_TYPE_COUNT];
+};
+
+// table[typeA][typeB] is applied to every event (a, b), and a < b always.
+// the rule of the original pair loop: a yellow ball is cleared by the ball
+// before it in the array that touches it, whatever that ball is. so two
+// yellows lose the later one, and in the default rack the white cue ball
+// (the last ball) clears nothing. targets and obstacles were never balls
+// there and clear nothing.
+template<class Balls>
+const typename TCollisionRules<Balls>::Rule TCollisionRules<Balls>::table[ENTITY_TYPE_COUNT][ENTITY_TYPE_COUNT] = {
+	//					RED		YELLOW			WHITE	TARGET	OBSTACLE
+	/* RED      */ { none,	removeSecond,	none,	none,	none },
+	/* YELLOW   */ { none,	removeSecond,	none,	none,	none },
+	/* WHITE    */ { none,	removeSecond,	none,	none,	none },
+	/* TARGET   */ { none,	none,			none,	none,	none },
+	/* OBSTACLE */ { none,	none,			none,	none,	none },
+};
+
+template<class Balls>
+void dispatchCollisionEvents(const CCollisionEventBuffer& events, Balls balls)
+{
+	for (size_t i = 0; i < events.size(); i++) {
+		const CollisionEvent& e = events[i];
+		TCollisionRules<Balls>::table[e.typeA][e.typeB](balls, e.a, e.b);
+	}
+}
+
+#endif // __tableTypesH__
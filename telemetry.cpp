@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: telemetry.cpp
+//
+// Desc: Shared-memory telemetry slots, seqlock writer and reader.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "telemetry.h"
+#include <cstring>
+
+static_assert(sizeof(std::atomic<unsigned int>) == sizeof(unsigned int), "atomics must be plain words in shared memory");
+static_assert(sizeof(telemetry::Counters) % sizeof(unsigned int) == 0, "counters are copied as words");
+static_assert(sizeof(telemetry::SegmentHeader) == 64, "segment layout");
+static_assert(sizeof(telemetry::Slot) == telemetry::SLOT_SIZE, "segment layout");
+
+namespace
+{
+	// a slot whose owner is gone can be taken. a process that cannot be
+	// opened for another reason is taken to be running
+	bool processExited(unsigned int processId)
+	{
+		HANDLE process = ::OpenProcess(SYNCHRONIZE, FALSE, processId);
+		if (process == NULL)
+			return ::GetLastError() == ERROR_INVALID_PARAMETER;
+		bool exited = ::WaitForSingleObject(process, 0) == WAIT_OBJECT_0;
+		::CloseHandle(process);
+		return exited;
+	}
+
+	bool validHeader(const telemetry::SegmentHeader& h)
+	{
+		return h.magic.load(std::memory_order_acquire) == telemetry::SEGMENT_MAGIC &&
+			h.version == telemetry::SEGMENT_VERSION && h.slotCount == telemetry::SLOT_COUNT &&
+			h.slotSize == telemetry::SLOT_SIZE;
+	}
+}
+
+telemetry::CTelemetryPublisher::CTelemetryPublisher(void)
+{
+	m_mapping = NULL;
+	m_segment = NULL;
+	m_slot = NULL;
+}
+
+telemetry::CTelemetryPublisher::~CTelemetryPublisher(void)
+{
+	close();
+}
+
+bool telemetry::CTelemetryPublisher::open(const char* name)
+{
+	close();
+	m_mapping = ::CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(Segment), name);
+	if (m_mapping == NULL)
+		return false;
+	m_segment = (Segment*)::MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Segment));
+	if (m_segment == NULL) {
+		close();
+		return false;
+	}
+
+	// a new segment is all zero. instances that create it at the same time
+	// write the same values
+	SegmentHeader& h = m_segment->header;
+	if (h.magic.load(std::memory_order_acquire) == 0) {
+		h.version = SEGMENT_VERSION;
+		h.slotCount = SLOT_COUNT;
+		h.slotSize = SLOT_SIZE;
+		h.magic.store(SEGMENT_MAGIC, std::memory_order_release);
+	}
+	if (!validHeader(h)) {
+		close();
+		return false;
+	}
+
+	const unsigned int self = (unsigned int)::GetCurrentProcessId();
+	for (unsigned int k = 0; k < SLOT_COUNT && m_slot == NULL; k++) {
+		if (claim(m_segment->slots[k], 0))
+			m_slot = &m_segment->slots[k];
+	}
+	for (unsigned int k = 0; k < SLOT_COUNT && m_slot == NULL; k++) {
+		unsigned int owner = m_segment->slots[k].processId.load(std::memory_order_relaxed);
+		if ((owner == self || processExited(owner)) && claim(m_segment->slots[k], owner))
+			m_slot = &m_segment->slots[k];
+	}
+	if (m_slot == NULL) {
+		close();
+		return false;
+	}
+
+	// an owner that died while writing left the sequence odd
+	unsigned int s = m_slot->sequence.load(std::memory_order_relaxed);
+	if (s & 1)
+		m_slot->sequence.store(s + 1, std::memory_order_release);
+	Counters zero;
+	memset(&zero, 0, sizeof(zero));
+	publish(zero);
+	return true;
+}
+
+bool telemetry::CTelemetryPublisher::claim(Slot& slot, unsigned int owner)
+{
+	return slot.processId.compare_exchange_strong(owner, (unsigned int)::GetCurrentProcessId());
+}
+
+void telemetry::CTelemetryPublisher::close(void)
+{
+	if (m_slot != NULL) {
+		m_slot->processId.store(0, std::memory_order_release);
+		m_slot = NULL;
+	}
+	if (m_segment != NULL) {
+		::UnmapViewOfFile(m_segment);
+		m_segment = NULL;
+	}
+	if (m_mapping != NULL) {
+		::CloseHandle(m_mapping);
+		m_mapping = NULL;
+	}
+}
+
+int telemetry::CTelemetryPublisher::getSlotIndex(void) const
+{
+	return m_slot != NULL ? (int)(m_slot - m_segment->slots) : -1;
+}
+
+void telemetry::CTelemetryPublisher::publish(const Counters& c)
+{
+	if (m_slot == NULL)
+		return;
+	unsigned int w[COUNTER_WORDS];
+	memcpy(w, &c, sizeof(c));
+
+	// odd, counters, even. the fence keeps the counter stores from
+	// becoming visible before the odd sequence does
+	const unsigned int s = m_slot->sequence.load(std::memory_order_relaxed);
+	m_slot->sequence.store(s + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (unsigned int k = 0; k < COUNTER_WORDS; k++)
+		m_slot->words[k].store(w[k], std::memory_order_relaxed);
+	m_slot->sequence.store(s + 2, std::memory_order_release);
+}
+
+telemetry::CTelemetryReader::CTelemetryReader(void)
+{
+	m_mapping = NULL;
+	m_segment = NULL;
+}
+
+telemetry::CTelemetryReader::~CTelemetryReader(void)
+{
+	close();
+}
+
+bool telemetry::CTelemetryReader::open(const char* name)
+{
+	close();
+	m_mapping = ::OpenFileMapping(FILE_MAP_READ, FALSE, name);
+	if (m_mapping == NULL)
+		return false;
+	m_segment = (const Segment*)::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, sizeof(Segment));
+	if (m_segment == NULL || !validHeader(m_segment->header)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void telemetry::CTelemetryReader::close(void)
+{
+	if (m_segment != NULL) {
+		::UnmapViewOfFile(m_segment);
+		m_segment = NULL;
+	}
+	if (m_mapping != NULL) {
+		::CloseHandle(m_mapping);
+		m_mapping = NULL;
+	}
+}
+
+bool telemetry::CTelemetryReader::read(unsigned int slot, unsigned int& processId, Counters& c, int retries) const
+{
+	if (m_segment == NULL || slot >= SLOT_COUNT)
+		return false;
+	const Slot& s = m_segment->slots[slot];
+	unsigned int w[COUNTER_WORDS];
+	for (int r = 0; r < retries; r++) {
+		processId = s.processId.load(std::memory_order_acquire);
+		if (processId == 0)
+			return false;
+		const unsigned int before = s.sequence.load(std::memory_order_acquire);
+		if (before & 1)
+			continue;
+		for (unsigned int k = 0; k < COUNTER_WORDS; k++)
+			w[k] = s.words[k].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (s.sequence.load(std::memory_order_relaxed) == before) {
+			memcpy(&c, w, sizeof(c));
+			return true;
+		}
+	}
+	return false;
+}
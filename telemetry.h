@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: telemetry.h
+//
+// Desc: Live counters of running instances in one named shared-memory
+//       segment, for tools that watch many instances at once.
+//
+//       The segment is a header and SLOT_COUNT fixed slots. An instance
+//       claims a free slot when it opens the segment (or the slot of a
+//       process that has exited) and from then on is the only writer of it.
+//       publish() is a seqlock write: the slot's sequence goes odd, the
+//       counters are stored, the sequence goes even again. That is a few
+//       plain stores, with no lock and no system call, so Display() can
+//       publish every frame. A reader copies the counters and takes them
+//       only if the sequence was even and the same before and after.
+//
+//       Counters are totals since the instance started, so that a reader
+//       gets rates from two samples however far apart, and the values of
+//       the last step. Pair tests and wall hits come from the float table
+//       (CSlabStepper); the fixed-point table publishes 0 for them.
+//
+//       Segment: SegmentHeader, then SLOT_COUNT slots of SLOT_SIZE bytes:
+//
+//         u32      process id, 0 if free
+//         u32      sequence, odd while being written
+//         u32[16]  Counters
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __telemetryH__
+#define __telemetryH__
+
+#include <windows.h>
+#include <atomic>
+
+namespace telemetry
+{
+	const unsigned int SEGMENT_MAGIC   = 0x4d4c4554;	// "TELM"
+	const unsigned int SEGMENT_VERSION = 1;
+	const unsigned int SLOT_COUNT      = 64;
+	const unsigned int SLOT_SIZE       = 128;			// two cache lines, never shared by two writers
+	const char* const DEFAULT_SEGMENT  = "Local\\VirtualLegoTelemetry";
+
+	struct Counters
+	{
+		unsigned long long	frames;			// totals
+		unsigned long long	steps;
+		unsigned long long	pairTests;
+		unsigned long long	contacts;
+		unsigned long long	wallHits;
+		unsigned int		activeBalls;	// of the last step
+		unsigned int		lastPairTests;
+		unsigned int		lastContacts;
+		unsigned int		lastWallHits;
+		unsigned int		lastSubsteps;
+		float				frameMs;		// of the last frame
+	};
+
+	const unsigned int COUNTER_WORDS = sizeof(Counters) / sizeof(unsigned int);
+
+	struct SegmentHeader
+	{
+		std::atomic<unsigned int>	magic;		// set once, by whoever creates the segment
+		unsigned int				version;
+		unsigned int				slotCount;
+		unsigned int				slotSize;
+		unsigned char				reserved[48];
+	};
+
+	struct Slot
+	{
+		std::atomic<unsigned int>	processId;
+		std::atomic<unsigned int>	sequence;
+		std::atomic<unsigned int>	words[COUNTER_WORDS];
+		unsigned char				reserved[SLOT_SIZE - (2 + COUNTER_WORDS) * sizeof(unsigned int)];
+	};
+
+	struct Segment
+	{
+		SegmentHeader	header;
+		Slot			slots[SLOT_COUNT];
+	};
+
+	// -------------------------------------------------------------------------
+	// The instance's side: one slot, written by one thread
+	// -------------------------------------------------------------------------
+
+	class CTelemetryPublisher
+	{
+	public:
+		CTelemetryPublisher(void);
+		~CTelemetryPublisher(void);
+
+		// creates the segment if no instance has yet. false if it cannot be
+		// mapped or every slot belongs to a running process
+		bool open(const char* name = DEFAULT_SEGMENT);
+		// frees the slot
+		void close(void);
+		bool isOpen(void) const { return m_slot != NULL; }
+		int getSlotIndex(void) const;
+
+		void publish(const Counters& c);
+
+	private:
+		CTelemetryPublisher(const CTelemetryPublisher&);
+		CTelemetryPublisher& operator=(const CTelemetryPublisher&);
+
+		bool claim(Slot& slot, unsigned int owner);
+
+		HANDLE		m_mapping;
+		Segment*	m_segment;
+		Slot*		m_slot;
+	};
+
+	// -------------------------------------------------------------------------
+	// The tool's side: every slot, read only
+	// -------------------------------------------------------------------------
+
+	class CTelemetryReader
+	{
+	public:
+		CTelemetryReader(void);
+		~CTelemetryReader(void);
+
+		// false if no instance has created the segment
+		bool open(const char* name = DEFAULT_SEGMENT);
+		void close(void);
+
+		// false if the slot is free, or kept changing for every retry
+		bool read(unsigned int slot, unsigned int& processId, Counters& c, int retries = 64) const;
+
+	private:
+		CTelemetryReader(const CTelemetryReader&);
+		CTelemetryReader& operator=(const CTelemetryReader&);
+
+		HANDLE			m_mapping;
+		const Segment*	m_segment;
+	};
+}
+
+#endif // __telemetryH__
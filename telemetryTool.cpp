@@ -0,0 +1,184 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: telemetryTool.cpp
+//
+// Desc: Watches the telemetry slots of every running instance.
+//
+//       telemetryTool watch  [interval ms] [samples] [segment]
+//       telemetryTool stress [ms]
+//
+//       watch reads every slot, waits the interval, reads them again and
+//       prints one line per instance: steps and frames per second over the
+//       interval, active balls, pair tests, contacts and wall hits per step,
+//       substeps and frame time of the last step. An instance whose frame
+//       count did not move is marked stalled. samples 0 runs until killed.
+//
+//       stress publishes from one thread as fast as it can into a private
+//       segment while readers on other threads check that every copy they
+//       take is whole (each counter is derived from the same number). Prints
+//       the cost of one publish and the reads taken, retried and torn.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "telemetry.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+using namespace telemetry;
+
+typedef std::chrono::steady_clock Clock;
+
+static int watch(unsigned int intervalMs, int samples, const char* name)
+{
+	CTelemetryReader reader;
+	if (!reader.open(name)) {
+		fprintf(stderr, "no instance has created %s\n", name);
+		return 1;
+	}
+
+	std::vector<unsigned int> lastPid(SLOT_COUNT, 0);
+	std::vector<Counters> last(SLOT_COUNT);
+	for (unsigned int k = 0; k < SLOT_COUNT; k++) {
+		if (!reader.read(k, lastPid[k], last[k]))
+			lastPid[k] = 0;
+	}
+
+	for (int n = 0; samples == 0 || n < samples; n++) {
+		Clock::time_point t0 = Clock::now();
+		::Sleep(intervalMs);
+		const double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+		printf("%6s %9s %8s %8s %10s %9s %8s %4s %8s\n",
+			"pid", "steps/s", "frames/s", "balls", "pairs/st", "cont/st", "walls/st", "sub", "frame ms");
+		for (unsigned int k = 0; k < SLOT_COUNT; k++) {
+			unsigned int pid;
+			Counters c;
+			if (!reader.read(k, pid, c)) {
+				lastPid[k] = 0;
+				continue;
+			}
+			if (pid != lastPid[k]) {
+				// a new instance in this slot: rates from the next sample
+				lastPid[k] = pid;
+				last[k] = c;
+				printf("%6u (new)\n", pid);
+				continue;
+			}
+			const Counters& p = last[k];
+			const double steps = (double)(c.steps - p.steps);
+			const double perStep = steps > 0 ? 1 / steps : 0;
+			printf("%6u %9.1f %8.1f %8u %10.1f %9.2f %8.2f %4u %8.2f%s\n",
+				pid, steps / seconds, (c.frames - p.frames) / seconds, c.activeBalls,
+				(c.pairTests - p.pairTests) * perStep, (c.contacts - p.contacts) * perStep,
+				(c.wallHits - p.wallHits) * perStep, c.lastSubsteps, c.frameMs,
+				c.frames == p.frames ? "  stalled" : "");
+			last[k] = c;
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+	return 0;
+}
+
+// every field from v, so that a copy mixing two publishes shows
+static void fillCounters(Counters& c, unsigned long long v)
+{
+	c.frames = v;
+	c.steps = v * 3;
+	c.pairTests = v * 5;
+	c.contacts = v * 7;
+	c.wallHits = v * 11;
+	c.activeBalls = (unsigned int)v;
+	c.lastPairTests = (unsigned int)(v * 13);
+	c.lastContacts = (unsigned int)(v * 17);
+	c.lastWallHits = (unsigned int)(v * 19);
+	c.lastSubsteps = (unsigned int)(v * 23);
+	c.frameMs = (float)(v & 0xffff);
+}
+
+static bool wholeCounters(const Counters& c)
+{
+	Counters expected;
+	fillCounters(expected, c.frames);
+	return memcmp(&expected, &c, sizeof(c)) == 0;
+}
+
+static int stress(unsigned int ms)
+{
+	char name[64];
+	sprintf(name, "Local\\TelemetryStress.%lu", (unsigned long)::GetCurrentProcessId());
+	CTelemetryPublisher publisher;
+	if (!publisher.open(name)) {
+		fprintf(stderr, "cannot create %s\n", name);
+		return 1;
+	}
+	CTelemetryReader reader;
+	if (!reader.open(name)) {
+		fprintf(stderr, "cannot open %s\n", name);
+		return 1;
+	}
+	const unsigned int slot = (unsigned int)publisher.getSlotIndex();
+
+	std::atomic<bool> stop(false);
+	const int readers = 2;
+	std::vector<unsigned long long> taken(readers, 0), missed(readers, 0), torn(readers, 0);
+	std::vector<std::thread> threads;
+	for (int r = 0; r < readers; r++) {
+		threads.push_back(std::thread([&, r] {
+			while (!stop.load(std::memory_order_relaxed)) {
+				unsigned int pid;
+				Counters c;
+				if (!reader.read(slot, pid, c, 1))
+					missed[r]++;
+				else if (!wholeCounters(c))
+					torn[r]++;
+				else
+					taken[r]++;
+			}
+		}));
+	}
+
+	Counters c;
+	unsigned long long v = 0;
+	Clock::time_point t0 = Clock::now();
+	const Clock::time_point end = t0 + std::chrono::milliseconds(ms);
+	while (Clock::now() < end) {
+		for (int k = 0; k < 1024; k++) {
+			fillCounters(c, ++v);
+			publisher.publish(c);
+		}
+	}
+	const double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / v;
+	stop = true;
+	for (size_t k = 0; k < threads.size(); k++)
+		threads[k].join();
+
+	unsigned long long allTaken = 0, allMissed = 0, allTorn = 0;
+	for (int r = 0; r < readers; r++) {
+		allTaken += taken[r];
+		allMissed += missed[r];
+		allTorn += torn[r];
+	}
+	printf("%llu publishes, %.1f ns each (with filling the counters)\n", v, ns);
+	printf("%d readers: %llu whole copies, %llu retried, %llu torn\n", readers, allTaken, allMissed, allTorn);
+	return allTorn == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && strcmp(argv[1], "watch") == 0) {
+		unsigned int intervalMs = argc > 2 ? (unsigned int)atoi(argv[2]) : 1000;
+		int samples = argc > 3 ? atoi(argv[3]) : 0;
+		return watch(intervalMs, samples, argc > 4 ? argv[4] : DEFAULT_SEGMENT);
+	}
+	if (argc > 1 && strcmp(argv[1], "stress") == 0)
+		return stress(argc > 2 ? (unsigned int)atoi(argv[2]) : 1000);
+
+	fprintf(stderr, "telemetryTool watch [interval ms] [samples] [segment]\n");
+	fprintf(stderr, "telemetryTool stress [ms]\n");
+	return 1;
+}
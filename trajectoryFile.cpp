@@ -0,0 +1,428 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: trajectoryFile.cpp
+//
+// Desc: Chunked columnar trajectory export: delta + bit-packing encoder on a
+//       background thread, and the memory-mapped lazy reader.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "trajectoryFile.h"
+#include <cstring>
+#include <chrono>
+
+using namespace trajectory;
+
+namespace
+{
+	size_t alignUp4(size_t n) { return (n + 3) & ~(size_t)3; }
+
+	unsigned int zigzag(unsigned int d) { return (d << 1) ^ (unsigned int)((int)d >> 31); }
+	unsigned int unzigzag(unsigned int z) { return (z >> 1) ^ (0u - (z & 1)); }
+
+	unsigned int bitWidth(unsigned int v)
+	{
+		unsigned int w = 0;
+		while (v != 0) {
+			w++;
+			v >>= 1;
+		}
+		return w;
+	}
+
+	size_t packedBytes(unsigned int width, unsigned int ticks)
+	{
+		return ticks > 1 ? ((size_t)width * (ticks - 1) + 7) / 8 : 0;
+	}
+
+	// column prefix: first values, widths, padding
+	size_t columnPrefix(unsigned int ballCount)
+	{
+		return alignUp4((size_t)ballCount * 5);
+	}
+
+	void unpackBall(const unsigned char* packed, unsigned int width, int first, unsigned int ticks,
+		int* out, size_t stride)
+	{
+		unsigned int v = (unsigned int)first;
+		out[0] = first;
+		if (width == 0) {
+			for (unsigned int t = 1; t < ticks; t++)
+				out[t * stride] = first;
+			return;
+		}
+
+		unsigned long long acc = 0;
+		unsigned int bits = 0;
+		const unsigned long long mask = (width == 32) ? 0xffffffffULL : ((1ULL << width) - 1);
+		for (unsigned int t = 1; t < ticks; t++) {
+			while (bits < width) {
+				acc |= (unsigned long long)*packed++ << bits;
+				bits += 8;
+			}
+			v += unzigzag((unsigned int)(acc & mask));
+			acc >>= width;
+			bits -= width;
+			out[t * stride] = (int)v;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// CTrajectoryWriter
+// -----------------------------------------------------------------------------
+
+CTrajectoryWriter::CTrajectoryWriter(void)
+{
+	m_fp = NULL;
+	m_ballCount = 0;
+	m_ticksPerChunk = 0;
+	m_tickCount = 0;
+	m_fill = 0;
+	m_pending = -1;
+	m_quit = false;
+	m_offset = 0;
+	m_ioError = false;
+	m_stalls = 0;
+	m_stallMs = 0;
+}
+
+CTrajectoryWriter::~CTrajectoryWriter(void)
+{
+	close();
+}
+
+bool CTrajectoryWriter::open(const char* path, unsigned int ballCount, unsigned int ticksPerChunk)
+{
+	close();
+
+	if (ballCount == 0 || ticksPerChunk == 0)
+		return false;
+	m_fp = fopen(path, "wb");
+	if (m_fp == NULL)
+		return false;
+
+	m_ballCount = ballCount;
+	m_ticksPerChunk = ticksPerChunk;
+	m_tickCount = 0;
+	for (int i = 0; i < 2; i++) {
+		for (int f = 0; f < FIELD_COUNT; f++)
+			m_staging[i].values[f].resize((size_t)ballCount * ticksPerChunk);
+		m_staging[i].ticks = 0;
+		m_staging[i].firstTick = 0;
+	}
+	m_fill = 0;
+	m_pending = -1;
+	m_quit = false;
+	m_chunkOffsets.clear();
+	m_ioError = false;
+	m_stalls = 0;
+	m_stallMs = 0;
+
+	// the header is rewritten with the final counts on close
+	FileHeader h;
+	memset(&h, 0, sizeof(h));
+	m_ioError = fwrite(&h, sizeof(h), 1, m_fp) != 1;
+	m_offset = sizeof(h);
+
+	m_thread = std::thread(&CTrajectoryWriter::writerMain, this);
+	return true;
+}
+
+bool CTrajectoryWriter::close(void)
+{
+	if (m_fp == NULL)
+		return false;
+
+	if (m_staging[m_fill].ticks > 0)
+		handOff();
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return m_pending < 0; });
+		m_quit = true;
+	}
+	m_wake.notify_one();
+	m_thread.join();
+
+	FileHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = TRAJECTORY_MAGIC;
+	h.version = TRAJECTORY_VERSION;
+	h.ballCount = m_ballCount;
+	h.ticksPerChunk = m_ticksPerChunk;
+	h.chunkCount = (unsigned int)m_chunkOffsets.size();
+	h.tickCount = m_tickCount;
+	h.indexOffset = m_offset;
+
+	bool ok = !m_ioError;
+	if (!m_chunkOffsets.empty())
+		ok = ok && fwrite(&m_chunkOffsets[0], sizeof(unsigned long long), m_chunkOffsets.size(), m_fp) == m_chunkOffsets.size();
+	ok = ok && fseek(m_fp, 0, SEEK_SET) == 0;
+	ok = ok && fwrite(&h, sizeof(h), 1, m_fp) == 1;
+	ok = (fclose(m_fp) == 0) && ok;
+	m_fp = NULL;
+
+	for (int i = 0; i < 2; i++) {
+		for (int f = 0; f < FIELD_COUNT; f++)
+			std::vector<int>().swap(m_staging[i].values[f]);
+	}
+	return ok;
+}
+
+void CTrajectoryWriter::append(const int* x, const int* z, const int* vx, const int* vz)
+{
+	if (m_fp == NULL)
+		return;
+
+	Staging& s = m_staging[m_fill];
+	if (s.ticks == 0)
+		s.firstTick = m_tickCount;
+
+	const size_t row = (size_t)s.ticks * m_ballCount;
+	const size_t bytes = m_ballCount * sizeof(int);
+	memcpy(&s.values[FIELD_X][row], x, bytes);
+	memcpy(&s.values[FIELD_Z][row], z, bytes);
+	memcpy(&s.values[FIELD_VX][row], vx, bytes);
+	memcpy(&s.values[FIELD_VZ][row], vz, bytes);
+	s.ticks++;
+	m_tickCount++;
+
+	if (s.ticks == m_ticksPerChunk)
+		handOff();
+}
+
+// give the filled buffer to the writer thread and switch to the other one.
+// waits only if the thread still has the other buffer.
+void CTrajectoryWriter::handOff(void)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_pending >= 0) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			m_done.wait(lock, [this] { return m_pending < 0; });
+			m_stalls++;
+			m_stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		m_pending = m_fill;
+	}
+	m_wake.notify_one();
+
+	m_fill ^= 1;
+	m_staging[m_fill].ticks = 0;
+}
+
+void CTrajectoryWriter::writerMain(void)
+{
+	for (;;) {
+		int index;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_quit || m_pending >= 0; });
+			if (m_pending < 0)
+				return;		// quit with nothing left
+			index = m_pending;
+		}
+
+		encodeChunk(m_staging[index], m_encoded);
+		m_chunkOffsets.push_back(m_offset);
+		if (fwrite(&m_encoded[0], 1, m_encoded.size(), m_fp) != m_encoded.size())
+			m_ioError = true;
+		m_offset += m_encoded.size();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending = -1;
+		}
+		m_done.notify_all();
+	}
+}
+
+void CTrajectoryWriter::encodeChunk(const Staging& s, std::vector<unsigned char>& out) const
+{
+	const unsigned int n = m_ballCount;
+	const unsigned int ticks = s.ticks;
+
+	out.resize(sizeof(ChunkHeader));
+	ChunkHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = CHUNK_MAGIC;
+	h.tickCount = ticks;
+	h.firstTick = s.firstTick;
+
+	std::vector<unsigned char> widths(n);
+	for (int f = 0; f < FIELD_COUNT; f++) {
+		const int* v = &s.values[f][0];
+
+		// widest zigzag delta per ball
+		for (unsigned int b = 0; b < n; b++) {
+			unsigned int all = 0;
+			for (unsigned int t = 1; t < ticks; t++)
+				all |= zigzag((unsigned int)v[t * n + b] - (unsigned int)v[(t - 1) * n + b]);
+			widths[b] = (unsigned char)bitWidth(all);
+		}
+
+		size_t start = out.size();
+		h.columnOffset[f] = (unsigned int)start;
+		out.resize(start + columnPrefix(n), 0);
+		memcpy(&out[start], v, n * sizeof(int));
+		memcpy(&out[start + n * sizeof(int)], &widths[0], n);
+
+		for (unsigned int b = 0; b < n; b++) {
+			const unsigned int width = widths[b];
+			if (width == 0)
+				continue;
+			unsigned long long acc = 0;
+			unsigned int bits = 0;
+			for (unsigned int t = 1; t < ticks; t++) {
+				acc |= (unsigned long long)zigzag((unsigned int)v[t * n + b] - (unsigned int)v[(t - 1) * n + b]) << bits;
+				bits += width;
+				while (bits >= 8) {
+					out.push_back((unsigned char)acc);
+					acc >>= 8;
+					bits -= 8;
+				}
+			}
+			if (bits > 0)
+				out.push_back((unsigned char)acc);
+		}
+
+		out.resize(alignUp4(out.size()), 0);
+		h.columnSize[f] = (unsigned int)(out.size() - start);
+	}
+
+	// keeps the next chunk header and the index 8 byte aligned
+	out.resize((out.size() + 7) & ~(size_t)7, 0);
+
+	memcpy(&out[0], &h, sizeof(h));
+}
+
+// -----------------------------------------------------------------------------
+// CTrajectoryFile
+// -----------------------------------------------------------------------------
+
+CTrajectoryFile::CTrajectoryFile(void)
+{
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+	m_data = NULL;
+	m_size = 0;
+	m_header = NULL;
+	m_index = NULL;
+}
+
+CTrajectoryFile::~CTrajectoryFile(void)
+{
+	close();
+}
+
+bool CTrajectoryFile::open(const char* path)
+{
+	close();
+
+	m_file = ::CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(m_file, &size) || size.QuadPart < (LONGLONG)sizeof(FileHeader)) {
+		close();
+		return false;
+	}
+
+	m_mapping = ::CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == NULL) {
+		close();
+		return false;
+	}
+
+	m_data = (const unsigned char*)::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == NULL) {
+		close();
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+
+	if (!validate()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void CTrajectoryFile::close(void)
+{
+	if (m_mapping != NULL) {
+		if (m_data != NULL)
+			::UnmapViewOfFile(m_data);
+		::CloseHandle(m_mapping);
+		m_mapping = NULL;
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		::CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+	m_data = NULL;
+	m_size = 0;
+	m_header = NULL;
+	m_index = NULL;
+}
+
+// bounds of the index, chunk headers and columns. packed data inside a
+// column is trusted.
+bool CTrajectoryFile::validate(void)
+{
+	const FileHeader* h = (const FileHeader*)m_data;
+	if (h->magic != TRAJECTORY_MAGIC || h->version != TRAJECTORY_VERSION || h->ballCount == 0)
+		return false;
+	if (h->indexOffset + (unsigned long long)h->chunkCount * sizeof(unsigned long long) > m_size)
+		return false;
+
+	const unsigned long long* index = (const unsigned long long*)(m_data + h->indexOffset);
+	for (unsigned int c = 0; c < h->chunkCount; c++) {
+		if (index[c] + sizeof(ChunkHeader) > m_size)
+			return false;
+		const ChunkHeader* ch = (const ChunkHeader*)(m_data + index[c]);
+		if (ch->magic != CHUNK_MAGIC || ch->tickCount == 0 || ch->tickCount > h->ticksPerChunk)
+			return false;
+		for (int f = 0; f < FIELD_COUNT; f++) {
+			if (ch->columnSize[f] < columnPrefix(h->ballCount) ||
+				index[c] + ch->columnOffset[f] + ch->columnSize[f] > m_size)
+				return false;
+		}
+	}
+
+	m_header = h;
+	m_index = index;
+	return true;
+}
+
+void CTrajectoryFile::decodeBall(unsigned int c, Field f, unsigned int ball, int* out) const
+{
+	const ChunkHeader& ch = chunk(c);
+	const unsigned int n = m_header->ballCount;
+	const unsigned char* column = (const unsigned char*)&ch + ch.columnOffset[f];
+	const int* first = (const int*)column;
+	const unsigned char* widths = column + n * sizeof(int);
+
+	// skip the packed streams of the balls before this one
+	const unsigned char* packed = column + columnPrefix(n);
+	for (unsigned int b = 0; b < ball; b++)
+		packed += packedBytes(widths[b], ch.tickCount);
+
+	unpackBall(packed, widths[ball], first[ball], ch.tickCount, out, 1);
+}
+
+void CTrajectoryFile::decodeColumn(unsigned int c, Field f, int* out) const
+{
+	const ChunkHeader& ch = chunk(c);
+	const unsigned int n = m_header->ballCount;
+	const unsigned char* column = (const unsigned char*)&ch + ch.columnOffset[f];
+	const int* first = (const int*)column;
+	const unsigned char* widths = column + n * sizeof(int);
+
+	const unsigned char* packed = column + columnPrefix(n);
+	for (unsigned int b = 0; b < n; b++) {
+		unpackBall(packed, widths[b], first[b], ch.tickCount, out + b, n);
+		packed += packedBytes(widths[b], ch.tickCount);
+	}
+}
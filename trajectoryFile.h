@@ -0,0 +1,171 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: trajectoryFile.h
+//
+// Desc: Streaming export of per-tick ball state (x, z, vx, vz) in a chunked,
+//       columnar file, and a memory-mapped reader for it.
+//
+//       Values are Q16.16 ints, the FixedPolicy representation, so the file
+//       holds exactly what the fixed-point table computed. Float tables are
+//       converted with FixedPolicy::fromFloat before they are appended.
+//
+//       File:   FileHeader, chunks, chunk index (u64 offset per chunk)
+//       Chunk:  ChunkHeader, then one column per field
+//       Column: i32 first[ballCount]       value at the chunk's first tick
+//               u8  width[ballCount]       bits per packed delta, 0..32
+//               pad to 4 bytes
+//               per ball: (tickCount - 1) zigzag deltas between consecutive
+//               ticks, width bits each, LSB first, starting on a byte
+//
+//       A ball that does not change over a chunk has width 0 and no packed
+//       bytes at all. The reader decodes nothing up front: a column, or a
+//       single ball of a column, is unpacked only when it is asked for.
+//
+//       The writer copies each tick into a staging chunk and returns. Full
+//       chunks are encoded and written by a background thread while the
+//       other staging buffer fills, so the simulation only waits when the
+//       disk falls a whole chunk behind.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __trajectoryFileH__
+#define __trajectoryFileH__
+
+#include <windows.h>
+#include <cstdio>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace trajectory
+{
+	const unsigned int TRAJECTORY_MAGIC   = 0x4a525442;	// "BTRJ"
+	const unsigned int TRAJECTORY_VERSION = 1;
+	const unsigned int CHUNK_MAGIC        = 0x4b4e4843;	// "CHNK"
+
+	enum Field { FIELD_X = 0, FIELD_Z, FIELD_VX, FIELD_VZ, FIELD_COUNT };
+
+	//
+	// On-disk records, little endian
+	//
+
+	struct FileHeader
+	{
+		unsigned int       magic;
+		unsigned int       version;
+		unsigned int       ballCount;
+		unsigned int       ticksPerChunk;		// every chunk but the last is full
+		unsigned int       chunkCount;
+		unsigned int       reserved;
+		unsigned long long tickCount;
+		unsigned long long indexOffset;		// u64 chunk offsets from the start of the file
+	};
+
+	struct ChunkHeader
+	{
+		unsigned int       magic;
+		unsigned int       tickCount;
+		unsigned long long firstTick;
+		unsigned int       columnOffset[FIELD_COUNT];	// from the start of the chunk
+		unsigned int       columnSize[FIELD_COUNT];
+	};
+
+	//
+	// Write side
+	//
+
+	class CTrajectoryWriter
+	{
+	public:
+		CTrajectoryWriter(void);
+		~CTrajectoryWriter(void);
+
+		bool open(const char* path, unsigned int ballCount, unsigned int ticksPerChunk = 256);
+		// flushes the last partial chunk and writes the index. false on any
+		// write error since open.
+		bool close(void);
+		bool isOpen(void) const { return m_fp != NULL; }
+
+		// one tick, ballCount values per field
+		void append(const int* x, const int* z, const int* vx, const int* vz);
+
+		unsigned long long getTickCount(void) const { return m_tickCount; }
+		unsigned long long getBytesWritten(void) const { return m_offset; }	// exact after close
+		unsigned int getStalls(void) const { return m_stalls; }		// appends that waited on the writer thread
+		double getStallMs(void) const { return m_stallMs; }
+
+	private:
+		CTrajectoryWriter(const CTrajectoryWriter&);
+		CTrajectoryWriter& operator=(const CTrajectoryWriter&);
+
+		struct Staging {
+			std::vector<int>	values[FIELD_COUNT];	// tick-major: [tick * ballCount + ball]
+			unsigned int		ticks;
+			unsigned long long	firstTick;
+		};
+
+		void handOff(void);
+		void writerMain(void);
+		void encodeChunk(const Staging& s, std::vector<unsigned char>& out) const;
+
+		FILE*						m_fp;
+		unsigned int				m_ballCount;
+		unsigned int				m_ticksPerChunk;
+		unsigned long long			m_tickCount;
+
+		Staging						m_staging[2];
+		int							m_fill;			// buffer appends go to
+
+		std::thread					m_thread;
+		std::mutex					m_mutex;
+		std::condition_variable		m_wake;
+		std::condition_variable		m_done;
+		int							m_pending;		// buffer owned by the thread, -1 if none
+		bool						m_quit;
+
+		// writer thread only, until close
+		std::vector<unsigned char>	m_encoded;
+		std::vector<unsigned long long>	m_chunkOffsets;
+		unsigned long long			m_offset;
+		bool						m_ioError;
+
+		unsigned int				m_stalls;
+		double						m_stallMs;
+	};
+
+	//
+	// Read side: a read-only mapped file, decoded on demand
+	//
+
+	class CTrajectoryFile
+	{
+	public:
+		CTrajectoryFile(void);
+		~CTrajectoryFile(void);
+
+		bool open(const char* path);
+		void close(void);
+
+		const FileHeader& header(void) const { return *m_header; }
+		unsigned int getChunkCount(void) const { return m_header->chunkCount; }
+		const ChunkHeader& chunk(unsigned int c) const { return *(const ChunkHeader*)(m_data + m_index[c]); }
+
+		// one field of one ball over a chunk; out needs chunk(c).tickCount entries
+		void decodeBall(unsigned int c, Field f, unsigned int ball, int* out) const;
+		// one field of every ball over a chunk, tick-major like the writer
+		void decodeColumn(unsigned int c, Field f, int* out) const;
+
+	private:
+		bool validate(void);
+
+		HANDLE						m_file;
+		HANDLE						m_mapping;
+		const unsigned char*		m_data;
+		size_t						m_size;
+		const FileHeader*			m_header;
+		const unsigned long long*	m_index;
+	};
+}
+
+#endif // __trajectoryFileH__
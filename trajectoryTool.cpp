@@ -0,0 +1,189 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: trajectoryTool.cpp
+//
+// Desc: Records and inspects trajectory files.
+//
+//       trajectoryTool record <out.traj> <shots> [rack rows]
+//       trajectoryTool dump   <file.traj> [ball]
+//
+//       record plays random shots on a rack, appending every tick, and
+//       times the appends against the same shots played without export.
+//       It then reopens the file and checks that it decodes to exactly what
+//       was appended.
+//
+//       dump prints the header, the size of each column over all chunks and,
+//       if a ball is given, that ball's trajectory decoded on its own.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "trajectoryFile.h"
+#include "tableServer.h"
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+static const float TICK = 0.005f;
+
+static void hashInts(unsigned int& h, const int* v, size_t count)
+{
+	const unsigned char* p = (const unsigned char*)v;
+	for (size_t k = 0; k < count * sizeof(int); k++)
+		h = (h ^ p[k]) * 16777619u;
+}
+
+// plays the shots; with a writer, every tick is appended and hashed.
+// returns the loop time; appendMs is the part spent inside append.
+static double play(const scene::CSceneFile& sc, unsigned int shots, trajectory::CTrajectoryWriter* writer,
+	unsigned int& hash, double& appendMs)
+{
+	typedef std::chrono::steady_clock Clock;
+	CTableInstance table;
+	table.load(sc);
+	const TBallSet<FixedPolicy>& b = table.getBalls();
+	const int dt = FixedPolicy::fromFloat(TICK);
+	scene::CRandom rng(7);
+
+	appendMs = 0;
+	Clock::time_point start = Clock::now();
+	for (unsigned int s = 0; s < shots; s++) {
+		unsigned int target = rng.next() % (unsigned int)b.size();
+		if (target == table.getCue())
+			target = (target + 1) % (unsigned int)b.size();
+		table.queueShot(b.x[target], b.z[target]);
+
+		while (table.needsStep()) {
+			table.step(dt);
+			if (writer != NULL) {
+				Clock::time_point t0 = Clock::now();
+				writer->append(&b.x[0], &b.z[0], &b.vx[0], &b.vz[0]);
+				appendMs += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+				hashInts(hash, &b.x[0], b.size());
+				hashInts(hash, &b.z[0], b.size());
+				hashInts(hash, &b.vx[0], b.size());
+				hashInts(hash, &b.vz[0], b.size());
+			}
+		}
+	}
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static int record(const char* path, unsigned int shots, unsigned int rows)
+{
+	scene::CSceneBuilder builder;
+	scene::generateRack(builder, rows, 1);
+	std::vector<unsigned char> image;
+	builder.build(image);
+	scene::CSceneFile sc;
+	if (!sc.openMemory(&image[0], image.size()))
+		return 1;
+	const unsigned int n = sc.header().ballCount;
+
+	trajectory::CTrajectoryWriter writer;
+	if (!writer.open(path, n)) {
+		fprintf(stderr, "cannot create '%s'\n", path);
+		return 1;
+	}
+	unsigned int written = 2166136261u;
+	double appendMs;
+	play(sc, shots, &writer, written, appendMs);
+	unsigned long long ticks = writer.getTickCount();
+	unsigned int stalls = writer.getStalls();
+	double stallMs = writer.getStallMs();
+	if (!writer.close()) {
+		fprintf(stderr, "write error on '%s'\n", path);
+		return 1;
+	}
+
+	unsigned int unused = 0;
+	double unusedMs;
+	double plainMs = play(sc, shots, NULL, unused, unusedMs);
+
+	trajectory::CTrajectoryFile file;
+	if (!file.open(path)) {
+		fprintf(stderr, "cannot map '%s'\n", path);
+		return 1;
+	}
+
+	// decode everything and hash it in append order
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<int> columns[trajectory::FIELD_COUNT];
+	unsigned int decoded = 2166136261u;
+	for (unsigned int c = 0; c < file.getChunkCount(); c++) {
+		unsigned int t = file.chunk(c).tickCount;
+		for (int f = 0; f < trajectory::FIELD_COUNT; f++) {
+			columns[f].resize((size_t)t * n);
+			file.decodeColumn(c, (trajectory::Field)f, &columns[f][0]);
+		}
+		for (unsigned int k = 0; k < t; k++) {
+			for (int f = 0; f < trajectory::FIELD_COUNT; f++)
+				hashInts(decoded, &columns[f][(size_t)k * n], n);
+		}
+	}
+	double decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	unsigned long long raw = ticks * n * trajectory::FIELD_COUNT * sizeof(int);
+	LARGE_INTEGER size;
+	HANDLE h = ::CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	::GetFileSizeEx(h, &size);
+	::CloseHandle(h);
+
+	printf("%u shots, %llu ticks, %u balls, %u chunks\n", shots, ticks, n, file.getChunkCount());
+	printf("raw %.1f KB, file %.1f KB (%.1fx)\n", raw / 1024.0, size.QuadPart / 1024.0, (double)raw / size.QuadPart);
+	printf("simulation %.1f ms; append %.1f ms (%.2f us per tick), %u stalls, %.2f ms waited\n",
+		plainMs, appendMs, appendMs * 1000.0 / ticks, stalls, stallMs);
+	printf("full decode %.1f ms (%.0f M values/s)\n", decodeMs, raw / sizeof(int) / decodeMs / 1000.0);
+	printf("hash %08x written, %08x decoded: %s\n", written, decoded, written == decoded ? "ok" : "MISMATCH");
+	return written == decoded ? 0 : 1;
+}
+
+static int dump(const char* path, int ball)
+{
+	trajectory::CTrajectoryFile file;
+	if (!file.open(path)) {
+		fprintf(stderr, "cannot map '%s'\n", path);
+		return 1;
+	}
+
+	const trajectory::FileHeader& h = file.header();
+	printf("%u balls, %llu ticks, %u chunks of %u ticks\n", h.ballCount, h.tickCount, h.chunkCount, h.ticksPerChunk);
+
+	static const char* names[trajectory::FIELD_COUNT] = { "x", "z", "vx", "vz" };
+	for (int f = 0; f < trajectory::FIELD_COUNT; f++) {
+		unsigned long long bytes = 0;
+		for (unsigned int c = 0; c < file.getChunkCount(); c++)
+			bytes += file.chunk(c).columnSize[f];
+		printf("  %-2s %10llu bytes, %.2f bits per value\n", names[f], bytes, bytes * 8.0 / ((double)h.tickCount * h.ballCount));
+	}
+
+	if (ball < 0 || (unsigned int)ball >= h.ballCount)
+		return 0;
+
+	// only this ball's streams are unpacked
+	std::vector<int> v[trajectory::FIELD_COUNT];
+	for (unsigned int c = 0; c < file.getChunkCount(); c++) {
+		const trajectory::ChunkHeader& ch = file.chunk(c);
+		for (int f = 0; f < trajectory::FIELD_COUNT; f++) {
+			v[f].resize(ch.tickCount);
+			file.decodeBall(c, (trajectory::Field)f, ball, &v[f][0]);
+		}
+		for (unsigned int t = 0; t < ch.tickCount; t += 50) {
+			printf("tick %8llu  x %8.4f  z %8.4f  vx %8.4f  vz %8.4f\n", ch.firstTick + t,
+				FixedPolicy::toFloat(v[0][t]), FixedPolicy::toFloat(v[1][t]),
+				FixedPolicy::toFloat(v[2][t]), FixedPolicy::toFloat(v[3][t]));
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc >= 4 && strcmp(argv[1], "record") == 0)
+		return record(argv[2], (unsigned int)atoi(argv[3]), argc > 4 ? (unsigned int)atoi(argv[4]) : 5);
+	if (argc >= 3 && strcmp(argv[1], "dump") == 0)
+		return dump(argv[2], argc > 3 ? atoi(argv[3]) : -1);
+
+	fprintf(stderr, "usage: %s record <out.traj> <shots> [rack rows]\n", argv[0]);
+	fprintf(stderr, "       %s dump <file.traj> [ball]\n", argv[0]);
+	return 1;
+}
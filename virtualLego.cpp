@@ -10,10 +10,25 @@
 //        
 ////////////////////////////////////////////////////////////////////////////////
 #include "d3dUtility.h"
+#include "sceneFile.h"
+#include "billiard.h"
+#include "slabStepper.h"
+#include "tablePhysics.h"
+#include "lockstep.h"
+#include "spectatorServer.h"
+#include "trajectoryFile.h"
+#include "aimPreview.h"
+#include "ballBvh.h"
+#include "jobGraph.h"
+#include "meshCache.h"
+#include "telemetry.h"
+#include "inputQueue.h"
+#include "staticLighting.h"
 #include <vector>
 #include <ctime>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 
 IDirect3DDevice9* Device = NULL;
@@ -22,11 +37,12 @@ IDirect3DDevice9* Device = NULL;
 const int Width = 1024;
 const int Height = 768;
 
-// There are four balls
-// initialize the position (coordinate) of each ball (ball0 ~ ball3)
+// Default scene, used when no scene file is given on the command line
+// initialize the position (coordinate) of each ball (ball0 ~ ball6)
 const float spherePos[7][2] = { {-1.2f,0} , {-0.2f,-2.0f}, {-0.2f,-1.0f}, {-0.2f,0}, {-0.2f,+1.0f}, {-0.2f,+2.0f} , {-3.3f,0} };
 // initialize the color of each ball (ball0 ~ ball3)
 const D3DXCOLOR sphereColor[7] = { d3d::RED, d3d::YELLOW, d3d::YELLOW, d3d::YELLOW, d3d::YELLOW, d3d::YELLOW, d3d::WHITE };
+const int sphereType[7] = { ENTITY_RED, ENTITY_YELLOW, ENTITY_YELLOW, ENTITY_YELLOW, ENTITY_YELLOW, ENTITY_YELLOW, ENTITY_WHITE };
 
 // -----------------------------------------------------------------------------
 // Transform matrices
@@ -35,378 +51,12 @@ D3DXMATRIX g_mWorld;
 D3DXMATRIX g_mView;
 D3DXMATRIX g_mProj;
 
-#define M_RADIUS 0.21   // ball radius
-#define PI 3.14159265
-#define M_HEIGHT 0.01
-#define DECREASE_RATE 0.9982
-//added preprocessors
-#define BLOCK_WIDTH 0.8f
-#define BLOCK_HEIGHT 0.4f
-#define PADDLE_WIDTH 2.0f
-#define PADDLE_HEIGHT 0.3f
-#define BALL_SPEED 3.0f
-#define PADDLE_SPEED 4.0f
+float g_tableHalfX = 4.5f;
+float g_tableHalfZ = 3.0f;
 
-// -----------------------------------------------------------------------------
-// CSphere class definition
-// -----------------------------------------------------------------------------
-
-class CSphere {
-private:
-	float					center_x, center_y, center_z;
-	float                   m_radius;
-	float					m_velocity_x;
-	float					m_velocity_z;
-
-	bool active=true;
-
-public:
-	CSphere(void)
-	{
-		D3DXMatrixIdentity(&m_mLocal);
-		ZeroMemory(&m_mtrl, sizeof(m_mtrl));
-		m_radius = 0;
-		m_velocity_x = 0;
-		m_velocity_z = 0;
-		m_pSphereMesh = NULL;
-	}
-	~CSphere(void) {}
-
-public:
-	bool create(IDirect3DDevice9* pDevice, D3DXCOLOR color = d3d::WHITE)
-	{
-		if (NULL == pDevice)
-			return false;
-
-		m_mtrl.Ambient = color;
-		m_mtrl.Diffuse = color;
-		m_mtrl.Specular = color;
-		m_mtrl.Emissive = d3d::BLACK;
-		m_mtrl.Power = 5.0f;
-
-		if (FAILED(D3DXCreateSphere(pDevice, getRadius(), 50, 50, &m_pSphereMesh, NULL)))
-			return false;
-		return true;
-	}
-
-	void destroy(void)
-	{
-		if (m_pSphereMesh != NULL) {
-			m_pSphereMesh->Release();
-			m_pSphereMesh = NULL;
-		}
-	}
-
-	/*void draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& mWorld)
-	{
-		if (NULL == pDevice)
-			return;
-		pDevice->SetTransform(D3DTS_WORLD, &mWorld);
-		pDevice->MultiplyTransform(D3DTS_WORLD, &m_mLocal);
-		pDevice->SetMaterial(&m_mtrl);
-		m_pSphereMesh->DrawSubset(0);
-	}*/
-	void draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& mWorld)
-	{
-		if (!active || NULL == pDevice || m_pSphereMesh == NULL) return; // Skip inactive or invalid balls
-		pDevice->SetTransform(D3DTS_WORLD, &mWorld);
-		pDevice->MultiplyTransform(D3DTS_WORLD, &m_mLocal);
-		pDevice->SetMaterial(&m_mtrl);
-		m_pSphereMesh->DrawSubset(0);
-	}
-
-	bool hasIntersected(CSphere& ball)
-	{
-		// Insert your code here.
-		// Get the centers of both spheres
-		D3DXVECTOR3 thisCenter = this->getCenter();
-		D3DXVECTOR3 ballCenter = ball.getCenter();
-
-		// Calculate the distance between the centers
-		float distance = sqrt(pow(thisCenter.x - ballCenter.x, 2) +
-			pow(thisCenter.y - ballCenter.y, 2) +
-			pow(thisCenter.z - ballCenter.z, 2));
-
-		// Check if the distance is less than or equal to the sum of their radii
-		return distance <= (this->getRadius() + ball.getRadius());
-	}
-
-	//추가
-	bool isActive() const { return active; }
-	bool isColorEqual(const D3DXCOLOR& color1, const D3DXCOLOR& color2, float tolerance = 0.01f)
-	{
-		return fabs(color1.r - color2.r) <= tolerance &&
-			fabs(color1.g - color2.g) <= tolerance &&
-			fabs(color1.b - color2.b) <= tolerance &&
-			fabs(color1.a - color2.a) <= tolerance;
-	}
-
-	void hitBy(CSphere& ball)
-	{
-		if (!this->active || !ball.active) return; // Skip if either ball is inactive
-		if (!this->hasIntersected(ball)) return;  // No collision, return early
-
-		// Handle red ball hitting yellow ball logic
-		else if (isColorEqual(this->m_mtrl.Diffuse, d3d::YELLOW) && isColorEqual(ball.m_mtrl.Diffuse, d3d::RED))
-		{
-			(this->active) = false; // Mark the yellow ball as removed
-			ball.setPower(-ball.getVelocity_X(), -ball.getVelocity_Z()); // Bounce red ball back
-			return;
-		}
-
-		else {
-			// Handle other collision logic here (e.g., normal ball interactions)
-			D3DXVECTOR3 thisCenter = this->getCenter();
-			D3DXVECTOR3 ballCenter = ball.getCenter();
-
-			D3DXVECTOR3 normal = thisCenter - ballCenter;
-			D3DXVec3Normalize(&normal, &normal);
-
-			D3DXVECTOR3 tangent(-normal.z, 0, normal.x);
-
-			float thisNormalVel = D3DXVec3Dot(&normal, &D3DXVECTOR3(this->getVelocity_X(), 0, this->getVelocity_Z()));
-			float ballNormalVel = D3DXVec3Dot(&normal, &D3DXVECTOR3(ball.getVelocity_X(), 0, ball.getVelocity_Z()));
-
-			float thisTangentVel = D3DXVec3Dot(&tangent, &D3DXVECTOR3(this->getVelocity_X(), 0, this->getVelocity_Z()));
-			float ballTangentVel = D3DXVec3Dot(&tangent, &D3DXVECTOR3(ball.getVelocity_X(), 0, ball.getVelocity_Z()));
-
-			std::swap(thisNormalVel, ballNormalVel);
-
-			D3DXVECTOR3 thisNewVel = thisNormalVel * normal + thisTangentVel * tangent;
-			D3DXVECTOR3 ballNewVel = ballNormalVel * normal + ballTangentVel * tangent;
-
-			this->setPower(thisNewVel.x, thisNewVel.z);
-			ball.setPower(ballNewVel.x, ballNewVel.z);
-		}
-	}
-
-	//void hitBy(CSphere& ball)
-	//{
-	//	// Insert your code here.
-	//	if (!this->active || !ball.active) return; // Skip if either ball is inactive
-	//	if (!this->hasIntersected(ball)) return; // No collision, return early
-
-	//	// Get centers of spheres
-	//	D3DXVECTOR3 thisCenter = this->getCenter();
-	//	D3DXVECTOR3 ballCenter = ball.getCenter();
-
-	//	// Calculate normal and tangent directions
-	//	D3DXVECTOR3 normal = thisCenter - ballCenter;
-	//	D3DXVec3Normalize(&normal, &normal); // Normalize to unit vector
-
-	//	D3DXVECTOR3 tangent(-normal.z, 0, normal.x); // Tangent is perpendicular to normal
-
-	//	// Calculate velocities along the normal and tangent directions
-	//	float thisNormalVel = D3DXVec3Dot(&normal, &D3DXVECTOR3(this->getVelocity_X(), 0, this->getVelocity_Z()));
-	//	float ballNormalVel = D3DXVec3Dot(&normal, &D3DXVECTOR3(ball.getVelocity_X(), 0, ball.getVelocity_Z()));
-
-	//	float thisTangentVel = D3DXVec3Dot(&tangent, &D3DXVECTOR3(this->getVelocity_X(), 0, this->getVelocity_Z()));
-	//	float ballTangentVel = D3DXVec3Dot(&tangent, &D3DXVECTOR3(ball.getVelocity_X(), 0, ball.getVelocity_Z()));
-
-	//	// Swap normal velocities (elastic collision)
-	//	std::swap(thisNormalVel, ballNormalVel);
-
-	//	// Compute the new velocities for both spheres
-	//	D3DXVECTOR3 thisNewVel = thisNormalVel * normal + thisTangentVel * tangent;
-	//	D3DXVECTOR3 ballNewVel = ballNormalVel * normal + ballTangentVel * tangent;
-
-	//	// Set the new velocities
-	//	this->setPower(thisNewVel.x, thisNewVel.z);
-	//	ball.setPower(ballNewVel.x, ballNewVel.z);
-	//}
-
-
-	void ballUpdate(float timeDiff)
-	{
-		const float TIME_SCALE = 3.3;
-		D3DXVECTOR3 cord = this->getCenter();
-		double vx = abs(this->getVelocity_X());
-		double vz = abs(this->getVelocity_Z());
-
-		if (vx > 0.01 || vz > 0.01)
-		{
-			float tX = cord.x + TIME_SCALE * timeDiff * m_velocity_x;
-			float tZ = cord.z + TIME_SCALE * timeDiff * m_velocity_z;
-
-			//correction of position of ball
-			// Please uncomment this part because this correction of ball position is necessary when a ball collides with a wall
-			if (tX >= (4.5 - M_RADIUS))
-				tX = 4.5 - M_RADIUS;
-			else if (tX <= (-4.5 + M_RADIUS))
-				tX = -4.5 + M_RADIUS;
-			else if (tZ <= (-3 + M_RADIUS))
-				tZ = -3 + M_RADIUS;
-			else if (tZ >= (3 - M_RADIUS))
-				tZ = 3 - M_RADIUS;
-
-			this->setCenter(tX, cord.y, tZ);
-		}
-		else { this->setPower(0, 0); }
-		//this->setPower(this->getVelocity_X() * DECREASE_RATE, this->getVelocity_Z() * DECREASE_RATE);
-		double rate = 1 - (1 - DECREASE_RATE) * timeDiff * 400;
-		if (rate < 0)
-			rate = 0;
-		this->setPower(getVelocity_X() * rate, getVelocity_Z() * rate);
-	}
-
-	double getVelocity_X() { return this->m_velocity_x; }
-	double getVelocity_Z() { return this->m_velocity_z; }
-
-	void setPower(double vx, double vz)
-	{
-		this->m_velocity_x = vx;
-		this->m_velocity_z = vz;
-	}
-
-	void setCenter(float x, float y, float z)
-	{
-		D3DXMATRIX m;
-		center_x = x;	center_y = y;	center_z = z;
-		D3DXMatrixTranslation(&m, x, y, z);
-		setLocalTransform(m);
-	}
-
-	float getRadius(void)  const { return (float)(M_RADIUS); }
-	const D3DXMATRIX& getLocalTransform(void) const { return m_mLocal; }
-	void setLocalTransform(const D3DXMATRIX& mLocal) { m_mLocal = mLocal; }
-	D3DXVECTOR3 getCenter(void) const
-	{
-		D3DXVECTOR3 org(center_x, center_y, center_z);
-		return org;
-	}
-
-private:
-	D3DXMATRIX              m_mLocal;
-	D3DMATERIAL9            m_mtrl;
-	ID3DXMesh* m_pSphereMesh;
-
-};
-
-
-
-// -----------------------------------------------------------------------------
-// CWall class definition
-// -----------------------------------------------------------------------------
-
-class CWall {
-
-private:
-
-	float					m_x;
-	float					m_z;
-	float                   m_width;
-	float                   m_depth;
-	float					m_height;
-
-public:
-	CWall(void)
-	{
-		D3DXMatrixIdentity(&m_mLocal);
-		ZeroMemory(&m_mtrl, sizeof(m_mtrl));
-		m_width = 0;
-		m_depth = 0;
-		m_pBoundMesh = NULL;
-	}
-	~CWall(void) {}
-public:
-	bool create(IDirect3DDevice9* pDevice, float ix, float iz, float iwidth, float iheight, float idepth, D3DXCOLOR color = d3d::WHITE)
-	{
-		if (NULL == pDevice)
-			return false;
-
-		m_mtrl.Ambient = color;
-		m_mtrl.Diffuse = color;
-		m_mtrl.Specular = color;
-		m_mtrl.Emissive = d3d::BLACK;
-		m_mtrl.Power = 5.0f;
-
-		m_width = iwidth;
-		m_depth = idepth;
-
-		if (FAILED(D3DXCreateBox(pDevice, iwidth, iheight, idepth, &m_pBoundMesh, NULL)))
-			return false;
-		return true;
-	}
-	void destroy(void)
-	{
-		if (m_pBoundMesh != NULL) {
-			m_pBoundMesh->Release();
-			m_pBoundMesh = NULL;
-		}
-	}
-	void draw(IDirect3DDevice9* pDevice, const D3DXMATRIX& mWorld)
-	{
-		if (NULL == pDevice)
-			return;
-		pDevice->SetTransform(D3DTS_WORLD, &mWorld);
-		pDevice->MultiplyTransform(D3DTS_WORLD, &m_mLocal);
-		pDevice->SetMaterial(&m_mtrl);
-		m_pBoundMesh->DrawSubset(0);
-	}
-
-	bool hasIntersected(CSphere& ball)
-	{
-		// Insert your code here.
-		D3DXVECTOR3 ballCenter = ball.getCenter();
-		float ballRadius = ball.getRadius();
-
-		// Check for collision with this wall (based on its position and size)
-		if (ballCenter.x - ballRadius <= -4.5f || ballCenter.x + ballRadius >= 4.5f ||
-			ballCenter.z - ballRadius <= -3.0f || ballCenter.z + ballRadius >= 3.0f) {
-			return true; // Collision detected
-		}
-		return false; // No collision
-	}
-
-
-	void CWall::hitBy(CSphere& ball)
-	{
-		if (!this->hasIntersected(ball)) return; // No collision, return early
-
-		D3DXVECTOR3 ballCenter = ball.getCenter();
-		float ballRadius = ball.getRadius();
-
-		// Check collisions with walls and adjust velocity and position
-		if (ballCenter.x - ballRadius <= -4.5f) { // Left wall
-			ball.setPower(-abs(ball.getVelocity_X()), ball.getVelocity_Z()); // Reflect X velocity
-			ball.setCenter(-4.5f + ballRadius, ballCenter.y, ballCenter.z); // Reposition outside wall
-		}
-		if (ballCenter.x + ballRadius >= 4.5f) { // Right wall
-			ball.setPower(abs(ball.getVelocity_X()), ball.getVelocity_Z()); // Reflect X velocity
-			ball.setCenter(4.5f - ballRadius, ballCenter.y, ballCenter.z); // Reposition outside wall
-		}
-		if (ballCenter.z - ballRadius <= -3.0f) { // Bottom wall
-			ball.setPower(ball.getVelocity_X(), abs(ball.getVelocity_Z())); // Reflect Z velocity
-			ball.setCenter(ballCenter.x, ballCenter.y, -3.0f + ballRadius); // Reposition outside wall
-		}
-		if (ballCenter.z + ballRadius >= 3.0f) { // Top wall
-			ball.setPower(ball.getVelocity_X(), -abs(ball.getVelocity_Z())); // Reflect Z velocity
-			ball.setCenter(ballCenter.x, ballCenter.y, 3.0f - ballRadius); // Reposition outside wall
-		}
-	}
-
-
-	void setPosition(float x, float y, float z)
-	{
-		D3DXMATRIX m;
-		this->m_x = x;
-		this->m_z = z;
-
-		D3DXMatrixTranslation(&m, x, y, z);
-		setLocalTransform(m);
-	}
-
-	float getHeight(void) const { return M_HEIGHT; }
-
-
-
-private:
-	void setLocalTransform(const D3DXMATRIX& mLocal) { m_mLocal = mLocal; }
-
-	D3DXMATRIX              m_mLocal;
-	D3DMATERIAL9            m_mtrl;
-	ID3DXMesh* m_pBoundMesh;
-};
+// cushions of a scene with an outline; g_cushions points here when built
+CCushionField g_cushionField;
+const CCushionField* g_cushions = NULL;
 
 // -----------------------------------------------------------------------------
 // CLight class definition
@@ -426,11 +76,15 @@ public:
 	}
 	~CLight(void) {}
 public:
-	bool create(IDirect3DDevice9* pDevice, const D3DLIGHT9& lit, float radius = 0.1f)
+	bool create(IDirect3DDevice9* pDevice, const D3DLIGHT9& lit, float radius = 0.1f, ID3DXMesh* pMesh = NULL)
 	{
 		if (NULL == pDevice)
 			return false;
-		if (FAILED(D3DXCreateSphere(pDevice, radius, 10, 10, &m_pMesh, NULL)))
+		if (pMesh != NULL) {
+			pMesh->AddRef();
+			m_pMesh = pMesh;
+		}
+		else if (FAILED(D3DXCreateSphere(pDevice, radius, 10, 10, &m_pMesh, NULL)))
 			return false;
 
 		m_bound._center = lit.Position;
@@ -485,6 +139,8 @@ public:
 	}
 
 	D3DXVECTOR3 getPosition(void) const { return D3DXVECTOR3(m_lit.Position); }
+	// as the device has it since setLight()
+	const D3DLIGHT9& getLight(void) const { return m_lit; }
 
 private:
 	DWORD               m_index;
@@ -499,10 +155,126 @@ private:
 // Global variables
 // -----------------------------------------------------------------------------
 CWall	g_legoPlane;
-CWall	g_legowall[4];
-CSphere	g_sphere[7];
+std::vector<CWall>		g_legowall;
+std::vector<CSphere>	g_sphere;
+std::vector<CSphereLook>	g_sphereLook;	// one per g_sphere, only for drawing
+int		g_cueIndex = 6;
+ID3DXMesh*	g_ballMesh = NULL;
 CSphere	g_target_blueball;
+CSphereLook	g_targetLook;
 CLight	g_light;
+CCollisionEventBuffer g_collisionEvents;
+CWorkerPool*	g_workerPool = NULL;
+CSlabStepper*	g_stepper = NULL;
+
+// fixed-point mode ("-fixed"): the table runs on TTablePhysics<FixedPolicy>
+// at a fixed tick and g_sphere only mirrors it for drawing and the rules
+const float FIXED_TICK = 0.005f;
+bool	g_fixedMode = false;
+TBallSet<FixedPolicy>		g_fixedBalls;
+TTablePhysics<FixedPolicy>	g_fixedTable;
+float	g_fixedAccum = 0;
+
+// two-player lockstep ("-peer <local port> <host>:<port> [-first]"), fixed mode only
+CLockstepPeer*	g_lockstep = NULL;
+bool	g_lockstepDesyncShown = false;
+
+// spectator stream ("-spectate <port>"), fed with the drawn state every frame
+CSpectatorServer*	g_spectators = NULL;
+std::vector<float>	g_spectatorX, g_spectatorZ;
+std::vector<unsigned char>	g_spectatorActive;
+
+// trajectory export ("-export <file>"): every fixed tick, or every frame in
+// float mode, goes to the writer thread
+std::string	g_exportPath;
+trajectory::CTrajectoryWriter	g_exporter;
+std::vector<int>	g_exportX, g_exportZ, g_exportVX, g_exportVZ;
+
+// predicted cue ball path while aiming, traced over the resting table
+CAimPreview	g_aimPreview;
+std::vector<float>	g_previewX, g_previewZ;
+std::vector<int>	g_previewType;
+std::vector<unsigned char>	g_previewActive;
+
+struct PreviewVertex {
+	float		x, y, z;
+	D3DCOLOR	color;
+};
+const DWORD PREVIEW_FVF = D3DFVF_XYZ | D3DFVF_DIFFUSE;
+std::vector<PreviewVertex>	g_previewVertices;
+
+// right-click picking: a sphere tree over g_sphere, refit every frame and
+// rebuilt only at rest once refitting has made it this much looser
+const float PICK_REBUILD_DEGRADATION = 2.0f;
+CBallBvh	g_ballBvh;
+std::vector<float>	g_pickX, g_pickZ;
+std::vector<unsigned char>	g_pickActive;
+
+// a frame as two job graphs on g_workerPool. the prepare jobs read the
+// table that is there now: culling and world matrices for the balls into
+// g_ballDraws, picking, the aim preview, spectators. then the step jobs move
+// the table on while this thread draws from g_ballDraws and presents, so
+// the picture is always the table as it was before this frame's step.
+// "-jobtimes <file>" writes every job's timing, one line each
+const int BALLS_PER_DRAW_JOB = 2048;
+struct BallDraw {
+	D3DXMATRIX				world;		// local * world, as draw() would set it
+	const D3DMATERIAL9*		material;
+	ID3DXMesh*				mesh;
+	bool					visible;
+};
+std::vector<BallDraw>	g_ballDraws;
+CJobGraph	g_prepareJobs;
+CJobGraph	g_stepJobs;
+std::string	g_jobTimesPath;
+FILE*	g_jobTimes = NULL;
+unsigned int	g_frameNumber = 0;
+
+// startup geometry: vertices and indices of every mesh come from the cache
+// file ("-meshcache <file>", "" for none) or are generated on g_workerPool,
+// and only the device meshes are made on this thread. the time from launch
+// to the first Present goes to the debugger, and with "-startlog <file>" is
+// appended to that file
+const float LIGHT_RADIUS = 0.1f;
+std::string	g_meshCachePath = "meshes.cache";
+std::string	g_startLogPath;
+DWORD	g_launchTime = 0;
+bool	g_firstFrameShown = false;
+struct StartupTimes {
+	DWORD		geometryMs;		// cache lookup and generation
+	DWORD		meshesMs;		// device meshes
+	DWORD		setupMs;		// all of Setup()
+	size_t		meshCount;
+	size_t		generatedCount;	// not in the cache
+	bool		cacheWritten;
+};
+StartupTimes	g_startup;
+
+// live counters in a slot of the shared telemetry segment, for
+// telemetryTool ("-notelemetry" to stay out of it). stepTable() counts on
+// the step job, Display() publishes once that job is done
+bool	g_telemetryEnabled = true;
+telemetry::CTelemetryPublisher	g_telemetry;
+telemetry::Counters	g_counters;
+
+// input from the window procedure, applied at the start of each frame.
+// percentiles of the time from input to the Present that shows it go to
+// the debugger every INPUT_REPORT_FRAMES frames with new input and at exit,
+// and with "-inputlog <file>" are appended to that file
+const unsigned int INPUT_REPORT_FRAMES = 600;
+CInputQueue	g_input;
+std::vector<InputEvent>	g_inputEvents;
+std::string	g_inputLogPath;
+unsigned long long	g_inputReported = 0;	// events applied at the last report
+unsigned int	g_inputFrames = 0;		// frames that applied any input
+
+// the plane and walls lit once into vertex colours (staticLighting.h) and
+// drawn with lighting off, baked again only when g_mWorld turns the table
+// under the light. "-livelight" has the device light them every frame
+bool	g_bakeStatic = true;
+std::vector<lighting::CBakedMesh>	g_bakedStatic;	// the plane, then the walls
+D3DXMATRIX	g_bakedWorld;
+bool	g_staticBaked = false;
 
 double g_camera_pos[3] = { 0.0, 5.0, -8.0 };
 
@@ -515,38 +287,599 @@ void destroyAllLegoBlock(void)
 {
 }
 
-// initialization
-bool Setup()
+// layout of the original game, as a scene image
+void buildDefaultScene(scene::CSceneBuilder& b)
+{
+	b.setTable(4.5f, 3.0f);
+	for (int i = 0; i < 7; i++)
+		b.addBall(spherePos[i][0], spherePos[i][1], sphereType[i], (DWORD)sphereColor[i]);
+	b.setCue(6);
+	b.addWall(0.0f, 0.12f, 3.06f, 9, 0.3f, 0.12f, (DWORD)d3d::DARKRED);
+	b.addWall(0.0f, 0.12f, -3.06f, 9, 0.3f, 0.12f, (DWORD)d3d::DARKRED);
+	b.addWall(4.56f, 0.12f, 0.0f, 0.12f, 0.3f, 6.24f, (DWORD)d3d::DARKRED);
+	b.addWall(-4.56f, 0.12f, 0.0f, 0.12f, 0.3f, 6.24f, (DWORD)d3d::DARKRED);
+}
+
+// the meshes loadScene() and Setup() use, in this order: the plane, every
+// wall, the sphere all balls share, the light
+void sceneMeshParams(const scene::CSceneFile& sc, std::vector<geometry::MeshParams>& params)
+{
+	const scene::SceneHeader& h = sc.header();
+	params.clear();
+	params.push_back(geometry::boxParams(2 * h.tableHalfX, 0.03f, 2 * h.tableHalfZ));
+	for (unsigned int i = 0; i < h.wallCount; i++)
+		params.push_back(geometry::boxParams(sc.walls()[i].width, sc.walls()[i].height, sc.walls()[i].depth));
+	params.push_back(geometry::sphereParams((float)M_RADIUS, 50, 50));
+	params.push_back(geometry::sphereParams(LIGHT_RADIUS, 10, 10));
+}
+
+// a managed mesh in the layout D3DXCreateSphere and D3DXCreateBox give
+ID3DXMesh* createCachedMesh(const geometry::MeshData& d)
+{
+	if (d.vertices == NULL || d.indexCount == 0)
+		return NULL;
+	ID3DXMesh* mesh = NULL;
+	if (FAILED(D3DXCreateMeshFVF(d.indexCount / 3, d.vertexCount, D3DXMESH_MANAGED, D3DFVF_XYZ | D3DFVF_NORMAL, Device, &mesh)))
+		return NULL;
+
+	void* vertices = NULL;
+	void* indices = NULL;
+	DWORD* attributes = NULL;
+	bool ok = SUCCEEDED(mesh->LockVertexBuffer(0, &vertices));
+	if (ok) {
+		memcpy(vertices, d.vertices, d.vertexCount * sizeof(geometry::MeshVertex));
+		mesh->UnlockVertexBuffer();
+		ok = SUCCEEDED(mesh->LockIndexBuffer(0, &indices));
+	}
+	if (ok) {
+		memcpy(indices, d.indices, d.indexCount * sizeof(unsigned short));
+		mesh->UnlockIndexBuffer();
+		ok = SUCCEEDED(mesh->LockAttributeBuffer(0, &attributes));
+	}
+	if (ok) {
+		memset(attributes, 0, d.indexCount / 3 * sizeof(DWORD));
+		mesh->UnlockAttributeBuffer();
+	}
+	if (!ok)
+		d3d::Release<ID3DXMesh*>(mesh);
+	return ok ? mesh : NULL;
+}
+
+// device meshes in sceneMeshParams() order. the caller releases them once
+// the objects that use them have taken their own references
+bool createSceneMeshes(const scene::CSceneFile& sc, std::vector<ID3DXMesh*>& meshes)
+{
+	std::vector<geometry::MeshParams> params;
+	sceneMeshParams(sc, params);
+
+	DWORD t0 = timeGetTime();
+	geometry::CMeshCache cache;
+	cache.load(g_meshCachePath.c_str(), &params[0], params.size(), g_workerPool);
+	DWORD t1 = timeGetTime();
+
+	bool ok = true;
+	meshes.assign(params.size(), NULL);
+	for (size_t i = 0; i < params.size() && ok; i++) {
+		meshes[i] = createCachedMesh(cache.get(i));
+		ok = meshes[i] != NULL;
+	}
+	g_startup.geometryMs = t1 - t0;
+	g_startup.meshesMs = timeGetTime() - t1;
+	g_startup.meshCount = params.size();
+	g_startup.generatedCount = cache.getGeneratedCount();
+	g_startup.cacheWritten = cache.wasWritten();
+	return ok;
+}
+
+void releaseMeshes(std::vector<ID3DXMesh*>& meshes)
 {
-	int i;
+	for (size_t i = 0; i < meshes.size(); i++)
+		d3d::Release<ID3DXMesh*>(meshes[i]);
+	meshes.clear();
+}
+
+// called after the first Present
+void reportStartup(void)
+{
+	char line[256];
+	sprintf(line, "first frame %lu ms after launch: setup %lu ms, geometry %lu ms, device meshes %lu ms, "
+		"%u of %u meshes generated%s\n",
+		(unsigned long)(timeGetTime() - g_launchTime), (unsigned long)g_startup.setupMs,
+		(unsigned long)g_startup.geometryMs, (unsigned long)g_startup.meshesMs,
+		(unsigned int)g_startup.generatedCount, (unsigned int)g_startup.meshCount,
+		g_startup.cacheWritten ? ", cache written" : "");
+	::OutputDebugString(line);
+	if (!g_startLogPath.empty()) {
+		FILE* fp = fopen(g_startLogPath.c_str(), "a");
+		if (fp != NULL) {
+			fputs(line, fp);
+			fclose(fp);
+		}
+	}
+}
 
+void reportInputLatency(void)
+{
+	if (g_input.getApplied() == g_inputReported)
+		return;
+	g_inputReported = g_input.getApplied();
+	LatencySummary l;
+	g_input.summarize(l);
+	char line[256];
+	sprintf(line, "input to present over %u events: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, worst %.1f ms "
+		"(%.1f ms ever); %llu messages, %llu moves merged\n",
+		l.samples, l.p50Ms, l.p90Ms, l.p99Ms, l.worstMs, l.allWorstMs,
+		g_input.getReceived(), g_input.getMerged());
+	::OutputDebugString(line);
+	if (!g_inputLogPath.empty()) {
+		FILE* fp = fopen(g_inputLogPath.c_str(), "a");
+		if (fp != NULL) {
+			fputs(line, fp);
+			fclose(fp);
+		}
+	}
+}
+
+void destroyBakedStatic(void)
+{
+	for (size_t i = 0; i < g_bakedStatic.size(); i++)
+		g_bakedStatic[i].destroy();
+	g_bakedStatic.clear();
+	g_staticBaked = false;
+}
+
+// copies of the plane and wall meshes for baking. without them the device
+// lights the originals
+bool createBakedStatic(void)
+{
+	g_bakedStatic.resize(1 + g_legowall.size());
+	bool ok = g_bakedStatic[0].create(Device, g_legoPlane.getMesh(), g_legoPlane.getMaterial());
+	for (size_t i = 0; i < g_legowall.size() && ok; i++)
+		ok = g_bakedStatic[1 + i].create(Device, g_legowall[i].getMesh(), g_legowall[i].getMaterial());
+	if (!ok)
+		destroyBakedStatic();
+	return ok;
+}
+
+// the light, camera and render states of Setup()
+void bakeStatic(void)
+{
+	lighting::LightSetup s;
+	s.light = g_light.getLight();
+	s.eye = lighting::eyeOfView(g_mView);
+	::ZeroMemory(&s.ambient, sizeof(s.ambient));
+	g_bakedStatic[0].bake(s, g_legoPlane.getLocalTransform() * g_mWorld);
+	for (size_t i = 0; i < g_legowall.size(); i++)
+		g_bakedStatic[1 + i].bake(s, g_legowall[i].getLocalTransform() * g_mWorld);
+	g_bakedWorld = g_mWorld;
+	g_staticBaked = true;
+}
+
+// the plane and walls, baked when there is a bake
+void drawStatic(void)
+{
+	if (g_bakedStatic.empty()) {
+		g_legoPlane.draw(Device, g_mWorld);
+		for (size_t i = 0; i < g_legowall.size(); i++)
+			g_legowall[i].draw(Device, g_mWorld);
+		return;
+	}
+	if (!g_staticBaked || memcmp(&g_bakedWorld, &g_mWorld, sizeof(D3DXMATRIX)) != 0)
+		bakeStatic();
+	Device->SetRenderState(D3DRS_LIGHTING, FALSE);
+	g_bakedStatic[0].draw(Device, g_legoPlane.getLocalTransform() * g_mWorld);
+	for (size_t i = 0; i < g_legowall.size(); i++)
+		g_bakedStatic[1 + i].draw(Device, g_legowall[i].getLocalTransform() * g_mWorld);
+	Device->SetRenderState(D3DRS_LIGHTING, TRUE);
+}
+
+// create the table objects from a mapped scene, with the meshes of
+// createSceneMeshes()
+bool loadScene(const scene::CSceneFile& sc, const std::vector<ID3DXMesh*>& meshes)
+{
+	const scene::SceneHeader& h = sc.header();
+	unsigned int i;
+
+	g_tableHalfX = h.tableHalfX;
+	g_tableHalfZ = h.tableHalfZ;
+	g_cueIndex = (int)h.cueIndex;
+	g_cushions = g_cushionField.build(sc) ? &g_cushionField : NULL;
+
+	// create plane and set the position
+	if (false == g_legoPlane.create(Device, -1, -1, 2 * g_tableHalfX, 0.03f, 2 * g_tableHalfZ, d3d::GREEN, meshes[0])) return false;
+	g_legoPlane.setPosition(0.0f, -0.0006f / 5, 0.0f);
+
+	// create walls and set the position
+	const scene::SceneWall* walls = sc.walls();
+	g_legowall.resize(h.wallCount);
+	for (i = 0; i < h.wallCount; i++) {
+		const scene::SceneWall& w = walls[i];
+		if (false == g_legowall[i].create(Device, -1, -1, w.width, w.height, w.depth, D3DXCOLOR(w.color), meshes[1 + i])) return false;
+		g_legowall[i].setPosition(w.x, w.y, w.z);
+	}
+
+	// create balls and obstacles. all of them share one sphere mesh
+	g_ballMesh = meshes[1 + h.wallCount];
+	g_ballMesh->AddRef();
+
+	const scene::SceneBall* balls = sc.balls();
+	const scene::SceneObstacle* obstacles = sc.obstacles();
+	g_sphere.resize(h.ballCount + h.obstacleCount);
+	g_sphereLook.resize(h.ballCount + h.obstacleCount);
+	for (i = 0; i < h.ballCount; i++) {
+		const scene::SceneBall& b = balls[i];
+		g_sphere[i].setShape(sc.ballRadius(i), sc.ballMass(i));
+		g_sphere[i].setType(b.type);
+		if (false == g_sphereLook[i].create(Device, sc.ballRadius(i), D3DXCOLOR(b.color), g_ballMesh)) return false;
+		g_sphere[i].setCenter(b.x, sc.ballRadius(i), b.z);
+		g_sphere[i].setPower(b.vx, b.vz);
+	}
+	for (i = 0; i < h.obstacleCount; i++) {
+		const scene::SceneObstacle& o = obstacles[i];
+		CSphere& s = g_sphere[h.ballCount + i];
+		s.setShape(o.radius, 1.0f);
+		s.setType(ENTITY_OBSTACLE);
+		if (false == g_sphereLook[h.ballCount + i].create(Device, o.radius, D3DXCOLOR(o.color), g_ballMesh)) return false;
+		s.setCenter(o.x, o.radius, o.z);
+		s.setPower(0, 0);
+	}
+	return true;
+}
+
+void initFixedPhysics(void)
+{
+	g_fixedTable.setTable(g_tableHalfX, g_tableHalfZ);
+	g_fixedTable.setCushions(g_cushions);
+	g_fixedBalls.resize(g_sphere.size());
+	for (size_t i = 0; i < g_sphere.size(); i++) {
+		D3DXVECTOR3 c = g_sphere[i].getCenter();
+		g_fixedBalls.x[i] = FixedPolicy::fromFloat(c.x);
+		g_fixedBalls.z[i] = FixedPolicy::fromFloat(c.z);
+		g_fixedBalls.vx[i] = FixedPolicy::fromFloat(g_sphere[i].getVelocity_X());
+		g_fixedBalls.vz[i] = FixedPolicy::fromFloat(g_sphere[i].getVelocity_Z());
+		g_fixedBalls.radius[i] = FixedPolicy::fromFloat(g_sphere[i].getRadius());
+		g_fixedBalls.mass[i] = FixedPolicy::fromFloat(g_sphere[i].getMass());
+		g_fixedBalls.type[i] = g_sphere[i].getType();
+		g_fixedBalls.active[i] = g_sphere[i].isActive() ? 1 : 0;
+	}
+	g_fixedAccum = 0;
+}
+
+// whole ticks only, whatever the frame time was. the rules run after every
+// tick so that a removed ball is gone before the next one.
+void countStep(const StepStats& st)
+{
+	g_counters.steps++;
+	g_counters.pairTests += st.pairTests;
+	g_counters.contacts += st.contacts;
+	g_counters.wallHits += st.wallHits;
+	g_counters.activeBalls = st.activeBalls;
+	g_counters.lastPairTests = st.pairTests;
+	g_counters.lastContacts = st.contacts;
+	g_counters.lastWallHits = st.wallHits;
+	g_counters.lastSubsteps = (unsigned int)g_stepper->getLastSubsteps();
+}
+
+void stepFixedPhysics(float timeDelta)
+{
+	const int dt = FixedPolicy::fromFloat(FIXED_TICK);
+	unsigned int now = timeGetTime();
+
+	// in lockstep the table only runs during a shot, so that both peers
+	// count the same ticks from the same resting state
+	if (g_lockstep != NULL) {
+		LockstepShot shot;
+		if (g_lockstep->takeRemoteShot(shot))
+			TTablePhysics<FixedPolicy>::shot(g_fixedBalls, g_cueIndex, shot.targetX, shot.targetZ);
+		if (!g_lockstep->isShotInProgress()) {
+			g_fixedAccum = 0;
+			return;
+		}
+	}
+
+	g_fixedAccum += timeDelta;
+	while (g_fixedAccum >= FIXED_TICK) {
+		g_fixedAccum -= FIXED_TICK;
+
+		g_collisionEvents.clear();
+		g_fixedTable.step(g_fixedBalls, dt, g_collisionEvents);
+		g_counters.steps++;
+		g_counters.contacts += g_collisionEvents.size();
+		g_counters.activeBalls = g_fixedTable.getLastActiveCount();
+		g_counters.lastContacts = (unsigned int)g_collisionEvents.size();
+		g_counters.lastSubsteps = (unsigned int)g_fixedTable.getLastSubsteps();
+		dispatchCollisionEvents(g_collisionEvents, &g_sphere[0]);
+		for (size_t k = 0; k < g_collisionEvents.size(); k++) {
+			const CollisionEvent& e = g_collisionEvents[k];
+			if (!g_sphere[e.a].isActive()) g_fixedBalls.remove(e.a);
+			if (!g_sphere[e.b].isActive()) g_fixedBalls.remove(e.b);
+		}
+		if (g_cushions != NULL) {
+			// and the other way for balls the table dropped into a pocket
+			for (size_t i = 0; i < g_sphere.size(); i++) {
+				if (!g_fixedBalls.active[i] && g_sphere[i].isActive())
+					g_sphere[i].remove();
+			}
+		}
+		if (g_exporter.isOpen())
+			g_exporter.append(&g_fixedBalls.x[0], &g_fixedBalls.z[0], &g_fixedBalls.vx[0], &g_fixedBalls.vz[0]);
+
+		if (g_lockstep != NULL) {
+			g_lockstep->recordTick(g_fixedBalls.hash(), now);
+			if (g_fixedBalls.atRest()) {
+				g_lockstep->endTurn(now);
+				g_fixedAccum = 0;
+				break;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < g_sphere.size(); i++) {
+		g_sphere[i].setCenter(FixedPolicy::toFloat(g_fixedBalls.x[i]), g_sphere[i].getRadius(), FixedPolicy::toFloat(g_fixedBalls.z[i]));
+		g_sphere[i].setPower(FixedPolicy::toFloat(g_fixedBalls.vx[i]), FixedPolicy::toFloat(g_fixedBalls.vz[i]));
+	}
+}
+
+bool ballsAtRest(void)
+{
+	for (size_t i = 0; i < g_sphere.size(); i++) {
+		if (g_sphere[i].isActive() && (g_sphere[i].getVelocity_X() != 0 || g_sphere[i].getVelocity_Z() != 0))
+			return false;
+	}
+	return true;
+}
+
+// the preview table is built once each time the balls come to rest and
+// dropped while they move. a trace left unfinished by the last mouse move
+// goes on here, one budget per frame.
+void updateAimPreview(bool atRest)
+{
+	if (!atRest || !g_sphere[g_cueIndex].isActive()) {
+		if (g_aimPreview.hasBalls())
+			g_aimPreview.clear();
+		return;
+	}
+
+	if (!g_aimPreview.hasBalls()) {
+		size_t n = g_sphere.size();
+		g_previewX.resize(n);
+		g_previewZ.resize(n);
+		g_previewType.resize(n);
+		g_previewActive.resize(n);
+		for (size_t i = 0; i < n; i++) {
+			D3DXVECTOR3 c = g_sphere[i].getCenter();
+			g_previewX[i] = c.x;
+			g_previewZ[i] = c.z;
+			g_previewType[i] = g_sphere[i].getType();
+			g_previewActive[i] = g_sphere[i].isActive() ? 1 : 0;
+		}
+		g_aimPreview.setBalls(&g_previewX[0], &g_previewZ[0], &g_previewType[0], &g_previewActive[0],
+			(unsigned int)n, (unsigned int)g_cueIndex, g_tableHalfX, g_tableHalfZ);
+
+		D3DXVECTOR3 target = g_target_blueball.getCenter();
+		g_aimPreview.aim(target.x, target.z);
+	}
+	g_aimPreview.advance(PREVIEW_WORK_BUDGET);
+}
+
+void refitPicking(bool atRest)
+{
+	size_t n = g_sphere.size();
+	g_pickX.resize(n);
+	g_pickZ.resize(n);
+	g_pickActive.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		D3DXVECTOR3 c = g_sphere[i].getCenter();
+		g_pickX[i] = c.x;
+		g_pickZ[i] = c.z;
+		g_pickActive[i] = g_sphere[i].isActive() ? 1 : 0;
+	}
+
+	if (g_ballBvh.getBallCount() != n || (atRest && g_ballBvh.getDegradation() > PICK_REBUILD_DEGRADATION))
+		g_ballBvh.build(&g_pickX[0], &g_pickZ[0], &g_pickActive[0], (unsigned int)n, (float)M_RADIUS, (float)M_RADIUS);
+	else
+		g_ballBvh.refit(&g_pickX[0], &g_pickZ[0], &g_pickActive[0]);
+}
+
+// screen point to a ray in table space: through the projection, then back
+// through the view and the rotated world
+d3d::Ray calcPickingRay(int x, int y)
+{
+	D3DVIEWPORT9 vp;
+	Device->GetViewport(&vp);
+	float px = ((2.0f * x) / vp.Width - 1.0f) / g_mProj(0, 0);
+	float py = ((-2.0f * y) / vp.Height + 1.0f) / g_mProj(1, 1);
+
+	d3d::Ray ray;
+	ray._origin = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	ray._direction = D3DXVECTOR3(px, py, 1.0f);
+
+	D3DXMATRIX worldView = g_mWorld * g_mView;
+	D3DXMATRIX inverse;
+	D3DXMatrixInverse(&inverse, 0, &worldView);
+	D3DXVec3TransformCoord(&ray._origin, &ray._origin, &inverse);
+	D3DXVec3TransformNormal(&ray._direction, &ray._direction, &inverse);
+	D3DXVec3Normalize(&ray._direction, &ray._direction);
+	return ray;
+}
+
+// cue ball path in white, the object balls it sends off in cyan
+void drawAimPreview(void)
+{
+	const std::vector<PreviewSegment>& segments = g_aimPreview.getSegments();
+	if (segments.empty())
+		return;
+
+	const float y = 0.02f;
+	g_previewVertices.resize(segments.size() * 2);
+	for (size_t i = 0; i < segments.size(); i++) {
+		const PreviewSegment& s = segments[i];
+		D3DCOLOR color = s.ball == g_cueIndex ? (D3DCOLOR)d3d::WHITE : (D3DCOLOR)d3d::CYAN;
+		PreviewVertex a = { s.x0, y, s.z0, color };
+		PreviewVertex b = { s.x1, y, s.z1, color };
+		g_previewVertices[2 * i] = a;
+		g_previewVertices[2 * i + 1] = b;
+	}
+
+	Device->SetTransform(D3DTS_WORLD, &g_mWorld);
+	Device->SetRenderState(D3DRS_LIGHTING, FALSE);
+	Device->SetFVF(PREVIEW_FVF);
+	Device->DrawPrimitiveUP(D3DPT_LINELIST, (UINT)segments.size(), &g_previewVertices[0], sizeof(PreviewVertex));
+	Device->SetRenderState(D3DRS_LIGHTING, TRUE);
+}
+
+// view frustum in table space for this frame's world matrix, a x + b y +
+// c z + d >= 0 inside, unit normals
+void frustumPlanes(float planes[6][4])
+{
+	D3DXMATRIX m = g_mWorld * g_mView * g_mProj;
+	for (int k = 0; k < 4; k++) {
+		float w = m(k, 3);
+		planes[0][k] = w + m(k, 0);		// left
+		planes[1][k] = w - m(k, 0);		// right
+		planes[2][k] = w + m(k, 1);		// bottom
+		planes[3][k] = w - m(k, 1);		// top
+		planes[4][k] = m(k, 2);			// near
+		planes[5][k] = w - m(k, 2);		// far
+	}
+	for (int p = 0; p < 6; p++) {
+		float len = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+		for (int k = 0; k < 4; k++)
+			planes[p][k] /= len;
+	}
+}
+
+// balls first .. last - 1 of g_ballDraws. the world matrix only rotates, so
+// a ball's radius is the same in table space
+void buildBallDraws(int first, int last, const float planes[6][4])
+{
+	for (int i = first; i < last; i++) {
+		const CSphere& s = g_sphere[i];
+		const CSphereLook& look = g_sphereLook[i];
+		BallDraw& d = g_ballDraws[i];
+		d.visible = s.isActive() && look.getMesh() != NULL;
+		D3DXVECTOR3 c = s.getCenter();
+		float r = s.getRadius();
+		for (int p = 0; p < 6 && d.visible; p++)
+			d.visible = planes[p][0] * c.x + planes[p][1] * c.y + planes[p][2] * c.z + planes[p][3] >= -r;
+		if (!d.visible)
+			continue;
+		D3DXMATRIX local;
+		look.getLocalTransform(s, local);
+		d.world = local * g_mWorld;
+		d.material = &look.getMaterial();
+		d.mesh = look.getMesh();
+	}
+}
+
+// one frame of physics and rules, and the export of its result
+void stepTable(float timeDelta)
+{
+	if (g_fixedMode) {
+		stepFixedPhysics(timeDelta);
+		return;
+	}
+
+	g_collisionEvents.clear();
+	g_stepper->step(g_sphere, g_legowall, timeDelta, g_collisionEvents);
+	countStep(g_stepper->getLastStats());
+	dispatchCollisionEvents(g_collisionEvents, &g_sphere[0]);
+
+	if (g_exporter.isOpen()) {
+		int numBalls = (int)g_sphere.size();
+		g_exportX.resize(numBalls);		g_exportZ.resize(numBalls);
+		g_exportVX.resize(numBalls);	g_exportVZ.resize(numBalls);
+		for (int i = 0; i < numBalls; i++) {
+			D3DXVECTOR3 c = g_sphere[i].getCenter();
+			g_exportX[i] = FixedPolicy::fromFloat(c.x);
+			g_exportZ[i] = FixedPolicy::fromFloat(c.z);
+			g_exportVX[i] = FixedPolicy::fromFloat(g_sphere[i].getVelocity_X());
+			g_exportVZ[i] = FixedPolicy::fromFloat(g_sphere[i].getVelocity_Z());
+		}
+		g_exporter.append(&g_exportX[0], &g_exportZ[0], &g_exportVX[0], &g_exportVZ[0]);
+	}
+}
+
+void publishSpectators(void)
+{
+	int numBalls = (int)g_sphere.size();
+	g_spectatorX.resize(numBalls);
+	g_spectatorZ.resize(numBalls);
+	g_spectatorActive.resize(numBalls);
+	for (int i = 0; i < numBalls; i++) {
+		D3DXVECTOR3 c = g_sphere[i].getCenter();
+		g_spectatorX[i] = c.x;
+		g_spectatorZ[i] = c.z;
+		g_spectatorActive[i] = g_sphere[i].isActive() ? 1 : 0;
+	}
+	g_spectators->publish(&g_spectatorX[0], &g_spectatorZ[0], &g_spectatorActive[0], numBalls);
+	g_spectators->poll(0);
+}
+
+void writeJobTimes(const char* graph, const CJobGraph& jobs)
+{
+	for (int k = 0; k < jobs.getJobCount(); k++) {
+		const JobTiming& t = jobs.getTiming(k);
+		fprintf(g_jobTimes, "%u %s %s %d %.3f %.3f\n", g_frameNumber, graph, t.name, t.worker, t.startMs, t.endMs);
+	}
+}
+
+// initialization
+bool Setup(const char* scenePath)
+{
+	DWORD setupStart = timeGetTime();
 	D3DXMatrixIdentity(&g_mWorld);
 	D3DXMatrixIdentity(&g_mView);
 	D3DXMatrixIdentity(&g_mProj);
 
-	// create plane and set the position
-	if (false == g_legoPlane.create(Device, -1, -1, 9, 0.03f, 6, d3d::GREEN)) return false;
-	g_legoPlane.setPosition(0.0f, -0.0006f / 5, 0.0f);
+	// the scene is used in place, straight from the mapped file
+	scene::CSceneFile sc;
+	std::vector<unsigned char> defaultImage;
+	if (scenePath != NULL && scenePath[0] != '\0') {
+		if (!sc.open(scenePath))
+			return false;
+	}
+	else {
+		scene::CSceneBuilder b;
+		buildDefaultScene(b);
+		b.build(defaultImage);
+		if (!sc.openMemory(&defaultImage[0], defaultImage.size()))
+			return false;
+	}
 
-	// create walls and set the position. note that there are four walls
-	if (false == g_legowall[0].create(Device, -1, -1, 9, 0.3f, 0.12f, d3d::DARKRED)) return false;
-	g_legowall[0].setPosition(0.0f, 0.12f, 3.06f);
-	if (false == g_legowall[1].create(Device, -1, -1, 9, 0.3f, 0.12f, d3d::DARKRED)) return false;
-	g_legowall[1].setPosition(0.0f, 0.12f, -3.06f);
-	if (false == g_legowall[2].create(Device, -1, -1, 0.12f, 0.3f, 6.24f, d3d::DARKRED)) return false;
-	g_legowall[2].setPosition(4.56f, 0.12f, 0.0f);
-	if (false == g_legowall[3].create(Device, -1, -1, 0.12f, 0.3f, 6.24f, d3d::DARKRED)) return false;
-	g_legowall[3].setPosition(-4.56f, 0.12f, 0.0f);
+	g_workerPool = new CWorkerPool();
+	std::vector<ID3DXMesh*> meshes;
+	if (!createSceneMeshes(sc, meshes) || !loadScene(sc, meshes)) {
+		releaseMeshes(meshes);
+		return false;
+	}
+	g_collisionEvents.reserve(g_sphere.size());
+
+	if (g_lockstep != NULL)
+		g_fixedMode = true;
 
-	// create four balls and set the position
-	for (i = 0; i < 7; i++) {
-		if (false == g_sphere[i].create(Device, sphereColor[i])) return false;
-		g_sphere[i].setCenter(spherePos[i][0], (float)M_RADIUS, spherePos[i][1]);
-		g_sphere[i].setPower(0, 0);
+	g_stepper = new CSlabStepper(*g_workerPool);
+	if (g_fixedMode)
+		initFixedPhysics();
+
+	if (!g_exportPath.empty() && !g_exporter.open(g_exportPath.c_str(), (unsigned int)g_sphere.size()))
+		return false;
+	// a full or foreign segment only costs the live counters
+	if (g_telemetryEnabled)
+		g_telemetry.open();
+	if (!g_jobTimesPath.empty()) {
+		g_jobTimes = fopen(g_jobTimesPath.c_str(), "w");
+		if (g_jobTimes == NULL)
+			return false;
+		fprintf(g_jobTimes, "frame graph job worker startMs endMs\n");
 	}
 
 	// create blue ball for set direction
-	if (false == g_target_blueball.create(Device, d3d::BLUE)) return false;
+	g_target_blueball.setType(ENTITY_TARGET);
+	if (false == g_targetLook.create(Device, g_target_blueball.getRadius(), d3d::BLUE, g_ballMesh)) {
+		releaseMeshes(meshes);
+		return false;
+	}
 	g_target_blueball.setCenter(.0f, (float)M_RADIUS, .0f);
 
 	// light setting 
@@ -561,11 +894,16 @@ bool Setup()
 	lit.Attenuation0 = 0.0f;
 	lit.Attenuation1 = 0.9f;
 	lit.Attenuation2 = 0.0f;
-	if (false == g_light.create(Device, lit))
+	bool lightMade = g_light.create(Device, lit, LIGHT_RADIUS, meshes.back());
+	releaseMeshes(meshes);
+	if (!lightMade)
 		return false;
 
-	// Position and aim the camera.
-	D3DXVECTOR3 pos(0.0f, 5.0f, -8.0f);
+	// Position and aim the camera. larger tables are viewed from further away
+	float viewScale = 1.0f;
+	if (g_tableHalfX / 4.5f > viewScale) viewScale = g_tableHalfX / 4.5f;
+	if (g_tableHalfZ / 3.0f > viewScale) viewScale = g_tableHalfZ / 3.0f;
+	D3DXVECTOR3 pos(0.0f, 5.0f * viewScale, -8.0f * viewScale);
 	D3DXVECTOR3 target(0.0f, 0.0f, 0.0f);
 	D3DXVECTOR3 up(0.0f, 2.0f, 0.0f);
 	D3DXMatrixLookAtLH(&g_mView, &pos, &target, &up);
@@ -573,41 +911,80 @@ bool Setup()
 
 	// Set the projection matrix.
 	D3DXMatrixPerspectiveFovLH(&g_mProj, D3DX_PI / 4,
-		(float)Width / (float)Height, 1.0f, 100.0f);
+		(float)Width / (float)Height, 1.0f, 100.0f * viewScale);
 	Device->SetTransform(D3DTS_PROJECTION, &g_mProj);
 
 	// Set render states.
 	Device->SetRenderState(D3DRS_LIGHTING, TRUE);
 	Device->SetRenderState(D3DRS_SPECULARENABLE, TRUE);
 	Device->SetRenderState(D3DRS_SHADEMODE, D3DSHADE_GOURAUD);
+	Device->SetRenderState(D3DRS_NORMALIZENORMALS, TRUE);	// balls of other sizes are drawn scaled
 
 	g_light.setLight(Device, g_mWorld);
+	if (g_bakeStatic)
+		createBakedStatic();
+	g_startup.setupMs = timeGetTime() - setupStart;
 	return true;
 }
 
 void Cleanup(void)
 {
+	destroyBakedStatic();
 	g_legoPlane.destroy();
-	for (int i = 0; i < 4; i++) {
+	for (size_t i = 0; i < g_legowall.size(); i++) {
 		g_legowall[i].destroy();
 	}
+	for (size_t i = 0; i < g_sphereLook.size(); i++) {
+		g_sphereLook[i].destroy();
+	}
+	g_targetLook.destroy();
+	d3d::Release<ID3DXMesh*>(g_ballMesh);
+	g_ballMesh = NULL;
+	d3d::Delete<CSlabStepper*>(g_stepper);
+	g_stepper = NULL;
+	d3d::Delete<CWorkerPool*>(g_workerPool);
+	g_workerPool = NULL;
+	d3d::Delete<CLockstepPeer*>(g_lockstep);
+	g_lockstep = NULL;
+	g_exporter.close();
+	g_telemetry.close();
+	reportInputLatency();
+	if (g_jobTimes != NULL) {
+		fclose(g_jobTimes);
+		g_jobTimes = NULL;
+	}
+	d3d::Delete<CSpectatorServer*>(g_spectators);
+	g_spectators = NULL;
 	destroyAllLegoBlock();
 	g_light.destroy();
 }
 
 
+void applyInput(const InputEvent& e);	// with the window procedure
+
 // timeDelta represents the time between the current image frame and the last image frame.
 // the distance of moving balls should be "velocity * timeDelta"
 bool Display(float timeDelta)
 {
 	int i = 0;
-	int j = 0;
-
+	int numBalls = (int)g_sphere.size();
 
 	if (Device)
 	{
-		Device->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0x00afafaf, 1.0f, 0);
-		Device->BeginScene();
+		if (g_lockstep != NULL) {
+			g_lockstep->poll(timeGetTime());
+			if (g_lockstep->isDesynced() && !g_lockstepDesyncShown) {
+				char msg[128];
+				sprintf(msg, "Lockstep desync at turn %u, tick %u",
+					(unsigned int)g_lockstep->getDesyncTurn(), g_lockstep->getDesyncTick());
+				g_lockstepDesyncShown = true;
+				::MessageBox(0, msg, 0, 0);
+			}
+		}
+
+		g_input.take(g_inputEvents);
+		for (size_t k = 0; k < g_inputEvents.size(); k++)
+			applyInput(g_inputEvents[k]);
 
 		//// update the position of each ball. during update, check whether each ball hit by walls.
 		//for (i = 0; i < 7; i++) {
@@ -623,60 +1000,82 @@ bool Display(float timeDelta)
 		//	}
 		//}
 
-		for (i = 0; i < 7; i++) {
-			if (!g_sphere[i].isActive()) continue; // Skip inactive balls
-			g_sphere[i].ballUpdate(timeDelta);
-			for (j = 0; j < 4; j++) {
-				g_legowall[j].hitBy(g_sphere[i]);
-			}
+		// what the prepare jobs read stays put until they are done
+		bool atRest = ballsAtRest();
+		float planes[6][4];
+		frustumPlanes(planes);
+		g_ballDraws.resize(numBalls);
+
+		g_prepareJobs.clear();
+		for (int first = 0; first < numBalls; first += BALLS_PER_DRAW_JOB) {
+			int last = first + BALLS_PER_DRAW_JOB < numBalls ? first + BALLS_PER_DRAW_JOB : numBalls;
+			g_prepareJobs.add("draws", [first, last, &planes] { buildBallDraws(first, last, planes); });
 		}
+		g_prepareJobs.add("picking", [atRest] { refitPicking(atRest); });
+		g_prepareJobs.add("aimPreview", [atRest] { updateAimPreview(atRest); });
+		if (g_spectators != NULL)
+			g_prepareJobs.add("spectators", [] { publishSpectators(); });
+		g_prepareJobs.start(*g_workerPool);
 
-		// Check collisions between balls
-		for (i = 0; i < 7; i++) {
-			if (!g_sphere[i].isActive()) continue; // Skip inactive balls
-			for (j = 0; j < 7; j++) {
-				if (i >= j || !g_sphere[j].isActive()) continue; // Skip inactive balls
-				//g_sphere[i].hitBy(g_sphere[j]);
-				if (g_sphere[i].hasIntersected(g_sphere[j])) {
-					if (sphereColor[j] == d3d::YELLOW) { // Check if the ball is yellow
-						g_sphere[i].hitBy(g_sphere[j]); // Ensure bounce happens
-						//g_sphere[j].hitBy(g_sphere[i]); // Ensure both balls affect each other
-						//g_sphere[j].active= false; // Mark the yellow ball as inactive
-						g_sphere[j].destroy(); // Destroy the yellow ball
-					}
-					else {
-						g_sphere[i].hitBy(g_sphere[j]); // Bounce for non-yellow balls
-						//g_sphere[j].hitBy(g_sphere[i]);
-					}
-				}
+		// the plane and walls do not move. only this thread uses the device
+		Device->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0x00afafaf, 1.0f, 0);
+		Device->BeginScene();
+		drawStatic();
+		g_prepareJobs.wait();
 
-			}
-		}
+		// move the balls, bounce them off the walls and collect ball-ball
+		// contacts, while the balls are drawn from g_ballDraws. the slabs
+		// of the step are jobs of their own on the same pool; the game
+		// rules run on the whole batch of contacts afterwards.
+		g_stepJobs.clear();
+		g_stepJobs.add("physics", [timeDelta] { stepTable(timeDelta); });
+		g_stepJobs.start(*g_workerPool);
 
-		// draw plane, walls, and spheres
-		g_legoPlane.draw(Device, g_mWorld);
-		for (i = 0; i < 4; i++) {
-			g_legowall[i].draw(Device, g_mWorld);
-		}
 		/*for (i = 0; i < 7; i++) {
 			g_sphere[i].draw(Device, g_mWorld);
 		}*/
-		for (i = 0; i < 7; i++) {
-			if (g_sphere[i].isActive()) { // Draw only active balls
-				g_sphere[i].draw(Device, g_mWorld);
-			}
+		for (i = 0; i < numBalls; i++) {
+			const BallDraw& d = g_ballDraws[i];
+			if (!d.visible)
+				continue;
+			Device->SetTransform(D3DTS_WORLD, &d.world);
+			Device->SetMaterial(d.material);
+			d.mesh->DrawSubset(0);
 		}
-		g_target_blueball.draw(Device, g_mWorld);
+		drawAimPreview();
+		g_targetLook.draw(Device, g_mWorld, g_target_blueball);
 		g_light.draw(Device);
 
 		Device->EndScene();
 		Device->Present(0, 0, 0, 0);
+		g_input.presented(CInputQueue::now());
 		Device->SetTexture(0, NULL);
+		if (!g_firstFrameShown) {
+			g_firstFrameShown = true;
+			reportStartup();
+		}
+
+		// the next frame's input reads the table
+		g_stepJobs.wait();
+		if (g_telemetry.isOpen()) {
+			g_counters.frames++;
+			g_counters.frameMs = timeDelta / 0.0007f;	// EnterMsgLoop's scale
+			g_telemetry.publish(g_counters);
+		}
+		if (g_jobTimes != NULL) {
+			writeJobTimes("prepare", g_prepareJobs);
+			writeJobTimes("step", g_stepJobs);
+		}
+		g_frameNumber++;
+		if (!g_inputEvents.empty() && ++g_inputFrames % INPUT_REPORT_FRAMES == 0)
+			reportInputLatency();
 	}
 	return true;
 }
 
-LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+// one queued event, at the start of the frame: the prepare jobs are not
+// running yet and the step jobs of the last frame are done
+void applyInput(const InputEvent& e)
 {
 	static bool wire = false;
 	static bool isReset = true;
@@ -684,18 +1083,10 @@ LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	static int old_y = 0;
 	static enum { WORLD_MOVE, LIGHT_MOVE, BLOCK_MOVE } move = WORLD_MOVE;
 
-	switch (msg) {
-	case WM_DESTROY:
-	{
-		::PostQuitMessage(0);
-		break;
-	}
+	switch (e.msg) {
 	case WM_KEYDOWN:
 	{
-		switch (wParam) {
-		case VK_ESCAPE:
-			::DestroyWindow(hwnd);
-			break;
+		switch (e.wParam) {
 		case VK_RETURN:
 			if (NULL != Device) {
 				wire = !wire;
@@ -706,14 +1097,24 @@ LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		case VK_SPACE:
 
 			D3DXVECTOR3 targetpos = g_target_blueball.getCenter();
-			D3DXVECTOR3	whitepos = g_sphere[6].getCenter();
+			if (g_fixedMode) {
+				// integer shot, the same on every host. in lockstep only the
+				// target goes over the wire and the peer replays the shot
+				int tx = FixedPolicy::fromFloat(targetpos.x);
+				int tz = FixedPolicy::fromFloat(targetpos.z);
+				if (g_lockstep != NULL && !g_lockstep->sendShot(tx, tz, timeGetTime()))
+					break;
+				TTablePhysics<FixedPolicy>::shot(g_fixedBalls, g_cueIndex, tx, tz);
+				break;
+			}
+			D3DXVECTOR3	whitepos = g_sphere[g_cueIndex].getCenter();
 			double theta = acos(sqrt(pow(targetpos.x - whitepos.x, 2)) / sqrt(pow(targetpos.x - whitepos.x, 2) +
 				pow(targetpos.z - whitepos.z, 2)));		// 기본 1 사분면
 			if (targetpos.z - whitepos.z <= 0 && targetpos.x - whitepos.x >= 0) { theta = -theta; }	//4 사분면
 			if (targetpos.z - whitepos.z >= 0 && targetpos.x - whitepos.x <= 0) { theta = PI - theta; } //2 사분면
 			if (targetpos.z - whitepos.z <= 0 && targetpos.x - whitepos.x <= 0) { theta = PI + theta; } // 3 사분면
 			double distance = sqrt(pow(targetpos.x - whitepos.x, 2) + pow(targetpos.z - whitepos.z, 2));
-			g_sphere[6].setPower(distance * cos(theta), distance * sin(theta));
+			g_sphere[g_cueIndex].setPower((float)(distance * cos(theta)), (float)(distance * sin(theta)));
 
 			break;
 
@@ -721,14 +1122,47 @@ LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		break;
 	}
 
+	case WM_RBUTTONDOWN:
+	{
+		// the target jumps to the ball under the cursor, or else to the
+		// cloth there. dragging then nudges it as before
+		d3d::Ray ray = calcPickingRay(LOWORD(e.lParam), HIWORD(e.lParam));
+		const float origin[3] = { ray._origin.x, ray._origin.y, ray._origin.z };
+		const float dir[3] = { ray._direction.x, ray._direction.y, ray._direction.z };
+		float t;
+		int ball = g_ballBvh.intersect(origin, dir, &t);
+		float x, z;
+		if (ball >= 0 && ball != g_cueIndex) {
+			D3DXVECTOR3 c = g_sphere[ball].getCenter();
+			x = c.x;
+			z = c.z;
+		}
+		else if (ray._direction.y < 0) {
+			t = ((float)M_RADIUS - ray._origin.y) / ray._direction.y;
+			x = ray._origin.x + t * ray._direction.x;
+			z = ray._origin.z + t * ray._direction.z;
+			if (x < -g_tableHalfX) x = -g_tableHalfX;
+			if (x > g_tableHalfX) x = g_tableHalfX;
+			if (z < -g_tableHalfZ) z = -g_tableHalfZ;
+			if (z > g_tableHalfZ) z = g_tableHalfZ;
+		}
+		else
+			break;
+
+		g_target_blueball.setCenter(x, (float)M_RADIUS, z);
+		g_aimPreview.aim(x, z);
+		g_aimPreview.advance(PREVIEW_WORK_BUDGET);
+		break;
+	}
+
 	case WM_MOUSEMOVE:
 	{
-		int new_x = LOWORD(lParam);
-		int new_y = HIWORD(lParam);
+		int new_x = LOWORD(e.lParam);
+		int new_y = HIWORD(e.lParam);
 		float dx;
 		float dy;
 
-		if (LOWORD(wParam) & MK_LBUTTON) {
+		if (LOWORD(e.wParam) & MK_LBUTTON) {
 
 			if (isReset) {
 				isReset = false;
@@ -759,12 +1193,17 @@ LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		else {
 			isReset = true;
 
-			if (LOWORD(wParam) & MK_RBUTTON) {
+			if (LOWORD(e.wParam) & MK_RBUTTON) {
 				dx = (old_x - new_x);// * 0.01f;
 				dy = (old_y - new_y);// * 0.01f;
 
 				D3DXVECTOR3 coord3d = g_target_blueball.getCenter();
 				g_target_blueball.setCenter(coord3d.x + dx * (-0.007f), coord3d.y, coord3d.z + dy * 0.007f);
+
+				// the first stretch of the new path is ready before the next frame
+				coord3d = g_target_blueball.getCenter();
+				g_aimPreview.aim(coord3d.x, coord3d.z);
+				g_aimPreview.advance(PREVIEW_WORK_BUDGET);
 			}
 			old_x = new_x;
 			old_y = new_y;
@@ -774,16 +1213,112 @@ LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		break;
 	}
 	}
+}
+
+// input is only queued here, stamped, and applied by Display()
+LRESULT CALLBACK d3d::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	switch (msg) {
+	case WM_DESTROY:
+		::PostQuitMessage(0);
+		break;
+	case WM_KEYDOWN:
+		if (wParam == VK_ESCAPE)
+			::DestroyWindow(hwnd);
+		else if (wParam == VK_RETURN || wParam == VK_SPACE)
+			g_input.push(msg, wParam, lParam, CInputQueue::messageStamp());
+		break;
+	case WM_RBUTTONDOWN:
+	case WM_MOUSEMOVE:
+		g_input.push(msg, wParam, lParam, CInputQueue::messageStamp());
+		break;
+	}
 
 	return ::DefWindowProc(hwnd, msg, wParam, lParam);
 }
 
 
+// [-fixed] [-peer <local port> <host>:<port> [-first]] [-spectate <port>]
+// [-export <file>] [-jobtimes <file>] [-meshcache <file>] [-startlog <file>]
+// [-notelemetry] [-inputlog <file>] [-livelight] [scene file]
+bool parseCommandLine(const char* cmdLine, std::string& scenePath)
+{
+	const char* p = cmdLine != NULL ? cmdLine : "";
+	std::vector<std::string> args;
+
+	while (*p != '\0') {
+		while (*p == ' ' || *p == '\t') p++;
+		if (*p == '\0') break;
+
+		std::string arg;
+		if (*p == '"') {
+			p++;
+			while (*p != '\0' && *p != '"') arg += *p++;
+			if (*p == '"') p++;
+		}
+		else {
+			while (*p != '\0' && *p != ' ' && *p != '\t') arg += *p++;
+		}
+		args.push_back(arg);
+	}
+
+	unsigned short localPort = 0, remotePort = 0, spectatePort = 0;
+	std::string remoteHost;
+	bool first = false;
+
+	for (size_t i = 0; i < args.size(); i++) {
+		if (args[i] == "-fixed")
+			g_fixedMode = true;
+		else if (args[i] == "-first")
+			first = true;
+		else if (args[i] == "-peer" && i + 2 < args.size()) {
+			localPort = (unsigned short)atoi(args[i + 1].c_str());
+			size_t colon = args[i + 2].rfind(':');
+			if (colon == std::string::npos)
+				return false;
+			remoteHost = args[i + 2].substr(0, colon);
+			remotePort = (unsigned short)atoi(args[i + 2].c_str() + colon + 1);
+			i += 2;
+		}
+		else if (args[i] == "-spectate" && i + 1 < args.size())
+			spectatePort = (unsigned short)atoi(args[++i].c_str());
+		else if (args[i] == "-export" && i + 1 < args.size())
+			g_exportPath = args[++i];
+		else if (args[i] == "-jobtimes" && i + 1 < args.size())
+			g_jobTimesPath = args[++i];
+		else if (args[i] == "-meshcache" && i + 1 < args.size())
+			g_meshCachePath = args[++i];
+		else if (args[i] == "-startlog" && i + 1 < args.size())
+			g_startLogPath = args[++i];
+		else if (args[i] == "-notelemetry")
+			g_telemetryEnabled = false;
+		else if (args[i] == "-inputlog" && i + 1 < args.size())
+			g_inputLogPath = args[++i];
+		else if (args[i] == "-livelight")
+			g_bakeStatic = false;
+		else
+			scenePath = args[i];
+	}
+
+	if (localPort != 0) {
+		g_lockstep = new CLockstepPeer();
+		if (!g_lockstep->open(localPort, remoteHost.c_str(), remotePort, first))
+			return false;
+	}
+	if (spectatePort != 0) {
+		g_spectators = new CSpectatorServer();
+		if (!g_spectators->open(spectatePort))
+			return false;
+	}
+	return true;
+}
+
 int WINAPI WinMain(_In_ HINSTANCE hinstance,
 	_In_opt_ HINSTANCE prevInstance,
 	_In_ PSTR cmdLine,
 	_In_ int showCmd)
 {
+	g_launchTime = timeGetTime();
 	srand(static_cast<unsigned int>(time(NULL)));
 
 	if (!d3d::InitD3D(hinstance,
@@ -793,7 +1328,14 @@ int WINAPI WinMain(_In_ HINSTANCE hinstance,
 		return 0;
 	}
 
-	if (!Setup())
+	std::string scenePath;
+	if (!parseCommandLine(cmdLine, scenePath))
+	{
+		::MessageBox(0, "Bad command line or socket - FAILED", 0, 0);
+		return 0;
+	}
+
+	if (!Setup(scenePath.c_str()))
 	{
 		::MessageBox(0, "Setup() - FAILED", 0, 0);
 		return 0;
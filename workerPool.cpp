@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: workerPool.cpp
+//
+// Desc: Fixed set of worker threads with work-stealing task deques.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "workerPool.h"
+
+namespace
+{
+	// which pool's thread this is, and which one
+	thread_local const CWorkerPool*	t_pool = NULL;
+	thread_local int				t_index = 0;
+
+	const int RANGES_PER_THREAD = 4;	// parallelFor() splits no finer than this
+}
+
+CWorkerPool::CWorkerPool(int threadCount)
+{
+	m_queued = 0;
+	m_quit = false;
+
+	if (threadCount < 0) {
+		threadCount = (int)std::thread::hardware_concurrency() - 1;
+		if (threadCount < 0)
+			threadCount = 0;
+	}
+	m_dequeCount = threadCount + 1;
+	m_deques.reset(new Deque[m_dequeCount]);
+	for (int i = 0; i < threadCount; i++)
+		m_threads.push_back(std::thread(&CWorkerPool::workerMain, this, i));
+}
+
+CWorkerPool::~CWorkerPool(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_threads.size(); i++)
+		m_threads[i].join();
+}
+
+int CWorkerPool::getWorkerIndex(void) const
+{
+	return t_pool == this ? t_index : (int)m_threads.size();
+}
+
+void CWorkerPool::parallelFor(int count, const std::function<void(int)>& fn)
+{
+	if (count <= 0)
+		return;
+
+	// not worth waking anybody
+	if (m_threads.empty() || count == 1) {
+		for (int i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+
+	int grain = count / (RANGES_PER_THREAD * m_dequeCount);
+	if (grain < 1)
+		grain = 1;
+	std::atomic<int> pending(count);
+	runRange(0, count, grain, fn, pending);
+	wait(pending);
+}
+
+// the back half goes to the deque, where a thief takes the largest piece
+// first, until what is left is one grain
+void CWorkerPool::runRange(int begin, int end, int grain, const std::function<void(int)>& fn, std::atomic<int>& pending)
+{
+	while (end - begin > grain) {
+		int mid = begin + (end - begin) / 2;
+		submit([this, mid, end, grain, &fn, &pending] { runRange(mid, end, grain, fn, pending); });
+		end = mid;
+	}
+	for (int i = begin; i < end; i++)
+		fn(i);
+	pending.fetch_sub(end - begin);
+}
+
+void CWorkerPool::submit(Task task)
+{
+	Deque& d = m_deques[getWorkerIndex()];
+	{
+		std::lock_guard<std::mutex> lock(d.mutex);
+		d.tasks.push_back(std::move(task));
+	}
+	m_queued.fetch_add(1);
+
+	// a worker about to sleep has either seen the count or is waiting
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wake.notify_one();
+}
+
+void CWorkerPool::wait(const std::atomic<int>& pending)
+{
+	const int self = getWorkerIndex();
+	while (pending.load() > 0) {
+		if (!runOne(self))
+			std::this_thread::yield();
+	}
+}
+
+// own deque newest first, then the others oldest first, starting next door
+bool CWorkerPool::runOne(int self)
+{
+	Task task;
+	for (int k = 0; k < m_dequeCount && !task; k++) {
+		Deque& d = m_deques[(self + k) % m_dequeCount];
+		std::lock_guard<std::mutex> lock(d.mutex);
+		if (d.tasks.empty())
+			continue;
+		if (k == 0) {
+			task = std::move(d.tasks.back());
+			d.tasks.pop_back();
+		}
+		else {
+			task = std::move(d.tasks.front());
+			d.tasks.pop_front();
+		}
+	}
+	if (!task)
+		return false;
+
+	m_queued.fetch_sub(1);
+	task();
+	return true;
+}
+
+void CWorkerPool::workerMain(int index)
+{
+	t_pool = this;
+	t_index = index;
+
+	for (;;) {
+		if (runOne(index))
+			continue;
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wake.wait(lock, [this] { return m_quit || m_queued.load() > 0; });
+		if (m_quit)
+			return;
+	}
+}
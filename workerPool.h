@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File: workerPool.h
+//
+// Desc: Fixed set of worker threads with a task deque each. A thread runs
+//       the newest task of its own deque first and, when that is empty,
+//       steals the oldest task of another. Threads outside the pool share
+//       one more deque.
+//
+//       A thread that waits for tasks runs tasks meanwhile, so the calling
+//       thread takes part in every loop (a pool of N threads runs N + 1
+//       items at a time), parallelFor() may be called from inside a task,
+//       and several threads may use the pool at once.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __workerPoolH__
+#define __workerPoolH__
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class CWorkerPool {
+public:
+	typedef std::function<void(void)> Task;
+
+	// threadCount < 0 picks hardware_concurrency() - 1 workers
+	explicit CWorkerPool(int threadCount = -1);
+	~CWorkerPool(void);
+
+	int getThreadCount(void) const { return (int)m_threads.size(); }
+
+	// runs fn(0) .. fn(count - 1) and returns when all of them are done.
+	// items are handed out in no particular order; callers that need
+	// deterministic results must not depend on it.
+	void parallelFor(int count, const std::function<void(int)>& fn);
+
+	// queues task on the calling thread's deque. the task has to count
+	// itself done somewhere that wait() is given
+	void submit(Task task);
+
+	// runs queued tasks, anybody's, until pending is 0
+	void wait(const std::atomic<int>& pending);
+
+	// 0 .. getThreadCount() - 1 on the pool's threads, getThreadCount()
+	// on any other thread
+	int getWorkerIndex(void) const;
+
+private:
+	CWorkerPool(const CWorkerPool&);
+	CWorkerPool& operator=(const CWorkerPool&);
+
+	struct Deque {
+		std::mutex			mutex;
+		std::deque<Task>	tasks;
+	};
+
+	void workerMain(int index);
+	bool runOne(int self);
+	void runRange(int begin, int end, int grain, const std::function<void(int)>& fn, std::atomic<int>& pending);
+
+	std::vector<std::thread>			m_threads;
+	std::unique_ptr<Deque[]>			m_deques;		// one per thread, the last for other threads
+	int									m_dequeCount;
+	std::atomic<int>					m_queued;		// tasks in all deques
+
+	std::mutex							m_sleepMutex;
+	std::condition_variable				m_wake;
+	bool								m_quit;
+};
+
+#endif // __workerPoolH__